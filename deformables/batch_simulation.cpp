@@ -0,0 +1,266 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "batch_simulation.h"
+#include "parallel_for.h"
+#include <conio.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+
+// Same as Cteschner_deformableApp::simtick(): this many consecutive ticks
+// with enormous velocities or accelerations means the simulation exploded
+#define VERY_BIG 1e10
+#define MAX_VERY_BIG_ITERATIONS 20
+
+int run_mesh_to_steady_state(cTeschnerMesh* ctm, const steady_state_criteria& criteria,
+	float* steady_state_time) {
+
+	if (criteria.static_solve) return run_mesh_to_static_equilibrium(ctm, steady_state_time);
+
+	if (steady_state_time) *steady_state_time = -1.0f;
+
+	int very_big_iterations = 0;
+	float steady_state_start_time = -1.0f;
+
+	while (1) {
+
+		float curtime = ctm->m_current_sim_time;
+
+		float maxvel = ctm->m_maximum_vertex_velocity;
+		float meanvel = fabs(ctm->m_mean_vertex_velocity);
+		float maxaccel = ctm->m_maximum_vertex_acceleration;
+		float meanaccel = fabs(ctm->m_mean_vertex_acceleration);
+
+		if (maxvel > VERY_BIG || meanvel > VERY_BIG || maxaccel > VERY_BIG || meanaccel > VERY_BIG) {
+			very_big_iterations++;
+		}
+		else {
+			very_big_iterations = 0;
+		}
+
+		bool way_too_big = (very_big_iterations > MAX_VERY_BIG_ITERATIONS);
+
+		if (curtime >= criteria.minimum_simtime || way_too_big) {
+
+			bool steadystate = (
+				((criteria.max_acceleration_threshold < 0.0) || (maxaccel < criteria.max_acceleration_threshold))
+				&&
+				((criteria.max_velocity_threshold < 0.0) || (maxvel < criteria.max_velocity_threshold))
+				&&
+				((criteria.mean_acceleration_threshold < 0.0) || (meanaccel < criteria.mean_acceleration_threshold))
+				&&
+				((criteria.mean_velocity_threshold < 0.0) || (meanvel < criteria.mean_velocity_threshold))
+				);
+
+			if (_isnan(maxvel) || _isnan(meanvel) || _isnan(maxaccel) || _isnan(meanaccel)) {
+				return RESULT_ERROR;
+			}
+
+			if (steadystate == false && curtime > criteria.maximum_simtime) {
+				return RESULT_NO_STEADY_STATE;
+			}
+
+			if (way_too_big) {
+				return RESULT_NO_STEADY_STATE;
+			}
+
+			if (steadystate) {
+
+				// This means we weren't previously at steady-state
+				if (steady_state_start_time < 0) {
+					steady_state_start_time = curtime;
+				}
+				else if (curtime - steady_state_start_time >= criteria.required_time_at_steady_state) {
+					if (steady_state_time) *steady_state_time = curtime;
+					return RESULT_STEADY_STATE;
+				}
+			}
+			else {
+				steady_state_start_time = -1.0f;
+			}
+		}
+
+		if (ctm->tick() == false) return RESULT_ERROR;
+
+	}
+
+} // run_mesh_to_steady_state
+
+
+int run_mesh_to_static_equilibrium(cTeschnerMesh* ctm, float* steady_state_time,
+	int* iterations, float* residual) {
+
+	int result = ctm->solve_static(iterations, residual);
+
+	if (steady_state_time) {
+		*steady_state_time = (result == STATIC_SOLVE_CONVERGED) ? ctm->m_current_sim_time : -1.0f;
+	}
+
+	if (result == STATIC_SOLVE_CONVERGED) return RESULT_STEADY_STATE;
+	if (result == STATIC_SOLVE_NOT_CONVERGED) return RESULT_NO_STEADY_STATE;
+	return RESULT_ERROR;
+
+} // run_mesh_to_static_equilibrium
+
+
+struct batch_job {
+	std::vector<cTeschnerMesh*>* meshes;
+	std::vector<batch_result>* results;
+	const steady_state_criteria* criteria;
+};
+
+// Runs one parameter set to completion
+static void run_batch_instance(void* param, int chunk, int thread_index) {
+
+	batch_job* job = (batch_job*)(param);
+	cTeschnerMesh* ctm = (*(job->meshes))[chunk];
+	batch_result& r = (*(job->results))[chunk];
+
+	r.result = run_mesh_to_steady_state(ctm, *(job->criteria), &(r.steady_state_time));
+	r.final_sim_time = ctm->m_current_sim_time;
+
+	r.final_positions.resize(3 * ctm->m_nVertices);
+	for (unsigned int i = 0; i < ctm->m_nVertices; i++) {
+		for (int k = 0; k < 3; k++) {
+			r.final_positions[3 * i + k] = ctm->m_vertex_state.pos[k][i];
+		}
+	}
+
+}
+
+
+int run_batch_simulation(cTeschnerMesh* prototype,
+	const std::vector<batch_parameter_set>& parameter_sets,
+	const steady_state_criteria& criteria,
+	std::vector<batch_result>& results,
+	int num_threads) {
+
+	results.clear();
+
+	if (prototype == 0 || prototype->m_initialized == false) {
+		_cprintf("Can't run a batch without an initialized mesh\n");
+		return -1;
+	}
+
+	unsigned int nsets = parameter_sets.size();
+	results.resize(nsets);
+	if (nsets == 0) return 0;
+
+	// Constraints may live on the top-level mesh even if the simulation
+	// is happening in its child
+	constraint_set* prototype_constraints = prototype->m_constraints;
+	if (prototype_constraints == 0 && prototype->m_proxy_sim_mesh)
+		prototype_constraints = prototype->m_proxy_sim_mesh->m_constraints;
+
+	// Set up all the meshes here, before any threads start; chai objects
+	// aren't safe to create concurrently
+	std::vector<cTeschnerMesh*> meshes(nsets);
+	unsigned int i;
+	int retval = 0;
+
+	for (i = 0; i < nsets; i++) {
+
+		cTeschnerMesh* ctm = new cTeschnerMesh(prototype->getParentWorld());
+		meshes[i] = ctm;
+
+		if (ctm->initialize_shared(prototype) < 0) {
+			retval = -1;
+			continue;
+		}
+
+		const batch_parameter_set& p = parameter_sets[i];
+		ctm->m_kVolumePreservation = p.kVolumePreservation;
+		ctm->m_kAreaPreservation = p.kAreaPreservation;
+		ctm->m_kDistancePreservation = p.kDistancePreservation;
+		ctm->m_kDistanceDamping = p.kDistanceDamping;
+		ctm->m_heterogeneous_constant_flags &=
+			~((1 << KVOLUME) | (1 << KAREA) | (1 << KDISTANCE) | (1 << KDAMPING));
+
+		// Each instance steps on one thread; the parallelism is across
+		// instances
+		ctm->m_num_threads = 1;
+
+		// Constraint sets keep their own position in time, so each mesh
+		// needs one, but the constraints themselves are shared
+		if (prototype_constraints) {
+			ctm->m_constraints = new constraint_set;
+			std::multiset<constraint*, lt_constraint_start>::iterator iter;
+			for (iter = prototype_constraints->constraints_by_start_time.begin();
+				iter != prototype_constraints->constraints_by_start_time.end();
+				iter++) {
+				ctm->m_constraints->add_constraint(*iter);
+			}
+			ctm->m_constraints->reset();
+		}
+
+	}
+
+	if (retval == 0) {
+
+		_cprintf("Running %d parameter sets...\n", nsets);
+
+		batch_job job;
+		job.meshes = &meshes;
+		job.results = &results;
+		job.criteria = &criteria;
+
+		parallel_for_chunks(nsets, run_batch_instance, &job, num_threads);
+
+		_cprintf("Finished running %d parameter sets...\n", nsets);
+	}
+
+	for (i = 0; i < nsets; i++) {
+		cTeschnerMesh* ctm = meshes[i];
+		if (ctm->m_constraints) {
+			// The constraints belong to the prototype
+			ctm->m_constraints->clear();
+			delete ctm->m_constraints;
+		}
+		delete ctm;
+	}
+
+	return retval;
+
+} // run_batch_simulation
+
+
+bool write_batch_results(const char* filename,
+	const std::vector<batch_parameter_set>& parameter_sets,
+	const std::vector<batch_result>& results) {
+
+	FILE* f = fopen(filename, "w");
+	if (f == 0) {
+		_cprintf("Could not open batch output file %s\n", filename);
+		return false;
+	}
+
+	fprintf(f, "# kvolume karea kdistance kdamping result steady_state_time final_sim_time nvertices\n");
+
+	for (unsigned int i = 0; i < results.size() && i < parameter_sets.size(); i++) {
+		const batch_parameter_set& p = parameter_sets[i];
+		const batch_result& r = results[i];
+		unsigned int nvertices = r.final_positions.size() / 3;
+
+		fprintf(f, "%f %f %f %f %d %f %f %d\n",
+			p.kVolumePreservation, p.kAreaPreservation, p.kDistancePreservation, p.kDistanceDamping,
+			r.result, r.steady_state_time, r.final_sim_time, nvertices);
+
+		for (unsigned int j = 0; j < nvertices; j++) {
+			fprintf(f, "%f %f %f\n", r.final_positions[3 * j], r.final_positions[3 * j + 1],
+				r.final_positions[3 * j + 2]);
+		}
+	}
+
+	fclose(f);
+	return true;
+
+} // write_batch_results
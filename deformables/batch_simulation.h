@@ -0,0 +1,129 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Headless batch simulation, for calibration sweeps: the same mesh run to
+  steady state with many different sets of spring constants.
+
+  Each parameter set gets its own cTeschnerMesh, set up with
+  cTeschnerMesh::initialize_shared(), so the connectivity and rest state
+  (faces, edges, containing-element arrays, rest lengths/areas/volumes) are
+  stored once no matter how many sets there are.  The meshes are stepped
+  concurrently, one per thread, with the same steady-state test that
+  Cteschner_deformableApp::simtick() uses; nothing is rendered.
+
+***********/
+
+#ifndef _BATCH_SIMULATION_H_
+#define _BATCH_SIMULATION_H_
+
+#include "cTeschnerMesh.h"
+#include <vector>
+#include <float.h>
+
+typedef enum {
+  RESULT_NOT_DONE_YET=0,RESULT_STEADY_STATE,RESULT_NO_STEADY_STATE,
+  RESULT_ERROR,RESULT_MANUAL_TERMINATION,RESULT_MANUAL_PAUSE
+} steady_state_result;
+
+// When is a simulation at steady state?  These mean the same thing as the
+// corresponding Cteschner_deformableApp members (set by the
+// steady_state_output and steady_state_parameters problem file commands);
+// a negative threshold is ignored.
+struct steady_state_criteria {
+	float minimum_simtime;
+	float maximum_simtime;
+	float required_time_at_steady_state;
+	float max_velocity_threshold;
+	float mean_velocity_threshold;
+	float max_acceleration_threshold;
+	float mean_acceleration_threshold;
+
+	// If this is set, the thresholds and times are ignored, and each mesh
+	// is moved straight to equilibrium by cTeschnerMesh::solve_static()
+	bool static_solve;
+
+	steady_state_criteria() {
+		minimum_simtime = 0.0f;
+		maximum_simtime = FLT_MAX;
+		required_time_at_steady_state = 0.0f;
+		max_velocity_threshold = -1.0f;
+		mean_velocity_threshold = -1.0f;
+		max_acceleration_threshold = -1.0f;
+		mean_acceleration_threshold = -1.0f;
+		static_solve = false;
+	}
+};
+
+// One set of constants to try; everything else comes from the prototype
+struct batch_parameter_set {
+	float kVolumePreservation;
+	float kAreaPreservation;
+	float kDistancePreservation;
+	float kDistanceDamping;
+};
+
+struct batch_result {
+
+	// A steady_state_result
+	int result;
+
+	// The sim time at which steady state was reached (or -1)
+	float steady_state_time;
+
+	// The sim time at which we stopped
+	float final_sim_time;
+
+	// x,y,z for each vertex, in the mesh's local frame
+	std::vector<float> final_positions;
+};
+
+// Ticks [ctm] until it reaches steady state, blows up, or passes
+// criteria.maximum_simtime; returns a steady_state_result.
+//
+// If [steady_state_time] is supplied, it gets the sim time at which steady
+// state was reached (or -1).
+int run_mesh_to_steady_state(cTeschnerMesh* ctm, const steady_state_criteria& criteria,
+	float* steady_state_time = 0);
+
+// Moves [ctm] straight to equilibrium with cTeschnerMesh::solve_static();
+// returns a steady_state_result.
+//
+// [steady_state_time], [iterations], and [residual], if supplied, get the
+// sim time at which steady state was reached (or -1), the number of solver
+// iterations, and the largest remaining force on any free vertex.
+int run_mesh_to_static_equilibrium(cTeschnerMesh* ctm, float* steady_state_time = 0,
+	int* iterations = 0, float* residual = 0);
+
+// Runs [prototype] (which has to be initialized) to steady state once for
+// each parameter set, using up to [num_threads] threads (less than one
+// means one per processor).  The prototype's constraints apply to every
+// run; the prototype itself isn't touched.
+//
+// Each set replaces the prototype's homogeneous constants, and any
+// heterogeneous values for those constants.
+//
+// [results] gets one entry per parameter set.  Returns -1 if there's an
+// error, zero if all goes well (whatever the individual results were).
+int run_batch_simulation(cTeschnerMesh* prototype,
+	const std::vector<batch_parameter_set>& parameter_sets,
+	const steady_state_criteria& criteria,
+	std::vector<batch_result>& results,
+	int num_threads = 0);
+
+// Writes one line per parameter set (constants, result, times), followed
+// by that set's final vertex positions, one vertex per line
+bool write_batch_results(const char* filename,
+	const std::vector<batch_parameter_set>& parameter_sets,
+	const std::vector<batch_result>& results);
+
+#endif
@@ -9,6 +9,12 @@
 #define DEFAULT_K_DISTANCE 1000000.0
 #define DEFAULT_DISTANCE_DAMPING 20.0
 
+#define DEFAULT_IMPLICIT_MAX_ITERATIONS 200
+#define DEFAULT_IMPLICIT_TOLERANCE 1.0e-4
+
+#define DEFAULT_STATIC_MAX_ITERATIONS 2000
+#define DEFAULT_STATIC_TOLERANCE 1.0e-4
+
 #define DEFAULT_PARTICLE_MASS 0.1
 #define DEFAULT_TET_DENSITY 100.0
 #define DEFAULT_TOTAL_MASS 1.0
@@ -39,9 +45,15 @@ int g_debug_vertex_index = 0;
 
 #include <set>
 #include <map>
+#include <algorithm>
 #include <math.h>
 #include <float.h>
 #include "CVertex.h"
+#include "parallel_for.h"
+#include "teschner_snapshot.h"
+#include "teschner_implicit.h"
+#include "teschner_simd.h"
+#include "teschner_skinning.h"
 using std::set;
 using std::map;
 
@@ -319,6 +331,9 @@ cTeschnerMesh::cTeschnerMesh(cWorld* a_parentWorld) : teschner_mesh_parent_mesh_
 	m_use_coordinate_frame_based_skinning = true;
 
 	m_initialized = false;
+	m_shares_connectivity = false;
+	m_snapshot_root[0] = '\0';
+	m_snapshot_key = 0;
 	m_renderFromVBO = false;
 	m_rendering_mesh = 0;
 	m_vertex_effectors = 0;
@@ -375,11 +390,27 @@ cTeschnerMesh::cTeschnerMesh(cWorld* a_parentWorld) : teschner_mesh_parent_mesh_
 	m_kFloor = DEFAULT_K_FLOOR;
 	m_floor_position = DEFAULT_FLOOR_POSITION;
 
+	m_num_threads = 0;
+
+	m_integrator = INTEGRATOR_VERLET;
+	m_implicit_max_iterations = DEFAULT_IMPLICIT_MAX_ITERATIONS;
+	m_implicit_tolerance = DEFAULT_IMPLICIT_TOLERANCE;
+	m_implicit = 0;
+	m_skinning = 0;
+	m_worker_pool = 0;
+	m_worker_pool_num_threads = 0;
+
+	m_static_max_iterations = DEFAULT_STATIC_MAX_ITERATIONS;
+	m_static_tolerance = DEFAULT_STATIC_TOLERANCE;
+
 	// Zero out array variables
 	m_faceNormalsAndAreas = 0;
 	m_edgeLengths = m_tetVolumes = 0;
 
-	m_deformableVertices = m_previousPositions = 0;
+	m_faceUnitNormals = m_faceAreaForces = m_edgeForces = 0;
+	m_tetVolumeForceScales = 0;
+
+	m_deformableVertices = 0;
 
 	m_restFaceNormalsAndAreas = 0;
 	m_restEdgeLengths = m_restTetVolumes = 0;
@@ -392,6 +423,10 @@ cTeschnerMesh::cTeschnerMesh(cWorld* a_parentWorld) : teschner_mesh_parent_mesh_
 
 	m_containingTets = m_containingFaces = m_containingEdges = 0;
 
+	m_bkup_faceNormalsAndAreas = 0;
+	m_bkup_edgeLengths = m_bkup_tetVolumes = 0;
+	m_bkup_deformableVertices = 0;
+
 	m_heterogeneous_constants = false;
 
 	m_hetero_kVolumePreservation = 0;
@@ -406,12 +441,30 @@ cTeschnerMesh::cTeschnerMesh(cWorld* a_parentWorld) : teschner_mesh_parent_mesh_
 
 cTeschnerMesh::~cTeschnerMesh() {
 
+	// If I was set up by initialize_shared(), these belong to my prototype
+	if (m_shares_connectivity) {
+		m_restEdgeLengths = 0;
+		m_restFaceNormalsAndAreas = 0;
+		m_restTetVolumes = 0;
+		m_faces = 0;
+		m_edges = 0;
+		m_opposingFaces = 0;
+		m_containingTets = 0;
+		m_containingFaces = 0;
+		m_containingEdges = 0;
+		m_tets = 0;
+		m_nTets = 0;
+	}
+
 	// Delete lots of arrays
 	SAFE_ARRAY_DELETE(m_faceNormalsAndAreas);
 	SAFE_ARRAY_DELETE(m_edgeLengths);
 	SAFE_ARRAY_DELETE(m_tetVolumes);
+	SAFE_ARRAY_DELETE(m_faceUnitNormals);
+	SAFE_ARRAY_DELETE(m_faceAreaForces);
+	SAFE_ARRAY_DELETE(m_edgeForces);
+	SAFE_ARRAY_DELETE(m_tetVolumeForceScales);
 	SAFE_ARRAY_DELETE(m_deformableVertices);
-	SAFE_ARRAY_DELETE(m_previousPositions);
 	SAFE_ARRAY_DELETE(m_restEdgeLengths);
 	SAFE_ARRAY_DELETE(m_restFaceNormalsAndAreas);
 	SAFE_ARRAY_DELETE(m_restTetVolumes);
@@ -432,6 +485,15 @@ cTeschnerMesh::~cTeschnerMesh() {
 	SAFE_ARRAY_DELETE(m_vertex_coordframe_positions);
 	SAFE_ARRAY_DELETE(m_opposite_edge_vertices);
 
+	if (m_implicit) delete m_implicit;
+	m_implicit = 0;
+
+	if (m_skinning) delete m_skinning;
+	m_skinning = 0;
+
+	if (m_worker_pool) delete m_worker_pool;
+	m_worker_pool = 0;
+
 	m_nFaces = m_nEdges = 0;
 
 	clear_solid_sections();
@@ -454,66 +516,79 @@ void cTeschnerMesh::clear_solid_sections() {
 
 }
 
-bool cTeschnerMesh::tick() {
+// Adds [sign] times [f] to the constraint force on each of [vertices]
+static void scatter_constraint_force(deformable_vertex_state& s, const std::vector<unsigned int>& vertices,
+	const cVector3f& f, float sign) {
 
-	m_current_sim_time += m_timestep;
+	unsigned int n = vertices.size();
+	if (n == 0) return;
+	const unsigned int* index = &(vertices[0]);
 
-	// _cprintf("Sim time is %f\n",m_current_sim_time);
+	for (int a = 0; a < 3; a++) {
+		float* cf = s.constraint_force[a];
+		float fa = sign * f[a];
+		for (unsigned int i = 0; i < n; i++) cf[index[i]] += fa;
+	}
+}
+
+// Moves each of [vertices] to [p]
+static void scatter_position(deformable_vertex_state& s, const std::vector<unsigned int>& vertices,
+	const cVector3f& p) {
+
+	unsigned int n = vertices.size();
+	if (n == 0) return;
+	const unsigned int* index = &(vertices[0]);
+
+	for (int a = 0; a < 3; a++) {
+		float* pos = s.pos[a];
+		float pa = p[a];
+		for (unsigned int i = 0; i < n; i++) pos[index[i]] = pa;
+	}
+}
+
+void cTeschnerMesh::update_constraints() {
 
-	// Add or remove constraints
 	if (m_constraints) {
 
-		constraint* c;
+		constraint_set* cs = m_constraints;
+		if (cs->needs_compile(m_nVertices)) cs->compile(m_nVertices);
+
+		cs->last_update_cost = constraint_update_cost();
+
+		scheduled_constraint* sc;
 
 		while (1) {
-			c = m_constraints->get_next_constraint_start(m_current_sim_time);
-			if (c == 0) break;
+			sc = cs->get_next_constraint_start(m_current_sim_time);
+			if (sc == 0) break;
+
+			constraint* c = sc->c;
+			const std::vector<unsigned int>& vertices = sc->vertices;
+			unsigned int nVertices = vertices.size();
+			unsigned int i;
 
 			// _cprintf("Applying a constraint of type %d at time %f\n",c->type,m_current_sim_time);
 
 			if (c->type == CONSTRAINT_FORCE_CONSTANT) {
 				constraint_force_constant* fc = (constraint_force_constant*)c;
 
-				unsigned int nVertices = fc->affects_all_vertices ? m_nVertices : fc->vertices.size();
-				for (unsigned int i = 0; i < nVertices; i++) {
-					unsigned int index = fc->affects_all_vertices ? i : fc->vertices[i];
-					if (index < 0 || index > m_nVertices) {
-						_cprintf("Illegal vertex %d (of %d)\n", i, m_nVertices);
-						continue;
-					}
-					cDeformableVertex* v = m_deformableVertices + index;
-					v->force_is_constrained++;
-					v->constraint_force += fc->force;
-					/*
-					_cprintf("Applying force %s to vertex %d (%d,%s)\n",
-					   fc->force.str().c_str(),
-					  index,
-					  (int)v->force_is_constrained,
-					  v->constraint_force.str().c_str());
-					*/
-
-				} // for each constrained vertex
-
+				scatter_constraint_force(m_vertex_state, vertices, fc->force, 1.0f);
+				for (i = 0; i < nVertices; i++) {
+					m_deformableVertices[vertices[i]].force_is_constrained++;
+				}
 
 			} // constant force constraint
 
 			else if (c->type == CONSTRAINT_POSITION_CONSTANT) {
 				constraint_position_constant* pc = (constraint_position_constant*)c;
 
+				// A locked vertex just stays where it is
+				if (pc->lock == false) scatter_position(m_vertex_state, vertices, pc->position);
 
-				unsigned int nVertices = pc->affects_all_vertices ? m_nVertices : pc->vertices.size();
-				for (unsigned int i = 0; i < nVertices; i++) {
-					unsigned int index = pc->affects_all_vertices ? i : pc->vertices[i];
-					if (index < 0 || index > m_nVertices) {
-						_cprintf("Illegal vertex %d (of %d)\n", i, m_nVertices);
-						continue;
-					}
-					cDeformableVertex* v = m_deformableVertices + index;
-					cVector3f pos = (pc->lock) ? v->m_pos : pc->position;
-					v->position_is_constrained++;
-					// _cprintf("Applying position constraint %s to vertex %d (%d)\n",pos.str().c_str(),index,(int)(v->position_is_constrained));
-					v->m_pos = pos;
-				} // for each constrained vertex        
+				for (i = 0; i < nVertices; i++) {
+					unsigned int index = vertices[i];
+					m_deformableVertices[index].position_is_constrained++;
+					m_vertex_state.position_free[index] = 0.0f;
+				}
 
 			}
 
@@ -521,45 +596,40 @@ bool cTeschnerMesh::tick() {
 				_cprintf("Unknown constraint type %d\n", c->type);
 			}
 
+			cs->last_update_cost.events++;
+			cs->last_update_cost.vertex_updates += nVertices;
 		}
 
 		while (1) {
-			c = m_constraints->get_next_constraint_end(m_current_sim_time);
-			if (c == 0) break;
+			sc = cs->get_next_constraint_end(m_current_sim_time);
+			if (sc == 0) break;
 
 			else _cprintf("Ending constraint at time %f...\n", m_current_sim_time);
 
+			constraint* c = sc->c;
+			const std::vector<unsigned int>& vertices = sc->vertices;
+			unsigned int nVertices = vertices.size();
+			unsigned int i;
+
 			if (c->type == CONSTRAINT_FORCE_CONSTANT) {
 				constraint_force_constant* fc = (constraint_force_constant*)c;
 
-				unsigned int nVertices = fc->affects_all_vertices ? m_nVertices : fc->vertices.size();
-				for (unsigned int i = 0; i < nVertices; i++) {
-					unsigned int index = fc->affects_all_vertices ? i : fc->vertices[i];
-					if (index < 0 || index > m_nVertices) {
-						_cprintf("Illegal vertex %d (of %d)\n", i, m_nVertices);
-						continue;
-					}
-					cDeformableVertex* v = m_deformableVertices + index;
-					_cprintf("Releasing force %s from vertex %d\n", fc->force.str().c_str(), index);
-					v->force_is_constrained--;
-					v->constraint_force -= fc->force;
-				} // for each constrained vertex        
+				_cprintf("Releasing force %s from %d vertices\n", fc->force.str().c_str(), nVertices);
+				scatter_constraint_force(m_vertex_state, vertices, fc->force, -1.0f);
+				for (i = 0; i < nVertices; i++) {
+					m_deformableVertices[vertices[i]].force_is_constrained--;
+				}
 			}
 
 			else if (c->type == CONSTRAINT_POSITION_CONSTANT) {
-				constraint_position_constant* pc = (constraint_position_constant*)c;
 
-				unsigned int nVertices = pc->affects_all_vertices ? m_nVertices : pc->vertices.size();
-				for (unsigned int i = 0; i < nVertices; i++) {
-					unsigned int index = pc->affects_all_vertices ? i : pc->vertices[i];
-					if (index < 0 || index > m_nVertices) {
-						_cprintf("Illegal vertex %d (of %d)\n", i, m_nVertices);
-						continue;
-					}
+				_cprintf("Releasing %d vertices\n", nVertices);
+				for (i = 0; i < nVertices; i++) {
+					unsigned int index = vertices[i];
 					cDeformableVertex* v = m_deformableVertices + index;
 					v->position_is_constrained--;
-					_cprintf("Released vertex %d (%d)\n", index, (int)(v->position_is_constrained));
-				} // for each constrained vertex
+					if (v->position_is_constrained == 0) m_vertex_state.position_free[index] = 1.0f;
+				}
 
 			}
 
@@ -567,9 +637,28 @@ bool cTeschnerMesh::tick() {
 				_cprintf("Unknown constraint type %d\n", c->type);
 			}
 
+			cs->last_update_cost.events++;
+			cs->last_update_cost.vertex_updates += nVertices;
+
 		} // ending constraints
 
+		cs->total_update_cost.events += cs->last_update_cost.events;
+		cs->total_update_cost.vertex_updates += cs->last_update_cost.vertex_updates;
+
 	} // if we have constraints
+
+} // update_constraints()
+
+
+bool cTeschnerMesh::tick() {
+
+	m_current_sim_time += m_timestep;
+
+	// _cprintf("Sim time is %f\n",m_current_sim_time);
+
+	// Add or remove constraints
+	update_constraints();
+
 	if (m_nVertices == 0) {
 		_cprintf("Deformable mesh not initialized...\n");
 		return false;
@@ -584,7 +673,13 @@ bool cTeschnerMesh::tick() {
 	if (!compute_tet_volumes()) return false;
 	if (!compute_spring_lengths()) return false;
 	if (!compute_forces()) return false;
-	if (!move_vertices()) return false;
+
+	if (m_integrator == INTEGRATOR_IMPLICIT_EULER) {
+		if (!implicit_step()) return false;
+	}
+	else {
+		if (!move_vertices()) return false;
+	}
 
 	return true;
 }
@@ -652,6 +747,11 @@ void cTeschnerMesh::initialize_vertex_masses() {
 	if (m_mass_assignment_strategy != FIXED_VERTEX_MASS)
 		_cprintf("Total mass: %f, min mass: %f, max mass: %f\n", total_mass, minmass, maxmass);
 
+	// The integrator wants 1/mass
+	for (unsigned int i = 0; i < m_nVertices; i++) {
+		m_vertex_state.inverse_mass[i] = 1.0f / m_deformableVertices[i].m_mass;
+	}
+
 }
 
 
@@ -678,104 +778,29 @@ void cTeschnerMesh::prepare_to_render() {
 
 		// std::vector<cVertex>* rendering_vertex_vector = m_rendering_mesh->pVerticesNonEmpty();
 		std::vector<cVertex>* rendering_vertex_vector = m_rendering_mesh->pVertices();
-		cVertex* vertex_array = (cVertex*) &((*rendering_vertex_vector)[0]);
 		unsigned int n_rendering_vertices = rendering_vertex_vector->size();
-		cVertex* cur = vertex_array;
-		cVertex* end = vertex_array + n_rendering_vertices;
-
-		int weight_offset = 0;
-
-		// _cprintf("Rendering from array %x (%d)\n",vertex_array,n_rendering_vertices);
-
-		unsigned int vcount = 0;
-
-		// For each of my rendering mesh's vertices
-		while (cur != end) {
-
-			vcount++;
-			cur->m_localPos.zero();
-
-			// For each relevant effector vertex
-			for (unsigned int j = 0; j < m_weights_per_vertex; j++) {
-
-				// This will be the "vote" from this weight source
-				cVector3f temppos; // (0,0,0);
-
-				// Find the effector point
-				int effector_index = m_vertex_effectors[weight_offset];
-
-				// A -1 value says "no more effectors"
-				if (effector_index < 0) break;
-				cDeformableVertex* cdv = m_deformableVertices + effector_index;
-				temppos = cdv->m_pos;
-
-				if (m_use_coordinate_frame_based_skinning) {
-
-					// One axis is the vertex normal
-					cVector3f axis1 = cdv->m_normal;
-
-					// The next will be the first triangle axis, made perpendicular to the normal
-					unsigned int other_pt_idx = m_opposite_edge_vertices[weight_offset];
-					cVector3f other_pt_pos = m_deformableVertices[other_pt_idx].m_pos;
-					cVector3f edge = other_pt_pos - cdv->m_pos;
-
-					// Component parallel to my normal
-					cVector3f axis2_parallel = (edge*axis1) * axis1;
-
-					// Component perpendicular to my normal
-					cVector3f axis2_perpendicular = edge - axis2_parallel;
-
-					// The normalized perpendicular is my second axis
-					cVector3f axis2 = axis2_perpendicular;
-					axis2.normalize();
-
-					// The third axis will be their cross-product
-					cVector3f axis3 = axis1;
-					axis3.cross(axis2);
-
-					cVector3f offset_in_vertex_space = m_vertex_coordframe_positions[weight_offset];
-
-					cVector3f offset_in_world_space =
-						axis1 * offset_in_vertex_space.x +
-						axis2 * offset_in_vertex_space.y +
-						axis3 * offset_in_vertex_space.z;
-
-					temppos += offset_in_world_space;
-
-#ifdef DEBUG_VERTEX_INDEX
-					if (cur == vertex_array + DEBUG_VERTEX_INDEX) {
-						int i = cur - vertex_array;
-						cVector3f origin = cdv->m_pos;
-						_cprintf("Handling vertex %d,%d (%d) (wo %d): origin %s, otherpos %s, axis1 %s, axis2 %s, axis3 %s, vspace %s, wspace %s\n",
-							i, weight_offset, g_debug_vertex_index, weight_offset,
-							origin.str(2).c_str(),
-							other_pt_pos.str(2).c_str(),
-							axis1.str(2).c_str(), axis2.str(2).c_str(), axis3.str(2).c_str(),
-							offset_in_vertex_space.str(2).c_str(),
-							offset_in_world_space.str(2).c_str());
-						// _getch();
-					}
-#endif
-				}
-
-				else {
 
-					// Add his current position to the stored offset times his normal + plus the
-					// tangential offset
-					temppos.add(m_vertex_normal_offsets[weight_offset] * (cdv->m_normal));
-					temppos.add(m_vertex_tangential_offsets[weight_offset]);
-				}
-
-				// Multiply by the stored weight and store this vertex's new position
-				temppos.mul(m_vertex_weights[weight_offset]);
-				cur->m_localPos += cVector3d(temppos.x, temppos.y, temppos.z);
-				weight_offset++;
+		// Pack the weights the first time through (or if the rendering
+		// mesh has changed size)
+		if (m_skinning && m_skinning->n_rendering_vertices != n_rendering_vertices) {
+			delete m_skinning;
+			m_skinning = 0;
+		}
 
-			} // for each effector
+		if (m_skinning == 0 && n_rendering_vertices > 0) {
+			m_skinning = new skinning_engine;
+			if (m_skinning->build(this, n_rendering_vertices) == false) {
+				delete m_skinning;
+				m_skinning = 0;
+			}
+		}
 
-			cur++;
+		if (m_skinning) {
+			cVertex* vertex_array = (cVertex*) &((*rendering_vertex_vector)[0]);
+			m_skinning->update(this, m_num_threads);
+			m_skinning->copy_to_vertices(vertex_array, m_num_threads);
+		}
 
-		} // for each vertex in my rendering mesh
 	} // if I have a rendering mesh
 
 	// I really want to do this just when I'm rendering the boxes,
@@ -801,9 +826,9 @@ void cTeschnerMesh::prepare_to_render() {
 			cDeformableVertex* dv = &(m_deformableVertices[i]);
 			// Copy vertex position to the rendering array
 			vertex_array[i].setPos(
-				dv->m_pos.x,
-				dv->m_pos.y,
-				dv->m_pos.z);
+				m_vertex_state.pos[0][i],
+				m_vertex_state.pos[1][i],
+				m_vertex_state.pos[2][i]);
 
 			if (m_compute_vertex_normals) {
 				if (m_use_cmesh_normal_computation) {
@@ -887,30 +912,6 @@ inline bool isDegenerateTet(const unsigned int* t, cVertex* vertex_array) {
 }
 
 
-struct ltface {
-	inline bool operator()(const face& f1, const face& f2) const
-	{
-		if (f1.v0 < f2.v0) return true;
-		else if (f1.v0 > f2.v0) return false;
-		else if (f1.v1 < f2.v1) return true;
-		else if (f1.v1 > f2.v1) return false;
-		else if (f1.v2 < f2.v2) return true;
-		return false;
-	}
-};
-
-
-struct ltedge {
-	inline bool operator()(const edge& e1, const edge& e2) const
-	{
-		if (e1.v0 < e2.v0) return true;
-		else if (e1.v0 > e2.v0) return false;
-		else if (e1.v1 < e2.v1) return true;
-		return false;
-	}
-};
-
-
 int cTeschnerMesh::clear_constraints() {
 
 	if (m_initialized == false) return -1;
@@ -942,7 +943,7 @@ int cTeschnerMesh::reset() {
 	memcpy(m_tetVolumes, m_bkup_tetVolumes, m_nTets * sizeof(float));
 
 	memcpy(m_deformableVertices, m_bkup_deformableVertices, m_nVertices * sizeof(cDeformableVertex));
-	memcpy(m_previousPositions, m_bkup_deformableVertices, m_nVertices * sizeof(cDeformableVertex));
+	m_vertex_state.copy_from(m_bkup_vertex_state);
 
 	if (m_constraints) {
 		m_constraints->reset();
@@ -1000,7 +1001,7 @@ void cTeschnerMesh::process_pending_constant_assignments() {
 		// _cprintf("Processing %d vertices...\n",cur.vertices.size());
 		for (viter = cur.vertices.begin(); viter != cur.vertices.end(); viter++) {
 			unsigned int curindex = *viter;
-			if (curindex > m_nVertices) {
+			if (curindex >= m_nVertices) {
 				_cprintf("Illegal constant assignment to vertex %d\n", curindex);
 				continue;
 			}
@@ -1039,50 +1040,245 @@ void cTeschnerMesh::initialize_nonhomogeneity() {
 
 }
 
-int cTeschnerMesh::initialize(cTeschnerMesh* old_model) {
+/***
+Topology construction, used by initialize()
 
-	_cprintf("Initializing deformable mesh...\n");
-	// _getch();
+Every tet face (and edge) is filed under its smallest vertex, with the
+other vertices packed into a 64-bit key.  Sorting each vertex's (short)
+list then puts all copies of a face next to each other, and walking the
+vertices in order numbers the unique faces in lexicographic order.  The
+per-vertex sorts are independent, so they run in parallel.
+***/
 
-	if (old_model) {
-		void* dst_begin = (void*)(&(this->BEGIN_CONSTANTS));
-		void* src_begin = (void*)(&(old_model->BEGIN_CONSTANTS));
-		void* dst_end = (void*)(&(this->END_CONSTANTS));
-		unsigned int length = (char*)dst_end - (char*)dst_begin;
-		memcpy(dst_begin, src_begin, length);
-		if (m_constraints) m_constraints->reset();
+// Vertices per work item when building connectivity
+#define TOPOLOGY_CHUNK_SIZE 1024
+
+struct topology_entry {
+
+	// The element's other vertices: (v1 << 32) | v2 for faces, v1 for edges
+	unsigned long long key;
+
+	// Where this copy came from (4*tet+face for faces)
+	unsigned int source;
+
+	inline bool operator<(const topology_entry& other) const {
+		if (key < other.key) return true;
+		if (key > other.key) return false;
+		return (source < other.source);
 	}
+};
 
-	m_current_sim_time = 0.0f;
-	GetSystemTime(&m_sim_start_date_and_time);
+struct topology_job {
+	topology_entry* entries;
 
-	// TODO: I should probably descend properly through my children here
-	if (m_nTets == 0) {
-		if (getNumChildren() == 0) {
-			_cprintf("Oops... I have no tets and no children...\n");
-			return -1;
+	// [nVertices+1] offsets of each vertex's entries
+	const unsigned int* bucket_start;
+
+	// Unique elements per vertex (pass 0), then the index of each vertex's
+	// first unique element (pass 1)
+	unsigned int* bucket_elements;
+
+	unsigned int nVertices;
+	int num_chunks;
+	int pass;
+
+	// Outputs for pass 1; one of faces/edges is used
+	face* faces;
+	edge* edges;
+
+	// Optional: the element index for each entry's source
+	unsigned int* source_element;
+};
+
+static void topology_chunk(void* param, int chunk, int thread_index) {
+
+	topology_job* job = (topology_job*)(param);
+
+	unsigned int first = chunk * TOPOLOGY_CHUNK_SIZE;
+	unsigned int last = first + TOPOLOGY_CHUNK_SIZE;
+	if (last > job->nVertices) last = job->nVertices;
+
+	for (unsigned int v = first; v < last; v++) {
+
+		topology_entry* begin = job->entries + job->bucket_start[v];
+		topology_entry* end = job->entries + job->bucket_start[v + 1];
+
+		if (job->pass == 0) {
+			std::sort(begin, end);
+			unsigned int nunique = 0;
+			for (topology_entry* e = begin; e < end; e++) {
+				if (e == begin || e->key != (e - 1)->key) nunique++;
+			}
+			job->bucket_elements[v] = nunique;
+			continue;
 		}
-		cTeschnerMesh* ctm = dynamic_cast<cTeschnerMesh*>(getChild(0));
-		if (ctm == 0) {
-			_cprintf("Oops... my child is not a teschner mesh...\n");
-			return -1;
+
+		unsigned int element = job->bucket_elements[v] - 1;
+		for (topology_entry* e = begin; e < end; e++) {
+			if (e == begin || e->key != (e - 1)->key) {
+				element++;
+				if (job->faces)
+					job->faces[element] = face(v, (unsigned int)(e->key >> 32), (unsigned int)(e->key & 0xffffffff));
+				else
+					job->edges[element] = edge(v, (unsigned int)(e->key));
+			}
+			if (job->source_element) job->source_element[e->source] = element;
 		}
-		_cprintf("Deferring operation to my child...\n");
-		m_proxy_sim_mesh = ctm;
-		return ctm->initialize();
 	}
 
-	m_proxy_sim_mesh = 0;
+}
 
-	// Create connectivity (face and edge) data from tet data
-	set<face, ltface> faces;
-	set<edge, ltedge> edges;
+// Given entries filed by vertex (bucket_start has nVertices+1 offsets),
+// sorts each vertex's entries and numbers the unique elements starting at
+// [first_element]; [bucket_elements] gets the index of each vertex's first
+// unique element.  Returns the number of unique elements.
+static unsigned int count_unique_elements(topology_entry* entries, const unsigned int* bucket_start,
+	unsigned int nVertices, unsigned int first_element, std::vector<unsigned int>& bucket_elements,
+	int num_threads) {
+
+	bucket_elements.resize(nVertices + 1);
+
+	topology_job job;
+	job.entries = entries;
+	job.bucket_start = bucket_start;
+	job.bucket_elements = &(bucket_elements[0]);
+	job.nVertices = nVertices;
+	job.num_chunks = (nVertices + TOPOLOGY_CHUNK_SIZE - 1) / TOPOLOGY_CHUNK_SIZE;
+	job.faces = 0;
+	job.edges = 0;
+	job.source_element = 0;
+
+	// Sort and count
+	job.pass = 0;
+	parallel_for_chunks(job.num_chunks, topology_chunk, &job, num_threads);
+
+	// Turn counts into starting indices
+	unsigned int total = first_element;
+	for (unsigned int v = 0; v < nVertices; v++) {
+		unsigned int count = bucket_elements[v];
+		bucket_elements[v] = total;
+		total += count;
+	}
+
+	return total - first_element;
+
+}
+
+// Fills in [faces] or [edges] (and [source_element], if it's non-null) from
+// entries that count_unique_elements() has already sorted
+static void fill_unique_elements(topology_entry* entries, const unsigned int* bucket_start,
+	unsigned int nVertices, std::vector<unsigned int>& bucket_elements, face* faces, edge* edges,
+	unsigned int* source_element, int num_threads) {
+
+	topology_job job;
+	job.entries = entries;
+	job.bucket_start = bucket_start;
+	job.bucket_elements = &(bucket_elements[0]);
+	job.nVertices = nVertices;
+	job.num_chunks = (nVertices + TOPOLOGY_CHUNK_SIZE - 1) / TOPOLOGY_CHUNK_SIZE;
+	job.faces = faces;
+	job.edges = edges;
+	job.source_element = source_element;
+
+	job.pass = 1;
+	parallel_for_chunks(job.num_chunks, topology_chunk, &job, num_threads);
+
+}
+
+// Tests every tet for degeneracy, in parallel
+struct degenerate_tet_job {
+	const unsigned int* tets;
+	unsigned int nTets;
+	cVertex* vertex_array;
+	unsigned char* degenerate;
+};
+
+static void degenerate_tet_chunk(void* param, int chunk, int thread_index) {
+	degenerate_tet_job* job = (degenerate_tet_job*)(param);
+	unsigned int first = chunk * TOPOLOGY_CHUNK_SIZE;
+	unsigned int last = first + TOPOLOGY_CHUNK_SIZE;
+	if (last > job->nTets) last = job->nTets;
+	for (unsigned int i = first; i < last; i++) {
+		job->degenerate[i] = isDegenerateTet(job->tets + i * 4, job->vertex_array) ? 1 : 0;
+	}
+}
+
+// Fills in per-vertex connectivity counts and opposing-face signs, in
+// parallel over vertices
+struct vertex_connectivity_job {
+	cTeschnerMesh* mesh;
+	cVertex* vertex_array;
+	const unsigned int* tet_start;
+	const unsigned int* face_start;
+	const unsigned int* edge_start;
+};
+
+static void vertex_connectivity_chunk(void* param, int chunk, int thread_index) {
+
+	vertex_connectivity_job* job = (vertex_connectivity_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
+
+	unsigned int first = chunk * TOPOLOGY_CHUNK_SIZE;
+	unsigned int last = first + TOPOLOGY_CHUNK_SIZE;
+	if (last > mesh->m_nVertices) last = mesh->m_nVertices;
+
+	for (unsigned int i = first; i < last; i++) {
+
+		cVertex* v = job->vertex_array + i;
+		cDeformableVertex* dv = mesh->m_deformableVertices + i;
+
+		// Copy normals from the (initialized) rendering mesh to the simulation mesh
+		dv->m_normal = v->getNormal();
+
+		dv->m_startingTetIndex = job->tet_start[i];
+		dv->m_startingFaceIndex = job->face_start[i];
+		dv->m_startingEdgeIndex = job->edge_start[i];
+
+		dv->m_nTets = job->tet_start[i + 1] - job->tet_start[i];
+		dv->m_nFaces = job->face_start[i + 1] - job->face_start[i];
+		dv->m_nEdges = job->edge_start[i + 1] - job->edge_start[i];
+
+		cVector3f vertex_pos = v->m_localPos;
+
+		// For each tet that I live in, determine the sign of the face
+		// across from me
+		for (unsigned int slot = dv->m_startingTetIndex; slot < dv->m_startingTetIndex + dv->m_nTets; slot++) {
+
+			int face_index = mesh->m_opposingFaces[slot];
+			face opposing_face = mesh->m_faces[face_index];
+
+			// The center of this face
+			cVector3f face_center(0, 0, 0);
+			for (unsigned int k = 0; k < 3; k++) {
+				cVector3f p = job->vertex_array[opposing_face[k]].m_localPos;
+				face_center += p;
+			}
+			face_center /= 3.0;
+
+			// A vector from the face center to this vertex
+			cVector3f face_center_to_vertex = vertex_pos - face_center;
+			face_center_to_vertex.normalize();
 
-	// Insert a degenerate face to avoid the problem with face zero
-	face degenerate_face(0, 0, 0);
-	faces.insert(degenerate_face);
+			// The triangle's (non-normalized) surface normal
+			cVector3f face_normal = mesh->m_faceNormalsAndAreas[face_index];
+			face_normal.normalize();
+
+			// Does this face point toward me?
+			bool points_toward_me = ((face_normal * face_center_to_vertex) > 0.0f);
+
+			// Store the _signed_ face index
+			if (!points_toward_me) mesh->m_opposingFaces[slot] = -face_index;
+		}
+	}
+
+}
 
+
+void cTeschnerMesh::build_initial_state() {
+
+	// Create connectivity (face and edge) data from tet data
 	unsigned int i;
+	int num_threads = parallel_resolve_num_threads(m_num_threads);
 
 	// Get access to my vertex array
 	std::vector<cVertex>* vertex_vector = this->pVertices();
@@ -1091,55 +1287,56 @@ int cTeschnerMesh::initialize(cTeschnerMesh* old_model) {
 
 	// Test for degenerate tets first and adjust the
 	// tet array accordingly
-	std::list<unsigned int> good_tets;
-	for (i = 0; i < m_nTets; i++) {
+	std::vector<unsigned char> degenerate(m_nTets);
+	degenerate_tet_job djob;
+	djob.tets = m_tets;
+	djob.nTets = m_nTets;
+	djob.vertex_array = vertex_array;
+	djob.degenerate = (m_nTets > 0) ? &(degenerate[0]) : 0;
+	parallel_for_chunks((m_nTets + TOPOLOGY_CHUNK_SIZE - 1) / TOPOLOGY_CHUNK_SIZE,
+		degenerate_tet_chunk, &djob, num_threads);
+
+	unsigned int old_nTets = m_nTets;
+	unsigned int cur_good_tet_slot = 0;
+	for (i = 0; i < old_nTets; i++) {
 
 		// Grab the indices for this tet
 		unsigned int* tet_indices = m_tets + i * 4;
 
-		if (isDegenerateTet(tet_indices, vertex_array)) {
+		if (degenerate[i]) {
 			_cprintf("Warning: degenerate tet %d (%d,%d,%d,%d)\n", i,
 				tet_indices[0], tet_indices[1], tet_indices[2], tet_indices[3]);
 			continue;
 		}
-		good_tets.push_back(i);
-	}
-	_cprintf("Pruned from %d tets to %d tets\n", m_nTets, good_tets.size());
-	m_nTets = good_tets.size();
-	unsigned int cur_good_tet_slot = 0;
-	std::list<unsigned int>::iterator good_tet_iter = good_tets.begin();
-	while (good_tet_iter != good_tets.end()) {
-		int old_tet_index = *good_tet_iter;
-		unsigned int tet[4];
-		// Grab the old tet
-		memcpy(tet, m_tets + old_tet_index * 4, 4 * sizeof(unsigned int));
-		// Put it in the new slot
-		memcpy(m_tets + cur_good_tet_slot * 4, tet, 4 * sizeof(unsigned int));
-
-		/*
-		_cprintf("Moving good tet %d (%d,%d,%d,%d) to %d\n",
-		  old_tet_index,
-		  tet[0],tet[1],tet[2],tet[3],
-		  cur_good_tet_slot);
-		  */
 
-		good_tet_iter++;
+		// Move it to the next good slot
+		if (cur_good_tet_slot != i)
+			memcpy(m_tets + cur_good_tet_slot * 4, tet_indices, 4 * sizeof(unsigned int));
 		cur_good_tet_slot++;
-
+	}
+	_cprintf("Pruned from %d tets to %d tets\n", old_nTets, cur_good_tet_slot);
+	m_nTets = cur_good_tet_slot;
+
+	// Which of a tet's faces is across from each of its vertices?
+	int opposing_local_face[4];
+	for (int j = 0; j < 4; j++) {
+		for (int curface = 0; curface < 4; curface++) {
+			if (tet_triangle_faces[curface][0] != j &&
+				tet_triangle_faces[curface][1] != j &&
+				tet_triangle_faces[curface][2] != j)
+				opposing_local_face[j] = curface;
+		}
 	}
 
-	for (i = 0; i < m_nTets; i++) {
+	// File four _sorted_ faces and six _sorted_ edges per tet under their
+	// smallest vertices
+	std::vector<unsigned int> face_bucket_start(m_nVertices + 1, 0);
+	std::vector<unsigned int> edge_bucket_start(m_nVertices + 1, 0);
 
-		// Grab the indices for this tet
-		unsigned int* tet_indices = m_tets + i * 4;
+	static const int tet_edges[6][2] = { {0,1},{0,2},{0,3},{1,2},{1,3},{2,3} };
 
-		if (isDegenerateTet(tet_indices, vertex_array)) {
-			_cprintf("Warning: degenerate tet %d (%d,%d,%d,%d) shouldn't be here any more\n",
-				i, tet_indices[0], tet_indices[1], tet_indices[2], tet_indices[3]);
-			continue;
-		}
-
-		// Create and insert four _sorted_ faces
+	for (i = 0; i < m_nTets; i++) {
+		unsigned int* tet_indices = m_tets + i * 4;
 		for (unsigned int curface = 0; curface < 4; curface++) {
 			face f(
 				tet_indices[(tet_triangle_faces[curface][0])],
@@ -1147,169 +1344,148 @@ int cTeschnerMesh::initialize(cTeschnerMesh* old_model) {
 				tet_indices[(tet_triangle_faces[curface][2])]
 			);
 			sort_face(f);
-			faces.insert(f);
+			face_bucket_start[f.v0 + 1]++;
+		}
+		for (unsigned int curedge = 0; curedge < 6; curedge++) {
+			edge e(tet_indices[tet_edges[curedge][0]], tet_indices[tet_edges[curedge][1]]);
+			sort_edge(e);
+			edge_bucket_start[e.v0 + 1]++;
 		}
+	}
+
+	for (i = 0; i < m_nVertices; i++) {
+		face_bucket_start[i + 1] += face_bucket_start[i];
+		edge_bucket_start[i + 1] += edge_bucket_start[i];
+	}
 
-		// Create and insert six _sorted_ edges
-		edge local_edges[6];
-		local_edges[0] = edge(tet_indices[0], tet_indices[1]);
-		local_edges[1] = edge(tet_indices[0], tet_indices[2]);
-		local_edges[2] = edge(tet_indices[0], tet_indices[3]);
-		local_edges[3] = edge(tet_indices[1], tet_indices[2]);
-		local_edges[4] = edge(tet_indices[1], tet_indices[3]);
-		local_edges[5] = edge(tet_indices[2], tet_indices[3]);
+	std::vector<topology_entry> face_entries(4 * m_nTets + 1);
+	std::vector<topology_entry> edge_entries(6 * m_nTets + 1);
 
-		for (unsigned int curedge = 0; curedge < 6; curedge++) {
-			sort_edge(local_edges[curedge]);
-			edges.insert(local_edges[curedge]);
+	{
+		std::vector<unsigned int> face_cursor(face_bucket_start.begin(), face_bucket_start.end() - 1);
+		std::vector<unsigned int> edge_cursor(edge_bucket_start.begin(), edge_bucket_start.end() - 1);
+
+		for (i = 0; i < m_nTets; i++) {
+			unsigned int* tet_indices = m_tets + i * 4;
+			for (unsigned int curface = 0; curface < 4; curface++) {
+				face f(
+					tet_indices[(tet_triangle_faces[curface][0])],
+					tet_indices[(tet_triangle_faces[curface][1])],
+					tet_indices[(tet_triangle_faces[curface][2])]
+				);
+				sort_face(f);
+				topology_entry& e = face_entries[face_cursor[f.v0]++];
+				e.key = (((unsigned long long)(f.v1)) << 32) | f.v2;
+				e.source = i * 4 + curface;
+			}
+			for (unsigned int curedge = 0; curedge < 6; curedge++) {
+				edge ed(tet_indices[tet_edges[curedge][0]], tet_indices[tet_edges[curedge][1]]);
+				sort_edge(ed);
+				topology_entry& e = edge_entries[edge_cursor[ed.v0]++];
+				e.key = ed.v1;
+				e.source = i * 6 + curedge;
+			}
 		}
+	}
 
-	} // For each tet
+	// Count unique faces and edges; face zero is a degenerate face, to avoid
+	// the problem with face zero
+	std::vector<unsigned int> face_bucket_elements;
+	std::vector<unsigned int> edge_bucket_elements;
+	m_nFaces = 1 + count_unique_elements(&(face_entries[0]), &(face_bucket_start[0]), m_nVertices,
+		1, face_bucket_elements, num_threads);
+	m_nEdges = count_unique_elements(&(edge_entries[0]), &(edge_bucket_start[0]), m_nVertices,
+		0, edge_bucket_elements, num_threads);
 
-	m_nFaces = faces.size();
-	m_nEdges = edges.size();
 	m_faces = new face[m_nFaces];
 	m_edges = new edge[m_nEdges];
+	m_faces[0] = face(0, 0, 0);
 
-	// A map just to map triangles to indices
-	std::map<face, unsigned int, ltface> face_int_map;
-	std::map<face, unsigned int, ltface>::iterator face_int_map_iter;
+	// The face index of each tet face
+	std::vector<unsigned int> tet_face_index(4 * m_nTets + 1);
 
-	i = 0;
-	set<face, ltface>::iterator faceiter;
-	for (faceiter = faces.begin(); faceiter != faces.end(); faceiter++, i++) {
-		m_faces[i] = *faceiter;
-		face_int_map[*faceiter] = i;
-	}
-
-	i = 0;
-	set<edge, ltedge>::iterator edgeiter;
-	for (edgeiter = edges.begin(); edgeiter != edges.end(); edgeiter++, i++) {
-		m_edges[i] = *edgeiter;
-	}
+	fill_unique_elements(&(face_entries[0]), &(face_bucket_start[0]), m_nVertices,
+		face_bucket_elements, m_faces, 0, &(tet_face_index[0]), num_threads);
+	fill_unique_elements(&(edge_entries[0]), &(edge_bucket_start[0]), m_nVertices,
+		edge_bucket_elements, 0, m_edges, 0, num_threads);
 
 	// Create per-pass arrays
 	m_faceNormalsAndAreas = new cVector3f[m_nFaces];
 	m_edgeLengths = new float[m_nEdges];
 	m_tetVolumes = new float[m_nTets];
 
-	// Create maps from vertices back to connectivity maps
-	temp_vertex_info* tmpv = new temp_vertex_info[m_nVertices];
+	// Per-element force terms, filled in by compute_internal_forces
+	m_faceUnitNormals = new cVector3f[m_nFaces];
+	m_faceAreaForces = new cVector3f[3 * m_nFaces];
+	m_edgeForces = new cVector3f[m_nEdges];
+	m_tetVolumeForceScales = new float[m_nTets];
 
-	// For each tet
-	for (unsigned int i = 0; i < m_nTets; i++) {
-
-		// For each vertex
-		for (int j = 0; j < 4; j++) {
+	// Create maps from vertices back to connectivity; each of these is
+	// counted, prefix-summed, then filled in element order, so each
+	// vertex's list is sorted by element index
+	std::vector<unsigned int> tet_start(m_nVertices + 1, 0);
+	std::vector<unsigned int> face_start(m_nVertices + 1, 0);
+	std::vector<unsigned int> edge_start(m_nVertices + 1, 0);
 
-			unsigned int* curtet = m_tets + i * 4;
-			unsigned int cur_vertex_index = curtet[j];
+	for (i = 0; i < m_nTets * 4; i++) tet_start[m_tets[i] + 1]++;
 
-			if (cur_vertex_index == 0) {
-				int k = 2;
-			}
+	// (skip the zero face, since it's invalid)
+	for (i = 1; i < m_nFaces; i++) {
+		for (unsigned int j = 0; j < 3; j++) face_start[m_faces[i][j] + 1]++;
+	}
 
-			// Add this tet to the containing tets list for this vertex
-			tmpv[cur_vertex_index].containing_tets.push_back(i);
+	for (i = 0; i < m_nEdges; i++) {
+		edge_start[m_edges[i].v0 + 1]++;
+		edge_start[m_edges[i].v1 + 1]++;
+	}
 
-			// Where does this tet appear in this vertex's tet list?
-			unsigned int local_tet_index = tmpv[cur_vertex_index].containing_tets.size() - 1;
+	for (i = 0; i < m_nVertices; i++) {
+		tet_start[i + 1] += tet_start[i];
+		face_start[i + 1] += face_start[i];
+		edge_start[i + 1] += edge_start[i];
+	}
 
-			// Build the triangle in this tet that _doesn't_ include this
-			// vertex...
-			face f;
-			unsigned int vertices_added = 0;
-			for (int k = 0; k < 4; k++) {
-				if (k == j) continue;
-				f[vertices_added] = curtet[k];
-				vertices_added++;
-			}
-			sort_face(f);
+	m_containingTets = new unsigned int[tet_start[m_nVertices]];
+	m_opposingFaces = new int[tet_start[m_nVertices]];
+	m_containingFaces = new unsigned int[face_start[m_nVertices]];
+	m_containingEdges = new unsigned int[edge_start[m_nVertices]];
 
-			face_int_map_iter = face_int_map.find(f);
-			if (face_int_map_iter == face_int_map.end()) {
-				_cprintf("Warning: I couldn't find this face in the face map...\n");
-				continue;
+	{
+		std::vector<unsigned int> cursor(tet_start.begin(), tet_start.end() - 1);
+		for (i = 0; i < m_nTets; i++) {
+			for (int j = 0; j < 4; j++) {
+				unsigned int slot = cursor[m_tets[i * 4 + j]]++;
+				m_containingTets[slot] = i;
+
+				// The face in this tet that _doesn't_ include this vertex;
+				// its sign gets determined after we've computed face normals
+				m_opposingFaces[slot] = tet_face_index[i * 4 + opposing_local_face[j]];
 			}
-
-			unsigned int face_index = (*face_int_map_iter).second;
-
-			// Put him in the opposing-faces list in the _same place_ that
-			// this tet appears in the containing-tets list
-
-			/*
-			// Re-allocate if necessary
-			if (tmpv[cur_vertex_index].opposing_faces.capacity() < (local_tet_index+1))
-			  tmpv[cur_vertex_index].opposing_faces.reserve(local_tet_index+1);
-
-			tmpv[cur_vertex_index].opposing_faces[local_tet_index] = face_index;
-			*/
-			tmpv[cur_vertex_index].opposing_faces.push_back(face_index);
-
-			// We'll determine the _sign_ for the opposing faces later, after
-			// we've computed face normals
 		}
-	}
-
-	// For each face
-	// 
-	// (skip the zero face, since it's invalid)
-	for (unsigned int i = 1; i < m_nFaces; i++) {
-
-		// For each vertex
-		for (unsigned int j = 0; j < 3; j++) {
-
-			// Which vertex is this?
-			unsigned int cur_vertex_index = ((unsigned int*)(m_faces))[3 * i + j];
 
-			// Add this face to the containing faces list for this vertex
-			tmpv[cur_vertex_index].containing_faces.push_back(i);
+		cursor.assign(face_start.begin(), face_start.end() - 1);
+		for (i = 1; i < m_nFaces; i++) {
+			for (unsigned int j = 0; j < 3; j++) m_containingFaces[cursor[m_faces[i][j]]++] = i;
 		}
-	}
-
-	// For each edge
-	for (unsigned int i = 0; i < m_nEdges; i++) {
-
-		// For each vertex
-		for (int j = 0; j < 2; j++) {
 
-			unsigned int cur_vertex_index = ((unsigned int*)(m_edges))[2 * i + j];
-			// Add this edge to the containing edges list for this vertex
-			tmpv[cur_vertex_index].containing_edges.push_back(i);
+		cursor.assign(edge_start.begin(), edge_start.end() - 1);
+		for (i = 0; i < m_nEdges; i++) {
+			m_containingEdges[cursor[m_edges[i].v0]++] = i;
+			m_containingEdges[cursor[m_edges[i].v1]++] = i;
 		}
 	}
 
-	// Create and fill the connectivity data structures
-	unsigned int total_containing_tets = 0;
-	unsigned int total_containing_edges = 0;
-	unsigned int total_containing_faces = 0;
-
-	for (unsigned int i = 0; i < m_nVertices; i++) {
-		temp_vertex_info* v = tmpv + i;
-		total_containing_tets += v->containing_tets.size();
-		total_containing_edges += v->containing_edges.size();
-		total_containing_faces += v->containing_faces.size();
-	}
-
-	m_containingTets = new unsigned int[total_containing_tets];
-	m_opposingFaces = new int[total_containing_tets];
-	m_containingFaces = new unsigned int[total_containing_faces];
-	m_containingEdges = new unsigned int[total_containing_edges];
-
-	// Fill the connectivity data structures
-	unsigned int current_tet_slot = 0;
-	unsigned int current_face_slot = 0;
-	unsigned int current_edge_slot = 0;
-
 	// Create the vertex data structures
 	m_deformableVertices = new cDeformableVertex[m_nVertices];
 	memset(m_deformableVertices, 0, m_nVertices * sizeof(cDeformableVertex));
+	m_vertex_state.allocate(m_nVertices);
 
 	// Set up vertex positions first
 	for (unsigned int i = 0; i < m_nVertices; i++) {
 		cVertex* v = vertex_array + i;
-		cDeformableVertex* dv = m_deformableVertices + i;
-		dv->m_pos = v->getPos();
+		cVector3f pos;
+		pos.set(v->getPos());
+		m_vertex_state.set_pos(i, pos);
 	}
 
 	// Now compute initial face areas and tet volumes, which depend only
@@ -1318,95 +1494,15 @@ int cTeschnerMesh::initialize(cTeschnerMesh* old_model) {
 	compute_spring_lengths();
 	compute_face_areas();
 
-	// Now the more complex vertex data structures...
-
-	// For each vertex
-	for (unsigned int i = 0; i < m_nVertices; i++) {
-		cVertex* v = vertex_array + i;
-		cDeformableVertex* dv = m_deformableVertices + i;
-		temp_vertex_info* tvi = tmpv + i;
-
-		dv->m_pos = v->getPos();
-
-		// Copy normals from the (initialized) rendering mesh to the simulation mesh
-		// if (m_compute_vertex_normals)
-		dv->m_normal = v->getNormal();
-
-		// Normal and force are still unspecified...
-
-		dv->m_nTets = tvi->containing_tets.size();
-		dv->m_nFaces = tvi->containing_faces.size();
-		dv->m_nEdges = tvi->containing_edges.size();
-
-		dv->m_startingTetIndex = current_tet_slot;
-		dv->m_startingFaceIndex = current_face_slot;
-		dv->m_startingEdgeIndex = current_edge_slot;
-
-		// For each tet that I live in
-		for (unsigned int j = 0; j < dv->m_nTets; j++, current_tet_slot++) {
-
-			m_containingTets[current_tet_slot] = tvi->containing_tets[j];
-
-			// Determine sign for the opposing face
-			int face_index = tvi->opposing_faces[j];
-
-			// The current vertex position
-			cVertex* v = vertex_array + i;
-			cVector3f vertex_pos = v->m_localPos;
-
-			face opposing_face = m_faces[face_index];
-			cVector3f opposing_face_vertices[3];
-
-			// The center of this face
-			cVector3f face_center(0, 0, 0);
-
-			for (unsigned int k = 0; k < 3; k++) {
-				cVertex* v = vertex_array + opposing_face[k];
-				opposing_face_vertices[k] = v->m_localPos;
-				face_center += opposing_face_vertices[k];
-			}
-			face_center /= 3.0;
-
-			// A vector from the face center to this vertex
-			cVector3f face_center_to_vertex = vertex_pos - face_center;
-			face_center_to_vertex.normalize();
-
-			// The triangle's (non-normalized) surface normal
-			cVector3f face_normal = m_faceNormalsAndAreas[face_index];
-			face_normal.normalize();
-
-			// Does this face point toward me?
-			bool points_toward_me = ((face_normal * face_center_to_vertex) > 0.0f);
-
-			int sign = points_toward_me ? 1 : -1;
-
-			/*
-			_cprintf("Face %d (%f,%f,%f) points %s v %d (%f,%f,%f)\n",
-			  face_index,face_normal.x,face_normal.y,face_normal.z,
-			  points_toward_me?"toward":"away from",i,
-			  vertex_pos.x,vertex_pos.y,vertex_pos.z);
-			  */
-
-			  // Set the sign of this face index appropriately
-			tvi->opposing_faces[j] *= sign;
-
-			// Store the _signed_ face index
-			m_opposingFaces[current_tet_slot] = tvi->opposing_faces[j];
-		}
-
-		// For each face that I live in
-		for (unsigned int j = 0; j < dv->m_nFaces; j++) {
-			m_containingFaces[current_face_slot++] = tvi->containing_faces[j];
-		}
-
-		// For each edge that I live in
-		for (unsigned int j = 0; j < dv->m_nEdges; j++) {
-			m_containingEdges[current_edge_slot++] = tvi->containing_edges[j];
-		}
-
-	} // For each vertex   
-
-	delete[] tmpv;
+	// Now the per-vertex data structures and opposing-face signs
+	vertex_connectivity_job vjob;
+	vjob.mesh = this;
+	vjob.vertex_array = vertex_array;
+	vjob.tet_start = &(tet_start[0]);
+	vjob.face_start = &(face_start[0]);
+	vjob.edge_start = &(edge_start[0]);
+	parallel_for_chunks((m_nVertices + TOPOLOGY_CHUNK_SIZE - 1) / TOPOLOGY_CHUNK_SIZE,
+		vertex_connectivity_chunk, &vjob, num_threads);
 
 	_cprintf("Creating rest-state structures...\n");
 	// _getch();
@@ -1421,14 +1517,71 @@ int cTeschnerMesh::initialize(cTeschnerMesh* old_model) {
 	memcpy(m_restTetVolumes, m_tetVolumes, m_nTets * sizeof(float));
 
 	// Create history data (same as current data)
-	m_previousPositions = new cDeformableVertex[m_nVertices];
-	memcpy(m_previousPositions, m_deformableVertices, m_nVertices * sizeof(cDeformableVertex));
+	for (int a = 0; a < 3; a++)
+		memcpy(m_vertex_state.prev_pos[a], m_vertex_state.pos[a], m_vertex_state.padded_n * sizeof(float));
 
 	_cprintf("Initializing vertex masses...\n");
 	// _getch();
 
 	initialize_vertex_masses();
 
+} // build_initial_state
+
+
+int cTeschnerMesh::initialize(cTeschnerMesh* old_model) {
+
+	_cprintf("Initializing deformable mesh...\n");
+	// _getch();
+
+	if (old_model) {
+		void* dst_begin = (void*)(&(this->BEGIN_CONSTANTS));
+		void* src_begin = (void*)(&(old_model->BEGIN_CONSTANTS));
+		void* dst_end = (void*)(&(this->END_CONSTANTS));
+		unsigned int length = (char*)dst_end - (char*)dst_begin;
+		memcpy(dst_begin, src_begin, length);
+		if (m_constraints) m_constraints->reset();
+	}
+
+	m_current_sim_time = 0.0f;
+	GetSystemTime(&m_sim_start_date_and_time);
+
+	// TODO: I should probably descend properly through my children here
+	if (m_nTets == 0) {
+		if (getNumChildren() == 0) {
+			_cprintf("Oops... I have no tets and no children...\n");
+			return -1;
+		}
+		cTeschnerMesh* ctm = dynamic_cast<cTeschnerMesh*>(getChild(0));
+		if (ctm == 0) {
+			_cprintf("Oops... my child is not a teschner mesh...\n");
+			return -1;
+		}
+		_cprintf("Deferring operation to my child...\n");
+		m_proxy_sim_mesh = ctm;
+		strcpy(ctm->m_snapshot_root, m_snapshot_root);
+		return ctm->initialize();
+	}
+
+	m_proxy_sim_mesh = 0;
+
+	// Is there a snapshot of this mesh, already initialized?
+	char snapshot_filename[_MAX_PATH];
+	snapshot_filename[0] = '\0';
+	m_snapshot_key = 0;
+
+	if (m_snapshot_root[0]) {
+		sprintf(snapshot_filename, "%s%s", m_snapshot_root, TESCHNER_SNAPSHOT_EXTENSION);
+		m_snapshot_key = compute_snapshot_key();
+	}
+
+	if (snapshot_filename[0] && load_snapshot(snapshot_filename, m_snapshot_key)) {
+		_cprintf("Loaded initialized mesh from %s\n", snapshot_filename);
+	}
+	else {
+		build_initial_state();
+		if (snapshot_filename[0]) save_snapshot(snapshot_filename, m_snapshot_key);
+	}
+
 	_cprintf("Backing up data structures...\n");
 	// _getch();
 
@@ -1445,6 +1598,7 @@ int cTeschnerMesh::initialize(cTeschnerMesh* old_model) {
 
 	m_bkup_deformableVertices = new cDeformableVertex[m_nVertices];
 	memcpy(m_bkup_deformableVertices, m_deformableVertices, m_nVertices * sizeof(cDeformableVertex));
+	m_bkup_vertex_state.copy_from(m_vertex_state);
 
 	m_initialized = true;
 
@@ -1463,19 +1617,121 @@ int cTeschnerMesh::initialize(cTeschnerMesh* old_model) {
 	float maxy = -FLT_MAX;
 
 	for (int i = 0; i < (int)m_nVertices; i++) {
-		cDeformableVertex* v = m_deformableVertices + i;
-		if (v->m_pos.y < miny) miny = v->m_pos.y;
-		if (v->m_pos.y > maxy) maxy = v->m_pos.y;
+		float y = m_vertex_state.pos[1][i];
+		if (y < miny) miny = y;
+		if (y > maxy) maxy = y;
 	}
 
 	_cprintf("Min y is %f\n", miny);
 	_cprintf("Max y is %f\n", maxy);
 #endif
 
-	_cprintf("Finished initializing deformable mesh...\n");
+	_cprintf("Finished initializing deformable mesh...\n");
+
+	return 0;
+}
+
+
+int cTeschnerMesh::initialize_shared(cTeschnerMesh* prototype) {
+
+	if (m_initialized) {
+		_cprintf("Can't share connectivity with a mesh that's already initialized\n");
+		return -1;
+	}
+
+	// The simulation may really be happening in the prototype's child
+	if (prototype->m_proxy_sim_mesh) prototype = prototype->m_proxy_sim_mesh;
+
+	if (prototype->m_initialized == false || prototype->m_nVertices == 0) {
+		_cprintf("Can't share connectivity with an uninitialized mesh\n");
+		return -1;
+	}
+
+	// Copy constants
+	void* dst_begin = (void*)(&(this->BEGIN_CONSTANTS));
+	void* src_begin = (void*)(&(prototype->BEGIN_CONSTANTS));
+	void* dst_end = (void*)(&(this->END_CONSTANTS));
+	unsigned int length = (char*)dst_end - (char*)dst_begin;
+	memcpy(dst_begin, src_begin, length);
+
+	m_current_sim_time = 0.0f;
+	GetSystemTime(&m_sim_start_date_and_time);
+
+	m_localPos = prototype->m_localPos;
+	m_localRot = prototype->m_localRot;
+
+	m_proxy_sim_mesh = 0;
+	m_shares_connectivity = true;
+
+	// Fixed connectivity and rest state
+	m_nVertices = prototype->m_nVertices;
+	m_nFaces = prototype->m_nFaces;
+	m_nEdges = prototype->m_nEdges;
+	m_nTets = prototype->m_nTets;
+
+	m_tets = prototype->m_tets;
+	m_faces = prototype->m_faces;
+	m_edges = prototype->m_edges;
+	m_containingTets = prototype->m_containingTets;
+	m_opposingFaces = prototype->m_opposingFaces;
+	m_containingEdges = prototype->m_containingEdges;
+	m_containingFaces = prototype->m_containingFaces;
+
+	m_restFaceNormalsAndAreas = prototype->m_restFaceNormalsAndAreas;
+	m_restEdgeLengths = prototype->m_restEdgeLengths;
+	m_restTetVolumes = prototype->m_restTetVolumes;
+
+	// The backups are never written, so those can be shared too
+	m_bkup_faceNormalsAndAreas = prototype->m_bkup_faceNormalsAndAreas;
+	m_bkup_edgeLengths = prototype->m_bkup_edgeLengths;
+	m_bkup_tetVolumes = prototype->m_bkup_tetVolumes;
+	m_bkup_deformableVertices = prototype->m_bkup_deformableVertices;
+	m_bkup_vertex_state.copy_from(prototype->m_bkup_vertex_state);
+
+	// Per-pass arrays, starting from the prototype's rest state
+	m_faceNormalsAndAreas = new cVector3f[m_nFaces];
+	m_edgeLengths = new float[m_nEdges];
+	m_tetVolumes = new float[m_nTets];
+
+	memcpy(m_faceNormalsAndAreas, m_bkup_faceNormalsAndAreas, m_nFaces * sizeof(cVector3f));
+	memcpy(m_edgeLengths, m_bkup_edgeLengths, m_nEdges * sizeof(float));
+	memcpy(m_tetVolumes, m_bkup_tetVolumes, m_nTets * sizeof(float));
+
+	m_faceUnitNormals = new cVector3f[m_nFaces];
+	m_faceAreaForces = new cVector3f[3 * m_nFaces];
+	m_edgeForces = new cVector3f[m_nEdges];
+	m_tetVolumeForceScales = new float[m_nTets];
+
+	m_deformableVertices = new cDeformableVertex[m_nVertices];
+	memcpy(m_deformableVertices, m_bkup_deformableVertices, m_nVertices * sizeof(cDeformableVertex));
+	m_vertex_state.copy_from(m_bkup_vertex_state);
+
+	// Heterogeneous constants are per-mesh, since they're often what's
+	// being varied
+	if (prototype->m_hetero_kVolumePreservation) {
+		m_hetero_kVolumePreservation = new float[m_nVertices];
+		m_hetero_kAreaPreservation = new float[m_nVertices];
+		m_hetero_kDistancePreservation = new float[m_nVertices];
+		m_hetero_kDistanceDamping = new float[m_nVertices];
+		memcpy(m_hetero_kVolumePreservation, prototype->m_hetero_kVolumePreservation, m_nVertices * sizeof(float));
+		memcpy(m_hetero_kAreaPreservation, prototype->m_hetero_kAreaPreservation, m_nVertices * sizeof(float));
+		memcpy(m_hetero_kDistancePreservation, prototype->m_hetero_kDistancePreservation, m_nVertices * sizeof(float));
+		memcpy(m_hetero_kDistanceDamping, prototype->m_hetero_kDistanceDamping, m_nVertices * sizeof(float));
+	}
+	else {
+		m_heterogeneous_constants = false;
+	}
+
+	m_maximum_vertex_acceleration = -FLT_MAX;
+	m_maximum_vertex_velocity = -FLT_MAX;
+	m_mean_vertex_acceleration = -FLT_MAX;
+	m_mean_vertex_velocity = -FLT_MAX;
+
+	m_initialized = true;
 
 	return 0;
-}
+
+} // initialize_shared
 
 // #define RENDER_VERTEX_POINTS
 
@@ -1486,8 +1742,7 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 	if (m_nVertices > 0) {
 		for (unsigned int i = 0; i < m_nVertices; i++) {
 			cDeformableVertex* v = m_deformableVertices + i;
-			cDeformableVertex* pv = m_previousPositions + i;
-			cVector3f pos = v->m_pos;
+			cVector3f pos = m_vertex_state.get_pos(i);
 			glColor3f(0.1, 1.0, 0.3);
 			glPushMatrix();
 			glTranslatef(pos.x, pos.y, pos.z);
@@ -1504,8 +1759,7 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 
 		for (unsigned int i = 0; i < m_nVertices; i++) {
 			cDeformableVertex* v = m_deformableVertices + i;
-			cDeformableVertex* pv = m_previousPositions + i;
-			cVector3f pos = v->m_pos;
+			cVector3f pos = m_vertex_state.get_pos(i);
 			cVector3f force;
 
 			// float force_scale_factor = 0.005;
@@ -1581,12 +1835,12 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 		for(register unsigned int i=0; i<m_nEdges; i++) {
 
 		  edge e = m_edges[i];
-		  cDeformableVertex v0 = m_deformableVertices[e.v0];
-		  cDeformableVertex v1 = m_deformableVertices[e.v1];
+		  cVector3f v0 = m_vertex_state.get_pos(e.v0);
+		  cVector3f v1 = m_vertex_state.get_pos(e.v1);
 		  glColor3f(1,0,0);
 		  glBegin(GL_LINES);
-		  glVertex3f(v0.m_pos.x,v0.m_pos.y,v0.m_pos.z);
-		  glVertex3f(v1.m_pos.x,v1.m_pos.y,v1.m_pos.z);
+		  glVertex3f(v0.x,v0.y,v0.z);
+		  glVertex3f(v1.x,v1.y,v1.z);
 		  glEnd();
 		}
 		*/
@@ -1621,11 +1875,11 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 	for (; highlight_iter != m_highlighted_vertices.end(); highlight_iter++, color_iter++) {
 		unsigned int index = *highlight_iter;
 		unsigned int color_index = (color_iter == m_highlight_colors.end()) ? 0 : *color_iter;
-		cDeformableVertex* dv = m_deformableVertices + index;
+		cVector3f pos = m_vertex_state.get_pos(index);
 		glPushMatrix();
 		cColorf c = CHAI_BASIC_COLORS[color_index % 8];
 		glColor3f(c[0], c[1], c[2]);
-		glTranslatef(dv->m_pos.x, dv->m_pos.y, dv->m_pos.z);
+		glTranslatef(pos.x, pos.y, pos.z);
 		cDrawSphere(0.06, 5, 5);
 		glPopMatrix();
 	}
@@ -1636,12 +1890,13 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 
 		for (unsigned int i = 0; i < m_nVertices; i++) {
 			cDeformableVertex* dv = m_deformableVertices + i;
+			cVector3f pos = m_vertex_state.get_pos(i);
 
 			// Red balls mean position constraints
 			if (dv->position_is_constrained) {
 				glPushMatrix();
 				glColor3f(0.5, 0.5, 1.0);
-				glTranslatef(dv->m_pos.x, dv->m_pos.y, dv->m_pos.z);
+				glTranslatef(pos.x, pos.y, pos.z);
 				cDrawSphere(0.06, 5, 5);
 				glPopMatrix();
 			}
@@ -1653,9 +1908,9 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 
 				force_constraint_number++;
 
-				float fx = dv->constraint_force.x;
-				float fy = dv->constraint_force.y;
-				float fz = dv->constraint_force.z;
+				float fx = m_vertex_state.constraint_force[0][i];
+				float fy = m_vertex_state.constraint_force[1][i];
+				float fz = m_vertex_state.constraint_force[2][i];
 
 				bool point_away = true;
 				// if (force_constraint_number <= 2) point_away = true;
@@ -1674,14 +1929,14 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 				/*
 				glPushMatrix();
 				glColor3f(0.2,1.0,0.2);
-				glTranslatef(dv->m_pos.x,dv->m_pos.y,dv->m_pos.z);
+				glTranslatef(pos.x,pos.y,pos.z);
 				cDrawSphere(0.06,5,5);
 				glPopMatrix();
 				*/
 				/*
 				glPushMatrix();
 				glColor3f(0.2,1.0,0.2);
-				glTranslatef(dv->m_pos.x,dv->m_pos.y,dv->m_pos.z);
+				glTranslatef(pos.x,pos.y,pos.z);
 				glLineWidth(4.0);
 				//cVector3d astart(0,0,0);
 				//cVector3d atip(fx,fy,fz);
@@ -1694,8 +1949,8 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 				*/
 
 				glColor3f(0.3, 1.0, 0.3);
-				cVector3d arrowstart(dv->m_pos.x - fx, dv->m_pos.y - fy, dv->m_pos.z - fz);
-				cVector3d arrowtip(dv->m_pos.x, dv->m_pos.y, dv->m_pos.z);
+				cVector3d arrowstart(pos.x - fx, pos.y - fy, pos.z - fz);
+				cVector3d arrowtip(pos.x, pos.y, pos.z);
 
 				if (point_away)
 					cDrawArrow(arrowtip, arrowstart);
@@ -1713,142 +1968,138 @@ void cTeschnerMesh::renderMesh(const int a_renderMode) {
 
 bool cTeschnerMesh::move_vertices() {
 
-	float timestepsq = m_timestep*m_timestep;
-	float two_times_timestep = 2 * m_timestep;
+	deformable_vertex_state& s = m_vertex_state;
+
+	const simd_float timestepsq = simd_set1(m_timestep*m_timestep);
+	const simd_float one_over_two_timesteps = simd_set1(1.0f / (2.0f * m_timestep));
+	const simd_float zero = simd_zero();
+
+	simd_float max_vel = zero, max_accel = zero, sum_vel = zero, sum_accel = zero;
+
+#ifdef RENDER_DEBUG_FORCES
+	for (unsigned int i = 0; i < m_nVertices; i++) {
+		m_deformableVertices[i].m_debug_total_force = s.get_force(i) + s.get_constraint_force(i);
+	}
+#endif
 
 	// Use _current_ forces and _previous_ positions to update _current_ positions,
 	// which we write to the _previous_ positions array for now.
-	cDeformableVertex* cur_v = m_deformableVertices;
+	//
+	// The arrays are padded, so we never have a partial vector.
+	for (unsigned int i = 0; i < s.padded_n; i += SIMD_WIDTH) {
 
-	// These are the same pointer; I maintain two variables
-	// for clarity
-	cDeformableVertex* prev_v = m_previousPositions;
-	cDeformableVertex* next_v = m_previousPositions;
+		simd_float dt2_over_m = simd_mul(timestepsq, simd_load(s.inverse_mass + i));
 
-	cVector3f old_pos, old_vel;
+		// Zero for constrained vertices, which don't move
+		simd_float free = simd_load(s.position_free + i);
 
-	m_maximum_vertex_velocity = m_maximum_vertex_acceleration = 0.0f;
-	m_mean_vertex_velocity = m_mean_vertex_acceleration = 0.0f;
+		simd_float displacement_sq = zero, vel_sq = zero, old_vel_sq = zero;
 
-	// It will be helpful to have our inverse transform around
-	cMatrix3d irot = m_localRot.inv();
+		for (int a = 0; a < 3; a++) {
 
-	for (unsigned int i = 0; i < m_nVertices; i++, cur_v++, prev_v++, next_v++) {
+			simd_float cur = simd_load(s.pos[a] + i);
+			simd_float old = simd_load(s.prev_pos[a] + i);
+			simd_float old_vel = simd_load(s.velocity[a] + i);
 
-		if (cur_v->force_is_constrained) {
-			cur_v->m_force += cur_v->constraint_force;
+			// Constraint forces are zero for unconstrained vertices
+			simd_float force = simd_add(simd_load(s.force[a] + i), simd_load(s.constraint_force[a] + i));
 
-			/*
-			if (i == 0) {
-			  _cprintf("constraint: %s, %s\n",cur_v->constraint_force.str(2).c_str(),cur_v->m_force.str(2).c_str());
-			}
-			*/
+			// next = 2*cur - old + timestep^2 * force / mass
+			simd_float step = simd_add(simd_sub(cur, old), simd_mul(force, dt2_over_m));
+			simd_float next = simd_add(cur, simd_mul(free, step));
+
+			simd_float vel = simd_mul(simd_sub(next, old), one_over_two_timesteps);
+			simd_float displacement = simd_sub(next, cur);
+
+			displacement_sq = simd_add(displacement_sq, simd_mul(displacement, displacement));
+			vel_sq = simd_add(vel_sq, simd_mul(vel, vel));
+			old_vel_sq = simd_add(old_vel_sq, simd_mul(old_vel, old_vel));
+
+			simd_store(s.prev_pos[a] + i, next);
+			simd_store(s.velocity[a] + i, vel);
+
+			// Zero out forces for the next time around
+			simd_store(s.force[a] + i, zero);
 		}
 
-		next_v->m_normal = cur_v->m_normal;
+		// Velocity will just be displacement for thresholding (steady-state) computation
+		simd_float vel = simd_sqrt(displacement_sq);
+		simd_float accel = simd_sub(simd_sqrt(vel_sq), simd_sqrt(old_vel_sq));
 
-		// Zero out forces for the next time around
-		next_v->m_force.set(0, 0, 0);
-		next_v->m_mass = cur_v->m_mass;
+		max_vel = simd_max(max_vel, vel);
+		max_accel = simd_max(max_accel, accel);
+		sum_vel = simd_add(sum_vel, vel);
+		sum_accel = simd_add(sum_accel, accel);
+	}
 
-		next_v->force_is_constrained = cur_v->force_is_constrained;
-		next_v->constraint_force = cur_v->constraint_force;
-		next_v->position_is_constrained = cur_v->position_is_constrained;
+	// Push anything that went through the floor back up (after the fact, so
+	// the statistics below don't see this)
+	restrict_floor_penetration(1.0f / (2.0f * m_timestep));
 
-#ifdef RENDER_DEBUG_FORCES
-		next_v->m_debug_edge_force = cur_v->m_debug_edge_force;
-		next_v->m_debug_volume_force = cur_v->m_debug_volume_force;
-		next_v->m_debug_area_force = cur_v->m_debug_area_force;
-		next_v->m_debug_damping_force = cur_v->m_debug_damping_force;
-		next_v->m_debug_floor_force = cur_v->m_debug_floor_force;
-		next_v->m_debug_gravity_force = cur_v->m_debug_gravity_force;
-		next_v->m_debug_total_force = cur_v->m_force;
-
-		cur_v->m_debug_edge_force.set(0, 0, 0);
-		cur_v->m_debug_volume_force.set(0, 0, 0);
-		cur_v->m_debug_area_force.set(0, 0, 0);
-		cur_v->m_debug_damping_force.set(0, 0, 0);
-		cur_v->m_debug_floor_force.set(0, 0, 0);
-		cur_v->m_debug_gravity_force.set(0, 0, 0);
-#endif
+	// Maintain max and mean vertex velocity and acceleration (padding
+	// vertices contribute zeros)
+	float lanes[4][SIMD_WIDTH];
+	simd_storeu(lanes[0], max_vel);
+	simd_storeu(lanes[1], max_accel);
+	simd_storeu(lanes[2], sum_vel);
+	simd_storeu(lanes[3], sum_accel);
 
-		// Need to back up the position since next and prev are
-		// the same array
-		old_pos = prev_v->m_pos;
-		old_vel = prev_v->m_velocity;
+	m_maximum_vertex_velocity = m_maximum_vertex_acceleration = 0.0f;
+	m_mean_vertex_velocity = m_mean_vertex_acceleration = 0.0f;
 
-		if (next_v->position_is_constrained > 0) {
-			// _cprintf("Constrained vertex\n");
-			// Don't change his position
-			next_v->m_pos = cur_v->m_pos;
-		}
-		else {
-			next_v->m_pos = 2.0f*cur_v->m_pos - old_pos +
-				timestepsq * cur_v->m_force / cur_v->m_mass;
-		}
+	for (int k = 0; k < SIMD_WIDTH; k++) {
+		if (lanes[0][k] > m_maximum_vertex_velocity) m_maximum_vertex_velocity = lanes[0][k];
+		if (lanes[1][k] > m_maximum_vertex_acceleration) m_maximum_vertex_acceleration = lanes[1][k];
+		m_mean_vertex_velocity += lanes[2][k];
+		m_mean_vertex_acceleration += lanes[3][k];
+	}
+
+	m_mean_vertex_acceleration /= ((float)(m_nVertices));
+	m_mean_vertex_velocity /= ((float)(m_nVertices));
+
+	// Swap previous and current positions
+	s.swap_positions();
+
+	return true;
+}
+
+
+// With RESTRICT_FLOOR_PENETRATION, moves every next position (prev_pos,
+// after the integrator has run) that's below the floor up to it, adding
+// [velocity_scale] times the correction to the vertex's velocity
+void cTeschnerMesh::restrict_floor_penetration(float velocity_scale) {
 
 #ifdef RESTRICT_FLOOR_PENETRATION
-		// Find the global position of this vertex
-		cVector3d global_pos(
-			next_v->m_pos.x, next_v->m_pos.y, next_v->m_pos.z
-		);
-		m_localRot.mul(global_pos);
-		global_pos += m_localPos;
 
-		if (global_pos.y < m_floor_position)
-			global_pos.y = m_floor_position;
+	deformable_vertex_state& s = m_vertex_state;
 
-		global_pos -= m_localPos;
-		irot.mul(global_pos);
-		next_v->m_pos.set(global_pos);
+	// It will be helpful to have our inverse transform around
+	cMatrix3d irot = m_localRot.inv();
 
-#endif
+	for (unsigned int i = 0; i < m_nVertices; i++) {
 
-		// Maintain max vertex velocity and acceleration
-		next_v->m_velocity = (next_v->m_pos - old_pos) / (two_times_timestep);
-		cVector3f nextvel = (next_v->m_velocity - old_vel) / (two_times_timestep);
+		// Find the global position of this vertex
+		cVector3d global_pos(s.prev_pos[0][i], s.prev_pos[1][i], s.prev_pos[2][i]);
+		m_localRot.mul(global_pos);
+		global_pos += m_localPos;
 
-		// Velocity will just be displacement for thresholding (steady-state) computation
-		float vel = (next_v->m_pos - cur_v->m_pos).length(); // next_v->m_velocity.length();    
-		float accel = (next_v->m_velocity.length() - old_vel.length());
+		if (global_pos.y >= m_floor_position) continue;
 
-		m_mean_vertex_velocity += vel;
-		m_mean_vertex_acceleration += accel;
+		global_pos.y = m_floor_position;
 
-		if (vel > m_maximum_vertex_velocity) {
-			m_maximum_vertex_velocity = vel;
-		}
-		if (accel > m_maximum_vertex_acceleration) {
-			m_maximum_vertex_acceleration = accel;
+		global_pos -= m_localPos;
+		irot.mul(global_pos);
 
-			/*
-			_cprintf("v%d vel (%f) %s, accel %f, force %s\n",i,
-			  vel,
-			  next_v->m_velocity.str(2).c_str(),
-			  accel,
-			  cur_v->m_force.str(2).c_str());
-			_cprintf("Moving from %.6f,%.6f,%.6f to %.6f,%.6f,%.6f\n\n",
-			  cur_v->m_pos.x,cur_v->m_pos.y,cur_v->m_pos.z,
-			  next_v->m_pos.x,next_v->m_pos.y,next_v->m_pos.z);
-			*/
+		for (int a = 0; a < 3; a++) {
+			float clamped = (float)(global_pos[a]);
+			s.velocity[a][i] += (clamped - s.prev_pos[a][i]) * velocity_scale;
+			s.prev_pos[a][i] = clamped;
 		}
-
-		/*
-		_cprintf("Moving vertex %d to %f,%f,%f\n",
-		  i,next_v->m_pos.x,next_v->m_pos.y,next_v->m_pos.z);
-		  */
 	}
 
-	m_mean_vertex_acceleration /= ((float)(m_nVertices));
-	m_mean_vertex_velocity /= ((float)(m_nVertices));
-
-	// Swap previous and current arrays
-	cDeformableVertex* tmp = m_previousPositions;
-	m_previousPositions = m_deformableVertices;
-	m_deformableVertices = tmp;
+#endif
 
-	return true;
-}
+} // restrict_floor_penetration()
 
 
 bool cTeschnerMesh::compute_forces() {
@@ -1878,11 +2129,10 @@ void cTeschnerMesh::compute_contact_forces() {
 
 		for (unsigned int i = 0; i < f->vertices.size(); i++) {
 			int vindex = f->vertices[i];
-			cDeformableVertex* v = m_deformableVertices + vindex;
-			v->m_force.add(local_force);
+			m_vertex_state.add_force(vindex, local_force);
 			/*
 			if (i == 0) {
-			  _cprintf("external: %s, %s\n",local_force.str(2).c_str(),v->m_force.str(2).c_str());
+			  _cprintf("external: %s, %s\n",local_force.str(2).c_str(),m_vertex_state.get_force(vindex).str(2).c_str());
 			}
 			*/
 		}
@@ -1909,10 +2159,10 @@ void cTeschnerMesh::compute_contact_forces() {
 				// Apply gravity
 				float factor = (GRAVITY_IS_ACCELERATION) ? v->m_mass : 1.0f;
 				gravity_force = gravity_fvector / factor;
-				v->m_force.add(gravity_force);
+				m_vertex_state.add_force(i, gravity_force);
 				/*
 				if (i == 0) {
-				  _cprintf("gravity: %s, %s\n",gravity_force.str(2).c_str(),v->m_force.str(2).c_str());
+				  _cprintf("gravity: %s, %s\n",gravity_force.str(2).c_str(),m_vertex_state.get_force(i).str(2).c_str());
 				}
 				*/
 
@@ -1935,18 +2185,18 @@ void cTeschnerMesh::compute_contact_forces() {
 				floor_fvector.normalize();
 				floor_fvector *= m_kFloor;
 
-				global_pos.set(v->m_pos.x, v->m_pos.y, v->m_pos.z);
+				global_pos.set(m_vertex_state.pos[0][i], m_vertex_state.pos[1][i], m_vertex_state.pos[2][i]);
 				m_localRot.mul(global_pos);
 				global_pos += m_localPos;
 				if (global_pos.y < m_floor_position) {
 					float floor_scale = (float)(m_floor_position - (float)(global_pos.y));
 					local_floor_force = floor_fvector;
 					local_floor_force *= floor_scale;
-					v->m_force.add(local_floor_force);
+					m_vertex_state.add_force(i, local_floor_force);
 
 					/*
 					if (i == 0) {
-					  _cprintf("floor: %s, %s\n",local_floor_force.str(2).c_str(),v->m_force.str(2).c_str());
+					  _cprintf("floor: %s, %s\n",local_floor_force.str(2).c_str(),m_vertex_state.get_force(i).str(2).c_str());
 					}
 					*/
 #ifdef RENDER_DEBUG_FORCES
@@ -1979,201 +2229,201 @@ void cTeschnerMesh::compute_contact_forces() {
 } // compute_contact_forces
 
 
-void cTeschnerMesh::compute_internal_forces() {
+// Elements per work item when computing internal forces
+#define INTERNAL_FORCE_CHUNK_SIZE 2048
 
-	cVector3f cur_vertex_pos, opposing_face_normal, volume_force;
+struct internal_force_job {
+	cTeschnerMesh* mesh;
+	int num_face_chunks;
+	int num_edge_chunks;
+	int num_tet_chunks;
+};
 
-	// For each vertex
-	for (register unsigned int i = 0; i < m_nVertices; i++) {
+inline int num_internal_force_chunks(unsigned int n) {
+	return (int)((n + INTERNAL_FORCE_CHUNK_SIZE - 1) / INTERNAL_FORCE_CHUNK_SIZE);
+}
 
-		cDeformableVertex* v = m_deformableVertices + i;
+// Chunks are numbered faces first, then edges, then tets
+void compute_element_terms_chunk(void* param, int chunk, int thread_index) {
 
-		if (m_compute_vertex_normals && (m_use_cmesh_normal_computation == false))
-			v->m_normal.set(0, 0, 0);
+	internal_force_job* job = (internal_force_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
 
-		cur_vertex_pos = v->m_pos;
+	if (chunk < job->num_face_chunks) {
+		unsigned int first = chunk * INTERNAL_FORCE_CHUNK_SIZE;
+		unsigned int last = first + INTERNAL_FORCE_CHUNK_SIZE;
+		if (last > mesh->m_nFaces) last = mesh->m_nFaces;
+		mesh->compute_face_terms(first, last);
+		return;
+	}
+	chunk -= job->num_face_chunks;
 
-		// Compute tet volume forces    
+	if (chunk < job->num_edge_chunks) {
+		unsigned int first = chunk * INTERNAL_FORCE_CHUNK_SIZE;
+		unsigned int last = first + INTERNAL_FORCE_CHUNK_SIZE;
+		if (last > mesh->m_nEdges) last = mesh->m_nEdges;
+		mesh->compute_edge_terms(first, last);
+		return;
+	}
+	chunk -= job->num_edge_chunks;
 
-		// For each tet I live in
-		const unsigned int n_local_tets = v->m_nTets;
-		unsigned int* curtet_index_ptr = m_containingTets + v->m_startingTetIndex;
-		int* cur_opposing_face = m_opposingFaces + v->m_startingTetIndex;
+	unsigned int first = chunk * INTERNAL_FORCE_CHUNK_SIZE;
+	unsigned int last = first + INTERNAL_FORCE_CHUNK_SIZE;
+	if (last > mesh->m_nTets) last = mesh->m_nTets;
+	mesh->compute_tet_terms(first, last);
+}
 
-		for (register unsigned int j = 0; j < n_local_tets; j++, curtet_index_ptr++, cur_opposing_face++) {
+void gather_vertex_forces_chunk(void* param, int chunk, int thread_index) {
 
-			int containing_tet_index = *curtet_index_ptr;
+	internal_force_job* job = (internal_force_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
 
-			// Find the rest and current volume for this tet
-			const float rest_volume = m_restTetVolumes[containing_tet_index];
-			const float cur_volume = m_tetVolumes[containing_tet_index];
+	unsigned int first = chunk * INTERNAL_FORCE_CHUNK_SIZE;
+	unsigned int last = first + INTERNAL_FORCE_CHUNK_SIZE;
+	if (last > mesh->m_nVertices) last = mesh->m_nVertices;
+	mesh->gather_vertex_forces(first, last);
+}
 
-			// Find the triangle I'm across from in this tet and get his normal
-			int facing_triangle = *cur_opposing_face;
 
-			volume_force = m_faceNormalsAndAreas[abs(facing_triangle)];
-			bool faces_toward_me = (sign(facing_triangle) >= 0);
-			volume_force.normalize();
+void cTeschnerMesh::compute_internal_forces() {
 
-			// Apply a force along or against that triangle's normal
-			// to restore tet volume
-			float volumek = m_kVolumePreservation;
-
-			if (m_heterogeneous_constants && (m_heterogeneous_constant_flags & (1 << KVOLUME))) {
-				volumek = m_hetero_kVolumePreservation[i];
-				float maxk = 0.0f;
-				bool nonuniform = false;
-				for (int m = 0; m < 4; m++) {
-					for (int n = 0; n < 4; n++) {
-						if (m_hetero_kVolumePreservation[containing_tet_index + m] != m_hetero_kVolumePreservation[containing_tet_index + n]) {
-							nonuniform = true;
-							float localmax = max(m_hetero_kVolumePreservation[containing_tet_index + m], m_hetero_kVolumePreservation[containing_tet_index + n]);
-							maxk = max(maxk, localmax);
-						}
-					}
-				}
+	internal_force_job job;
+	job.mesh = this;
+	job.num_face_chunks = num_internal_force_chunks(m_nFaces);
+	job.num_edge_chunks = num_internal_force_chunks(m_nEdges);
+	job.num_tet_chunks = num_internal_force_chunks(m_nTets);
 
-				if (nonuniform) volumek = maxk;
-			}
+	// Evaluate every element once...
+	int num_element_chunks = job.num_face_chunks + job.num_edge_chunks + job.num_tet_chunks;
+	run_chunks(num_element_chunks, compute_element_terms_chunk, &job);
 
-			volume_force *= ((cur_volume - rest_volume) * volumek);
+	// ...then have each vertex add up the terms from the elements it lives in
+	run_chunks(num_internal_force_chunks(m_nVertices), gather_vertex_forces_chunk, &job);
 
-			/*
-			_cprintf("Face %d (%f,%f,%f) points %s vertex %d (%f,%f,%f)\n",
-			  facing_triangle,
-			  opposing_face_normal.x,opposing_face_normal.y,opposing_face_normal.z,
-			  faces_toward_me?"toward":"away from",i,
-			  cur_vertex_pos.x,cur_vertex_pos.y,cur_vertex_pos.z);
-			  */
+} // compute_internal_forces()
 
-			if (faces_toward_me) volume_force *= -1.0f;
 
-			v->m_force.add(volume_force);
+void cTeschnerMesh::run_chunks(int num_chunks, void(*f)(void* param, int chunk, int thread_index),
+	void* param) {
 
-			/*
-			if (i == 0) {
-			  _cprintf("volume: %s, %s\n",volume_force.str(2).c_str(),v->m_force.str(2).c_str());
-			}
-			*/
+	int num_threads = parallel_resolve_num_threads(m_num_threads);
 
-#ifdef RENDER_DEBUG_FORCES
-			v->m_debug_volume_force += volume_force;
-#endif
+	if (num_threads == 1 || num_chunks <= 1 || m_nFaces + m_nEdges + m_nTets < PARALLEL_MIN_ELEMENTS) {
+		for (int i = 0; i < num_chunks; i++) f(param, i, 0);
+		return;
+	}
 
-		} // for each tet I live in
+	// Threads are started once and reused every tick after that
+	if (m_worker_pool && m_worker_pool_num_threads != m_num_threads) {
+		delete m_worker_pool;
+		m_worker_pool = 0;
+	}
+	if (m_worker_pool == 0) {
+		m_worker_pool = new parallel_worker_pool(num_threads);
+		m_worker_pool_num_threads = m_num_threads;
+	}
 
-		// Compute edge forces
+	m_worker_pool->run(num_chunks, f, param);
 
-		cVector3f opposing_vertex_pos, vector_toward_me, edge_force, damping_force;
+} // run_chunks()
 
-		// For each edge I live in
-		const unsigned int n_local_edges = v->m_nEdges;
-		unsigned int* curedge_index_ptr = m_containingEdges + v->m_startingEdgeIndex;
 
-		for (register unsigned int j = 0; j < n_local_edges; j++, curedge_index_ptr++) {
+float cTeschnerMesh::face_area_constant(const face& f) const {
 
-			unsigned int curedge_index = *curedge_index_ptr;
+	if (!(m_heterogeneous_constants && (m_heterogeneous_constant_flags & (1 << KAREA))))
+		return m_kAreaPreservation;
 
-			// Find the rest and current length for this edge
-			const float rest_length = m_restEdgeLengths[curedge_index];
-			const float cur_length = m_edgeLengths[curedge_index];
+	// If my vertices don't agree on a constant, use their max
+	float k0 = m_hetero_kAreaPreservation[f.v0];
+	float k1 = m_hetero_kAreaPreservation[f.v1];
+	float k2 = m_hetero_kAreaPreservation[f.v2];
+	float areak = k0;
+	if (k0 != k1 || k0 != k2 || k2 != k1) {
+		areak = max(max(k0, k1), k2);
+	}
+	return areak;
+}
 
-			edge e = m_edges[curedge_index];
 
-			// Find the vertex that isn't me
-			unsigned int opposing_vertex_index = (e.v0 == i) ? e.v1 : e.v0;
-			if (e.v1 == e.v0) {
-				_cprintf("Warning: degenerate edge\n");
-			}
+float cTeschnerMesh::edge_distance_constant(const edge& e) const {
+
+	if (!(m_heterogeneous_constants && (m_heterogeneous_constant_flags & (1 << KDISTANCE))))
+		return m_kDistancePreservation;
 
-			opposing_vertex_pos = m_deformableVertices[opposing_vertex_index].m_pos;
+	float distancek = m_hetero_kDistancePreservation[e.v0];
 
-			// Build a vector pointing from the opposing vertex toward this vertex
+	// Check to see whether I have a different constant than my neighbor; if so, 
+	// use our average, our max, whatever... but make it the same.
+	if (m_hetero_kDistancePreservation[e.v0] != m_hetero_kDistancePreservation[e.v1]) {
+		distancek = max(m_hetero_kDistancePreservation[e.v0], m_hetero_kDistancePreservation[e.v1]);
+	}
+	return distancek;
+}
 
-			edge_force = cur_vertex_pos;
-			edge_force.sub(opposing_vertex_pos);
-			edge_force.normalize();
 
-			// Apply a force along or against the edge to restore
-			// edge length
-			float distancek = m_kDistancePreservation;
-			if (m_heterogeneous_constants && (m_heterogeneous_constant_flags & (1 << KDISTANCE))) {
-				distancek = m_hetero_kDistancePreservation[i];
+float cTeschnerMesh::tet_volume_constant(unsigned int tet_index) const {
 
-				// Check to see whether I have a different constant than my neighbor; if so, 
-				// use our average, our max, whatever... but make it the same.
-				if (m_hetero_kDistancePreservation[i] != m_hetero_kDistancePreservation[opposing_vertex_index]) {
-					distancek = max(m_hetero_kDistancePreservation[i], m_hetero_kDistancePreservation[opposing_vertex_index]);
-				}
+	if (!(m_heterogeneous_constants && (m_heterogeneous_constant_flags & (1 << KVOLUME))))
+		return m_kVolumePreservation;
 
+	// If my vertices don't agree on a constant, use their max
+	const unsigned int* tet = m_tets + tet_index * 4;
+	float volumek = m_hetero_kVolumePreservation[tet[0]];
+	float maxk = 0.0f;
+	bool nonuniform = false;
+	for (int m = 0; m < 4; m++) {
+		for (int n = 0; n < 4; n++) {
+			if (m_hetero_kVolumePreservation[tet[m]] != m_hetero_kVolumePreservation[tet[n]]) {
+				nonuniform = true;
+				float localmax = max(m_hetero_kVolumePreservation[tet[m]], m_hetero_kVolumePreservation[tet[n]]);
+				maxk = max(maxk, localmax);
 			}
-			edge_force *= distancek * (rest_length - cur_length);
+		}
+	}
 
-			/*
-			_cprintf("Vertex %d to %d, force %f,%f,%f on edge %d\n",
-			  i,opposing_vertex_index,edge_force.x,edge_force.y,edge_force.z,curedge_index);
-			  */
+	if (nonuniform) volumek = maxk;
+	return volumek;
+}
 
-			v->m_force.add(edge_force);
 
-			/*
-			if (i == 0) {
-			  _cprintf("edge: %s, %s\n",edge_force.str(2).c_str(),v->m_force.str(2).c_str());
-			}
-			*/
+float cTeschnerMesh::vertex_damping_constant(unsigned int vertex_index) const {
+	if (m_heterogeneous_constants && (m_heterogeneous_constant_flags & (1 << KDAMPING)))
+		return m_hetero_kDistanceDamping[vertex_index];
+	return m_kDistanceDamping;
+}
 
-#ifdef RENDER_DEBUG_FORCES
-			v->m_debug_edge_force += edge_force;
-#endif      
 
-		} // for each edge I live in
+void cTeschnerMesh::compute_face_terms(unsigned int first, unsigned int last) {
 
-		// Compute face forces and update normal
+	cVector3f cur_face_normal, cur_vertex_pos, midpoint, other_vertex_positions[2],
+		force_vector, projection, perpendicular, area_force, edge, vector_toward_me;
 
-		// For each face I live in
-		const unsigned int n_local_faces = v->m_nFaces;
-		unsigned int* curface_index_ptr = m_containingFaces + v->m_startingFaceIndex;
+	// (skip the zero face, since it's invalid)
+	if (first == 0) first = 1;
 
-		cVector3f cur_face_normal, rest_face_normal, midpoint, other_vertex_positions[2],
-			force_vector, projection, perpendicular, area_force, edge;
+	for (unsigned int i = first; i < last; i++) {
 
-		for (register unsigned int j = 0; j < n_local_faces; j++, curface_index_ptr++) {
+		const face f = m_faces[i];
 
-			unsigned int curface_index = *curface_index_ptr;
+		// Find the current and rest areas for this face
+		cur_face_normal = m_faceNormalsAndAreas[i];
+		float current_area = cur_face_normal.length();
+		float rest_area = m_restFaceNormalsAndAreas[i].length();
 
-			// Find the current normal and length for this face 
-			cur_face_normal = m_faceNormalsAndAreas[curface_index];
-			float current_area = cur_face_normal.length();
-
-			// Find the rest normal and length for this face 
-			rest_face_normal = m_restFaceNormalsAndAreas[curface_index];
-			float rest_area = rest_face_normal.length();
-			// Not used for anything right now...
-			// rest_face_normal.normalize();
-
-			// Find the midpoint between the other two vertices for this face
-			unsigned int other_vertex_indices[2];
-			face f = m_faces[curface_index];
-			if (f.v0 == i) {
-				other_vertex_indices[0] = f.v1;
-				other_vertex_indices[1] = f.v2;
-			}
-			else if (f.v1 == i) {
-				other_vertex_indices[0] = f.v0;
-				other_vertex_indices[1] = f.v2;
-			}
-			else if (f.v2 == i) {
-				other_vertex_indices[0] = f.v0;
-				other_vertex_indices[1] = f.v1;
-			}
-			else {
-				_cprintf("Oops... I can't find myself in this face...\n");
-			}
+		// Both the volume forces and the vertex normals want this
+		cur_face_normal.normalize();
+		m_faceUnitNormals[i] = cur_face_normal;
+
+		float area_scale = face_area_constant(f) * (rest_area - current_area);
 
-			other_vertex_positions[0] =
-				m_deformableVertices[(other_vertex_indices[0])].m_pos;
-			other_vertex_positions[1] =
-				m_deformableVertices[(other_vertex_indices[1])].m_pos;
+		// For each of my vertices
+		for (int c = 0; c < 3; c++) {
+
+			cur_vertex_pos = m_vertex_state.get_pos(f[c]);
+
+			// The other two vertices, in order
+			other_vertex_positions[0] = m_vertex_state.get_pos(f[(c == 0) ? 1 : 0]);
+			other_vertex_positions[1] = m_vertex_state.get_pos(f[(c == 2) ? 1 : 2]);
 
 #define PROJECT_ONTO_PERPENDICULAR_EDGE
 
@@ -2185,7 +2435,7 @@ void cTeschnerMesh::compute_internal_forces() {
 
 			// Just a vector from this edge toward me, not necessarily
 			// optimal...
-			cVector3f vector_toward_me = cur_vertex_pos - midpoint;
+			vector_toward_me = cur_vertex_pos - midpoint;
 			vector_toward_me.normalize();
 			force_vector = vector_toward_me;
 
@@ -2218,51 +2468,173 @@ void cTeschnerMesh::compute_internal_forces() {
 			force_vector.normalize();
 
 #endif
-			// Apply a force between myself and that midpoint
+			// Apply a force between this vertex and the opposite edge
 			area_force = force_vector;
-			float areak = m_kAreaPreservation;
-			if (m_heterogeneous_constants && (m_heterogeneous_constant_flags & (1 << KAREA))) {
-				areak = m_hetero_kAreaPreservation[i];
-				if (
-					m_hetero_kAreaPreservation[i] != m_hetero_kAreaPreservation[(other_vertex_indices[0])]
-					||
-					m_hetero_kAreaPreservation[i] != m_hetero_kAreaPreservation[(other_vertex_indices[1])]
-					||
-					m_hetero_kAreaPreservation[(other_vertex_indices[1])] != m_hetero_kAreaPreservation[(other_vertex_indices[0])]
-					) {
-					areak = max(
-						max(m_hetero_kAreaPreservation[i], m_hetero_kAreaPreservation[(other_vertex_indices[0])]),
-						m_hetero_kAreaPreservation[(other_vertex_indices[1])]
-					);
-				}
-			}
-			area_force.mul(
-				areak * (rest_area - current_area)
-			);
+			area_force.mul(area_scale);
 
-			v->m_force.add(area_force);
+			m_faceAreaForces[3 * i + c] = area_force;
 
-			/*
-			if (i == 0) {
-			  _cprintf("area: %s, %s\n",area_force.str(2).c_str(),v->m_force.str(2).c_str());
+		} // for each of my vertices
+
+	} // for each face
+
+} // compute_face_terms()
+
+
+void cTeschnerMesh::compute_edge_terms(unsigned int first, unsigned int last) {
+
+	cVector3f edge_force;
+
+	for (unsigned int i = first; i < last; i++) {
+
+		const edge e = m_edges[i];
+
+		if (e.v1 == e.v0) {
+			_cprintf("Warning: degenerate edge\n");
+		}
+
+		// Find the rest and current length for this edge
+		const float rest_length = m_restEdgeLengths[i];
+		const float cur_length = m_edgeLengths[i];
+
+		// Build a vector pointing from v1 toward v0
+		edge_force = m_vertex_state.get_pos(e.v0);
+		edge_force.sub(m_vertex_state.get_pos(e.v1));
+		edge_force.normalize();
+
+		// Apply a force along or against the edge to restore
+		// edge length
+		edge_force *= edge_distance_constant(e) * (rest_length - cur_length);
+
+		// This is the force on v0; v1 gets the opposite
+		m_edgeForces[i] = edge_force;
+
+	} // for each edge
+
+} // compute_edge_terms()
+
+
+void cTeschnerMesh::compute_tet_terms(unsigned int first, unsigned int last) {
+
+	for (unsigned int i = first; i < last; i++) {
+
+		// Each vertex gets this times the unit normal of the face across from it
+		m_tetVolumeForceScales[i] = (m_tetVolumes[i] - m_restTetVolumes[i]) * tet_volume_constant(i);
+
+	} // for each tet
+
+} // compute_tet_terms()
+
+
+void cTeschnerMesh::gather_vertex_forces(unsigned int first, unsigned int last) {
+
+	cVector3f force, volume_force, edge_force, area_force, damping_force;
+
+	bool compute_normals = m_compute_vertex_normals && (m_use_cmesh_normal_computation == false);
+
+	// For each vertex
+	for (unsigned int i = first; i < last; i++) {
+
+		cDeformableVertex* v = m_deformableVertices + i;
+
+		// Accumulate locally; contact forces are already in here
+		force = m_vertex_state.get_force(i);
+
+		if (compute_normals) v->m_normal.set(0, 0, 0);
+
+#ifdef RENDER_DEBUG_FORCES
+		v->m_debug_volume_force.set(0, 0, 0);
+		v->m_debug_edge_force.set(0, 0, 0);
+		v->m_debug_area_force.set(0, 0, 0);
+#endif
+
+		// Add tet volume forces
+
+		// For each tet I live in
+		const unsigned int n_local_tets = v->m_nTets;
+		unsigned int* curtet_index_ptr = m_containingTets + v->m_startingTetIndex;
+		int* cur_opposing_face = m_opposingFaces + v->m_startingTetIndex;
+
+		for (unsigned int j = 0; j < n_local_tets; j++, curtet_index_ptr++, cur_opposing_face++) {
+
+			// Find the triangle I'm across from in this tet and get his normal
+			int facing_triangle = *cur_opposing_face;
+
+			volume_force = m_faceUnitNormals[abs(facing_triangle)];
+			bool faces_toward_me = (sign(facing_triangle) >= 0);
+
+			// Apply a force along or against that triangle's normal
+			// to restore tet volume
+			volume_force *= m_tetVolumeForceScales[*curtet_index_ptr];
+
+			if (faces_toward_me) volume_force *= -1.0f;
+
+			force.add(volume_force);
+
+#ifdef RENDER_DEBUG_FORCES
+			v->m_debug_volume_force += volume_force;
+#endif
+
+		} // for each tet I live in
+
+		// Add edge forces
+
+		// For each edge I live in
+		const unsigned int n_local_edges = v->m_nEdges;
+		unsigned int* curedge_index_ptr = m_containingEdges + v->m_startingEdgeIndex;
+
+		for (unsigned int j = 0; j < n_local_edges; j++, curedge_index_ptr++) {
+
+			unsigned int curedge_index = *curedge_index_ptr;
+
+			edge_force = m_edgeForces[curedge_index];
+			if (m_edges[curedge_index].v0 != i) edge_force.negate();
+
+			force.add(edge_force);
+
+#ifdef RENDER_DEBUG_FORCES
+			v->m_debug_edge_force += edge_force;
+#endif      
+
+		} // for each edge I live in
+
+		// Add face forces and update normal
+
+		// For each face I live in
+		const unsigned int n_local_faces = v->m_nFaces;
+		unsigned int* curface_index_ptr = m_containingFaces + v->m_startingFaceIndex;
+
+		for (unsigned int j = 0; j < n_local_faces; j++, curface_index_ptr++) {
+
+			unsigned int curface_index = *curface_index_ptr;
+
+			// Which of this face's vertices am I?
+			const face f = m_faces[curface_index];
+			int corner;
+			if (f.v0 == i) corner = 0;
+			else if (f.v1 == i) corner = 1;
+			else if (f.v2 == i) corner = 2;
+			else {
+				_cprintf("Oops... I can't find myself in this face...\n");
+				continue;
 			}
-			*/
 
+			area_force = m_faceAreaForces[3 * curface_index + corner];
+			force.add(area_force);
 
 #ifdef RENDER_DEBUG_FORCES
 			v->m_debug_area_force += area_force;
 #endif
 
-			if (m_compute_vertex_normals && (m_use_cmesh_normal_computation == false)) {
+			if (compute_normals) {
 				// Add this face's normal to my accumulating normal
-				cur_face_normal.normalize();
-				v->m_normal.add(cur_face_normal);
+				v->m_normal.add(m_faceUnitNormals[curface_index]);
 			}
 		} // for each face that I live in
 
 		// TODO: this doesn't need to happen every sim pass, just every
 		// rendering pass...
-		if (m_compute_vertex_normals && (m_use_cmesh_normal_computation == false)) {
+		if (compute_normals) {
 			// Normalize and store normal
 			v->m_normal.normalize();
 			if (i == g_debug_vertex_index) {
@@ -2274,18 +2646,11 @@ void cTeschnerMesh::compute_internal_forces() {
 		//
 		// TODO: This is actually global damping, not damping the distance
 		// force specifically...
-		damping_force = v->m_velocity;
-		float dampingk = m_kDistanceDamping;
-		if (m_heterogeneous_constants && (m_heterogeneous_constant_flags & (1 << KDAMPING)))
-			dampingk = m_hetero_kDistanceDamping[i];
-		damping_force *= (-1.0f * dampingk);
-		v->m_force.add(damping_force);
+		damping_force = m_vertex_state.get_velocity(i);
+		damping_force *= (-1.0f * vertex_damping_constant(i));
+		force.add(damping_force);
 
-		/*
-		if (i == 0) {
-		  _cprintf("damping: %s, %s\n",damping_force.str(2).c_str(),v->m_force.str(2).c_str());
-		}
-		*/
+		m_vertex_state.set_force(i, force);
 
 #ifdef RENDER_DEBUG_FORCES
 		v->m_debug_damping_force = damping_force;
@@ -2293,7 +2658,7 @@ void cTeschnerMesh::compute_internal_forces() {
 
 	} // for each vertex
 
-} // compute_forces()
+} // gather_vertex_forces()
 
 
 bool cTeschnerMesh::compute_face_areas() {
@@ -2308,7 +2673,7 @@ bool cTeschnerMesh::compute_face_areas() {
 		// Find the position of each vertex
 		cVector3f positions[3];
 		for (register int j = 0; j < 3; j++) {
-			positions[j] = m_deformableVertices[((*curface)[j])].m_pos;
+			positions[j] = m_vertex_state.get_pos((*curface)[j]);
 		}
 
 		// Compute face area / normal
@@ -2348,7 +2713,7 @@ bool cTeschnerMesh::compute_tet_volumes() {
 		// Find the position of each vertex
 		cVector3f positions[4];
 		for (register int j = 0; j < 4; j++) {
-			positions[j] = m_deformableVertices[(curtet[j])].m_pos;
+			positions[j] = m_vertex_state.get_pos(curtet[j]);
 		}
 
 		// Compute _signed_ tet volume
@@ -2387,8 +2752,8 @@ bool cTeschnerMesh::compute_spring_lengths() {
 		// Compute spring length
 		const edge* e = m_edges + i;
 		m_edgeLengths[i] =
-			m_deformableVertices[e->v0].m_pos.distance(
-				m_deformableVertices[e->v1].m_pos);
+			m_vertex_state.get_pos(e->v0).distance(
+				m_vertex_state.get_pos(e->v1));
 	}
 
 	return true;
@@ -2397,10 +2762,10 @@ bool cTeschnerMesh::compute_spring_lengths() {
 
 void cTeschnerMesh::applyForce(unsigned int vertex_index, cVector3f& force) {
 	if (vertex_index >= m_nVertices) return;
-	m_deformableVertices[vertex_index].m_force.add(force);
+	m_vertex_state.add_force(vertex_index, force);
 
 	if (vertex_index == 0) {
-		_cprintf("apply: %s, %s\n", force.str(2).c_str(), m_deformableVertices[vertex_index].m_force.str(2).c_str());
+		_cprintf("apply: %s, %s\n", force.str(2).c_str(), m_vertex_state.get_force(vertex_index).str(2).c_str());
 	}
 }
 
@@ -2413,12 +2778,31 @@ void cTeschnerMesh::build_rendering_weights() {
 
 	_cprintf("Building rendering weights...\n");
 
+	// prepare_to_render() will repack whatever we build here
+	if (m_skinning) delete m_skinning;
+	m_skinning = 0;
+
 #define KD_EPSILON 0.0001f
 
 	m_compute_vertex_normals = true;
 	m_weights_per_vertex = WEIGHTS_PER_VERTEX;
 	int neighbors_to_find = m_weights_per_vertex + EXTRA_NEIGHBORS_TO_FIND;
 
+	// Is there a snapshot of these weights?
+	char snapshot_filename[_MAX_PATH];
+	snapshot_filename[0] = '\0';
+	unsigned long long snapshot_key = 0;
+
+	if (m_snapshot_root[0] && m_snapshot_key) {
+		sprintf(snapshot_filename, "%s%s", m_snapshot_root, TESCHNER_SKINNING_SNAPSHOT_EXTENSION);
+		snapshot_key = compute_rendering_weights_snapshot_key(neighbors_to_find);
+		if (load_rendering_weights_snapshot(snapshot_filename, snapshot_key)) {
+			_cprintf("Loaded rendering weights from %s\n", snapshot_filename);
+			this->addChild(m_rendering_mesh);
+			return;
+		}
+	}
+
 	unsigned int n_rendering_vertices = m_rendering_mesh->getNumVertices(true);
 
 	unsigned int n_total_weights = n_rendering_vertices*m_weights_per_vertex;
@@ -2467,7 +2851,7 @@ void cTeschnerMesh::build_rendering_weights() {
 		// Put this vertex in the tree
 		ANNpoint p = kd_points[i];
 		for (int k = 0; k < 3; k++) {
-			p[k] = m_deformableVertices[index].m_pos[k];
+			p[k] = m_vertex_state.pos[k][index];
 		}
 	}
 
@@ -2510,7 +2894,7 @@ void cTeschnerMesh::build_rendering_weights() {
 
 			cDeformableVertex* cdv = m_deformableVertices + cur_pt_idx;
 
-			cVector3f cur_pt_pos = cdv->m_pos;
+			cVector3f cur_pt_pos = m_vertex_state.get_pos(cur_pt_idx);
 			cVector3f cur_pt_normal = cdv->m_normal;
 
 			bool valid_effector = true;
@@ -2606,7 +2990,7 @@ void cTeschnerMesh::build_rendering_weights() {
 
 				// The next will be the first triangle axis, made perpendicular to the normal
 				unsigned int other_pt_idx = m_opposite_edge_vertices[weight_offset];
-				cVector3f other_pt_pos = m_deformableVertices[other_pt_idx].m_pos;
+				cVector3f other_pt_pos = m_vertex_state.get_pos(other_pt_idx);
 				cVector3f edge = other_pt_pos - origin;
 
 				// Component parallel to my normal
@@ -2696,6 +3080,11 @@ void cTeschnerMesh::build_rendering_weights() {
 
 		if (valid_weights_found < m_weights_per_vertex) {
 			_cprintf("Warning: vertex %d only has %d weights (instead of %d)\n", i, valid_weights_found, m_weights_per_vertex);
+
+			// A -1 value says "no more effectors"
+			for (j = valid_weights_found; j < m_weights_per_vertex; j++) {
+				m_vertex_effectors[i*m_weights_per_vertex + j] = -1;
+			}
 		}
 
 		float normalization_factor = (float)(1.0 / total_inverse_squared_distance);
@@ -2723,6 +3112,8 @@ void cTeschnerMesh::build_rendering_weights() {
 
 	_cprintf("Cleaned up kd tree\n");
 
+	if (snapshot_filename[0]) save_rendering_weights_snapshot(snapshot_filename, snapshot_key);
+
 	this->addChild(m_rendering_mesh);
 }
 
@@ -2792,13 +3183,15 @@ void cTeschnerMesh::prepare_heterogeneous_constant_rendering() {
 		cVertex* cur = rendering_vertex_array;
 		cVertex* end = rendering_vertex_array + n_rendering_vertices;
 
-		int weight_offset = 0;
-
 		unsigned int vcount = 0;
 
 		// For each of my rendering mesh's vertices
 		while (cur != end) {
 
+			// Every vertex has m_weights_per_vertex slots, even if it doesn't
+			// use them all
+			unsigned int first_weight = vcount * m_weights_per_vertex;
+
 			vcount++;
 
 			cur->m_color.set(0, 0, 0);
@@ -2806,6 +3199,8 @@ void cTeschnerMesh::prepare_heterogeneous_constant_rendering() {
 			// For each relevant effector vertex
 			for (unsigned int j = 0; j < m_weights_per_vertex; j++) {
 
+				unsigned int weight_offset = first_weight + j;
+
 				// This will be the "vote" from this weight source
 				cColorb tempcolor;
 
@@ -2832,8 +3227,6 @@ void cTeschnerMesh::prepare_heterogeneous_constant_rendering() {
 				cur->m_color.m_color[1] += tempcolor.m_color[1];
 				cur->m_color.m_color[2] += tempcolor.m_color[2];
 
-				weight_offset++;
-
 			} // for each effector
 
 			cur++;
@@ -10,18 +10,32 @@
 
 #define DEFAULT_FLOOR_POSITION -1.0
 
+// Meshes with fewer elements (faces + edges + tets) than this run their
+// per-tick passes on the calling thread; waking the workers costs more than
+// it saves
+#define PARALLEL_MIN_ELEMENTS 8192
+
 typedef enum {
 	FIXED_TET_DENSITY = 0, FIXED_TOTAL_MASS, FIXED_VERTEX_MASS
 } mass_assignment_strategies;
 
+typedef enum {
+	INTEGRATOR_VERLET = 0, INTEGRATOR_IMPLICIT_EULER
+} integrator_types;
+
+// What cTeschnerMesh::solve_static() found
+typedef enum {
+	STATIC_SOLVE_CONVERGED = 0, STATIC_SOLVE_NOT_CONVERGED, STATIC_SOLVE_ERROR
+} static_solve_results;
+
 typedef cTetMesh teschner_mesh_parent_mesh_type;
 
-struct temp_vertex_info {
-	std::vector<unsigned int> containing_tets;
-	std::vector<unsigned int> opposing_faces;
-	std::vector<unsigned int> containing_faces;
-	std::vector<unsigned int> containing_edges;
-};
+// Defined in teschner_implicit.h
+struct implicit_solver_state;
+struct skinning_engine;
+
+// Defined in parallel_for.h
+class parallel_worker_pool;
 
 struct external_material_properties {
 	double youngs_modulus;
@@ -96,6 +110,19 @@ public:
 	// Returns true for success, false for errors.
 	bool tick();
 
+	// Starts and ends constraints according to the current sim time; called
+	// by tick()
+	void update_constraints();
+
+	// Moves the mesh straight to equilibrium under whatever loads are in
+	// effect one timestep from now, instead of simulating until it gets
+	// there (see teschner_static.cpp), and leaves it at rest.
+	//
+	// Returns a static_solve_results value; [iterations] and [residual]
+	// (the largest remaining force on any free vertex), if supplied, say
+	// how it went.
+	int solve_static(int* iterations = 0, float* residual = 0);
+
 	// Copy relevant vertex data to the rendering data structures (for now)
 	//
 	// Not called internally; should be called by the user at relevant
@@ -109,6 +136,37 @@ public:
 	// Returns -1 if there's an error, zero if all goes well
 	int initialize(cTeschnerMesh* old_model = 0);
 
+	// Set this mesh up as another copy of [prototype] (which has to be
+	// initialized already), in its rest state.  Connectivity and rest-state
+	// arrays aren't copied; they're shared with [prototype], which has to
+	// outlive this mesh.  Constants are copied, so they can be changed
+	// independently afterwards.  Constraints aren't copied.
+	//
+	// Returns -1 if there's an error, zero if all goes well
+	int initialize_shared(cTeschnerMesh* prototype);
+
+	// True if my connectivity and rest state belong to another mesh (see
+	// initialize_shared())
+	bool m_shares_connectivity;
+
+	// If this is set, initialize() and build_rendering_weights() look for
+	// snapshots of their results ([root].tsnap and [root].tskin) before
+	// doing any work, and write them afterwards (see teschner_snapshot.h)
+	char m_snapshot_root[_MAX_PATH];
+
+	// Hash of everything initialize() depended on (zero if we're not using
+	// snapshots)
+	unsigned long long m_snapshot_key;
+
+	unsigned long long compute_snapshot_key();
+	unsigned long long compute_rendering_weights_snapshot_key(int neighbors_to_find);
+
+	// Return true on success
+	bool save_snapshot(const char* filename, unsigned long long key);
+	bool load_snapshot(const char* filename, unsigned long long key);
+	bool save_rendering_weights_snapshot(const char* filename, unsigned long long key);
+	bool load_rendering_weights_snapshot(const char* filename, unsigned long long key);
+
 	// Reset mesh to initial state
 	int reset();
 
@@ -151,6 +209,25 @@ public:
 	// floor is enabled
 	float m_floor_position;
 
+	// How many threads compute_internal_forces() and implicit_step() use
+	// (less than one means one per processor)
+	int m_num_threads;
+
+	// Which integrator tick() uses (an integrator_types value)
+	int m_integrator;
+
+	// Conjugate gradient limits for INTEGRATOR_IMPLICIT_EULER; each solve
+	// stops after this many iterations, or when the residual is this
+	// fraction of the right-hand side
+	int m_implicit_max_iterations;
+	float m_implicit_tolerance;
+
+	// Limits for solve_static(); it has converged when no free vertex has
+	// a net force bigger than this fraction of the largest one it started
+	// with
+	int m_static_max_iterations;
+	float m_static_tolerance;
+
 	bool m_render_vertex_constraints;
 
 	// The remaining constants need to be set up _before_ initialization
@@ -209,6 +286,16 @@ public:
 
 	void build_rendering_weights();
 
+	// The packed form of the weights above that prepare_to_render() runs
+	// from; built the first time it's needed, and thrown away whenever the
+	// weights are rebuilt
+	skinning_engine* m_skinning;
+
+	// The threads run_chunks() uses, started the first time a tick needs
+	// them, and the m_num_threads they were started for
+	parallel_worker_pool* m_worker_pool;
+	int m_worker_pool_num_threads;
+
 	void clear_solid_sections();
 
 	SYSTEMTIME m_sim_start_date_and_time;
@@ -222,18 +309,51 @@ public:
 	// Move all my vertices based on current forces (via Verlet integration)
 	// * This is where the current and previous position arrays get swapped
 	// * This is also where the current set of forces gets zero'd at each
-	//   iteration... so after this is called, the _previous_ vertex
-	//   array holds the most recent set of forces.
+	//   iteration
 	bool move_vertices();
 
+	// The alternative to move_vertices() for INTEGRATOR_IMPLICIT_EULER: one
+	// backward Euler step, solved with preconditioned conjugate gradient
+	// (see teschner_implicit.cpp).  Also swaps positions and zeroes forces.
+	bool implicit_step();
+
+	// Called by both of the above before they swap positions; does nothing
+	// unless RESTRICT_FLOOR_PENETRATION is defined
+	void restrict_floor_penetration(float velocity_scale);
+
+	// Stiffness Jacobian factors and solver vectors for implicit_step(),
+	// allocated the first time it runs
+	implicit_solver_state* m_implicit;
+
 	// Compute forces (called at each iteration) based on current areas, etc.
 	//
 	// Should be called _after_ the face/tet/spring state computation functions.
 	bool compute_forces();
 
+	// Each edge, face, and tet is evaluated once (in parallel) into the
+	// per-element arrays below, then each vertex adds up the terms from the
+	// elements it lives in, in the same order every time
 	void compute_internal_forces();
 	void compute_contact_forces();
 
+	// Runs f(param,chunk,thread) for every chunk in [0,num_chunks) on my
+	// worker pool, or on this thread if I'm smaller than
+	// PARALLEL_MIN_ELEMENTS
+	void run_chunks(int num_chunks, void(*f)(void* param, int chunk, int thread_index), void* param);
+
+	// The pieces of compute_internal_forces, each over an index range
+	void compute_face_terms(unsigned int first, unsigned int last);
+	void compute_edge_terms(unsigned int first, unsigned int last);
+	void compute_tet_terms(unsigned int first, unsigned int last);
+	void gather_vertex_forces(unsigned int first, unsigned int last);
+
+	// The spring constants for each element (the max over its vertices, if
+	// constants are heterogeneous)
+	float face_area_constant(const face& f) const;
+	float edge_distance_constant(const edge& e) const;
+	float tet_volume_constant(unsigned int tet_index) const;
+	float vertex_damping_constant(unsigned int vertex_index) const;
+
 	// Compute the area and surface normal of each triangle
 	bool compute_face_areas();
 
@@ -248,6 +368,10 @@ public:
 	// Compute the mass of each vertex based on tet volumes
 	void initialize_vertex_masses();
 
+	// The expensive part of initialize(): prunes degenerate tets, builds
+	// connectivity, rest state, and masses
+	void build_initial_state();
+
 	/***
 	INITIALIZATION INFORMATION
 	***/
@@ -268,13 +392,29 @@ public:
 	// VARIABLE: current tet volumes
 	float* m_tetVolumes;
 
+	// VARIABLE: per-element force terms, written by compute_internal_forces
+
+	// Unit normal for each face
+	cVector3f* m_faceUnitNormals;
+
+	// Area-preservation force on each of a face's three vertices
+	cVector3f* m_faceAreaForces;
+
+	// Distance-preservation force on each edge's v0 (v1 gets the opposite)
+	cVector3f* m_edgeForces;
+
+	// Volume-preservation force magnitude for each tet; each vertex gets
+	// this along the normal of the face across from it
+	float* m_tetVolumeForceScales;
+
 	// VARIABLE: vertex data
 	unsigned int m_nVertices;
 
 	cDeformableVertex* m_deformableVertices;
 
-	// VARIABLE: positions (etc.) of each vertex in the previous frame
-	cDeformableVertex* m_previousPositions;
+	// VARIABLE: positions (current and previous), forces, velocities (etc.)
+	// of each vertex
+	deformable_vertex_state m_vertex_state;
 
 	/***
 	Backup information for mesh restoration
@@ -283,9 +423,7 @@ public:
 	float* m_bkup_edgeLengths;
 	float* m_bkup_tetVolumes;
 	cDeformableVertex* m_bkup_deformableVertices;
-
-	// Not necessary to store this, just a reminder...
-	// cDeformableVertex* m_bkup_previousPositions;
+	deformable_vertex_state m_bkup_vertex_state;
 
 
 	/***
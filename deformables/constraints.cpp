@@ -1,5 +1,6 @@
 #include "constraints.h"
 #include <regex>
+#include <algorithm>
 using namespace std;
 
 int g_next_constraint_tag = 0;
@@ -191,71 +192,151 @@ bool constraint_set::add_constraint(const char* constraint_str) {
 }
 
 
+constraint_set::constraint_set() {
+	m_compiled = false;
+	m_n_vertices = 0;
+}
+
+
 void constraint_set::add_constraint(constraint* c) {
 
 	constraints_by_start_time.insert(c);
 	constraints_by_end_time.insert(c);
 
+	scheduled.push_back(scheduled_constraint(c));
+
+	// If we're already running, this one joins the schedule now
+	if (m_compiled) {
+		compile_vertices(scheduled.back());
+		schedule(scheduled.size() - 1);
+	}
+
 }
 
 void constraint_set::clear() {
 	active_constraints.clear();
 	constraints_by_start_time.clear();
 	constraints_by_end_time.clear();
+	scheduled.clear();
+	start_events.clear();
+	end_events.clear();
+	m_compiled = false;
 }
 
 
 void constraint_set::reset() {
 	active_constraints.clear();
-	next_constraint_start = constraints_by_start_time.begin();
-	next_constraint_end = constraints_by_end_time.begin();
+	start_events.clear();
+	end_events.clear();
+	m_compiled = false;
+	last_update_cost = total_update_cost = constraint_update_cost();
+}
+
+
+void constraint_set::compile(unsigned int n_vertices) {
+
+	m_n_vertices = n_vertices;
+	active_constraints.clear();
+	start_events.clear();
+	end_events.clear();
+	start_events.reserve(scheduled.size());
+	end_events.reserve(scheduled.size());
+
+	for (unsigned int i = 0; i < scheduled.size(); i++) {
+		compile_vertices(scheduled[i]);
+		schedule(i);
+	}
+
+	m_compiled = true;
+}
+
+
+void constraint_set::compile_vertices(scheduled_constraint& sc) {
+
+	constraint* c = sc.c;
+	sc.vertices.clear();
+
+	if (c->affects_all_vertices) {
+		sc.vertices.resize(m_n_vertices);
+		for (unsigned int i = 0; i < m_n_vertices; i++) sc.vertices[i] = i;
+		return;
+	}
+
+	// Without a vertex count, we can't check anything
+	if (m_n_vertices == 0) return;
+
+	sc.vertices.reserve(c->vertices.size());
+	for (unsigned int i = 0; i < c->vertices.size(); i++) {
+		unsigned int index = c->vertices[i];
+		if (index >= m_n_vertices) {
+			_cprintf("Illegal vertex %d (of %d) in constraint %d\n", index, m_n_vertices, c->tag);
+			continue;
+		}
+		sc.vertices.push_back(index);
+	}
+}
+
+
+void constraint_set::schedule(unsigned int index) {
+
+	constraint_event e;
+	e.index = index;
+
+	e.time = scheduled[index].c->start_time;
+	start_events.push_back(e);
+	std::push_heap(start_events.begin(), start_events.end(), later_constraint_event());
+
+	e.time = scheduled[index].c->end_time;
+	end_events.push_back(e);
+	std::push_heap(end_events.begin(), end_events.end(), later_constraint_event());
 }
 
 
-constraint* constraint_set::get_next_constraint_start(float curtime) {
+scheduled_constraint* constraint_set::get_next_constraint_start(float curtime) {
+
+	if (m_compiled == false) compile(m_n_vertices);
 
 	// Are there any more starting constraints?
-	if (constraints_by_start_time.empty() || next_constraint_start == constraints_by_start_time.end()) {
+	if (start_events.empty() || start_events.front().time > curtime) {
 		return 0;
 	}
-	constraint* c = *next_constraint_start;
-	if (c->start_time <= curtime) {
 
-		// We need to activate this constraint
-		active_constraints[c->tag] = c;
+	std::pop_heap(start_events.begin(), start_events.end(), later_constraint_event());
+	scheduled_constraint* sc = &(scheduled[start_events.back().index]);
+	start_events.pop_back();
 
-		next_constraint_start++;
-		return c;
-	}
-	return 0;
+	// We need to activate this constraint
+	active_constraints[sc->c->tag] = sc->c;
+	return sc;
 
 }
 
 
-constraint* constraint_set::get_next_constraint_end(float curtime) {
+scheduled_constraint* constraint_set::get_next_constraint_end(float curtime) {
+
+	if (m_compiled == false) compile(m_n_vertices);
 
 	// Are there any more ending constraints?
-	if (constraints_by_end_time.empty() || next_constraint_end == constraints_by_end_time.end()) {
+	if (end_events.empty() || end_events.front().time > curtime) {
 		return 0;
 	}
-	constraint* c = *next_constraint_end;
-	if (c->end_time <= curtime) {
 
-		// We need to deactivate this constraint
-		std::map<unsigned int, constraint*>::iterator iter;
-		iter = active_constraints.find(c->tag);
+	std::pop_heap(end_events.begin(), end_events.end(), later_constraint_event());
+	scheduled_constraint* sc = &(scheduled[end_events.back().index]);
+	end_events.pop_back();
 
-		if (iter == active_constraints.end()) {
-			_cprintf("Oops... constraint %d is ending but not active\n", c->tag);
-		}
-		else {
-			active_constraints.erase(iter);
-		}
+	// We need to deactivate this constraint
+	std::map<unsigned int, constraint*>::iterator iter;
+	iter = active_constraints.find(sc->c->tag);
 
-		next_constraint_end++;
-		return c;
+	if (iter == active_constraints.end()) {
+		_cprintf("Oops... constraint %d is ending but not active\n", sc->c->tag);
+	}
+	else {
+		active_constraints.erase(iter);
 	}
-	return 0;
+
+	return sc;
 }
 
 constraint_set::~constraint_set() {
@@ -273,7 +354,7 @@ constraint_set::~constraint_set() {
 
 void constraint_set::idle(float curtime) {
 
-	constraint* c;
+	scheduled_constraint* c;
 	do { c = get_next_constraint_start(curtime); } while (c != 0);
 	do { c = get_next_constraint_end(curtime); } while (c != 0);
 
@@ -112,29 +112,87 @@ struct lt_constraint_end
 	}
 };
 
+// A constraint with its vertex list checked against the mesh it's applied
+// to (and "all" spelled out), so applying it is a plain scatter over
+// [vertices]
+struct scheduled_constraint {
+	constraint* c;
+	std::vector<unsigned int> vertices;
+	scheduled_constraint(constraint* c_) : c(c_) {}
+};
+
+// A constraint starting or ending
+struct constraint_event {
+	float time;
+
+	// Into constraint_set::scheduled
+	unsigned int index;
+};
+
+// Heap order: earliest on top, ties in the order constraints were added
+struct later_constraint_event
+{
+	bool operator()(const constraint_event& e1, const constraint_event& e2) const
+	{
+		if (e1.time != e2.time) return (e1.time > e2.time);
+		return (e1.index > e2.index);
+	}
+};
+
+// How much work cTeschnerMesh::update_constraints() has done
+struct constraint_update_cost {
+	// Constraints started or ended
+	unsigned int events;
+
+	// Vertex updates those constraints required
+	unsigned int vertex_updates;
+
+	constraint_update_cost() { events = vertex_updates = 0; }
+};
+
 class constraint_set {
 
 public:
+	constraint_set();
+
 	void add_constraint(constraint* c);
 	bool add_constraint(const char* constraint_str);
 
+	// Rewinds to time zero
 	void reset();
 	void clear();
 
+	// Checks every constraint's vertices against a mesh with [n_vertices]
+	// vertices and rewinds to time zero.  If nobody has done this since the
+	// last reset(), get_next_constraint_start() does it with the last
+	// vertex count it was given.
+	void compile(unsigned int n_vertices);
+	bool needs_compile(unsigned int n_vertices) const {
+		return (m_compiled == false || n_vertices != m_n_vertices);
+	}
+
 	// Call these until they return zero to get constraints that are
 	// starting and ending
 
 	// Returns constraints that should have started now
-	constraint* get_next_constraint_start(float curtime);
+	scheduled_constraint* get_next_constraint_start(float curtime);
 
 	// Returns constraints that should have ended now
-	constraint* get_next_constraint_end(float curtime);
+	scheduled_constraint* get_next_constraint_end(float curtime);
 
 	// Read-only... use to get the list of active constraints
 	std::map<unsigned int, constraint*> active_constraints;
 	std::multiset<constraint*, lt_constraint_start> constraints_by_start_time;
 	std::multiset<constraint*, lt_constraint_end> constraints_by_end_time;
 
+	// Every constraint, in the order it was added
+	std::vector<scheduled_constraint> scheduled;
+
+	// Filled in by the mesh: the cost of the most recent update, and the
+	// total since the last reset()
+	constraint_update_cost last_update_cost;
+	constraint_update_cost total_update_cost;
+
 	// If you just want the list of active constraints to be 
 	// maintained, use this...
 	void idle(float curtime);
@@ -142,9 +200,16 @@ public:
 	virtual ~constraint_set();
 
 protected:
-	std::multiset<constraint*, lt_constraint_start>::iterator next_constraint_start;
-	std::multiset<constraint*, lt_constraint_end>::iterator next_constraint_end;
+	// Binary heaps (see later_constraint_event) of the constraints that
+	// haven't started and haven't ended yet
+	std::vector<constraint_event> start_events;
+	std::vector<constraint_event> end_events;
+
+	bool m_compiled;
+	unsigned int m_n_vertices;
 
+	void compile_vertices(scheduled_constraint& sc);
+	void schedule(unsigned int index);
 };
 
 
@@ -2,6 +2,8 @@
 #define _DEFORMABLE_MESH_DATA_STRUCTURES_H_
 
 #include "CVector3f.h"
+#include <malloc.h>
+#include <string.h>
 
 #ifdef _DEBUG
 #define RENDER_DEBUG_FORCES
@@ -45,11 +47,10 @@ struct edge {
 	edge() {}
 };
 
+// Per-vertex data that isn't touched by the integrator; positions, forces,
+// and velocities live in deformable_vertex_state
 struct cDeformableVertex {
-	cVector3f m_pos;
-	cVector3f m_force;
 	cVector3f m_normal;
-	cVector3f m_velocity;
 
 #ifdef RENDER_DEBUG_FORCES
 	cVector3f m_debug_edge_force;
@@ -64,9 +65,9 @@ struct cDeformableVertex {
 	// How many position constraints affect this vertex?
 	unsigned char position_is_constrained;
 
-	// How many force constraints affect this vertex?
+	// How many force constraints affect this vertex?  (The sum of those
+	// forces is in deformable_vertex_state.)
 	unsigned char force_is_constrained;
-	cVector3f constraint_force;
 
 	float m_mass;
 
@@ -78,6 +79,110 @@ struct cDeformableVertex {
 	unsigned int m_startingEdgeIndex;
 };
 
+// The vertex count is padded out to a multiple of this, so the integrator
+// never has to handle a partial SIMD vector; it's also the alignment (in
+// floats) of each array
+#define VERTEX_STATE_PADDING 8
+
+// The per-vertex state that the integrator touches every timestep, stored
+// as separate x, y, and z arrays so move_vertices can work on a whole SIMD
+// vector of vertices at once.
+//
+// Only positions are double-buffered; pos and prev_pos trade places at each
+// timestep.  Padding vertices have zero mass, force, and freedom, so they
+// never move.
+struct deformable_vertex_state {
+
+	unsigned int n;
+	unsigned int padded_n;
+
+	float* pos[3];
+	float* prev_pos[3];
+	float* force[3];
+	float* velocity[3];
+
+	// Sum of the constant-force constraints on each vertex
+	float* constraint_force[3];
+
+	float* inverse_mass;
+
+	// 0 for vertices with a position constraint, 1 for everyone else
+	float* position_free;
+
+	// All of the above, in one block
+	float* m_data;
+
+	deformable_vertex_state() { n = padded_n = 0; m_data = 0; }
+	~deformable_vertex_state() { release(); }
+
+	// Allocates (and zeroes) state for n vertices, all free
+	void allocate(unsigned int n_vertices) {
+		release();
+		n = n_vertices;
+		padded_n = ((n + VERTEX_STATE_PADDING - 1) / VERTEX_STATE_PADDING) * VERTEX_STATE_PADDING;
+		m_data = (float*)_aligned_malloc(padded_n * 17 * sizeof(float), VERTEX_STATE_PADDING * sizeof(float));
+		memset(m_data, 0, padded_n * 17 * sizeof(float));
+		float* p = m_data;
+		for (int a = 0; a < 3; a++) {
+			pos[a] = p; p += padded_n;
+			prev_pos[a] = p; p += padded_n;
+			force[a] = p; p += padded_n;
+			velocity[a] = p; p += padded_n;
+			constraint_force[a] = p; p += padded_n;
+		}
+		inverse_mass = p; p += padded_n;
+		position_free = p;
+		for (unsigned int i = 0; i < n; i++) position_free[i] = 1.0f;
+	}
+
+	void release() {
+		if (m_data) _aligned_free(m_data);
+		m_data = 0;
+		n = padded_n = 0;
+	}
+
+	// Copies everything from [src], which has to be the same size
+	void copy_from(const deformable_vertex_state& src) {
+		if (src.padded_n != padded_n) allocate(src.n);
+		memcpy(m_data, src.m_data, padded_n * 17 * sizeof(float));
+
+		// [src]'s position buffers may be swapped
+		for (int a = 0; a < 3; a++) {
+			pos[a] = m_data + (src.pos[a] - src.m_data);
+			prev_pos[a] = m_data + (src.prev_pos[a] - src.m_data);
+		}
+	}
+
+	// Called after each timestep; the new positions were written to prev_pos
+	inline void swap_positions() {
+		for (int a = 0; a < 3; a++) {
+			float* tmp = pos[a];
+			pos[a] = prev_pos[a];
+			prev_pos[a] = tmp;
+		}
+	}
+
+	inline cVector3f get_pos(unsigned int i) const { return cVector3f(pos[0][i], pos[1][i], pos[2][i]); }
+	inline void set_pos(unsigned int i, const cVector3f& p) { pos[0][i] = p.x; pos[1][i] = p.y; pos[2][i] = p.z; }
+
+	inline cVector3f get_force(unsigned int i) const { return cVector3f(force[0][i], force[1][i], force[2][i]); }
+	inline void set_force(unsigned int i, const cVector3f& f) { force[0][i] = f.x; force[1][i] = f.y; force[2][i] = f.z; }
+	inline void add_force(unsigned int i, const cVector3f& f) { force[0][i] += f.x; force[1][i] += f.y; force[2][i] += f.z; }
+
+	inline cVector3f get_velocity(unsigned int i) const { return cVector3f(velocity[0][i], velocity[1][i], velocity[2][i]); }
+
+	inline cVector3f get_constraint_force(unsigned int i) const {
+		return cVector3f(constraint_force[0][i], constraint_force[1][i], constraint_force[2][i]);
+	}
+	inline void add_constraint_force(unsigned int i, const cVector3f& f) {
+		constraint_force[0][i] += f.x; constraint_force[1][i] += f.y; constraint_force[2][i] += f.z;
+	}
+
+private:
+	deformable_vertex_state(const deformable_vertex_state&);
+	void operator=(const deformable_vertex_state&);
+};
+
 
 
 #endif
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "constraints.h"
 #include "utils.h"
 #include "RunningAverage.h"
+#include "teschner_trajectory.h"
 #include <float.h>
 #include <regex>
 
@@ -37,6 +38,7 @@ void Cteschner_deformableApp::problem_defaults() {
 
 	cTetGenLoader::m_remove_small_tets_at_import = DEFAULT_REMOVE_SMALL_TETS_AT_IMPORT;
 	cTetGenLoader::m_small_import_tet_volume = DEFAULT_SMALL_IMPORT_TET_VOLUME;
+	cTetGenLoader::m_boundary_faces_only_at_import = DEFAULT_BOUNDARY_FACES_ONLY_AT_IMPORT;
 
 	m_periodically_outputting = false;
 	m_output_interval = -1.0f;;
@@ -63,11 +65,17 @@ void Cteschner_deformableApp::problem_defaults() {
 	m_steady_state_start_time = -1.0f;
 	m_last_output_time = 0.0;
 
+	m_use_snapshot_cache = false;
+	m_static_steady_state = false;
+	m_trajectory_output = false;
+	m_trajectory_quantization_step = 0.0f;
+
 	step_end_times.clear();
 }
 
 Cteschner_deformableApp::Cteschner_deformableApp() : m_exportHelper(this) {
 
+	m_trajectory = 0;
 	problem_defaults();
 
 	m_reset_pending = false;
@@ -419,6 +427,7 @@ void Cteschner_deformableExportHelper::postExport(FILE* f, int filetype) {
 
 int Cteschner_deformableApp::ExitInstance() {
 	_cprintf("Exiting teschner_deformable instance...\n");
+	CloseTrajectory();
 	// _getch();
 	return CwinmeshviewApp::ExitInstance();
 }
@@ -750,6 +759,18 @@ bool Cteschner_deformableApp::ParseProblemFileCommand(const char* line, int cur_
 		_cprintf("Using %d ticks per render loop\n", m_ticks_per_render_loop);
 	}
 
+	// Should initialized models be cached next to their files?  (only
+	// affects models loaded after this line)
+	else if (entry_type == "snapshot_cache") {
+		int value;
+		if (sscanf(entry_data.c_str(), "%d", &value) != 1) {
+			_cprintf("Could not convert snapshot_cache %s\n", buf);
+			return false;
+		}
+		m_use_snapshot_cache = (value != 0);
+		_cprintf("%s snapshot cache\n", m_use_snapshot_cache ? "Enabling" : "Disabling");
+	}
+
 	// Is this a request to enable or disable heterogeneous constants?
 	else if (entry_type == "enable_nonhomogeneous_constants") {
 
@@ -1090,6 +1111,12 @@ bool Cteschner_deformableApp::ParseProblemFileCommand(const char* line, int cur_
 
 			else if (namestr == "gravity_force") ctm->m_gravity_force = value;
 			else if (namestr == "floor_position") ctm->m_floor_position = value;
+			else if (namestr == "num_threads") ctm->m_num_threads = (int)value;
+			else if (namestr == "integrator") ctm->m_integrator = (int)value;
+			else if (namestr == "implicit_max_iterations") ctm->m_implicit_max_iterations = (int)value;
+			else if (namestr == "implicit_tolerance") ctm->m_implicit_tolerance = value;
+			else if (namestr == "static_max_iterations") ctm->m_static_max_iterations = (int)value;
+			else if (namestr == "static_tolerance") ctm->m_static_tolerance = value;
 
 			else if (namestr == "render_vertex_constraints")
 				ctm->m_render_vertex_constraints = (value == 0.0) ? false : true;
@@ -1123,6 +1150,12 @@ bool Cteschner_deformableApp::ParseProblemFileCommand(const char* line, int cur_
 		cTetGenLoader::m_small_import_tet_volume = value;
 		_cprintf("Read value %d for entry %s\n", value, entry_type.c_str());
 	}
+	else if (entry_type == "boundary_faces_only_at_import") {
+		int value;
+		sscanf(entry_data.c_str(), "%d", &value);
+		cTetGenLoader::m_boundary_faces_only_at_import = (value != 0);
+		_cprintf("Read value %d for entry %s\n", value, entry_type.c_str());
+	}
 
 	// Is this a periodic output specification?
 	else if (entry_type == "periodic_output") {
@@ -1141,6 +1174,16 @@ bool Cteschner_deformableApp::ParseProblemFileCommand(const char* line, int cur_
 		}
 	}
 
+	// Should periodic output go to one binary trajectory file?
+	else if (entry_type == "trajectory_output") {
+		float step = 0.0f;
+		sscanf(entry_data.c_str(), "%f", &step);
+		m_trajectory_output = true;
+		m_trajectory_quantization_step = (step > 0.0f) ? step : 0.0f;
+		_cprintf("Periodic output will be written as a trajectory (quantization step %f)\n",
+			m_trajectory_quantization_step);
+	}
+
 	// Is this a steady-state output specification?
 	else if (entry_type == "steady_state_output") {
 
@@ -1163,6 +1206,22 @@ bool Cteschner_deformableApp::ParseProblemFileCommand(const char* line, int cur_
 		}
 	}
 
+	// Should we simulate our way to steady state, or solve for it?
+	else if (entry_type == "steady_state_solver") {
+		char solver[_MAX_PATH];
+		if (sscanf(entry_data.c_str(), "%s", solver) != 1) {
+			_cprintf("Error processing steady-state solver directive %s\n", buf);
+			return false;
+		}
+		if (strcmp(solver, "static") == 0) m_static_steady_state = true;
+		else if (strcmp(solver, "dynamic") == 0) m_static_steady_state = false;
+		else {
+			_cprintf("Unrecognized steady-state solver %s\n", solver);
+			return false;
+		}
+		_cprintf("Using the %s steady-state solver\n", solver);
+	}
+
 	// Is this a steady-state output parameter specification?
 	else if (entry_type == "steady_state_parameters") {
 
@@ -1346,18 +1405,12 @@ bool Cteschner_deformableApp::AutoExport(char* out_filename, bool correct_for_tr
 }
 
 
-bool Cteschner_deformableApp::AutoExport(int filetype, char* out_filename, bool include_simtime, bool correct_for_transform) {
+void Cteschner_deformableApp::MakeAutoExportFilename(char* filename, const char* tick_str, const char* extension) {
 
 	cTeschnerMesh* ctm = dynamic_cast<cTeschnerMesh*>(object);
-	if (ctm == 0) return false;
 
-	char export_filename[_MAX_PATH];
 	char default_filename[_MAX_PATH];
 
-	// Find the extension for the selected file type
-	const char* selected_extension = "anode";
-	if (filetype >= 0 && filetype < FILETYPE_INVALID) selected_extension = mesh_export_extensions[filetype];
-
 	// Find the root filename, from the problem or mesh file
 	if (m_loaded_problem_filename[0] != '\0') {
 		find_filename(default_filename, m_loaded_problem_filename, true);
@@ -1368,17 +1421,34 @@ bool Cteschner_deformableApp::AutoExport(int filetype, char* out_filename, bool
 	else strcpy(default_filename, "deformation");
 
 	// Append time and date
-	makeTimeDateStr(export_filename, default_filename, &(ctm->m_sim_start_date_and_time));
+	makeTimeDateStr(filename, default_filename, ctm ? &(ctm->m_sim_start_date_and_time) : 0);
+
+	// Append tick information (if any) and extension
+	char* filename_extension = find_extension(filename);
+	if (tick_str) sprintf(filename_extension, "%s.%s", tick_str, extension);
+	else strcpy(filename_extension, extension);
+}
+
+
+bool Cteschner_deformableApp::AutoExport(int filetype, char* out_filename, bool include_simtime, bool correct_for_transform) {
+
+	cTeschnerMesh* ctm = dynamic_cast<cTeschnerMesh*>(object);
+	if (ctm == 0) return false;
+
+	char export_filename[_MAX_PATH];
+
+	// Find the extension for the selected file type
+	const char* selected_extension = "anode";
+	if (filetype >= 0 && filetype < FILETYPE_INVALID) selected_extension = mesh_export_extensions[filetype];
 
-	// Append tick information (if requested) and extension
+	// Append tick information (if requested)
 	char tick_str[_MAX_PATH];
 	if (include_simtime)
 		sprintf(tick_str, "tick.%06.3f", ctm->m_current_sim_time);
 	else
 		tick_str[0] = '\0';
 
-	char* extension = find_extension(export_filename);
-	sprintf(extension, "%s.%s", tick_str, selected_extension);
+	MakeAutoExportFilename(export_filename, tick_str, selected_extension);
 
 	if (out_filename) {
 		strcpy(out_filename, export_filename);
@@ -1391,6 +1461,49 @@ bool Cteschner_deformableApp::AutoExport(int filetype, char* out_filename, bool
 }
 
 
+bool Cteschner_deformableApp::WriteTrajectoryFrame() {
+
+	cTeschnerMesh* ctm = dynamic_cast<cTeschnerMesh*>(object);
+	if (ctm == 0) return false;
+
+	// If the top-level mesh defers to a child, that's where the vertices
+	// actually move
+	if (ctm->m_proxy_sim_mesh) ctm = ctm->m_proxy_sim_mesh;
+
+	// Start a trajectory named the way AutoExport() names files, so
+	// convert_trajectory_to_node_files() can reproduce AutoExport()'s
+	// output (exactly, unless the trajectory is quantized)
+	if (m_trajectory == 0) {
+		char trajectory_filename[_MAX_PATH];
+		MakeAutoExportFilename(trajectory_filename, 0, TESCHNER_TRAJECTORY_EXTENSION);
+		m_trajectory = new trajectory_writer;
+		if (m_trajectory->open(trajectory_filename, ctm->m_nVertices, ctm->m_tets, ctm->m_nTets,
+			m_loaded_mesh_filename, m_trajectory_quantization_step) == false) {
+			delete m_trajectory;
+			m_trajectory = 0;
+			return false;
+		}
+	}
+
+	deformable_vertex_state& s = ctm->m_vertex_state;
+	double offset[3] = {
+		current_mesh_transform.model_offset.x,
+		current_mesh_transform.model_offset.y,
+		current_mesh_transform.model_offset.z };
+
+	return m_trajectory->add_frame(ctm->m_current_sim_time, s.pos[0], s.pos[1], s.pos[2],
+		current_mesh_transform.model_scale_factor, offset);
+}
+
+
+void Cteschner_deformableApp::CloseTrajectory() {
+	if (m_trajectory == 0) return;
+	m_trajectory->close();
+	delete m_trajectory;
+	m_trajectory = 0;
+}
+
+
 bool Cteschner_deformableApp::LoadModel(const char* filename,
 	bool build_collision_detector, bool finalize, bool delete_old_model) {
 
@@ -1404,6 +1517,10 @@ bool Cteschner_deformableApp::LoadModel(const char* filename,
 	// Initialize the new model
 	if (result && ctm) {
 		_cprintf("Initializing model on load...\n");
+
+		// Snapshots live next to the model file
+		if (m_use_snapshot_cache) strcpy(ctm->m_snapshot_root, filename);
+
 		ctm->initialize(old_ctm);
 	}
 
@@ -1594,7 +1711,8 @@ void Cteschner_deformableApp::simtick() {
 			if (ctm->m_current_sim_time >= m_begin_periodic_output_time &&
 				ctm->m_current_sim_time <= m_end_periodic_output_time) {
 				if (curtime - m_last_output_time >= m_output_interval || m_last_output_time == 0.0) {
-					AutoExport();
+					if (m_trajectory_output) WriteTrajectoryFrame();
+					else AutoExport();
 
 					if (m_last_output_time == 0.0) {
 						_cprintf("Started periodic output...\n");
@@ -1605,6 +1723,7 @@ void Cteschner_deformableApp::simtick() {
 			}
 			else if (ctm->m_current_sim_time > m_end_periodic_output_time) {
 				m_periodically_outputting = false;
+				CloseTrajectory();
 				_cprintf("Finished periodic output...\n");
 			}
 		}
@@ -1779,6 +1898,10 @@ void Cteschner_deformableApp::singletick() {
 void Cteschner_deformableApp::reset_immediately() {
 	cTeschnerMesh* ctm = dynamic_cast<cTeschnerMesh*>(object);
 	if (ctm == 0) return;
+
+	// The next run gets its own trajectory
+	CloseTrajectory();
+
 	if (m_monitor_steady_state_after_reset) {
 		m_monitor_steady_state = true;
 		m_reached_steady_state = false;
@@ -1941,6 +2064,21 @@ int Cteschner_deformableApp::run_to_steady_state(double maxtime) {
 	ctm->prepare_heterogeneous_constant_rendering();
 
 	m_reached_steady_state = false;
+
+	if (m_static_steady_state) {
+		toggle_simulation(SIMTOGGLE_STOP);
+		_cprintf("Solving for steady-state...\n");
+		int iterations;
+		float residual;
+		m_steady_state_result = run_mesh_to_static_equilibrium(ctm, 0, &iterations, &residual);
+		m_reached_steady_state = (m_steady_state_result == RESULT_STEADY_STATE);
+		m_monitor_steady_state = false;
+		_cprintf("Finished static solve at time %f after %d iterations, largest remaining force %f (result %d)...\n",
+			ctm->m_current_sim_time, iterations, residual, m_steady_state_result);
+		if (m_gui_enabled) render_without_simulating();
+		return m_steady_state_result;
+	}
+
 	toggle_simulation(SIMTOGGLE_START);
 	_cprintf("Starting simulation until steady-state...\n");
 	while (m_simulation_running) {
@@ -1951,3 +2089,36 @@ int Cteschner_deformableApp::run_to_steady_state(double maxtime) {
 	_cprintf("Finished simulation (result %d)...\n", m_steady_state_result);
 	return m_steady_state_result;
 }
+
+
+int Cteschner_deformableApp::run_batch(const std::vector<batch_parameter_set>& parameter_sets,
+	std::vector<batch_result>& results, double maxtime, int num_threads) {
+
+	cTeschnerMesh* ctm = dynamic_cast<cTeschnerMesh*>(object);
+
+	if (ctm == 0) {
+		_cprintf("No mesh to simulate...\n");
+		return -1;
+	}
+
+	// The batch copies the model's rest state, so the interactive
+	// simulation can't be running while we set it up
+	toggle_simulation(SIMTOGGLE_STOP);
+
+	steady_state_criteria criteria;
+	criteria.minimum_simtime = m_minimum_steadystate_simtime;
+	criteria.maximum_simtime = m_maximum_steadystate_simtime;
+	if (maxtime >= 0.0 && maxtime < criteria.maximum_simtime)
+		criteria.maximum_simtime = (float)maxtime;
+	criteria.required_time_at_steady_state = m_required_time_at_steady_state;
+	criteria.max_velocity_threshold = m_max_velocity_threshold;
+	criteria.mean_velocity_threshold = m_mean_velocity_threshold;
+	criteria.max_acceleration_threshold = m_max_acceleration_threshold;
+	criteria.mean_acceleration_threshold = m_mean_acceleration_threshold;
+	criteria.static_solve = m_static_steady_state;
+
+	_cprintf("Starting batch simulation...\n");
+	int retval = run_batch_simulation(ctm, parameter_sets, criteria, results, num_threads);
+	_cprintf("Finished batch simulation...\n");
+	return retval;
+}
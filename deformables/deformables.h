@@ -13,17 +13,14 @@
 #include "constraints.h"
 #include "meshExporter.h"
 #include "cTeschnerMesh.h"
+#include "batch_simulation.h"
 
 typedef enum {
   SIMTOGGLE_TOGGLE=0, SIMTOGGLE_START, SIMTOGGLE_STOP
 } simtoggle_action;
 
-typedef enum {
-  RESULT_NOT_DONE_YET=0,RESULT_STEADY_STATE,RESULT_NO_STEADY_STATE,
-  RESULT_ERROR,RESULT_MANUAL_TERMINATION,RESULT_MANUAL_PAUSE
-} steady_state_result;
-
 class Cteschner_deformableApp;
+class trajectory_writer;
 
 class Cteschner_deformableExportHelper : public ExportHelper {
 public:
@@ -109,6 +106,23 @@ public:
   bool  m_reached_steady_state;
   int   m_steady_state_result;
 
+  // Should initialized models be cached as binary snapshots (see
+  // teschner_snapshot.h)?  Set by the snapshot_cache problem file command.
+  bool  m_use_snapshot_cache;
+
+  // Should run_to_steady_state() and run_batch() solve for equilibrium
+  // directly (see cTeschnerMesh::solve_static()) instead of simulating?
+  // Set by the steady_state_solver problem file command.
+  bool  m_static_steady_state;
+
+  // Should periodic output be written to one binary trajectory file (see
+  // teschner_trajectory.h) instead of one mesh file per period?  Set by the
+  // trajectory_output problem file command, along with the quantization
+  // step (zero for float deltas).
+  bool  m_trajectory_output;
+  float m_trajectory_quantization_step;
+  trajectory_writer* m_trajectory;
+
   // Override this to prevent finalization and deleting
   virtual bool LoadModel(const char* filename,
     bool build_collision_detector=false,
@@ -134,9 +148,25 @@ public:
   virtual void clear_constraints();
   virtual void render_without_simulating();
   virtual int run_to_steady_state(double maxtime = -1.0);
+
+  // Runs the current model to steady state once per parameter set, without
+  // rendering, using the steady-state criteria from the problem file (see
+  // batch_simulation.h).  [maxtime], if non-negative, caps the sim time of
+  // each run.  Returns -1 if there's an error, zero if all goes well.
+  virtual int run_batch(const std::vector<batch_parameter_set>& parameter_sets,
+    std::vector<batch_result>& results, double maxtime = -1.0, int num_threads = 0);
   virtual bool AutoExport(char* out_filename=0, bool correct_for_transform=true);
   virtual bool AutoExport(int filetype, char* out_filename=0, bool include_simtime=true, bool correct_for_transform=true);
 
+  // Builds the filename AutoExport() uses: the problem (or mesh) filename,
+  // the sim start time and date, [tick_str] (if non-null), and [extension]
+  void MakeAutoExportFilename(char* filename, const char* tick_str, const char* extension);
+
+  // Appends the current positions to the trajectory, starting one (named
+  // like AutoExport() output) if necessary
+  virtual bool WriteTrajectoryFrame();
+  virtual void CloseTrajectory();
+
 // Overrides
 	// ClassWizard generated virtual function overrides
 	//{{AFX_VIRTUAL(Cteschner_deformableApp)
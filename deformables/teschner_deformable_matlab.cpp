@@ -4,6 +4,7 @@
 #include "teschner_deformable.h"
 #include "cTeschnerMesh.h"
 #include "meshExporter.h"
+#include "teschner_trajectory.h"
 #include "mex.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -370,6 +371,30 @@ extern "C" void mexFunction(
 
     return;
   }
+  // convert_trajectory(filename)
+  //
+  // Writes one anode file per frame of a binary trajectory (see
+  // teschner_trajectory.h); returns [status, number of frames]
+  else if (strncmp(cmdstr,"convert_trajectory",strlen("convert_trajectory"))==0) {
+
+    if (nrhs < 2 || mxIsChar(prhs[1]) == 0)
+      return error_status("Need to supply a trajectory file name...");
+
+    char fname[1000];
+    mxGetString(prhs[1],fname,1000);
+
+    int frames = convert_trajectory_to_node_files(fname);
+
+    fill_status(nlhs,plhs,frames < 0 ? -1 : 0);
+
+    if (nlhs >= 2) {
+      plhs[1] = mxCreateDoubleMatrix(1, 1, mxREAL);
+      *mxGetPr(plhs[1]) = (double)frames;
+    }
+
+    return;
+  }
+
   else if (strncmp(cmdstr,"run_to_steady_state",strlen("run_to_steady_state"))==0) {
 
     double maxtime = -1.0;
@@ -404,6 +429,69 @@ extern "C" void mexFunction(
 
   }
 
+  // run_batch(params [nsets x 4: kvolume karea kdistance kdamping], maxtime, nthreads)
+  //
+  // Returns [status, results (nsets x 1), steady_state_times (nsets x 1),
+  //   final_positions (nvertices x 3 x nsets)]
+  else if (strncmp(cmdstr,"run_batch",strlen("run_batch"))==0) {
+
+    if (nrhs < 2 || mxIsDouble(prhs[1]) == 0 || mxGetN(prhs[1]) != 4)
+      return error_status("Need an nsets x 4 array of constants...");
+
+    unsigned int nsets = mxGetM(prhs[1]);
+    double* params = mxGetPr(prhs[1]);
+
+    double maxtime = -1.0;
+    if (nrhs >= 3 && mxIsDouble(prhs[2])) maxtime = mxGetScalar(prhs[2]);
+
+    int num_threads = 0;
+    if (nrhs >= 4 && mxIsDouble(prhs[3])) num_threads = (int)(mxGetScalar(prhs[3]));
+
+    std::vector<batch_parameter_set> parameter_sets(nsets);
+    unsigned int i,k;
+    for(i=0; i<nsets; i++) {
+      // Matlab arrays are column-major
+      parameter_sets[i].kVolumePreservation = (float)(params[0*nsets+i]);
+      parameter_sets[i].kAreaPreservation = (float)(params[1*nsets+i]);
+      parameter_sets[i].kDistancePreservation = (float)(params[2*nsets+i]);
+      parameter_sets[i].kDistanceDamping = (float)(params[3*nsets+i]);
+    }
+
+    std::vector<batch_result> results;
+    if (app->run_batch(parameter_sets,results,maxtime,num_threads) < 0)
+      return error_status("Batch simulation failed...");
+
+    if (nlhs >= 2) {
+      plhs[1] = mxCreateDoubleMatrix(nsets, 1, mxREAL);
+      double* data = mxGetPr(plhs[1]);
+      for(i=0; i<nsets; i++) data[i] = (double)(results[i].result);
+    }
+
+    if (nlhs >= 3) {
+      plhs[2] = mxCreateDoubleMatrix(nsets, 1, mxREAL);
+      double* data = mxGetPr(plhs[2]);
+      for(i=0; i<nsets; i++) data[i] = (double)(results[i].steady_state_time);
+    }
+
+    if (nlhs >= 4) {
+      unsigned int nvertices = (nsets > 0) ? results[0].final_positions.size() / 3 : 0;
+      int dims[3] = {(int)nvertices, 3, (int)nsets};
+      plhs[3] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+      double* data = mxGetPr(plhs[3]);
+      for(unsigned int set=0; set<nsets; set++) {
+        const std::vector<float>& pos = results[set].final_positions;
+        double* setdata = data + set*nvertices*3;
+        // Rotate to matlab indexing
+        for(i=0; i<nvertices; i++) {
+          for(k=0; k<3; k++) setdata[k*nvertices+i] = pos[3*i+k];
+        }
+      }
+    }
+
+    return fill_status(nlhs,plhs,0);
+
+  }
+
   else if (strncmp(cmdstr,"prepare_heterogeneous_constant_rendering",strlen("prepare_heterogeneous_constant_rendering"))==0) {
     ctm->prepare_heterogeneous_constant_rendering();
   }
@@ -458,9 +546,8 @@ extern "C" void mexFunction(
     unsigned int i,k;
 
     for(i=0; i<nvertices; i++) {
-      cDeformableVertex* v= ctm->m_deformableVertices+i;
       // Rotate to matlab indexing
-      for(k=0; k<3; k++) vertices_data[k*nvertices+i] = v->m_pos[k];
+      for(k=0; k<3; k++) vertices_data[k*nvertices+i] = ctm->m_vertex_state.pos[k][i];
     }
 
     for(i=0; i<ntets; i++) {
@@ -0,0 +1,631 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "cTeschnerMesh.h"
+#include "teschner_implicit.h"
+#include "parallel_for.h"
+#include <conio.h>
+#include <math.h>
+#include <float.h>
+
+// Elements or vertices per parallel_for chunk
+#define IMPLICIT_CHUNK_SIZE 1024
+
+// Gradients shorter than this contribute nothing to the Jacobian
+#define SMALL_GRADIENT 1.0e-12f
+
+inline int num_implicit_chunks(unsigned int n) {
+	return (int)((n + IMPLICIT_CHUNK_SIZE - 1) / IMPLICIT_CHUNK_SIZE);
+}
+
+inline void implicit_chunk_range(int chunk, unsigned int n, unsigned int& first, unsigned int& last) {
+	first = chunk * IMPLICIT_CHUNK_SIZE;
+	last = first + IMPLICIT_CHUNK_SIZE;
+	if (last > n) last = n;
+}
+
+// Symmetric 3x3 blocks are stored as xx,yy,zz,xy,xz,yz
+inline cVector3f symmetric_block_mul(const float* b, const cVector3f& x) {
+	return cVector3f(
+		b[0] * x.x + b[3] * x.y + b[4] * x.z,
+		b[3] * x.x + b[1] * x.y + b[5] * x.z,
+		b[4] * x.x + b[5] * x.y + b[2] * x.z);
+}
+
+// g / sqrt(|g|), so that w*w' has the magnitude of g*(unit g)'
+inline cVector3f gauss_newton_direction(const cVector3f& g) {
+	float len = g.length();
+	if (len < SMALL_GRADIENT) return cVector3f(0, 0, 0);
+	return g * (1.0f / sqrtf(len));
+}
+
+inline cVector3f componentwise_square(const cVector3f& v) {
+	return cVector3f(v.x * v.x, v.y * v.y, v.z * v.z);
+}
+
+// Which corner of a face or tet is [vertex]?  (-1 if it's not there.)
+inline int face_corner(const face& f, unsigned int vertex) {
+	if (f.v0 == vertex) return 0;
+	if (f.v1 == vertex) return 1;
+	if (f.v2 == vertex) return 2;
+	return -1;
+}
+
+inline int tet_corner(const unsigned int* tet, unsigned int vertex) {
+	for (int c = 0; c < 4; c++) if (tet[c] == vertex) return c;
+	return -1;
+}
+
+struct implicit_job {
+	cTeschnerMesh* mesh;
+	implicit_solver_state* st;
+
+	// Element chunks are numbered faces first, then edges, then tets, like
+	// compute_internal_forces()
+	int num_face_chunks;
+	int num_edge_chunks;
+	int num_tet_chunks;
+	int num_vertex_chunks;
+
+	// The timestep and its square
+	float h;
+	float hsq;
+
+	// For multiply(): y = A*x
+	const cVector3f* x;
+	cVector3f* y;
+
+	// Step sizes for the conjugate gradient updates
+	double alpha;
+	double beta;
+};
+
+// Number of partial sums each vertex chunk can write
+#define PARTIALS_PER_CHUNK 4
+
+
+/***
+Jacobian factors, once per step
+***/
+
+static void jacobian_terms_chunk(void* param, int chunk, int thread_index) {
+
+	implicit_job* job = (implicit_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
+	implicit_solver_state* st = job->st;
+	const deformable_vertex_state& s = mesh->m_vertex_state;
+	unsigned int first, last, i;
+
+	if (chunk < job->num_face_chunks) {
+
+		implicit_chunk_range(chunk, mesh->m_nFaces, first, last);
+
+		// (skip the zero face, since it's invalid)
+		if (first == 0) {
+			st->face_constants[0] = 0.0f;
+			for (int c = 0; c < 3; c++) st->face_directions[c].set(0, 0, 0);
+			first = 1;
+		}
+
+		for (i = first; i < last; i++) {
+
+			const face f = mesh->m_faces[i];
+			cVector3f p[3];
+			for (int c = 0; c < 3; c++) p[c] = s.get_pos(f[c]);
+
+			// compute_face_terms() left this here
+			const cVector3f& n = mesh->m_faceUnitNormals[i];
+
+			// The gradient of the area with respect to each corner points
+			// away from the opposite edge, with half that edge's length
+			for (int c = 0; c < 3; c++) {
+				cVector3f opposite_edge = p[(c + 2) % 3] - p[(c + 1) % 3];
+				cVector3f g = n.cross_and_return(opposite_edge) * 0.5f;
+				st->face_directions[3 * i + c] = gauss_newton_direction(g);
+			}
+			st->face_constants[i] = mesh->face_area_constant(f);
+		}
+		return;
+	}
+	chunk -= job->num_face_chunks;
+
+	if (chunk < job->num_edge_chunks) {
+
+		implicit_chunk_range(chunk, mesh->m_nEdges, first, last);
+
+		for (i = first; i < last; i++) {
+
+			const edge e = mesh->m_edges[i];
+			float* b = st->edge_blocks + 6 * i;
+
+			const float cur_length = mesh->m_edgeLengths[i];
+			if (cur_length < SMALL_GRADIENT) {
+				for (int k = 0; k < 6; k++) b[k] = 0.0f;
+				continue;
+			}
+
+			cVector3f u = s.get_pos(e.v0) - s.get_pos(e.v1);
+			u.mul(1.0f / cur_length);
+
+			// J = k * (u*u' + (1 - rest/cur) * (I - u*u')); the second term
+			// goes negative under compression, so it's clamped at zero
+			float k = mesh->edge_distance_constant(e);
+			float geometric = 1.0f - mesh->m_restEdgeLengths[i] / cur_length;
+			if (geometric < 0.0f) geometric = 0.0f;
+			float axial = k * (1.0f - geometric);
+			float isotropic = k * geometric;
+
+			b[0] = axial * u.x * u.x + isotropic;
+			b[1] = axial * u.y * u.y + isotropic;
+			b[2] = axial * u.z * u.z + isotropic;
+			b[3] = axial * u.x * u.y;
+			b[4] = axial * u.x * u.z;
+			b[5] = axial * u.y * u.z;
+		}
+		return;
+	}
+	chunk -= job->num_edge_chunks;
+
+	implicit_chunk_range(chunk, mesh->m_nTets, first, last);
+
+	for (i = first; i < last; i++) {
+
+		const unsigned int* tet = mesh->m_tets + 4 * i;
+		cVector3f p[4];
+		for (int c = 0; c < 4; c++) p[c] = s.get_pos(tet[c]);
+
+		// The gradient of the (signed) volume with respect to each corner;
+		// each is a third of the opposite face's area along its normal
+		cVector3f e1 = p[1] - p[0];
+		cVector3f e2 = p[2] - p[0];
+		cVector3f e3 = p[3] - p[0];
+		cVector3f g[4];
+		g[1] = e2.cross_and_return(e3) * (1.0f / 6.0f);
+		g[2] = e3.cross_and_return(e1) * (1.0f / 6.0f);
+		g[3] = e1.cross_and_return(e2) * (1.0f / 6.0f);
+		g[0] = (g[1] + g[2] + g[3]) * -1.0f;
+
+		for (int c = 0; c < 4; c++) st->tet_directions[4 * i + c] = gauss_newton_direction(g[c]);
+		st->tet_constants[i] = mesh->tet_volume_constant(i);
+	}
+
+} // jacobian_terms_chunk
+
+
+// Fills in the mass/damping diagonal, the preconditioner, and the starting
+// velocity (zero for constrained vertices)
+static void vertex_terms_chunk(void* param, int chunk, int thread_index) {
+
+	implicit_job* job = (implicit_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
+	implicit_solver_state* st = job->st;
+	const deformable_vertex_state& s = mesh->m_vertex_state;
+	unsigned int first, last;
+
+	implicit_chunk_range(chunk, mesh->m_nVertices, first, last);
+
+	for (unsigned int i = first; i < last; i++) {
+
+		const cDeformableVertex* v = mesh->m_deformableVertices + i;
+
+		float m = v->m_mass + job->h * mesh->vertex_damping_constant(i);
+		st->mass_and_damping[i] = m;
+
+		st->velocity[i] = s.get_velocity(i) * s.position_free[i];
+
+		// The diagonal of -K, from each element I live in
+		cVector3f stiffness(0, 0, 0);
+
+		const unsigned int* edge_ptr = mesh->m_containingEdges + v->m_startingEdgeIndex;
+		for (unsigned int j = 0; j < v->m_nEdges; j++) {
+			const float* b = st->edge_blocks + 6 * edge_ptr[j];
+			stiffness.add(b[0], b[1], b[2]);
+		}
+
+		const unsigned int* face_ptr = mesh->m_containingFaces + v->m_startingFaceIndex;
+		for (unsigned int j = 0; j < v->m_nFaces; j++) {
+			unsigned int f = face_ptr[j];
+			int c = face_corner(mesh->m_faces[f], i);
+			if (c < 0) continue;
+			stiffness.add(componentwise_square(st->face_directions[3 * f + c]) * st->face_constants[f]);
+		}
+
+		const unsigned int* tet_ptr = mesh->m_containingTets + v->m_startingTetIndex;
+		for (unsigned int j = 0; j < v->m_nTets; j++) {
+			unsigned int t = tet_ptr[j];
+			int c = tet_corner(mesh->m_tets + 4 * t, i);
+			if (c < 0) continue;
+			stiffness.add(componentwise_square(st->tet_directions[4 * t + c]) * st->tet_constants[t]);
+		}
+
+		cVector3f d = stiffness * job->hsq;
+		d.add(m, m, m);
+		for (int a = 0; a < 3; a++) {
+			st->inverse_diagonal[i][a] = (d[a] > 0.0f) ? (1.0f / d[a]) : 0.0f;
+		}
+	}
+
+} // vertex_terms_chunk
+
+
+/***
+y = A*x, where A = (M + h*Kd) - h^2*K, with constrained rows zeroed
+***/
+
+static void product_terms_chunk(void* param, int chunk, int thread_index) {
+
+	implicit_job* job = (implicit_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
+	implicit_solver_state* st = job->st;
+	const cVector3f* x = job->x;
+	unsigned int first, last, i;
+
+	if (chunk < job->num_face_chunks) {
+		implicit_chunk_range(chunk, mesh->m_nFaces, first, last);
+
+		// (skip the zero face, since it's invalid)
+		if (first == 0) {
+			st->face_products[0] = 0.0f;
+			first = 1;
+		}
+
+		for (i = first; i < last; i++) {
+			const face f = mesh->m_faces[i];
+			const cVector3f* w = st->face_directions + 3 * i;
+			st->face_products[i] = st->face_constants[i] *
+				(w[0].dot(x[f.v0]) + w[1].dot(x[f.v1]) + w[2].dot(x[f.v2]));
+		}
+		return;
+	}
+	chunk -= job->num_face_chunks;
+
+	if (chunk < job->num_edge_chunks) {
+		implicit_chunk_range(chunk, mesh->m_nEdges, first, last);
+		for (i = first; i < last; i++) {
+			const edge e = mesh->m_edges[i];
+			st->edge_products[i] = symmetric_block_mul(st->edge_blocks + 6 * i, x[e.v0] - x[e.v1]);
+		}
+		return;
+	}
+	chunk -= job->num_edge_chunks;
+
+	implicit_chunk_range(chunk, mesh->m_nTets, first, last);
+	for (i = first; i < last; i++) {
+		const unsigned int* tet = mesh->m_tets + 4 * i;
+		const cVector3f* w = st->tet_directions + 4 * i;
+		float sum = 0.0f;
+		for (int c = 0; c < 4; c++) sum += w[c].dot(x[tet[c]]);
+		st->tet_products[i] = st->tet_constants[i] * sum;
+	}
+
+} // product_terms_chunk
+
+
+// Each vertex adds up K*x from the elements it lives in; also leaves x'y
+// for this chunk in the first partial sum
+static void gather_product_chunk(void* param, int chunk, int thread_index) {
+
+	implicit_job* job = (implicit_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
+	implicit_solver_state* st = job->st;
+	const deformable_vertex_state& s = mesh->m_vertex_state;
+	const cVector3f* x = job->x;
+	cVector3f* y = job->y;
+	unsigned int first, last;
+
+	implicit_chunk_range(chunk, mesh->m_nVertices, first, last);
+
+	double xy = 0.0;
+
+	for (unsigned int i = first; i < last; i++) {
+
+		const cDeformableVertex* v = mesh->m_deformableVertices + i;
+
+		cVector3f kx(0, 0, 0);
+
+		const unsigned int* edge_ptr = mesh->m_containingEdges + v->m_startingEdgeIndex;
+		for (unsigned int j = 0; j < v->m_nEdges; j++) {
+			unsigned int e = edge_ptr[j];
+			if (mesh->m_edges[e].v0 == i) kx.sub(st->edge_products[e]);
+			else kx.add(st->edge_products[e]);
+		}
+
+		const unsigned int* face_ptr = mesh->m_containingFaces + v->m_startingFaceIndex;
+		for (unsigned int j = 0; j < v->m_nFaces; j++) {
+			unsigned int f = face_ptr[j];
+			int c = face_corner(mesh->m_faces[f], i);
+			if (c < 0) continue;
+			kx.sub(st->face_directions[3 * f + c] * st->face_products[f]);
+		}
+
+		const unsigned int* tet_ptr = mesh->m_containingTets + v->m_startingTetIndex;
+		for (unsigned int j = 0; j < v->m_nTets; j++) {
+			unsigned int t = tet_ptr[j];
+			int c = tet_corner(mesh->m_tets + 4 * t, i);
+			if (c < 0) continue;
+			kx.sub(st->tet_directions[4 * t + c] * st->tet_products[t]);
+		}
+
+		cVector3f result = x[i] * st->mass_and_damping[i];
+		result.sub(kx * job->hsq);
+		result.mul(s.position_free[i]);
+
+		y[i] = result;
+		xy += x[i].dot(result);
+	}
+
+	st->partial_sums[PARTIALS_PER_CHUNK * chunk] = xy;
+
+} // gather_product_chunk
+
+
+// Returns x'Ax
+static double multiply(implicit_job& job, const cVector3f* x, cVector3f* y) {
+
+	job.x = x;
+	job.y = y;
+
+	int num_element_chunks = job.num_face_chunks + job.num_edge_chunks + job.num_tet_chunks;
+	job.mesh->run_chunks(num_element_chunks, product_terms_chunk, &job);
+	job.mesh->run_chunks(job.num_vertex_chunks, gather_product_chunk, &job);
+
+	double sum = 0.0;
+	for (int c = 0; c < job.num_vertex_chunks; c++) sum += job.st->partial_sums[PARTIALS_PER_CHUNK * c];
+	return sum;
+}
+
+
+/***
+Conjugate gradient passes; each leaves its partial sums in partial_sums
+***/
+
+// rhs = h*f + h^2*K*v, which is h*f + (M + h*Kd)*v - A*v (A*v is in
+// [product] already), then r = rhs, z = P*r, d = z, dv = 0.
+//
+// Partial sums: r'z, r'r
+static void start_solve_chunk(void* param, int chunk, int thread_index) {
+
+	implicit_job* job = (implicit_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
+	implicit_solver_state* st = job->st;
+	const deformable_vertex_state& s = mesh->m_vertex_state;
+	unsigned int first, last;
+
+	implicit_chunk_range(chunk, mesh->m_nVertices, first, last);
+
+	double rz = 0.0, rr = 0.0;
+
+	for (unsigned int i = first; i < last; i++) {
+
+		// Constraint forces are zero for unconstrained vertices
+		cVector3f f = s.get_force(i) + s.get_constraint_force(i);
+
+		cVector3f b = f * job->h;
+		b.add(st->velocity[i] * st->mass_and_damping[i]);
+		b.sub(st->product[i]);
+		b.mul(s.position_free[i]);
+
+		st->rhs[i] = b;
+		st->residual[i] = b;
+		st->preconditioned_residual[i].set(b.x * st->inverse_diagonal[i].x,
+			b.y * st->inverse_diagonal[i].y, b.z * st->inverse_diagonal[i].z);
+		st->direction[i] = st->preconditioned_residual[i];
+		st->dv[i].set(0, 0, 0);
+
+		rz += b.dot(st->preconditioned_residual[i]);
+		rr += b.dot(b);
+	}
+
+	st->partial_sums[PARTIALS_PER_CHUNK * chunk] = rz;
+	st->partial_sums[PARTIALS_PER_CHUNK * chunk + 1] = rr;
+}
+
+
+// dv += alpha*d, r -= alpha*A*d, z = P*r
+//
+// Partial sums: r'z, r'r
+static void update_solution_chunk(void* param, int chunk, int thread_index) {
+
+	implicit_job* job = (implicit_job*)(param);
+	implicit_solver_state* st = job->st;
+	unsigned int first, last;
+
+	implicit_chunk_range(chunk, job->mesh->m_nVertices, first, last);
+
+	float alpha = (float)(job->alpha);
+	double rz = 0.0, rr = 0.0;
+
+	for (unsigned int i = first; i < last; i++) {
+
+		st->dv[i].add(st->direction[i] * alpha);
+		st->residual[i].sub(st->product[i] * alpha);
+
+		const cVector3f& r = st->residual[i];
+		st->preconditioned_residual[i].set(r.x * st->inverse_diagonal[i].x,
+			r.y * st->inverse_diagonal[i].y, r.z * st->inverse_diagonal[i].z);
+
+		rz += r.dot(st->preconditioned_residual[i]);
+		rr += r.dot(r);
+	}
+
+	st->partial_sums[PARTIALS_PER_CHUNK * chunk] = rz;
+	st->partial_sums[PARTIALS_PER_CHUNK * chunk + 1] = rr;
+}
+
+
+// d = z + beta*d
+static void update_direction_chunk(void* param, int chunk, int thread_index) {
+
+	implicit_job* job = (implicit_job*)(param);
+	implicit_solver_state* st = job->st;
+	unsigned int first, last;
+
+	implicit_chunk_range(chunk, job->mesh->m_nVertices, first, last);
+
+	float beta = (float)(job->beta);
+
+	for (unsigned int i = first; i < last; i++) {
+		st->direction[i] = st->preconditioned_residual[i] + st->direction[i] * beta;
+	}
+}
+
+
+// v += dv, x += h*v; the new positions go in prev_pos, to be swapped in,
+// like move_vertices()
+//
+// Partial sums: max displacement, max acceleration, sum of displacements,
+// sum of accelerations
+static void finish_step_chunk(void* param, int chunk, int thread_index) {
+
+	implicit_job* job = (implicit_job*)(param);
+	cTeschnerMesh* mesh = job->mesh;
+	implicit_solver_state* st = job->st;
+	deformable_vertex_state& s = mesh->m_vertex_state;
+	unsigned int first, last;
+
+	implicit_chunk_range(chunk, mesh->m_nVertices, first, last);
+
+	double max_vel = 0.0, max_accel = 0.0, sum_vel = 0.0, sum_accel = 0.0;
+
+	for (unsigned int i = first; i < last; i++) {
+
+		cVector3f old_vel = s.get_velocity(i);
+		cVector3f vel = (st->velocity[i] + st->dv[i]) * s.position_free[i];
+		cVector3f displacement = vel * job->h;
+
+		for (int a = 0; a < 3; a++) {
+			s.prev_pos[a][i] = s.pos[a][i] + displacement[a];
+			s.velocity[a][i] = vel[a];
+
+			// Zero out forces for the next time around
+			s.force[a][i] = 0.0f;
+		}
+
+		// Velocity will just be displacement for thresholding (steady-state)
+		// computation, as in move_vertices()
+		double v = displacement.length();
+		double accel = vel.length() - old_vel.length();
+
+		if (v > max_vel) max_vel = v;
+		if (accel > max_accel) max_accel = accel;
+		sum_vel += v;
+		sum_accel += accel;
+	}
+
+	double* partials = &(st->partial_sums[PARTIALS_PER_CHUNK * chunk]);
+	partials[0] = max_vel;
+	partials[1] = max_accel;
+	partials[2] = sum_vel;
+	partials[3] = sum_accel;
+}
+
+
+// Adds up partial sum [which] from every chunk, in chunk order
+static double sum_partials(const implicit_job& job, int which) {
+	double sum = 0.0;
+	for (int c = 0; c < job.num_vertex_chunks; c++) sum += job.st->partial_sums[PARTIALS_PER_CHUNK * c + which];
+	return sum;
+}
+
+
+bool cTeschnerMesh::implicit_step() {
+
+	if (m_implicit == 0) m_implicit = new implicit_solver_state;
+	implicit_solver_state* st = m_implicit;
+	st->allocate(m_nVertices, m_nFaces, m_nEdges, m_nTets);
+
+	implicit_job job;
+	job.mesh = this;
+	job.st = st;
+	job.num_face_chunks = num_implicit_chunks(m_nFaces);
+	job.num_edge_chunks = num_implicit_chunks(m_nEdges);
+	job.num_tet_chunks = num_implicit_chunks(m_nTets);
+	job.num_vertex_chunks = num_implicit_chunks(m_nVertices);
+	job.h = m_timestep;
+	job.hsq = m_timestep * m_timestep;
+	job.x = 0;
+	job.y = 0;
+	job.alpha = job.beta = 0.0;
+
+	st->partial_sums.resize(PARTIALS_PER_CHUNK * job.num_vertex_chunks);
+
+	// Linearize the forces around the current positions
+	int num_element_chunks = job.num_face_chunks + job.num_edge_chunks + job.num_tet_chunks;
+	run_chunks(num_element_chunks, jacobian_terms_chunk, &job);
+	run_chunks(job.num_vertex_chunks, vertex_terms_chunk, &job);
+
+	// Build the right-hand side and start the solve
+	multiply(job, st->velocity, st->product);
+	run_chunks(job.num_vertex_chunks, start_solve_chunk, &job);
+
+	double rz = sum_partials(job, 0);
+	double rhs_norm = sqrt(sum_partials(job, 1));
+	double tolerance = m_implicit_tolerance * rhs_norm;
+
+	if (_isnan(rz) || _isnan(rhs_norm)) {
+		_cprintf("Implicit step has an invalid right-hand side at time %f\n", m_current_sim_time);
+		return false;
+	}
+
+	// Preconditioned conjugate gradient, solving for dv
+	int iteration = 0;
+	if (rhs_norm > 0.0) {
+
+		for (iteration = 0; iteration < m_implicit_max_iterations; iteration++) {
+
+			double dad = multiply(job, st->direction, st->product);
+
+			// A is positive definite, so this only happens if we've already
+			// converged (or something has gone bad)
+			if (dad <= 0.0) break;
+
+			job.alpha = rz / dad;
+			run_chunks(job.num_vertex_chunks, update_solution_chunk, &job);
+
+			double new_rz = sum_partials(job, 0);
+			double residual_norm = sqrt(sum_partials(job, 1));
+			if (residual_norm <= tolerance) {
+				iteration++;
+				break;
+			}
+
+			job.beta = new_rz / rz;
+			rz = new_rz;
+			run_chunks(job.num_vertex_chunks, update_direction_chunk, &job);
+		}
+	}
+	st->last_iterations = iteration;
+
+	run_chunks(job.num_vertex_chunks, finish_step_chunk, &job);
+
+	// Maintain max and mean vertex velocity and acceleration
+	double max_vel = 0.0, max_accel = 0.0;
+	for (int c = 0; c < job.num_vertex_chunks; c++) {
+		const double* partials = &(st->partial_sums[PARTIALS_PER_CHUNK * c]);
+		if (partials[0] > max_vel) max_vel = partials[0];
+		if (partials[1] > max_accel) max_accel = partials[1];
+	}
+
+	m_maximum_vertex_velocity = (float)(max_vel);
+	m_maximum_vertex_acceleration = (float)(max_accel);
+	m_mean_vertex_velocity = (float)(sum_partials(job, 2) / ((double)(m_nVertices)));
+	m_mean_vertex_acceleration = (float)(sum_partials(job, 3) / ((double)(m_nVertices)));
+
+	// Same floor handling as move_vertices(); velocity here is displacement
+	// over one timestep, not a central difference over two
+	restrict_floor_penetration(1.0f / m_timestep);
+
+	// Swap previous and current positions
+	m_vertex_state.swap_positions();
+
+	return true;
+
+} // implicit_step()
@@ -0,0 +1,164 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Working storage for cTeschnerMesh::implicit_step(), a backward Euler
+  step for the Teschner forces:
+
+    (M + h*Kd - h^2*K) dv = h * (f + h*K*v)
+
+  ...where M is the lumped mass, Kd the (per-vertex) damping constant, K
+  the stiffness Jacobian df/dx, and dv the change in velocity.
+
+  K is never stored as a matrix.  Each element keeps a small factor of its
+  own piece of K (a 3x3 block per edge, a direction per face or tet corner),
+  and K*x is formed the same way compute_internal_forces() forms forces:
+  one parallel pass over elements, then one over vertices, each vertex
+  adding up the terms from the elements in its CSR lists.
+
+  Teschner's area and volume forces push along unit directions rather
+  than true gradients, so their Jacobians aren't symmetric.  Each is
+  replaced by the symmetric Gauss-Newton term -k*w*w' (w being the
+  gradient of the area or volume, divided by the square root of its
+  length); edges get their exact Jacobian, with the geometric term clamped
+  at zero under compression.  That keeps the system positive definite, so
+  conjugate gradient applies.
+
+***********/
+
+#ifndef _TESCHNER_IMPLICIT_H_
+#define _TESCHNER_IMPLICIT_H_
+
+#include "CVector3f.h"
+#include <vector>
+
+#define SAFE_IMPLICIT_ARRAY_DELETE(p) { if(p) { delete [] (p); (p)=0; } }
+
+struct implicit_solver_state {
+
+	// The sizes the arrays below were allocated for
+	unsigned int nVertices;
+	unsigned int nFaces;
+	unsigned int nEdges;
+	unsigned int nTets;
+
+	// Per edge: the symmetric 3x3 block J (xx,yy,zz,xy,xz,yz); the force on
+	// v0 changes by -J*(dx0-dx1), and v1 gets the opposite
+	float* edge_blocks;
+
+	// Per face corner and tet corner: the Gauss-Newton direction w
+	cVector3f* face_directions;
+	cVector3f* tet_directions;
+
+	// Per face and tet: the spring constant
+	float* face_constants;
+	float* tet_constants;
+
+	// Per-element terms of the product being formed: J*(x0-x1) for each
+	// edge, k*(w'x) for each face and tet
+	cVector3f* edge_products;
+	float* face_products;
+	float* tet_products;
+
+	// Per vertex: mass plus h * damping, and the inverse of the system's
+	// diagonal (the preconditioner)
+	float* mass_and_damping;
+	cVector3f* inverse_diagonal;
+
+	// Per vertex: the conjugate gradient vectors
+	cVector3f* velocity;
+	cVector3f* rhs;
+	cVector3f* dv;
+	cVector3f* residual;
+	cVector3f* preconditioned_residual;
+	cVector3f* direction;
+	cVector3f* product;
+
+	// Per-chunk partial sums, added up serially so results don't depend on
+	// the thread count
+	std::vector<double> partial_sums;
+
+	// Iterations used by the most recent solve
+	int last_iterations;
+
+	implicit_solver_state() {
+		nVertices = nFaces = nEdges = nTets = 0;
+		edge_blocks = 0;
+		face_directions = tet_directions = 0;
+		face_constants = tet_constants = 0;
+		edge_products = 0;
+		face_products = tet_products = 0;
+		mass_and_damping = 0;
+		inverse_diagonal = velocity = rhs = dv = residual =
+			preconditioned_residual = direction = product = 0;
+		last_iterations = 0;
+	}
+
+	~implicit_solver_state() { release(); }
+
+	// Does nothing if we're already the right size
+	void allocate(unsigned int n_vertices, unsigned int n_faces, unsigned int n_edges,
+		unsigned int n_tets) {
+
+		if (edge_blocks && n_vertices == nVertices && n_faces == nFaces &&
+			n_edges == nEdges && n_tets == nTets) return;
+
+		release();
+		nVertices = n_vertices; nFaces = n_faces; nEdges = n_edges; nTets = n_tets;
+
+		edge_blocks = new float[6 * nEdges + 1];
+		face_directions = new cVector3f[3 * nFaces + 1];
+		tet_directions = new cVector3f[4 * nTets + 1];
+		face_constants = new float[nFaces + 1];
+		tet_constants = new float[nTets + 1];
+		edge_products = new cVector3f[nEdges + 1];
+		face_products = new float[nFaces + 1];
+		tet_products = new float[nTets + 1];
+
+		mass_and_damping = new float[nVertices + 1];
+		inverse_diagonal = new cVector3f[nVertices + 1];
+		velocity = new cVector3f[nVertices + 1];
+		rhs = new cVector3f[nVertices + 1];
+		dv = new cVector3f[nVertices + 1];
+		residual = new cVector3f[nVertices + 1];
+		preconditioned_residual = new cVector3f[nVertices + 1];
+		direction = new cVector3f[nVertices + 1];
+		product = new cVector3f[nVertices + 1];
+	}
+
+	void release() {
+		SAFE_IMPLICIT_ARRAY_DELETE(edge_blocks);
+		SAFE_IMPLICIT_ARRAY_DELETE(face_directions);
+		SAFE_IMPLICIT_ARRAY_DELETE(tet_directions);
+		SAFE_IMPLICIT_ARRAY_DELETE(face_constants);
+		SAFE_IMPLICIT_ARRAY_DELETE(tet_constants);
+		SAFE_IMPLICIT_ARRAY_DELETE(edge_products);
+		SAFE_IMPLICIT_ARRAY_DELETE(face_products);
+		SAFE_IMPLICIT_ARRAY_DELETE(tet_products);
+		SAFE_IMPLICIT_ARRAY_DELETE(mass_and_damping);
+		SAFE_IMPLICIT_ARRAY_DELETE(inverse_diagonal);
+		SAFE_IMPLICIT_ARRAY_DELETE(velocity);
+		SAFE_IMPLICIT_ARRAY_DELETE(rhs);
+		SAFE_IMPLICIT_ARRAY_DELETE(dv);
+		SAFE_IMPLICIT_ARRAY_DELETE(residual);
+		SAFE_IMPLICIT_ARRAY_DELETE(preconditioned_residual);
+		SAFE_IMPLICIT_ARRAY_DELETE(direction);
+		SAFE_IMPLICIT_ARRAY_DELETE(product);
+		nVertices = nFaces = nEdges = nTets = 0;
+	}
+
+private:
+	implicit_solver_state(const implicit_solver_state&);
+	void operator=(const implicit_solver_state&);
+};
+
+#endif
@@ -0,0 +1,58 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#ifndef _TESCHNER_SIMD_H_
+#define _TESCHNER_SIMD_H_
+
+// The integrator and the skinning engine work on this many vertices at a
+// time: eight if we're built for AVX (/arch:AVX2), otherwise four with SSE
+#if defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_WIDTH 8
+typedef __m256 simd_float;
+#define simd_load _mm256_load_ps
+#define simd_store _mm256_store_ps
+#define simd_storeu _mm256_storeu_ps
+#define simd_set1 _mm256_set1_ps
+#define simd_zero _mm256_setzero_ps
+#define simd_add _mm256_add_ps
+#define simd_sub _mm256_sub_ps
+#define simd_mul _mm256_mul_ps
+#define simd_sqrt _mm256_sqrt_ps
+#define simd_max _mm256_max_ps
+
+// Loads base[index[0]] ... base[index[7]]
+inline simd_float simd_gather(const float* base, const int* index) {
+	return _mm256_set_ps(base[index[7]], base[index[6]], base[index[5]], base[index[4]],
+		base[index[3]], base[index[2]], base[index[1]], base[index[0]]);
+}
+#else
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+typedef __m128 simd_float;
+#define simd_load _mm_load_ps
+#define simd_store _mm_store_ps
+#define simd_storeu _mm_storeu_ps
+#define simd_set1 _mm_set1_ps
+#define simd_zero _mm_setzero_ps
+#define simd_add _mm_add_ps
+#define simd_sub _mm_sub_ps
+#define simd_mul _mm_mul_ps
+#define simd_sqrt _mm_sqrt_ps
+#define simd_max _mm_max_ps
+
+// Loads base[index[0]] ... base[index[3]]
+inline simd_float simd_gather(const float* base, const int* index) {
+	return _mm_set_ps(base[index[3]], base[index[2]], base[index[1]], base[index[0]]);
+}
+#endif
+
+#endif
@@ -0,0 +1,296 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "cTeschnerMesh.h"
+#include "teschner_skinning.h"
+#include "teschner_simd.h"
+#include "parallel_for.h"
+#include "CVertex.h"
+#include <conio.h>
+#include <malloc.h>
+#include <math.h>
+#include <string.h>
+
+// Rendering vertices (or sim vertices, for the frame pass) per
+// parallel_for chunk; a multiple of SIMD_WIDTH
+#define SKINNING_CHUNK_SIZE 4096
+
+inline int num_skinning_chunks(unsigned int n) {
+	return (int)((n + SKINNING_CHUNK_SIZE - 1) / SKINNING_CHUNK_SIZE);
+}
+
+inline void skinning_chunk_range(int chunk, unsigned int n, unsigned int& first, unsigned int& last) {
+	first = chunk * SKINNING_CHUNK_SIZE;
+	last = first + SKINNING_CHUNK_SIZE;
+	if (last > n) last = n;
+}
+
+struct skinning_job {
+	skinning_engine* e;
+	cTeschnerMesh* mesh;
+	cVertex* vertices;
+};
+
+
+skinning_engine::skinning_engine() {
+	n_rendering_vertices = weights_per_vertex = padded_n = 0;
+	n_sim_vertices = 0;
+	use_coordinate_frames = 0;
+	effectors = 0;
+	weights = 0;
+	positions = 0;
+	m_data = 0;
+	for (int a = 0; a < 3; a++) offsets[a] = constant[a] = 0;
+	for (int a = 0; a < 9; a++) axes[a] = 0;
+}
+
+skinning_engine::~skinning_engine() {
+	release();
+}
+
+void skinning_engine::release() {
+	if (effectors) delete[] effectors;
+	effectors = 0;
+	if (m_data) _aligned_free(m_data);
+	m_data = 0;
+	weights = positions = 0;
+	for (int a = 0; a < 3; a++) offsets[a] = constant[a] = 0;
+	for (int a = 0; a < 9; a++) axes[a] = 0;
+	frame_vertices.clear();
+	frame_neighbors.clear();
+	n_rendering_vertices = padded_n = n_sim_vertices = 0;
+}
+
+
+bool skinning_engine::build(cTeschnerMesh* mesh, unsigned int n) {
+
+	release();
+
+	if (mesh->m_vertex_effectors == 0 || mesh->m_vertex_weights == 0 ||
+		mesh->m_weights_per_vertex == 0 || n == 0) return false;
+
+	n_rendering_vertices = n;
+	weights_per_vertex = mesh->m_weights_per_vertex;
+	use_coordinate_frames = mesh->m_use_coordinate_frame_based_skinning;
+	padded_n = ((n + VERTEX_STATE_PADDING - 1) / VERTEX_STATE_PADDING) * VERTEX_STATE_PADDING;
+	n_sim_vertices = mesh->m_nVertices;
+	unsigned int padded_sim = ((n_sim_vertices + VERTEX_STATE_PADDING - 1) / VERTEX_STATE_PADDING) * VERTEX_STATE_PADDING;
+
+	unsigned int n_slots = weights_per_vertex * padded_n;
+
+	// weights, 3 offsets, 3 constants, positions, 9 axes
+	size_t n_floats = 4 * (size_t)n_slots + 6 * (size_t)padded_n + 9 * (size_t)padded_sim;
+	m_data = (float*)_aligned_malloc(n_floats * sizeof(float), VERTEX_STATE_PADDING * sizeof(float));
+	if (m_data == 0) {
+		_cprintf("Could not allocate skinning buffers for %d vertices\n", n);
+		return false;
+	}
+	memset(m_data, 0, n_floats * sizeof(float));
+
+	float* cur = m_data;
+	weights = cur; cur += n_slots;
+	int a;
+	for (a = 0; a < 3; a++) { offsets[a] = cur; cur += n_slots; }
+	for (a = 0; a < 3; a++) { constant[a] = cur; cur += padded_n; }
+	positions = cur; cur += 3 * padded_n;
+	for (a = 0; a < 9; a++) { axes[a] = cur; cur += padded_sim; }
+
+	effectors = new int[n_slots];
+	memset(effectors, 0, n_slots * sizeof(int));
+
+	std::vector<bool> used(n_sim_vertices, false);
+	if (use_coordinate_frames) frame_neighbors.assign(n_sim_vertices, -1);
+
+	for (unsigned int i = 0; i < n; i++) {
+		for (unsigned int j = 0; j < weights_per_vertex; j++) {
+
+			unsigned int k = i * weights_per_vertex + j;
+			int effector_index = mesh->m_vertex_effectors[k];
+
+			// A -1 value says "no more effectors"
+			if (effector_index < 0 || effector_index >= (int)n_sim_vertices) break;
+
+			float w = mesh->m_vertex_weights[k];
+			unsigned int slot = j * padded_n + i;
+
+			effectors[slot] = effector_index;
+			weights[slot] = w;
+
+			if (use_coordinate_frames) {
+				cVector3f o = mesh->m_vertex_coordframe_positions[k];
+				offsets[0][slot] = w * o.x;
+				offsets[1][slot] = w * o.y;
+				offsets[2][slot] = w * o.z;
+
+				// Each effector's second axis always comes from the same
+				// neighbor (the first border vertex it shares an edge with)
+				frame_neighbors[effector_index] = mesh->m_opposite_edge_vertices[k];
+			}
+			else {
+				offsets[0][slot] = w * mesh->m_vertex_normal_offsets[k];
+				cVector3f t = mesh->m_vertex_tangential_offsets[k];
+				constant[0][i] += w * t.x;
+				constant[1][i] += w * t.y;
+				constant[2][i] += w * t.z;
+			}
+
+			used[effector_index] = true;
+		}
+	}
+
+	for (unsigned int v = 0; v < n_sim_vertices; v++) {
+		if (used[v]) frame_vertices.push_back(v);
+	}
+
+	if (frame_vertices.size() == 0) {
+		release();
+		return false;
+	}
+
+	return true;
+}
+
+
+/***
+Per-frame work
+***/
+
+// Computes each driving vertex's frame into axes[]
+static void skinning_frames_chunk(void* param, int chunk, int thread_index) {
+
+	skinning_job* job = (skinning_job*)param;
+	skinning_engine* e = job->e;
+	cTeschnerMesh* mesh = job->mesh;
+	deformable_vertex_state& s = mesh->m_vertex_state;
+
+	unsigned int first, last;
+	skinning_chunk_range(chunk, e->frame_vertices.size(), first, last);
+
+	for (unsigned int f = first; f < last; f++) {
+
+		unsigned int v = e->frame_vertices[f];
+
+		// One axis is the vertex normal
+		cVector3f axis1 = mesh->m_deformableVertices[v].m_normal;
+		e->axes[0][v] = axis1.x;
+		e->axes[1][v] = axis1.y;
+		e->axes[2][v] = axis1.z;
+
+		if (e->use_coordinate_frames == 0) continue;
+
+		// The next will be the edge to the opposite vertex, made
+		// perpendicular to the normal
+		int other = e->frame_neighbors[v];
+		cVector3f edge(
+			s.pos[0][other] - s.pos[0][v],
+			s.pos[1][other] - s.pos[1][v],
+			s.pos[2][other] - s.pos[2][v]);
+
+		cVector3f axis2 = edge - (edge*axis1) * axis1;
+		axis2.normalize();
+
+		// The third axis will be their cross-product
+		cVector3f axis3 = axis1;
+		axis3.cross(axis2);
+
+		e->axes[3][v] = axis2.x;
+		e->axes[4][v] = axis2.y;
+		e->axes[5][v] = axis2.z;
+		e->axes[6][v] = axis3.x;
+		e->axes[7][v] = axis3.y;
+		e->axes[8][v] = axis3.z;
+	}
+}
+
+// Blends the rendering vertices in one chunk, SIMD_WIDTH at a time
+static void skinning_vertices_chunk(void* param, int chunk, int thread_index) {
+
+	skinning_job* job = (skinning_job*)param;
+	skinning_engine* e = job->e;
+	deformable_vertex_state& s = job->mesh->m_vertex_state;
+
+	unsigned int first, last;
+	skinning_chunk_range(chunk, e->padded_n, first, last);
+
+	unsigned int n_axes = e->use_coordinate_frames ? 3 : 1;
+	float lanes[3][SIMD_WIDTH];
+
+	for (unsigned int i = first; i < last; i += SIMD_WIDTH) {
+
+		simd_float acc[3];
+		int c;
+		for (c = 0; c < 3; c++) acc[c] = simd_load(e->constant[c] + i);
+
+		for (unsigned int j = 0; j < e->weights_per_vertex; j++) {
+
+			unsigned int slot = j * e->padded_n + i;
+			const int* index = e->effectors + slot;
+
+			// The weighted effector position...
+			simd_float w = simd_load(e->weights + slot);
+			for (c = 0; c < 3; c++) {
+				acc[c] = simd_add(acc[c], simd_mul(w, simd_gather(s.pos[c], index)));
+			}
+
+			// ...plus the weighted offset along each of its axes
+			for (unsigned int a = 0; a < n_axes; a++) {
+				simd_float o = simd_load(e->offsets[a] + slot);
+				for (c = 0; c < 3; c++) {
+					acc[c] = simd_add(acc[c], simd_mul(o, simd_gather(e->axes[3 * a + c], index)));
+				}
+			}
+		}
+
+		for (c = 0; c < 3; c++) simd_storeu(lanes[c], acc[c]);
+
+		float* out = e->positions + 3 * i;
+		for (int k = 0; k < SIMD_WIDTH; k++) {
+			out[3 * k] = lanes[0][k];
+			out[3 * k + 1] = lanes[1][k];
+			out[3 * k + 2] = lanes[2][k];
+		}
+	}
+}
+
+void skinning_engine::update(cTeschnerMesh* mesh, int num_threads) {
+
+	skinning_job job;
+	job.e = this;
+	job.mesh = mesh;
+	job.vertices = 0;
+
+	parallel_for_chunks(num_skinning_chunks(frame_vertices.size()), skinning_frames_chunk, &job, num_threads);
+	parallel_for_chunks(num_skinning_chunks(padded_n), skinning_vertices_chunk, &job, num_threads);
+}
+
+static void skinning_copy_chunk(void* param, int chunk, int thread_index) {
+
+	skinning_job* job = (skinning_job*)param;
+	skinning_engine* e = job->e;
+
+	unsigned int first, last;
+	skinning_chunk_range(chunk, e->n_rendering_vertices, first, last);
+
+	for (unsigned int i = first; i < last; i++) {
+		const float* p = e->positions + 3 * i;
+		job->vertices[i].m_localPos.set(p[0], p[1], p[2]);
+	}
+}
+
+void skinning_engine::copy_to_vertices(cVertex* vertices, int num_threads) {
+
+	skinning_job job;
+	job.e = this;
+	job.mesh = 0;
+	job.vertices = vertices;
+
+	parallel_for_chunks(num_skinning_chunks(n_rendering_vertices), skinning_copy_chunk, &job, num_threads);
+}
@@ -0,0 +1,102 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Moves a cTeschnerMesh's rendering mesh along with the simulation, for
+  cTeschnerMesh::prepare_to_render().
+
+  The weights that cTeschnerMesh::build_rendering_weights() computes are
+  repacked once into float arrays laid out weight-major ([weight][vertex]),
+  with each offset pre-multiplied by its weight.  Then, each frame:
+
+  * each sim vertex that drives anything gets its frame (its normal and,
+    for coordinate-frame skinning, the two tangent axes) computed once,
+    rather than once per rendering vertex it drives
+
+  * the rendering vertices are computed SIMD_WIDTH at a time, in parallel,
+    into [positions]: x,y,z floats per rendering vertex, ready to be
+    handed to glBufferSubData as is
+
+***********/
+
+#ifndef _TESCHNER_SKINNING_H_
+#define _TESCHNER_SKINNING_H_
+
+#include <vector>
+
+class cTeschnerMesh;
+class cVertex;
+
+struct skinning_engine {
+
+	unsigned int n_rendering_vertices;
+	unsigned int weights_per_vertex;
+
+	// Rendering vertices, rounded up to a multiple of SIMD_WIDTH
+	unsigned int padded_n;
+
+	int use_coordinate_frames;
+
+	// Weight j of rendering vertex i is at [j * padded_n + i].  Unused
+	// weights (and padding vertices) point at sim vertex zero with a weight
+	// of zero.
+	int* effectors;
+	float* weights;
+
+	// The weighted offset along each of the effector's axes (for
+	// normal+tangential skinning, only the first axis, the normal, is used)
+	float* offsets[3];
+
+	// Per rendering vertex: the part of its position that doesn't depend on
+	// the simulation (the weighted tangential offsets, for normal+tangential
+	// skinning)
+	float* constant[3];
+
+	// The sim vertices that drive at least one rendering vertex, and for
+	// coordinate-frame skinning, the neighbor that defines each one's
+	// second axis (indexed by sim vertex)
+	std::vector<unsigned int> frame_vertices;
+	std::vector<int> frame_neighbors;
+
+	// Per sim vertex: axis a, component c is in axes[3*a+c]
+	float* axes[9];
+	unsigned int n_sim_vertices;
+
+	// x,y,z for each rendering vertex
+	float* positions;
+
+	// The float arrays above, in one block
+	float* m_data;
+
+	skinning_engine();
+	~skinning_engine();
+
+	// Packs [mesh]'s skinning weights for [n] rendering vertices; returns
+	// false if there aren't any
+	bool build(cTeschnerMesh* mesh, unsigned int n);
+
+	// Computes [positions] from [mesh]'s current vertex positions and
+	// normals, using up to [num_threads] threads
+	void update(cTeschnerMesh* mesh, int num_threads);
+
+	// Copies [positions] into the first n_rendering_vertices of [vertices],
+	// for meshes that render from cVertex arrays
+	void copy_to_vertices(cVertex* vertices, int num_threads);
+
+	void release();
+
+private:
+	skinning_engine(const skinning_engine&);
+	void operator=(const skinning_engine&);
+};
+
+#endif
@@ -0,0 +1,392 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+// Saving and loading cTeschnerMesh snapshots; see teschner_snapshot.h
+
+#include "cTeschnerMesh.h"
+#include "teschner_snapshot.h"
+#include "CVertex.h"
+#include <conio.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SAFE_ARRAY_DELETE(p) { if(p) { delete [] (p); (p)=NULL; } }
+
+static const unsigned char g_snapshot_padding[TESCHNER_SNAPSHOT_ALIGNMENT] = { 0 };
+
+inline size_t snapshot_padding(size_t bytes) {
+	return (TESCHNER_SNAPSHOT_ALIGNMENT - (bytes % TESCHNER_SNAPSHOT_ALIGNMENT)) % TESCHNER_SNAPSHOT_ALIGNMENT;
+}
+
+// Writes [bytes] bytes, then pads to the next aligned offset
+static bool write_section(FILE* f, const void* data, size_t bytes) {
+	if (bytes && fwrite(data, 1, bytes, f) != bytes) return false;
+	size_t pad = snapshot_padding(bytes);
+	if (pad && fwrite(g_snapshot_padding, 1, pad, f) != pad) return false;
+	return true;
+}
+
+// Reads [bytes] bytes, then skips to the next aligned offset
+static bool read_section(FILE* f, void* data, size_t bytes) {
+	if (bytes && fread(data, 1, bytes, f) != bytes) return false;
+	size_t pad = snapshot_padding(bytes);
+	if (pad && fseek(f, (long)pad, SEEK_CUR) != 0) return false;
+	return true;
+}
+
+// Writes to a temporary file and moves it into place, so a reader never
+// sees a half-written snapshot
+static FILE* open_snapshot_for_writing(const char* filename, char* tmp_filename) {
+	sprintf(tmp_filename, "%s.tmp", filename);
+	FILE* f = fopen(tmp_filename, "wb");
+	if (f == 0) _cprintf("Could not open snapshot file %s for writing\n", tmp_filename);
+	return f;
+}
+
+static bool finish_snapshot(FILE* f, bool ok, const char* filename, const char* tmp_filename) {
+	if (fclose(f) != 0) ok = false;
+	if (ok) {
+		remove(filename);
+		if (rename(tmp_filename, filename) != 0) ok = false;
+	}
+	if (!ok) {
+		_cprintf("Could not write snapshot file %s\n", filename);
+		remove(tmp_filename);
+	}
+	return ok;
+}
+
+
+unsigned long long cTeschnerMesh::compute_snapshot_key() {
+
+	std::vector<cVertex>* vertex_vector = this->pVertices();
+	unsigned int nvertices = vertex_vector->size();
+
+	int version = TESCHNER_SNAPSHOT_VERSION;
+	unsigned long long h = TESCHNER_SNAPSHOT_HASH_SEED;
+	h = snapshot_hash(h, &version, sizeof(version));
+	h = snapshot_hash(h, &nvertices, sizeof(nvertices));
+
+	for (unsigned int i = 0; i < nvertices; i++) {
+		cVertex* v = &((*vertex_vector)[i]);
+		cVector3d p = v->getPos();
+		cVector3d n = v->getNormal();
+		double data[6] = { p.x, p.y, p.z, n.x, n.y, n.z };
+		h = snapshot_hash(h, data, sizeof(data));
+	}
+
+	h = snapshot_hash(h, &m_nTets, sizeof(m_nTets));
+	h = snapshot_hash(h, m_tets, 4 * m_nTets * sizeof(unsigned int));
+
+	h = snapshot_hash(h, &m_mass_assignment_strategy, sizeof(m_mass_assignment_strategy));
+	h = snapshot_hash(h, &m_mass_assignment_constant, sizeof(m_mass_assignment_constant));
+
+	return h;
+}
+
+
+bool cTeschnerMesh::save_snapshot(const char* filename, unsigned long long key) {
+
+	unsigned int total_containing_tets = 0;
+	unsigned int total_containing_faces = 0;
+	unsigned int total_containing_edges = 0;
+	for (unsigned int i = 0; i < m_nVertices; i++) {
+		total_containing_tets += m_deformableVertices[i].m_nTets;
+		total_containing_faces += m_deformableVertices[i].m_nFaces;
+		total_containing_edges += m_deformableVertices[i].m_nEdges;
+	}
+
+	teschner_snapshot_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = TESCHNER_SNAPSHOT_MAGIC;
+	hdr.version = TESCHNER_SNAPSHOT_VERSION;
+	hdr.header_size = sizeof(hdr);
+	hdr.vertex_record_size = sizeof(cDeformableVertex);
+	hdr.key = key;
+	hdr.nVertices = m_nVertices;
+	hdr.nTets = m_nTets;
+	hdr.nFaces = m_nFaces;
+	hdr.nEdges = m_nEdges;
+	hdr.nContainingTets = total_containing_tets;
+	hdr.nContainingFaces = total_containing_faces;
+	hdr.nContainingEdges = total_containing_edges;
+
+	char tmp_filename[_MAX_PATH + 8];
+	FILE* f = open_snapshot_for_writing(filename, tmp_filename);
+	if (f == 0) return false;
+
+	bool ok =
+		write_section(f, &hdr, sizeof(hdr)) &&
+		write_section(f, m_tets, 4 * m_nTets * sizeof(unsigned int)) &&
+		write_section(f, m_faces, m_nFaces * sizeof(face)) &&
+		write_section(f, m_edges, m_nEdges * sizeof(edge)) &&
+		write_section(f, m_containingTets, total_containing_tets * sizeof(unsigned int)) &&
+		write_section(f, m_opposingFaces, total_containing_tets * sizeof(int)) &&
+		write_section(f, m_containingFaces, total_containing_faces * sizeof(unsigned int)) &&
+		write_section(f, m_containingEdges, total_containing_edges * sizeof(unsigned int)) &&
+		write_section(f, m_restFaceNormalsAndAreas, m_nFaces * sizeof(cVector3f)) &&
+		write_section(f, m_restEdgeLengths, m_nEdges * sizeof(float)) &&
+		write_section(f, m_restTetVolumes, m_nTets * sizeof(float)) &&
+		write_section(f, m_deformableVertices, m_nVertices * sizeof(cDeformableVertex));
+
+	ok = finish_snapshot(f, ok, filename, tmp_filename);
+	if (ok) _cprintf("Wrote snapshot %s\n", filename);
+	return ok;
+
+} // save_snapshot
+
+
+bool cTeschnerMesh::load_snapshot(const char* filename, unsigned long long key) {
+
+	FILE* f = fopen(filename, "rb");
+	if (f == 0) return false;
+
+	std::vector<cVertex>* vertex_vector = this->pVertices();
+	cVertex* vertex_array = (cVertex*) &((*vertex_vector)[0]);
+
+	teschner_snapshot_header hdr;
+	if (read_section(f, &hdr, sizeof(hdr)) == false ||
+		hdr.magic != TESCHNER_SNAPSHOT_MAGIC ||
+		hdr.version != TESCHNER_SNAPSHOT_VERSION ||
+		hdr.header_size != sizeof(hdr) ||
+		hdr.vertex_record_size != sizeof(cDeformableVertex) ||
+		hdr.key != key ||
+		hdr.nVertices != vertex_vector->size() ||
+		hdr.nTets > m_nTets) {
+		_cprintf("Snapshot %s is out of date, rebuilding...\n", filename);
+		fclose(f);
+		return false;
+	}
+
+	unsigned int* tets = new unsigned int[4 * hdr.nTets + 1];
+	face* faces = new face[hdr.nFaces];
+	edge* edges = new edge[hdr.nEdges];
+	unsigned int* containingTets = new unsigned int[hdr.nContainingTets];
+	int* opposingFaces = new int[hdr.nContainingTets];
+	unsigned int* containingFaces = new unsigned int[hdr.nContainingFaces];
+	unsigned int* containingEdges = new unsigned int[hdr.nContainingEdges];
+	cVector3f* restFaceNormalsAndAreas = new cVector3f[hdr.nFaces];
+	float* restEdgeLengths = new float[hdr.nEdges];
+	float* restTetVolumes = new float[hdr.nTets];
+	cDeformableVertex* deformableVertices = new cDeformableVertex[hdr.nVertices];
+
+	bool ok =
+		read_section(f, tets, 4 * hdr.nTets * sizeof(unsigned int)) &&
+		read_section(f, faces, hdr.nFaces * sizeof(face)) &&
+		read_section(f, edges, hdr.nEdges * sizeof(edge)) &&
+		read_section(f, containingTets, hdr.nContainingTets * sizeof(unsigned int)) &&
+		read_section(f, opposingFaces, hdr.nContainingTets * sizeof(int)) &&
+		read_section(f, containingFaces, hdr.nContainingFaces * sizeof(unsigned int)) &&
+		read_section(f, containingEdges, hdr.nContainingEdges * sizeof(unsigned int)) &&
+		read_section(f, restFaceNormalsAndAreas, hdr.nFaces * sizeof(cVector3f)) &&
+		read_section(f, restEdgeLengths, hdr.nEdges * sizeof(float)) &&
+		read_section(f, restTetVolumes, hdr.nTets * sizeof(float)) &&
+		read_section(f, deformableVertices, hdr.nVertices * sizeof(cDeformableVertex));
+
+	fclose(f);
+
+	if (ok == false) {
+		_cprintf("Snapshot %s is truncated, rebuilding...\n", filename);
+		delete[] tets;
+		delete[] faces;
+		delete[] edges;
+		delete[] containingTets;
+		delete[] opposingFaces;
+		delete[] containingFaces;
+		delete[] containingEdges;
+		delete[] restFaceNormalsAndAreas;
+		delete[] restEdgeLengths;
+		delete[] restTetVolumes;
+		delete[] deformableVertices;
+		return false;
+	}
+
+	// The snapshot's tets have had degenerate tets pruned
+	m_nTets = hdr.nTets;
+	memcpy(m_tets, tets, 4 * m_nTets * sizeof(unsigned int));
+	delete[] tets;
+
+	m_nVertices = hdr.nVertices;
+	m_nFaces = hdr.nFaces;
+	m_nEdges = hdr.nEdges;
+
+	m_faces = faces;
+	m_edges = edges;
+	m_containingTets = containingTets;
+	m_opposingFaces = opposingFaces;
+	m_containingFaces = containingFaces;
+	m_containingEdges = containingEdges;
+	m_restFaceNormalsAndAreas = restFaceNormalsAndAreas;
+	m_restEdgeLengths = restEdgeLengths;
+	m_restTetVolumes = restTetVolumes;
+	m_deformableVertices = deformableVertices;
+
+	// Per-pass arrays start out at rest
+	m_faceNormalsAndAreas = new cVector3f[m_nFaces];
+	m_edgeLengths = new float[m_nEdges];
+	m_tetVolumes = new float[m_nTets];
+	memcpy(m_faceNormalsAndAreas, m_restFaceNormalsAndAreas, m_nFaces * sizeof(cVector3f));
+	memcpy(m_edgeLengths, m_restEdgeLengths, m_nEdges * sizeof(float));
+	memcpy(m_tetVolumes, m_restTetVolumes, m_nTets * sizeof(float));
+
+	m_faceUnitNormals = new cVector3f[m_nFaces];
+	m_faceAreaForces = new cVector3f[3 * m_nFaces];
+	m_edgeForces = new cVector3f[m_nEdges];
+	m_tetVolumeForceScales = new float[m_nTets];
+
+	// Positions come from the mesh we loaded (the key says they match)
+	m_vertex_state.allocate(m_nVertices);
+	for (unsigned int i = 0; i < m_nVertices; i++) {
+		cVertex* v = vertex_array + i;
+		cVector3f pos;
+		pos.set(v->getPos());
+		m_vertex_state.set_pos(i, pos);
+		m_vertex_state.inverse_mass[i] = 1.0f / m_deformableVertices[i].m_mass;
+	}
+
+	for (int a = 0; a < 3; a++)
+		memcpy(m_vertex_state.prev_pos[a], m_vertex_state.pos[a], m_vertex_state.padded_n * sizeof(float));
+
+	return true;
+
+} // load_snapshot
+
+
+unsigned long long cTeschnerMesh::compute_rendering_weights_snapshot_key(int neighbors_to_find) {
+
+	unsigned long long h = m_snapshot_key;
+	h = snapshot_hash(h, &neighbors_to_find, sizeof(neighbors_to_find));
+	h = snapshot_hash(h, &m_weights_per_vertex, sizeof(m_weights_per_vertex));
+	h = snapshot_hash(h, &m_use_coordinate_frame_based_skinning, sizeof(m_use_coordinate_frame_based_skinning));
+
+	// Which vertices are on the border
+	for (unsigned int i = 0; i < m_nVertices; i++) {
+		int border = m_vertexBoundaryMarkers[i*m_nVertexBoundaryMarkers] ? 1 : 0;
+		h = snapshot_hash(h, &border, sizeof(border));
+	}
+
+	std::vector<cVertex>* rendering_vertex_vector = m_rendering_mesh->pVerticesNonEmpty();
+	unsigned int n_rendering_vertices = rendering_vertex_vector->size();
+	h = snapshot_hash(h, &n_rendering_vertices, sizeof(n_rendering_vertices));
+	for (unsigned int i = 0; i < n_rendering_vertices; i++) {
+		cVector3d p = (*rendering_vertex_vector)[i].m_localPos;
+		double data[3] = { p.x, p.y, p.z };
+		h = snapshot_hash(h, data, sizeof(data));
+	}
+
+	return h;
+}
+
+
+bool cTeschnerMesh::save_rendering_weights_snapshot(const char* filename, unsigned long long key) {
+
+	// Same size build_rendering_weights() allocates
+	unsigned int n_rendering_vertices = m_rendering_mesh->getNumVertices(true);
+	unsigned int n_total_weights = n_rendering_vertices*m_weights_per_vertex;
+
+	teschner_skinning_snapshot_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = TESCHNER_SKINNING_SNAPSHOT_MAGIC;
+	hdr.version = TESCHNER_SNAPSHOT_VERSION;
+	hdr.header_size = sizeof(hdr);
+	hdr.weights_per_vertex = m_weights_per_vertex;
+	hdr.key = key;
+	hdr.nRenderingVertices = n_rendering_vertices;
+	hdr.use_coordinate_frame_based_skinning = m_use_coordinate_frame_based_skinning;
+
+	char tmp_filename[_MAX_PATH + 8];
+	FILE* f = open_snapshot_for_writing(filename, tmp_filename);
+	if (f == 0) return false;
+
+	bool ok =
+		write_section(f, &hdr, sizeof(hdr)) &&
+		write_section(f, m_vertex_effectors, n_total_weights * sizeof(int)) &&
+		write_section(f, m_vertex_weights, n_total_weights * sizeof(float)) &&
+		write_section(f, m_vertex_normal_offsets, n_total_weights * sizeof(float)) &&
+		write_section(f, m_vertex_tangential_offsets, n_total_weights * sizeof(cVector3f)) &&
+		write_section(f, m_vertex_coordframe_positions, n_total_weights * sizeof(cVector3f)) &&
+		write_section(f, m_opposite_edge_vertices, n_total_weights * sizeof(int));
+
+	ok = finish_snapshot(f, ok, filename, tmp_filename);
+	if (ok) _cprintf("Wrote skinning snapshot %s\n", filename);
+	return ok;
+
+} // save_rendering_weights_snapshot
+
+
+bool cTeschnerMesh::load_rendering_weights_snapshot(const char* filename, unsigned long long key) {
+
+	FILE* f = fopen(filename, "rb");
+	if (f == 0) return false;
+
+	unsigned int n_rendering_vertices = m_rendering_mesh->getNumVertices(true);
+
+	teschner_skinning_snapshot_header hdr;
+	if (read_section(f, &hdr, sizeof(hdr)) == false ||
+		hdr.magic != TESCHNER_SKINNING_SNAPSHOT_MAGIC ||
+		hdr.version != TESCHNER_SNAPSHOT_VERSION ||
+		hdr.header_size != sizeof(hdr) ||
+		hdr.weights_per_vertex != m_weights_per_vertex ||
+		hdr.key != key ||
+		hdr.nRenderingVertices != n_rendering_vertices ||
+		hdr.use_coordinate_frame_based_skinning != m_use_coordinate_frame_based_skinning) {
+		_cprintf("Skinning snapshot %s is out of date, rebuilding...\n", filename);
+		fclose(f);
+		return false;
+	}
+
+	unsigned int n_total_weights = n_rendering_vertices*m_weights_per_vertex;
+
+	int* vertex_effectors = new int[n_total_weights];
+	float* vertex_weights = new float[n_total_weights];
+	float* vertex_normal_offsets = new float[n_total_weights];
+	cVector3f* vertex_tangential_offsets = new cVector3f[n_total_weights];
+	cVector3f* vertex_coordframe_positions = new cVector3f[n_total_weights];
+	int* opposite_edge_vertices = new int[n_total_weights];
+
+	bool ok =
+		read_section(f, vertex_effectors, n_total_weights * sizeof(int)) &&
+		read_section(f, vertex_weights, n_total_weights * sizeof(float)) &&
+		read_section(f, vertex_normal_offsets, n_total_weights * sizeof(float)) &&
+		read_section(f, vertex_tangential_offsets, n_total_weights * sizeof(cVector3f)) &&
+		read_section(f, vertex_coordframe_positions, n_total_weights * sizeof(cVector3f)) &&
+		read_section(f, opposite_edge_vertices, n_total_weights * sizeof(int));
+
+	fclose(f);
+
+	if (ok == false) {
+		_cprintf("Skinning snapshot %s is truncated, rebuilding...\n", filename);
+		delete[] vertex_effectors;
+		delete[] vertex_weights;
+		delete[] vertex_normal_offsets;
+		delete[] vertex_tangential_offsets;
+		delete[] vertex_coordframe_positions;
+		delete[] opposite_edge_vertices;
+		return false;
+	}
+
+	SAFE_ARRAY_DELETE(m_vertex_effectors);
+	SAFE_ARRAY_DELETE(m_vertex_weights);
+	SAFE_ARRAY_DELETE(m_vertex_normal_offsets);
+	SAFE_ARRAY_DELETE(m_vertex_tangential_offsets);
+	SAFE_ARRAY_DELETE(m_vertex_coordframe_positions);
+	SAFE_ARRAY_DELETE(m_opposite_edge_vertices);
+
+	m_vertex_effectors = vertex_effectors;
+	m_vertex_weights = vertex_weights;
+	m_vertex_normal_offsets = vertex_normal_offsets;
+	m_vertex_tangential_offsets = vertex_tangential_offsets;
+	m_vertex_coordframe_positions = vertex_coordframe_positions;
+	m_opposite_edge_vertices = opposite_edge_vertices;
+
+	return true;
+
+} // load_rendering_weights_snapshot
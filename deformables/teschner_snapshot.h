@@ -0,0 +1,106 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Binary snapshots of an initialized cTeschnerMesh, so warm starts can skip
+  cTeschnerMesh::initialize() and cTeschnerMesh::build_rendering_weights().
+
+  There are two kinds of snapshot, each a header followed by raw arrays:
+
+  [root].tsnap : the output of initialize() (pruned tets, faces, edges, the
+                 per-vertex containing-element arrays, rest lengths, areas,
+                 and volumes, and per-vertex data including masses)
+
+  [root].tskin : the output of build_rendering_weights() (effectors,
+                 weights, and offsets for each rendering vertex)
+
+  Every array starts on a TESCHNER_SNAPSHOT_ALIGNMENT boundary, in the
+  order listed in teschner_snapshot.cpp, so the files can be mapped and
+  used in place.
+
+  Each header carries a key: a hash of everything the snapshot was built
+  from (the loaded vertex positions and tets, the mass parameters, and
+  for skinning, the rendering mesh).  A snapshot whose key, version, or
+  array sizes don't match is ignored and rebuilt.
+
+***********/
+
+#ifndef _TESCHNER_SNAPSHOT_H_
+#define _TESCHNER_SNAPSHOT_H_
+
+#include <stddef.h>
+
+#define TESCHNER_SNAPSHOT_EXTENSION ".tsnap"
+#define TESCHNER_SKINNING_SNAPSHOT_EXTENSION ".tskin"
+
+// "TSN1" and "TSK1"
+#define TESCHNER_SNAPSHOT_MAGIC 0x314e5354
+#define TESCHNER_SKINNING_SNAPSHOT_MAGIC 0x314b5354
+
+// Bump this whenever the layout or the meaning of any array changes
+#define TESCHNER_SNAPSHOT_VERSION 1
+
+#define TESCHNER_SNAPSHOT_ALIGNMENT 64
+
+struct teschner_snapshot_header {
+
+	// TESCHNER_SNAPSHOT_MAGIC
+	int magic;
+	int version;
+
+	// Size of this structure and of each per-vertex record
+	int header_size;
+	int vertex_record_size;
+
+	unsigned long long key;
+
+	// Array sizes
+	unsigned int nVertices;
+	unsigned int nTets;
+	unsigned int nFaces;
+	unsigned int nEdges;
+	unsigned int nContainingTets;
+	unsigned int nContainingFaces;
+	unsigned int nContainingEdges;
+
+	unsigned int unused;
+};
+
+struct teschner_skinning_snapshot_header {
+
+	// TESCHNER_SKINNING_SNAPSHOT_MAGIC
+	int magic;
+	int version;
+
+	int header_size;
+	int weights_per_vertex;
+
+	unsigned long long key;
+
+	unsigned int nRenderingVertices;
+	int use_coordinate_frame_based_skinning;
+};
+
+// 64-bit FNV-1a, continuing from [hash] (start from
+// TESCHNER_SNAPSHOT_HASH_SEED)
+#define TESCHNER_SNAPSHOT_HASH_SEED 14695981039346656037ULL
+
+inline unsigned long long snapshot_hash(unsigned long long hash, const void* data, size_t bytes) {
+	const unsigned char* p = (const unsigned char*)(data);
+	for (size_t i = 0; i < bytes; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+#endif
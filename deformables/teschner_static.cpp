@@ -0,0 +1,320 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  cTeschnerMesh::solve_static(): find the configuration where every free
+  vertex's net force is zero, without simulating the path there.
+
+  Teschner's area and volume forces push along unit directions rather
+  than along the gradients of area and volume, so they aren't quite the
+  gradient of any energy.  So rather than minimizing an energy function,
+  the solver treats the negated forces (exactly what tick() computes,
+  minus damping) as a gradient and drives them to zero: L-BFGS directions,
+  with a line search that only needs forces (it looks for the point along
+  each direction where the force stops pointing forward).  Where the
+  forces do come from an energy (edges, gravity, the floor), this is plain
+  L-BFGS.
+
+  Vertices with position constraints never move; constant-force
+  constraints are loads like any other.
+
+***********/
+
+#include "cTeschnerMesh.h"
+#include <conio.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+
+// How many steps L-BFGS remembers
+#define STATIC_HISTORY_LENGTH 8
+
+// Force evaluations allowed per line search
+#define MAX_LINE_SEARCH_EVALUATIONS 20
+
+// A step is accepted when the force along the search direction has
+// dropped to this fraction of its starting value (the Wolfe curvature
+// condition)
+#define LINE_SEARCH_CURVATURE 0.9
+
+// No vertex moves farther than this (times the mean rest edge length) on
+// the first try of each step; this keeps early steps from inverting tets
+#define MAX_STEP_FRACTION 0.25
+
+// Sets [mesh]'s positions to [x] and puts the negated net force on each
+// vertex in [g] (zero for vertices with position constraints).  Returns
+// false if the mesh has gone bad at [x].
+static bool static_gradient(cTeschnerMesh* mesh, const std::vector<double>& x, std::vector<double>& g) {
+
+	deformable_vertex_state& s = mesh->m_vertex_state;
+	unsigned int n = mesh->m_nVertices;
+	unsigned int i;
+	int a;
+
+	for (a = 0; a < 3; a++) {
+		for (i = 0; i < n; i++) {
+			s.pos[a][i] = (float)(x[3 * i + a]);
+			s.force[a][i] = 0.0f;
+		}
+	}
+
+	if (!mesh->compute_face_areas()) return false;
+	if (!mesh->compute_tet_volumes()) return false;
+	if (!mesh->compute_spring_lengths()) return false;
+	if (!mesh->compute_forces()) return false;
+
+	for (a = 0; a < 3; a++) {
+		for (i = 0; i < n; i++) {
+			double f = s.force[a][i] + s.constraint_force[a][i];
+			g[3 * i + a] = -f * s.position_free[i];
+		}
+	}
+
+	for (i = 0; i < 3 * n; i++) {
+		if (_isnan(g[i])) return false;
+	}
+
+	return true;
+}
+
+static double dot(const std::vector<double>& u, const std::vector<double>& v) {
+	double sum = 0.0;
+	for (unsigned int i = 0; i < u.size(); i++) sum += u[i] * v[i];
+	return sum;
+}
+
+// The longest per-vertex (3-component) piece of [v]
+static double max_vertex_length(const std::vector<double>& v) {
+	double maxlen = 0.0;
+	for (unsigned int i = 0; i < v.size(); i += 3) {
+		double len = sqrt(v[i] * v[i] + v[i + 1] * v[i + 1] + v[i + 2] * v[i + 2]);
+		if (len > maxlen) maxlen = len;
+	}
+	return maxlen;
+}
+
+
+int cTeschnerMesh::solve_static(int* iterations, float* residual) {
+
+	if (iterations) *iterations = 0;
+	if (residual) *residual = -1.0f;
+
+	// Like tick(), look one timestep ahead for constraints
+	m_current_sim_time += m_timestep;
+	update_constraints();
+
+	if (m_nVertices == 0) {
+		_cprintf("Deformable mesh not initialized...\n");
+		return STATIC_SOLVE_ERROR;
+	}
+
+	if (m_proxy_sim_mesh) {
+		return m_proxy_sim_mesh->solve_static(iterations, residual);
+	}
+
+	deformable_vertex_state& s = m_vertex_state;
+	unsigned int n = 3 * m_nVertices;
+	unsigned int i;
+	int a;
+
+	// We're looking for a configuration at rest, so nothing is damped
+	for (a = 0; a < 3; a++) {
+		for (i = 0; i < m_nVertices; i++) s.velocity[a][i] = 0.0f;
+	}
+
+	std::vector<double> x(n), g(n), d(n), x_new(n), g_new(n);
+	for (i = 0; i < m_nVertices; i++) {
+		for (a = 0; a < 3; a++) x[3 * i + a] = s.pos[a][i];
+	}
+
+	// L-BFGS history, oldest first
+	std::vector<double> history_s[STATIC_HISTORY_LENGTH];
+	std::vector<double> history_y[STATIC_HISTORY_LENGTH];
+	double history_rho[STATIC_HISTORY_LENGTH];
+	double history_alpha[STATIC_HISTORY_LENGTH];
+	int history_count = 0;
+	int history_first = 0;
+
+	double mean_rest_length = 0.0;
+	for (i = 0; i < m_nEdges; i++) mean_rest_length += m_restEdgeLengths[i];
+	if (m_nEdges > 0) mean_rest_length /= (double)(m_nEdges);
+	if (mean_rest_length <= 0.0) mean_rest_length = 1.0;
+	double max_step = MAX_STEP_FRACTION * mean_rest_length;
+
+	int result = STATIC_SOLVE_NOT_CONVERGED;
+	int iteration = 0;
+	double gmax = 0.0;
+
+	if (static_gradient(this, x, g) == false) {
+		_cprintf("Static solve: bad starting configuration\n");
+		result = STATIC_SOLVE_ERROR;
+	}
+
+	double threshold = m_static_tolerance * max_vertex_length(g);
+
+	for (; result == STATIC_SOLVE_NOT_CONVERGED && iteration < m_static_max_iterations; iteration++) {
+
+		gmax = max_vertex_length(g);
+		if (gmax <= threshold) {
+			result = STATIC_SOLVE_CONVERGED;
+			break;
+		}
+
+		// L-BFGS two-loop recursion: d = -H*g
+		d = g;
+		int k;
+		for (k = history_count - 1; k >= 0; k--) {
+			int h = (history_first + k) % STATIC_HISTORY_LENGTH;
+			history_alpha[h] = history_rho[h] * dot(history_s[h], d);
+			for (i = 0; i < n; i++) d[i] -= history_alpha[h] * history_y[h][i];
+		}
+
+		if (history_count > 0) {
+			int newest = (history_first + history_count - 1) % STATIC_HISTORY_LENGTH;
+			double gamma = dot(history_s[newest], history_y[newest]) / dot(history_y[newest], history_y[newest]);
+			for (i = 0; i < n; i++) d[i] *= gamma;
+		}
+
+		for (k = 0; k < history_count; k++) {
+			int h = (history_first + k) % STATIC_HISTORY_LENGTH;
+			double beta = history_rho[h] * dot(history_y[h], d);
+			for (i = 0; i < n; i++) d[i] += (history_alpha[h] - beta) * history_s[h][i];
+		}
+
+		for (i = 0; i < n; i++) d[i] = -d[i];
+
+		// If that's not downhill, forget the history and use the forces
+		double slope = dot(d, g);
+		if (slope >= 0.0 || history_count == 0) {
+			history_count = 0;
+			for (i = 0; i < n; i++) d[i] = -g[i];
+			slope = dot(d, g);
+		}
+
+		double step = 1.0;
+		double dmax = max_vertex_length(d);
+		if (dmax * step > max_step) step = max_step / dmax;
+
+		// Line search: bracket the point where the force along d changes
+		// sign, then narrow it down by secants
+		double lo = 0.0, slope_lo = slope;
+		double hi = -1.0, slope_hi = 0.0;
+		bool hi_is_valid = false;
+		bool accepted = false;
+
+		for (int evaluation = 0; evaluation < MAX_LINE_SEARCH_EVALUATIONS; evaluation++) {
+
+			for (i = 0; i < n; i++) x_new[i] = x[i] + step * d[i];
+
+			if (static_gradient(this, x_new, g_new) == false) {
+				// Too far; the mesh has inverted
+				hi = step;
+				hi_is_valid = false;
+			}
+			else {
+				double new_slope = dot(g_new, d);
+				if (fabs(new_slope) <= LINE_SEARCH_CURVATURE * fabs(slope)) {
+					accepted = true;
+					break;
+				}
+				if (new_slope < 0.0) {
+					lo = step;
+					slope_lo = new_slope;
+				}
+				else {
+					hi = step;
+					slope_hi = new_slope;
+					hi_is_valid = true;
+				}
+			}
+
+			if (hi < 0.0) {
+				step *= 2.0;
+			}
+			else if (hi_is_valid) {
+				double secant = lo - slope_lo * (hi - lo) / (slope_hi - slope_lo);
+				double margin = 0.1 * (hi - lo);
+				if (secant < lo + margin || secant > hi - margin) secant = 0.5 * (lo + hi);
+				step = secant;
+			}
+			else {
+				step = 0.5 * (lo + hi);
+			}
+		}
+
+		// If we never met the curvature condition, take the best step that
+		// still went downhill
+		if (accepted == false && lo > 0.0) {
+			step = lo;
+			for (i = 0; i < n; i++) x_new[i] = x[i] + step * d[i];
+			accepted = static_gradient(this, x_new, g_new);
+		}
+
+		if (accepted == false) {
+			// Nowhere to go along this direction; if that was already the
+			// plain force direction, we're as close as we're going to get
+			if (history_count == 0) break;
+			history_count = 0;
+			continue;
+		}
+
+		// Remember this step
+		int h;
+		if (history_count < STATIC_HISTORY_LENGTH) {
+			h = (history_first + history_count) % STATIC_HISTORY_LENGTH;
+		}
+		else {
+			h = history_first;
+			history_first = (history_first + 1) % STATIC_HISTORY_LENGTH;
+			history_count--;
+		}
+
+		history_s[h].resize(n);
+		history_y[h].resize(n);
+		for (i = 0; i < n; i++) {
+			history_s[h][i] = x_new[i] - x[i];
+			history_y[h][i] = g_new[i] - g[i];
+		}
+		double sy = dot(history_s[h], history_y[h]);
+		if (sy > 0.0) {
+			history_rho[h] = 1.0 / sy;
+			history_count++;
+		}
+
+		x.swap(x_new);
+		g.swap(g_new);
+	}
+
+	// Leave the mesh at rest at the final configuration
+	if (result != STATIC_SOLVE_ERROR) {
+		if (static_gradient(this, x, g) == false) result = STATIC_SOLVE_ERROR;
+		gmax = max_vertex_length(g);
+		if (result == STATIC_SOLVE_NOT_CONVERGED && gmax <= threshold) result = STATIC_SOLVE_CONVERGED;
+	}
+
+	for (a = 0; a < 3; a++) {
+		for (i = 0; i < m_nVertices; i++) {
+			s.prev_pos[a][i] = s.pos[a][i];
+			s.velocity[a][i] = 0.0f;
+			s.force[a][i] = 0.0f;
+		}
+	}
+
+	m_maximum_vertex_velocity = m_maximum_vertex_acceleration = 0.0f;
+	m_mean_vertex_velocity = m_mean_vertex_acceleration = 0.0f;
+
+	if (iterations) *iterations = iteration;
+	if (residual) *residual = (float)(gmax);
+
+	return result;
+
+} // solve_static()
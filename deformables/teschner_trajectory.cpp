@@ -0,0 +1,547 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+// Writing, reading, and converting binary trajectories; see
+// teschner_trajectory.h
+
+#include "teschner_trajectory.h"
+#include <conio.h>
+#include <math.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// A frame whose deltas are too big to quantize becomes a key frame
+#define MAX_QUANTIZED_STEPS 1.0e9f
+
+// A bounded queue of frames, filled by the simulation thread and drained
+// by the I/O thread.  Frames in [head, head+count) are waiting to be
+// written; the producer owns the slot after them.
+struct trajectory_queue {
+
+	FILE* f;
+	unsigned int n_vertices;
+	float quantization_step;
+
+	std::vector< std::vector<float> > frames;
+	std::vector<float> times;
+	unsigned int head;
+	unsigned int count;
+	bool closing;
+	bool failed;
+
+	// What the reader will have after the most recent frame
+	std::vector<float> reference;
+	unsigned int frames_written;
+	std::vector<unsigned char> payload;
+
+#ifdef _WIN32
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE not_empty;
+	CONDITION_VARIABLE not_full;
+	HANDLE thread;
+	void enter() { EnterCriticalSection(&lock); }
+	void leave() { LeaveCriticalSection(&lock); }
+	void wait_not_empty() { SleepConditionVariableCS(&not_empty, &lock, INFINITE); }
+	void wait_not_full() { SleepConditionVariableCS(&not_full, &lock, INFINITE); }
+	void signal_not_empty() { WakeConditionVariable(&not_empty); }
+	void signal_not_full() { WakeConditionVariable(&not_full); }
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	pthread_t thread;
+	void enter() { pthread_mutex_lock(&lock); }
+	void leave() { pthread_mutex_unlock(&lock); }
+	void wait_not_empty() { pthread_cond_wait(&not_empty, &lock); }
+	void wait_not_full() { pthread_cond_wait(&not_full, &lock); }
+	void signal_not_empty() { pthread_cond_signal(&not_empty); }
+	void signal_not_full() { pthread_cond_signal(&not_full); }
+#endif
+
+	trajectory_queue() {
+		f = 0;
+		head = count = 0;
+		closing = failed = false;
+		frames_written = 0;
+#ifdef _WIN32
+		InitializeCriticalSection(&lock);
+		InitializeConditionVariable(&not_empty);
+		InitializeConditionVariable(&not_full);
+		thread = 0;
+#else
+		pthread_mutex_init(&lock, 0);
+		pthread_cond_init(&not_empty, 0);
+		pthread_cond_init(&not_full, 0);
+#endif
+	}
+
+	~trajectory_queue() {
+#ifdef _WIN32
+		DeleteCriticalSection(&lock);
+#else
+		pthread_mutex_destroy(&lock);
+		pthread_cond_destroy(&not_empty);
+		pthread_cond_destroy(&not_full);
+#endif
+	}
+};
+
+static void append_varint(std::vector<unsigned char>& out, unsigned int v) {
+	while (v >= 0x80) {
+		out.push_back((unsigned char)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((unsigned char)v);
+}
+
+inline unsigned int zigzag(int v) {
+	return (((unsigned int)v) << 1) ^ (unsigned int)(v >> 31);
+}
+
+inline int unzigzag(unsigned int v) {
+	return (int)(v >> 1) ^ -((int)(v & 1));
+}
+
+// Encodes [positions] into q->payload, updating q->reference to match what
+// a reader will decode; returns the encoding used
+static int encode_trajectory_frame(trajectory_queue* q, const float* positions) {
+
+	unsigned int n = 3 * q->n_vertices;
+	float* ref = n ? &(q->reference[0]) : 0;
+	std::vector<unsigned char>& out = q->payload;
+	unsigned int i;
+
+	out.clear();
+
+	bool key = (q->frames_written % TRAJECTORY_KEYFRAME_INTERVAL) == 0;
+
+	if (key == false && q->quantization_step > 0.0f) {
+
+		float step = q->quantization_step;
+		float inverse_step = 1.0f / step;
+
+		// Make sure everything fits before we touch the reference
+		for (i = 0; i < n; i++) {
+			if (fabs((positions[i] - ref[i]) * inverse_step) > MAX_QUANTIZED_STEPS) break;
+		}
+
+		if (i == n) {
+			out.reserve(n);
+			for (i = 0; i < n; i++) {
+				int steps = (int)(floor((positions[i] - ref[i]) * inverse_step + 0.5f));
+				append_varint(out, zigzag(steps));
+				ref[i] += (float)(steps)* step;
+			}
+			return TRAJECTORY_FRAME_QUANTIZED_DELTAS;
+		}
+
+		key = true;
+	}
+
+	out.resize(n * sizeof(float));
+	float* payload = n ? (float*)(&(out[0])) : 0;
+
+	if (key) {
+		for (i = 0; i < n; i++) payload[i] = ref[i] = positions[i];
+		return TRAJECTORY_FRAME_KEY;
+	}
+
+	for (i = 0; i < n; i++) {
+		float delta = positions[i] - ref[i];
+		payload[i] = delta;
+		ref[i] += delta;
+	}
+	return TRAJECTORY_FRAME_FLOAT_DELTAS;
+}
+
+static bool write_trajectory_frame(trajectory_queue* q, float sim_time, const float* positions) {
+
+	teschner_trajectory_frame_header fh;
+	fh.sim_time = sim_time;
+	fh.encoding = encode_trajectory_frame(q, positions);
+	fh.payload_bytes = q->payload.size();
+	fh.unused = 0;
+
+	q->frames_written++;
+
+	if (fwrite(&fh, sizeof(fh), 1, q->f) != 1) return false;
+	if (fh.payload_bytes && fwrite(&(q->payload[0]), 1, fh.payload_bytes, q->f) != fh.payload_bytes) return false;
+	return true;
+}
+
+static void trajectory_io_loop(trajectory_queue* q) {
+
+	while (1) {
+
+		q->enter();
+		while (q->count == 0 && q->closing == false) q->wait_not_empty();
+		if (q->count == 0) {
+			q->leave();
+			break;
+		}
+		unsigned int slot = q->head;
+		bool failed = q->failed;
+		q->leave();
+
+		// The slot is ours until we advance the head; once a write fails we
+		// just drain the queue
+		bool write_failed = false;
+		if (failed == false) {
+			if (write_trajectory_frame(q, q->times[slot], &(q->frames[slot][0])) == false) {
+				_cprintf("Error writing trajectory frame\n");
+				write_failed = true;
+			}
+		}
+
+		q->enter();
+		if (write_failed) q->failed = true;
+		q->head = (q->head + 1) % q->frames.size();
+		q->count--;
+		q->signal_not_full();
+		q->leave();
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI trajectory_thread_proc(void* param) {
+	trajectory_io_loop((trajectory_queue*)param);
+	return 0;
+}
+#else
+static void* trajectory_thread_proc(void* param) {
+	trajectory_io_loop((trajectory_queue*)param);
+	return 0;
+}
+#endif
+
+
+trajectory_writer::trajectory_writer() {
+	m_queue = 0;
+	m_n_vertices = 0;
+	m_frames_queued = 0;
+}
+
+trajectory_writer::~trajectory_writer() {
+	close();
+}
+
+bool trajectory_writer::open(const char* filename, unsigned int n_vertices,
+	const unsigned int* tets, unsigned int n_tets, const char* base_filename,
+	float quantization_step, int queue_length) {
+
+	close();
+
+	FILE* f = fopen(filename, "wb");
+	if (f == 0) {
+		_cprintf("Could not open trajectory file %s for writing\n", filename);
+		return false;
+	}
+
+	if (quantization_step < 0.0f) quantization_step = 0.0f;
+	if (queue_length < 1) queue_length = 1;
+
+	teschner_trajectory_header h;
+	memset(&h, 0, sizeof(h));
+	h.magic = TESCHNER_TRAJECTORY_MAGIC;
+	h.version = TESCHNER_TRAJECTORY_VERSION;
+	h.header_size = sizeof(h);
+	h.nVertices = n_vertices;
+	h.nTets = tets ? n_tets : 0;
+	h.quantization_step = quantization_step;
+	h.base_filename_length = base_filename ? strlen(base_filename) : 0;
+
+	bool ok = (fwrite(&h, sizeof(h), 1, f) == 1);
+	if (ok && h.base_filename_length)
+		ok = (fwrite(base_filename, 1, h.base_filename_length, f) == h.base_filename_length);
+	if (ok && h.nTets)
+		ok = (fwrite(tets, 4 * sizeof(unsigned int), h.nTets, f) == h.nTets);
+
+	if (ok == false) {
+		_cprintf("Could not write trajectory header to %s\n", filename);
+		fclose(f);
+		return false;
+	}
+
+	trajectory_queue* q = new trajectory_queue;
+	q->f = f;
+	q->n_vertices = n_vertices;
+	q->quantization_step = quantization_step;
+	q->frames.resize(queue_length);
+	q->times.resize(queue_length);
+	for (int i = 0; i < queue_length; i++) q->frames[i].resize(3 * n_vertices + 1);
+	q->reference.resize(3 * n_vertices + 1);
+
+#ifdef _WIN32
+	DWORD thread_id;
+	q->thread = ::CreateThread(0, 0, trajectory_thread_proc, q, 0, &thread_id);
+	bool started = (q->thread != 0);
+#else
+	bool started = (pthread_create(&(q->thread), 0, trajectory_thread_proc, q) == 0);
+#endif
+
+	if (started == false) {
+		_cprintf("Could not start the trajectory writer thread\n");
+		fclose(f);
+		delete q;
+		return false;
+	}
+
+	m_queue = q;
+	m_n_vertices = n_vertices;
+	m_frames_queued = 0;
+
+	_cprintf("Writing trajectory to %s\n", filename);
+	return true;
+}
+
+bool trajectory_writer::add_frame(float sim_time, const float* x, const float* y, const float* z,
+	double scale, const double* offset) {
+
+	trajectory_queue* q = m_queue;
+	if (q == 0) return false;
+
+	// Wait for a free slot (the I/O thread sets [failed], so we only look
+	// at it under the lock)
+	q->enter();
+	while (q->count == q->frames.size()) q->wait_not_full();
+	bool failed = q->failed;
+	unsigned int slot = (q->head + q->count) % q->frames.size();
+	q->leave();
+
+	if (failed) return false;
+
+	// Undo the transform in double, dividing and then subtracting, just as
+	// ExportModel() does, so the floats we store are the ones it would print
+	if (scale == 0.0) scale = 1.0;
+	double ox = 0, oy = 0, oz = 0;
+	if (offset) { ox = offset[0]; oy = offset[1]; oz = offset[2]; }
+
+	float* out = &(q->frames[slot][0]);
+	for (unsigned int i = 0; i < m_n_vertices; i++) {
+		out[3 * i] = (float)((double)(x[i]) / scale - ox);
+		out[3 * i + 1] = (float)((double)(y[i]) / scale - oy);
+		out[3 * i + 2] = (float)((double)(z[i]) / scale - oz);
+	}
+	q->times[slot] = sim_time;
+
+	q->enter();
+	q->count++;
+	q->signal_not_empty();
+	q->leave();
+
+	m_frames_queued++;
+	return true;
+}
+
+bool trajectory_writer::close() {
+
+	trajectory_queue* q = m_queue;
+	if (q == 0) return true;
+
+	q->enter();
+	q->closing = true;
+	q->signal_not_empty();
+	q->leave();
+
+#ifdef _WIN32
+	WaitForSingleObject(q->thread, INFINITE);
+	CloseHandle(q->thread);
+#else
+	pthread_join(q->thread, 0);
+#endif
+
+	bool ok = (q->failed == false);
+	if (fclose(q->f) != 0) ok = false;
+
+	_cprintf("Closed trajectory file after %d frames\n", q->frames_written);
+
+	delete q;
+	m_queue = 0;
+	return ok;
+}
+
+
+trajectory_reader::trajectory_reader() {
+	m_file = 0;
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+trajectory_reader::~trajectory_reader() {
+	close();
+}
+
+void trajectory_reader::close() {
+	if (m_file) fclose(m_file);
+	m_file = 0;
+}
+
+bool trajectory_reader::open(const char* filename) {
+
+	close();
+
+	m_file = fopen(filename, "rb");
+	if (m_file == 0) {
+		_cprintf("Could not open trajectory file %s\n", filename);
+		return false;
+	}
+
+	bool ok = (fread(&m_header, sizeof(m_header), 1, m_file) == 1);
+	if (ok) {
+		ok = (m_header.magic == TESCHNER_TRAJECTORY_MAGIC &&
+			m_header.version == TESCHNER_TRAJECTORY_VERSION &&
+			m_header.header_size == sizeof(m_header));
+	}
+
+	if (ok) {
+		m_base_filename.resize(m_header.base_filename_length + 1);
+		if (m_header.base_filename_length)
+			ok = (fread(&(m_base_filename[0]), 1, m_header.base_filename_length, m_file) == m_header.base_filename_length);
+		m_base_filename[m_header.base_filename_length] = '\0';
+	}
+
+	if (ok && m_header.nTets) {
+		m_tets.resize(4 * m_header.nTets);
+		ok = (fread(&(m_tets[0]), 4 * sizeof(unsigned int), m_header.nTets, m_file) == m_header.nTets);
+	}
+
+	if (ok == false) {
+		_cprintf("%s is not a readable trajectory file\n", filename);
+		close();
+		return false;
+	}
+
+	m_positions.assign(3 * m_header.nVertices + 1, 0.0f);
+	return true;
+}
+
+bool trajectory_reader::read_frame(float& sim_time) {
+
+	if (m_file == 0) return false;
+
+	teschner_trajectory_frame_header fh;
+	if (fread(&fh, sizeof(fh), 1, m_file) != 1) return false;
+
+	m_payload.resize(fh.payload_bytes + 1);
+	if (fh.payload_bytes && fread(&(m_payload[0]), 1, fh.payload_bytes, m_file) != fh.payload_bytes) {
+		_cprintf("Trajectory ends in the middle of a frame\n");
+		return false;
+	}
+
+	unsigned int n = 3 * m_header.nVertices;
+	float* pos = &(m_positions[0]);
+	unsigned int i;
+
+	if (fh.encoding == TRAJECTORY_FRAME_KEY || fh.encoding == TRAJECTORY_FRAME_FLOAT_DELTAS) {
+		if (fh.payload_bytes != n * sizeof(float)) {
+			_cprintf("Bad trajectory frame size %d\n", fh.payload_bytes);
+			return false;
+		}
+		const float* payload = (const float*)(&(m_payload[0]));
+		if (fh.encoding == TRAJECTORY_FRAME_KEY) {
+			for (i = 0; i < n; i++) pos[i] = payload[i];
+		}
+		else {
+			for (i = 0; i < n; i++) pos[i] += payload[i];
+		}
+	}
+
+	else if (fh.encoding == TRAJECTORY_FRAME_QUANTIZED_DELTAS) {
+		float step = m_header.quantization_step;
+		const unsigned char* cur = &(m_payload[0]);
+		const unsigned char* end = cur + fh.payload_bytes;
+		for (i = 0; i < n; i++) {
+			unsigned int v = 0;
+			int shift = 0;
+			while (cur < end && (*cur & 0x80)) {
+				v |= ((unsigned int)(*cur & 0x7f)) << shift;
+				shift += 7;
+				cur++;
+			}
+			if (cur == end) break;
+			v |= ((unsigned int)(*cur)) << shift;
+			cur++;
+			pos[i] += (float)(unzigzag(v)) * step;
+		}
+		if (i != n) {
+			_cprintf("Truncated quantized trajectory frame\n");
+			return false;
+		}
+	}
+
+	else {
+		_cprintf("Unknown trajectory frame encoding %d\n", fh.encoding);
+		return false;
+	}
+
+	sim_time = fh.sim_time;
+	return true;
+}
+
+
+int convert_trajectory_to_node_files(const char* trajectory_filename) {
+
+	// Room for the name, plus a '.' if it has no extension
+	char root[_MAX_PATH];
+	if (strlen(trajectory_filename) + 2 > sizeof(root)) {
+		_cprintf("Trajectory filename %s is too long\n", trajectory_filename);
+		return -1;
+	}
+
+	trajectory_reader reader;
+	if (reader.open(trajectory_filename) == false) return -1;
+
+	strcpy(root, trajectory_filename);
+	char* extension = strrchr(root, '.');
+	if (extension) extension[1] = '\0';
+	else strcat(root, ".");
+
+	unsigned int n = reader.m_header.nVertices;
+	int frames = 0;
+	float sim_time;
+
+	while (reader.read_frame(sim_time)) {
+
+		char node_filename[_MAX_PATH];
+		int length = _snprintf(node_filename, sizeof(node_filename), "%stick.%06.3f.anode", root, sim_time);
+		if (length < 0 || length >= (int)(sizeof(node_filename))) {
+			_cprintf("Node filename for time %f would be too long\n", sim_time);
+			return frames;
+		}
+
+		FILE* f = fopen(node_filename, "wb");
+		if (f == 0) {
+			_cprintf("Could not open output node file %s\n", node_filename);
+			return frames;
+		}
+
+		// The same header ExportModel() writes for anode files
+		if (reader.m_header.base_filename_length)
+			fprintf(f, "# BASE_FILENAME %s\n", &(reader.m_base_filename[0]));
+		fprintf(f, "# Generated by WinMeshView ( http://cs.stanford.edu/~dmorris/projects/winmeshview )\n");
+		fprintf(f, "%d %d %d %d\n", n, 3, 0, 0);
+
+		const float* pos = reader.positions();
+		for (unsigned int i = 0; i < n; i++) {
+			fprintf(f, "%u %f %f %f\n", i, pos[3 * i], pos[3 * i + 1], pos[3 * i + 2]);
+		}
+
+		fclose(f);
+		frames++;
+	}
+
+	_cprintf("Wrote %d node files from %s\n", frames, trajectory_filename);
+	return frames;
+}
@@ -0,0 +1,168 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Binary trajectories: a whole run of periodic output in one file, in
+  place of one text mesh file per output period.
+
+  The file is a header, the base (mesh) filename, and the tets, all
+  written once, followed by one record per frame:
+
+    teschner_trajectory_frame_header
+    payload
+
+  A frame is encoded as one of:
+
+  TRAJECTORY_FRAME_KEY: x,y,z floats per vertex.  The first frame, and
+    every TRAJECTORY_KEYFRAME_INTERVAL'th frame after it, is a key frame.
+
+  TRAJECTORY_FRAME_FLOAT_DELTAS: x,y,z floats per vertex, each added to the
+    previous frame.
+
+  TRAJECTORY_FRAME_QUANTIZED_DELTAS: (if the file has a quantization step)
+    the change along each axis as a whole number of steps, zigzag-encoded
+    as a variable-length integer: one byte for anything under 64 steps, so
+    vertices that barely moved cost almost nothing.
+
+  Deltas are always taken from what the reader will have reconstructed,
+  not from the true previous positions, so quantization error never
+  accumulates past half a step.
+
+  Frames are encoded and written by a background thread; the simulation
+  thread only copies positions into a bounded queue, and only waits if the
+  disk falls that many frames behind.
+
+  The frame count isn't stored anywhere, so a trajectory that was cut off
+  (e.g. by a crash) is still readable up to its last complete frame.
+
+***********/
+
+#ifndef _TESCHNER_TRAJECTORY_H_
+#define _TESCHNER_TRAJECTORY_H_
+
+#include <stdio.h>
+#include <vector>
+
+#define TESCHNER_TRAJECTORY_EXTENSION "ttraj"
+
+// "TTR1"
+#define TESCHNER_TRAJECTORY_MAGIC 0x31525454
+
+#define TESCHNER_TRAJECTORY_VERSION 1
+
+#define TRAJECTORY_KEYFRAME_INTERVAL 64
+
+#define DEFAULT_TRAJECTORY_QUEUE_LENGTH 8
+
+typedef enum {
+	TRAJECTORY_FRAME_KEY = 0,
+	TRAJECTORY_FRAME_FLOAT_DELTAS,
+	TRAJECTORY_FRAME_QUANTIZED_DELTAS
+} trajectory_frame_encodings;
+
+struct teschner_trajectory_header {
+
+	// TESCHNER_TRAJECTORY_MAGIC
+	int magic;
+	int version;
+	int header_size;
+
+	unsigned int nVertices;
+	unsigned int nTets;
+
+	// Zero for float deltas
+	float quantization_step;
+
+	// Length of the base filename that follows the header (no terminator)
+	unsigned int base_filename_length;
+
+	unsigned int unused;
+};
+
+struct teschner_trajectory_frame_header {
+	float sim_time;
+	int encoding;
+	unsigned int payload_bytes;
+	unsigned int unused;
+};
+
+struct trajectory_queue;
+
+class trajectory_writer {
+
+public:
+	trajectory_writer();
+	~trajectory_writer();
+
+	// Writes the header and topology and starts the I/O thread.  A
+	// [quantization_step] of zero stores float deltas.
+	bool open(const char* filename, unsigned int n_vertices,
+		const unsigned int* tets, unsigned int n_tets, const char* base_filename = 0,
+		float quantization_step = 0.0f, int queue_length = DEFAULT_TRAJECTORY_QUEUE_LENGTH);
+
+	// Queues a frame.  Each position is written as (p / scale) - offset,
+	// i.e. with the transform applied at load time undone.  Returns false if
+	// the file isn't open or a write has failed.
+	bool add_frame(float sim_time, const float* x, const float* y, const float* z,
+		double scale = 1.0, const double* offset = 0);
+
+	// Waits for every queued frame to be written, then closes the file;
+	// returns false if anything failed along the way
+	bool close();
+
+	bool is_open() const { return m_queue != 0; }
+
+	unsigned int frames_queued() const { return m_frames_queued; }
+
+protected:
+	trajectory_queue* m_queue;
+	unsigned int m_n_vertices;
+	unsigned int m_frames_queued;
+
+private:
+	trajectory_writer(const trajectory_writer&);
+	void operator=(const trajectory_writer&);
+};
+
+class trajectory_reader {
+
+public:
+	trajectory_reader();
+	~trajectory_reader();
+
+	bool open(const char* filename);
+	void close();
+
+	// Decodes the next frame into positions(); returns false at the end of
+	// the file (or of its last complete frame)
+	bool read_frame(float& sim_time);
+
+	// x,y,z for each vertex, as of the last read_frame()
+	const float* positions() const { return m_positions.empty() ? 0 : &(m_positions[0]); }
+
+	teschner_trajectory_header m_header;
+	std::vector<char> m_base_filename;
+	std::vector<unsigned int> m_tets;
+
+protected:
+	FILE* m_file;
+	std::vector<float> m_positions;
+	std::vector<unsigned char> m_payload;
+};
+
+// Writes one node file per frame of [trajectory_filename], in the format
+// (and with the names) periodic output used to produce: the trajectory's
+// extension is replaced by "tick.[sim time].anode".  Returns the number of
+// frames written, or -1 if the trajectory couldn't be read.
+int convert_trajectory_to_node_files(const char* trajectory_filename);
+
+#endif
@@ -0,0 +1,442 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "stdafx.h"
+#include "voxelizer.h"
+#include "aabb_distance_tree.h"
+#include <float.h>
+#include <list>
+
+#ifdef AABB_DISTANCE_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+distance_packet::distance_packet() :
+	x(DISTANCE_PACKET_MAX_POINTS), y(DISTANCE_PACKET_MAX_POINTS), z(DISTANCE_PACKET_MAX_POINTS),
+	sq_distance(DISTANCE_PACKET_MAX_POINTS),
+	closest_x(DISTANCE_PACKET_MAX_POINTS), closest_y(DISTANCE_PACKET_MAX_POINTS), closest_z(DISTANCE_PACKET_MAX_POINTS),
+	closest_triangle(DISTANCE_PACKET_MAX_POINTS),
+	bound(DISTANCE_PACKET_MAX_POINTS), active(DISTANCE_PACKET_MAX_POINTS) {
+	num_points = 0;
+}
+
+int distance_packet::add_point(const cVector3d& p) {
+	x[num_points] = p.x;
+	y[num_points] = p.y;
+	z[num_points] = p.z;
+	return num_points++;
+}
+
+aabb_distance_tree::aabb_distance_tree() {
+	m_offset.set(0, 0, 0);
+}
+
+static inline void copy_vector(double* dest, const cVector3d& v) {
+	dest[0] = v.x; dest[1] = v.y; dest[2] = v.z;
+}
+
+static inline void cross3(const double* a, const double* b, double* out) {
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static inline double dot3(const double* a, const double* b) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void precompute_triangle(cTriangle* source, distance_tree_triangle& tri) {
+
+	copy_vector(tri.a, source->getVertex(0)->getPos());
+	copy_vector(tri.b, source->getVertex(1)->getPos());
+	copy_vector(tri.c, source->getVertex(2)->getPos());
+
+	for (int k = 0; k < 3; k++) {
+		tri.ab[k] = tri.b[k] - tri.a[k];
+		tri.bc[k] = tri.c[k] - tri.b[k];
+		tri.ca[k] = tri.a[k] - tri.c[k];
+	}
+
+	double len_sq;
+	len_sq = dot3(tri.ab, tri.ab); tri.inv_ab_sq = (len_sq > 0) ? 1.0 / len_sq : 0.0;
+	len_sq = dot3(tri.bc, tri.bc); tri.inv_bc_sq = (len_sq > 0) ? 1.0 / len_sq : 0.0;
+	len_sq = dot3(tri.ca, tri.ca); tri.inv_ca_sq = (len_sq > 0) ? 1.0 / len_sq : 0.0;
+
+	// n = ab x ac
+	double ac[3] = { -tri.ca[0], -tri.ca[1], -tri.ca[2] };
+	double n[3];
+	cross3(tri.ab, ac, n);
+	double n_len = sqrt(dot3(n, n));
+
+	if (n_len > 0) {
+
+		for (int k = 0; k < 3; k++) tri.n[k] = n[k] / n_len;
+		tri.n_offset = dot3(tri.n, tri.a);
+
+		cross3(tri.n, tri.ab, tri.m[0]);
+		cross3(tri.n, tri.bc, tri.m[1]);
+		cross3(tri.n, tri.ca, tri.m[2]);
+		tri.m_offset[0] = dot3(tri.m[0], tri.a);
+		tri.m_offset[1] = dot3(tri.m[1], tri.b);
+		tri.m_offset[2] = dot3(tri.m[2], tri.c);
+	}
+
+	// A degenerate triangle is just its edges; make sure no point ever
+	// projects "inside" it
+	else {
+		for (int k = 0; k < 3; k++) {
+			tri.n[k] = 0;
+			tri.m[k][0] = tri.m[k][1] = tri.m[k][2] = 0;
+			tri.m_offset[k] = 1.0;
+		}
+		tri.n_offset = 0;
+	}
+
+}
+
+void aabb_distance_tree::build(cMesh* mesh) {
+
+	m_nodes.clear();
+	m_roots.clear();
+	m_triangles.clear();
+	m_source_triangles.clear();
+
+	m_offset = mesh->getPos();
+
+	std::list<cCollisionAABB*> colliders;
+	collect_mesh_colliders(mesh, colliders);
+
+	std::list<cCollisionAABB*>::iterator iter;
+	for (iter = colliders.begin(); iter != colliders.end(); iter++) {
+		cCollisionAABBNode* root = (*iter)->getRoot();
+		if (root) m_roots.push_back(flatten(root));
+	}
+
+}
+
+// Copies the subtree under [node] onto the end of m_nodes, returning the
+// index of [node]'s copy
+//
+// CHAI's placement-new allocation resets m_nodeType, so we have to ask
+// dynamic_cast what kind of node this is, but we only ask once per node.
+int aabb_distance_tree::flatten(cCollisionAABBNode* node) {
+
+	int index = (int)(m_nodes.size());
+	m_nodes.push_back(distance_tree_node());
+
+	distance_tree_node& n = m_nodes[index];
+	copy_vector(n.box_min, node->m_bbox.m_min);
+	copy_vector(n.box_max, node->m_bbox.m_max);
+	n.left = n.right = n.triangle = -1;
+
+	cCollisionAABBLeaf* leaf = dynamic_cast<cCollisionAABBLeaf*>(node);
+
+	if (leaf) {
+		distance_tree_triangle tri;
+		precompute_triangle(leaf->m_triangle, tri);
+		n.triangle = (int)(m_triangles.size());
+		m_triangles.push_back(tri);
+		m_source_triangles.push_back(leaf->m_triangle);
+		return index;
+	}
+
+	cCollisionAABBInternal* internal = dynamic_cast<cCollisionAABBInternal*>(node);
+	if (internal == 0) return index;
+
+	// m_nodes may move while we recurse, so don't hang on to [n]
+	int left = -1, right = -1;
+	if (internal->m_leftSubTree) left = flatten(internal->m_leftSubTree);
+	if (internal->m_rightSubTree) right = flatten(internal->m_rightSubTree);
+	m_nodes[index].left = left;
+	m_nodes[index].right = right;
+
+	return index;
+}
+
+// The closest point on segment [s,s+e] to p
+static inline void closest_point_on_segment(const double* s, const double* e, double inv_len_sq,
+	double px, double py, double pz, double& dsq, double& qx, double& qy, double& qz) {
+
+	double t = ((px - s[0])*e[0] + (py - s[1])*e[1] + (pz - s[2])*e[2]) * inv_len_sq;
+	if (t < 0) t = 0;
+	if (t > 1) t = 1;
+
+	qx = s[0] + t*e[0];
+	qy = s[1] + t*e[1];
+	qz = s[2] + t*e[2];
+
+	double dx = px - qx, dy = py - qy, dz = pz - qz;
+	dsq = dx*dx + dy*dy + dz*dz;
+}
+
+// The closest point on a triangle to p: the projection of p onto the
+// triangle's plane if that lands inside the triangle, otherwise the closest
+// point on one of its edges
+static inline void closest_point_on_triangle(const distance_tree_triangle& tri,
+	double px, double py, double pz, double& dsq, double& qx, double& qy, double& qz) {
+
+	closest_point_on_segment(tri.a, tri.ab, tri.inv_ab_sq, px, py, pz, dsq, qx, qy, qz);
+
+	double d, x, y, z;
+	closest_point_on_segment(tri.b, tri.bc, tri.inv_bc_sq, px, py, pz, d, x, y, z);
+	if (d < dsq) { dsq = d; qx = x; qy = y; qz = z; }
+
+	closest_point_on_segment(tri.c, tri.ca, tri.inv_ca_sq, px, py, pz, d, x, y, z);
+	if (d < dsq) { dsq = d; qx = x; qy = y; qz = z; }
+
+	double s0 = px*tri.m[0][0] + py*tri.m[0][1] + pz*tri.m[0][2] - tri.m_offset[0];
+	double s1 = px*tri.m[1][0] + py*tri.m[1][1] + pz*tri.m[1][2] - tri.m_offset[1];
+	double s2 = px*tri.m[2][0] + py*tri.m[2][1] + pz*tri.m[2][2] - tri.m_offset[2];
+
+	if (s0 >= 0 && s1 >= 0 && s2 >= 0) {
+		double h = px*tri.n[0] + py*tri.n[1] + pz*tri.n[2] - tri.n_offset;
+		dsq = h*h;
+		qx = px - h*tri.n[0];
+		qy = py - h*tri.n[1];
+		qz = pz - h*tri.n[2];
+	}
+
+}
+
+#ifdef AABB_DISTANCE_USE_SSE2
+
+// Picks [a] where [mask] is set, [b] elsewhere
+static inline __m128d select_pd(__m128d mask, __m128d a, __m128d b) {
+	return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+static inline void closest_point_on_segment_sse2(const double* s, const double* e, double inv_len_sq,
+	__m128d px, __m128d py, __m128d pz, __m128d& dsq, __m128d& qx, __m128d& qy, __m128d& qz) {
+
+	__m128d sx = _mm_set1_pd(s[0]), sy = _mm_set1_pd(s[1]), sz = _mm_set1_pd(s[2]);
+	__m128d ex = _mm_set1_pd(e[0]), ey = _mm_set1_pd(e[1]), ez = _mm_set1_pd(e[2]);
+
+	__m128d t = _mm_add_pd(_mm_add_pd(
+		_mm_mul_pd(_mm_sub_pd(px, sx), ex),
+		_mm_mul_pd(_mm_sub_pd(py, sy), ey)),
+		_mm_mul_pd(_mm_sub_pd(pz, sz), ez));
+	t = _mm_mul_pd(t, _mm_set1_pd(inv_len_sq));
+	t = _mm_min_pd(_mm_max_pd(t, _mm_setzero_pd()), _mm_set1_pd(1.0));
+
+	qx = _mm_add_pd(sx, _mm_mul_pd(t, ex));
+	qy = _mm_add_pd(sy, _mm_mul_pd(t, ey));
+	qz = _mm_add_pd(sz, _mm_mul_pd(t, ez));
+
+	__m128d dx = _mm_sub_pd(px, qx), dy = _mm_sub_pd(py, qy), dz = _mm_sub_pd(pz, qz);
+	dsq = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+}
+
+// Which side of edge [e]'s in-plane normal each point is on
+static inline __m128d edge_side_sse2(const distance_tree_triangle& tri, int e,
+	__m128d px, __m128d py, __m128d pz) {
+
+	__m128d s = _mm_add_pd(_mm_add_pd(
+		_mm_mul_pd(px, _mm_set1_pd(tri.m[e][0])),
+		_mm_mul_pd(py, _mm_set1_pd(tri.m[e][1]))),
+		_mm_mul_pd(pz, _mm_set1_pd(tri.m[e][2])));
+	return _mm_sub_pd(s, _mm_set1_pd(tri.m_offset[e]));
+}
+
+// Same as closest_point_on_triangle, for two points at once
+static inline void closest_point_on_triangle_sse2(const distance_tree_triangle& tri,
+	__m128d px, __m128d py, __m128d pz, __m128d& dsq, __m128d& qx, __m128d& qy, __m128d& qz) {
+
+	closest_point_on_segment_sse2(tri.a, tri.ab, tri.inv_ab_sq, px, py, pz, dsq, qx, qy, qz);
+
+	__m128d d, x, y, z, closer;
+
+	closest_point_on_segment_sse2(tri.b, tri.bc, tri.inv_bc_sq, px, py, pz, d, x, y, z);
+	closer = _mm_cmplt_pd(d, dsq);
+	dsq = select_pd(closer, d, dsq);
+	qx = select_pd(closer, x, qx); qy = select_pd(closer, y, qy); qz = select_pd(closer, z, qz);
+
+	closest_point_on_segment_sse2(tri.c, tri.ca, tri.inv_ca_sq, px, py, pz, d, x, y, z);
+	closer = _mm_cmplt_pd(d, dsq);
+	dsq = select_pd(closer, d, dsq);
+	qx = select_pd(closer, x, qx); qy = select_pd(closer, y, qy); qz = select_pd(closer, z, qz);
+
+	__m128d zero = _mm_setzero_pd();
+	__m128d inside = _mm_and_pd(
+		_mm_and_pd(
+			_mm_cmpge_pd(edge_side_sse2(tri, 0, px, py, pz), zero),
+			_mm_cmpge_pd(edge_side_sse2(tri, 1, px, py, pz), zero)),
+		_mm_cmpge_pd(edge_side_sse2(tri, 2, px, py, pz), zero));
+
+	__m128d nx = _mm_set1_pd(tri.n[0]), ny = _mm_set1_pd(tri.n[1]), nz = _mm_set1_pd(tri.n[2]);
+	__m128d h = _mm_add_pd(_mm_add_pd(_mm_mul_pd(px, nx), _mm_mul_pd(py, ny)), _mm_mul_pd(pz, nz));
+	h = _mm_sub_pd(h, _mm_set1_pd(tri.n_offset));
+
+	dsq = select_pd(inside, _mm_mul_pd(h, h), dsq);
+	qx = select_pd(inside, _mm_sub_pd(px, _mm_mul_pd(h, nx)), qx);
+	qy = select_pd(inside, _mm_sub_pd(py, _mm_mul_pd(h, ny)), qy);
+	qz = select_pd(inside, _mm_sub_pd(pz, _mm_mul_pd(h, nz)), qz);
+}
+
+#endif
+
+// Records a candidate closest point for point [i] if it beats what we have
+static inline void offer_closest_point(distance_packet& packet, int i, int triangle_index,
+	double dsq, double qx, double qy, double qz) {
+
+	if (dsq >= packet.sq_distance[i]) return;
+
+	packet.sq_distance[i] = dsq;
+	packet.closest_x[i] = qx;
+	packet.closest_y[i] = qy;
+	packet.closest_z[i] = qz;
+	packet.closest_triangle[i] = triangle_index;
+
+	if (dsq < packet.bound[i]) packet.bound[i] = dsq;
+}
+
+// Tests one triangle against the first [num_active] points on the
+// packet's active list
+void aabb_distance_tree::test_leaf(const distance_tree_triangle& tri, int triangle_index,
+	distance_packet& packet, int num_active) const {
+
+	int q = 0;
+
+#ifdef AABB_DISTANCE_USE_SSE2
+	for (; q + 1 < num_active; q += 2) {
+
+		int i0 = packet.active[q];
+		int i1 = packet.active[q + 1];
+
+		__m128d px = _mm_set_pd(packet.x[i1], packet.x[i0]);
+		__m128d py = _mm_set_pd(packet.y[i1], packet.y[i0]);
+		__m128d pz = _mm_set_pd(packet.z[i1], packet.z[i0]);
+
+		__m128d dsq, qx, qy, qz;
+		closest_point_on_triangle_sse2(tri, px, py, pz, dsq, qx, qy, qz);
+
+		double d[2], x[2], y[2], z[2];
+		_mm_storeu_pd(d, dsq);
+		_mm_storeu_pd(x, qx);
+		_mm_storeu_pd(y, qy);
+		_mm_storeu_pd(z, qz);
+
+		offer_closest_point(packet, i0, triangle_index, d[0], x[0], y[0], z[0]);
+		offer_closest_point(packet, i1, triangle_index, d[1], x[1], y[1], z[1]);
+	}
+#endif
+
+	for (; q < num_active; q++) {
+		int i = packet.active[q];
+		double dsq, qx, qy, qz;
+		closest_point_on_triangle(tri, packet.x[i], packet.y[i], packet.z[i], dsq, qx, qy, qz);
+		offer_closest_point(packet, i, triangle_index, dsq, qx, qy, qz);
+	}
+
+}
+
+void aabb_distance_tree::query(distance_packet& packet) const {
+
+	int n = packet.num_points;
+	int i;
+
+	// Work in the mesh's local space
+	double cx = 0, cy = 0, cz = 0;
+	for (i = 0; i < n; i++) {
+		packet.x[i] -= m_offset.x;
+		packet.y[i] -= m_offset.y;
+		packet.z[i] -= m_offset.z;
+		packet.sq_distance[i] = DBL_MAX;
+		packet.bound[i] = DBL_MAX;
+		packet.closest_x[i] = packet.x[i];
+		packet.closest_y[i] = packet.y[i];
+		packet.closest_z[i] = packet.z[i];
+		packet.closest_triangle[i] = -1;
+		cx += packet.x[i]; cy += packet.y[i]; cz += packet.z[i];
+	}
+
+	if (n > 0) { cx /= n; cy /= n; cz /= n; }
+
+	std::vector<int>& stack = packet.stack;
+	stack.clear();
+	for (i = 0; i < (int)(m_roots.size()); i++) stack.push_back(m_roots[i]);
+
+	while (n > 0 && stack.empty() == false) {
+
+		const distance_tree_node& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		// Find the points that this box might still help, tightening each
+		// point's bound with the farthest corner of the box as we go (every
+		// box holds at least one triangle)
+		int num_active = 0;
+
+		for (i = 0; i < n; i++) {
+
+			double p[3] = { packet.x[i], packet.y[i], packet.z[i] };
+			double best_sq = 0, worst_sq = 0;
+
+			for (int k = 0; k < 3; k++) {
+				double below = node.box_min[k] - p[k];
+				double above = p[k] - node.box_max[k];
+				double gap = (below > 0) ? below : ((above > 0) ? above : 0);
+				double farthest = (-below > -above) ? -below : -above;
+				best_sq += gap*gap;
+				worst_sq += farthest*farthest;
+			}
+
+			if (best_sq > packet.bound[i]) continue;
+
+			packet.active[num_active++] = i;
+			if (worst_sq < packet.bound[i]) packet.bound[i] = worst_sq;
+		}
+
+		if (num_active == 0) continue;
+
+		if (node.triangle >= 0) {
+			test_leaf(m_triangles[node.triangle], node.triangle, packet, num_active);
+			continue;
+		}
+
+		// Visit the child that's closer to the middle of the packet first,
+		// so the bounds tighten as early as possible
+		if (node.left < 0 || node.right < 0) {
+			if (node.left >= 0) stack.push_back(node.left);
+			if (node.right >= 0) stack.push_back(node.right);
+			continue;
+		}
+
+		double d[2];
+		int children[2] = { node.left, node.right };
+		for (int c = 0; c < 2; c++) {
+			const distance_tree_node& child = m_nodes[children[c]];
+			double dx = 0.5 * (child.box_min[0] + child.box_max[0]) - cx;
+			double dy = 0.5 * (child.box_min[1] + child.box_max[1]) - cy;
+			double dz = 0.5 * (child.box_min[2] + child.box_max[2]) - cz;
+			d[c] = dx*dx + dy*dy + dz*dz;
+		}
+
+		if (d[0] < d[1]) {
+			stack.push_back(node.right);
+			stack.push_back(node.left);
+		}
+		else {
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+
+	}
+
+	// Back to global space
+	for (i = 0; i < n; i++) {
+		packet.x[i] += m_offset.x;
+		packet.y[i] += m_offset.y;
+		packet.z[i] += m_offset.z;
+		packet.closest_x[i] += m_offset.x;
+		packet.closest_y[i] += m_offset.y;
+		packet.closest_z[i] += m_offset.z;
+	}
+
+}
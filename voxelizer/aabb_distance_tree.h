@@ -0,0 +1,145 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Batched closest-point queries against a mesh.
+
+  aabb_distance_tree copies the AABB trees CHAI builds for a mesh (and all
+  of its cMesh children) into flat arrays, with each triangle stored in the
+  form the distance kernel wants.  Once it's built it's never modified, so
+  any number of threads can query it at once.
+
+  A query is a "packet" of points, typically the voxel centers in one small
+  brick of the voxel grid.  The tree is walked once per packet rather than
+  once per point, pruning any box that can't improve the answer for any
+  point in the packet, and each leaf's triangle is tested against the
+  packet's points two at a time with SSE2.
+
+  All per-query state lives in the distance_packet, so each thread just
+  needs its own packet.
+
+***********/
+
+#ifndef _AABB_DISTANCE_TREE_H_
+#define _AABB_DISTANCE_TREE_H_
+
+#include "CMesh.h"
+#include "CCollisionAABB.h"
+#include <vector>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define AABB_DISTANCE_USE_SSE2
+#endif
+
+// The most points a packet can hold
+#define DISTANCE_PACKET_MAX_POINTS 512
+
+// A node in the flattened tree; leaves have a triangle index, internal
+// nodes have child indices
+struct distance_tree_node {
+	double box_min[3];
+	double box_max[3];
+	int left;
+	int right;
+	int triangle;
+};
+
+// A triangle, precomputed for the point-triangle distance kernel
+struct distance_tree_triangle {
+
+	// Vertices and edges (ab, bc, ca)
+	double a[3], b[3], c[3];
+	double ab[3], bc[3], ca[3];
+
+	// 1 / squared edge lengths (zero for zero-length edges)
+	double inv_ab_sq, inv_bc_sq, inv_ca_sq;
+
+	// Unit normal and its plane offset
+	double n[3];
+	double n_offset;
+
+	// In-plane edge normals, pointing into the triangle, and their offsets;
+	// a point projects inside the triangle iff it's on the positive side of
+	// all three.  Degenerate triangles get offsets that nothing passes.
+	double m[3][3];
+	double m_offset[3];
+};
+
+// One query's worth of points, results, and scratch space
+class distance_packet {
+
+public:
+
+	distance_packet();
+
+	// Empties the packet
+	void clear() { num_points = 0; }
+
+	// Adds a point (in global space), returns its index in the packet
+	int add_point(const cVector3d& p);
+
+	int num_points;
+
+	// Query points
+	std::vector<double> x, y, z;
+
+	// Results: squared distance, closest point (in global space), and the
+	// index of the closest triangle
+	std::vector<double> sq_distance;
+	std::vector<double> closest_x, closest_y, closest_z;
+	std::vector<int> closest_triangle;
+
+	// Scratch space for the traversal
+	std::vector<double> bound;
+	std::vector<int> active;
+	std::vector<int> stack;
+};
+
+class aabb_distance_tree {
+
+public:
+
+	aabb_distance_tree();
+
+	// Flattens the collision trees for [mesh] and its cMesh descendants,
+	// which must already have AABB collision detectors.
+	//
+	// Like the rest of the voxelizer, this assumes children aren't offset
+	// from their parents.
+	void build(cMesh* mesh);
+
+	// Finds the closest point on the mesh to every point in [packet]
+	void query(distance_packet& packet) const;
+
+	inline int num_triangles() const { return (int)(m_triangles.size()); }
+
+	// The CHAI triangle that a triangle index refers to
+	inline cTriangle* source_triangle(int index) const { return m_source_triangles[index]; }
+
+protected:
+
+	int flatten(cCollisionAABBNode* node);
+
+	void test_leaf(const distance_tree_triangle& tri, int triangle_index,
+		distance_packet& packet, int num_active) const;
+
+	// The mesh's position; queries are done in its local space
+	cVector3d m_offset;
+
+	std::vector<distance_tree_node> m_nodes;
+	std::vector<int> m_roots;
+	std::vector<distance_tree_triangle> m_triangles;
+	std::vector<cTriangle*> m_source_triangles;
+
+};
+
+#endif
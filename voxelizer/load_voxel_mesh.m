@@ -3,7 +3,9 @@
 %
 % Written by Chris Sewell and Dan Morris, 2006.
 %
-% Loads a voxel mesh as output by the voxelizer program.
+% Loads a voxel mesh as output by the voxelizer program.  Reads both the
+% original (version 1) and sparse (version 2) .voxels formats; see
+% voxel_file_format.h.
 %
 % filename: the .voxels file you want to read
 %
@@ -33,10 +35,24 @@ fprintf(1,'Loading %s...\n',filename);
 
 header = struct;
 
-header.header_size = fread(fid,1,'int32');
-header.num_objects = fread(fid,1,'int32');
-header.object_header_size = fread(fid,1,'int32');
-header.voxel_struct_size = fread(fid,1,'int32');
+VOXELFILE_MAGIC_V2 = 844648278;
+
+first = fread(fid,1,'int32');
+
+if (first == VOXELFILE_MAGIC_V2)
+  header.version = fread(fid,1,'int32');
+  header.header_size = fread(fid,1,'int32');
+  header.num_objects = fread(fid,1,'int32');
+  header.object_header_size = fread(fid,1,'int32');
+  header.object_header_v2_size = fread(fid,1,'int32');
+  header.chunk_header_size = fread(fid,1,'int32');
+else
+  header.version = 1;
+  header.header_size = first;
+  header.num_objects = fread(fid,1,'int32');
+  header.object_header_size = fread(fid,1,'int32');
+  header.voxel_struct_size = fread(fid,1,'int32');
+end
 
 header.num_voxels = fread(fid,1,'int32');
 header.voxel_resolution = fread(fid,3,'int32');
@@ -51,9 +67,25 @@ null_index = min(find(namestr==0));
 namestr = namestr(1:null_index-1);
 header.texture_filename = char(namestr);
 
-NUM_MODIFIERS = 5;
+if (header.version == 2)
+  header.num_modifiers = fread(fid,1,'int32');
+  header.encoding = fread(fid,1,'int32');
+  header.compression = fread(fid,1,'int32');
+  header.planes_per_chunk = fread(fid,1,'int32');
+  header.num_chunks = fread(fid,1,'int32');
+  NUM_MODIFIERS = header.num_modifiers;
+else
+  NUM_MODIFIERS = 5;
+end
+
 NUM_COLUMNS = 17 + NUM_MODIFIERS*4;
 DATA_ALLOCATION_CHUNK = 100000;
+
+if (header.version == 2)
+  data = read_v2_chunks(fid, header, NUM_COLUMNS);
+  i = size(data,1);
+else
+
 data = zeros(DATA_ALLOCATION_CHUNK,NUM_COLUMNS);
 
 i = 0;
@@ -114,6 +146,8 @@ for (c=1:resolution_product)
   
 end
 
+end % version 1
+
 data = data(1:i,:);
 
 voxels = struct;
@@ -142,3 +176,167 @@ voxels.is_on_border = data(:,16+4*NUM_MODIFIERS+1);
 voxels.index = voxels.i * (header.voxel_resolution(2) * header.voxel_resolution(3)) + voxels.j * header.voxel_resolution(3) + voxels.k;
 
 fclose(fid);
+
+
+% Reads every chunk of a version 2 file into the same columns the version 1
+% reader fills in
+function data = read_v2_chunks(fid, header, NUM_COLUMNS)
+
+NUM_MODIFIERS = header.num_modifiers;
+res = header.voxel_resolution;
+plane_size = res(2)*res(3);
+
+data = zeros(header.num_voxels,NUM_COLUMNS);
+i = 0;
+
+for chunk=1:header.num_chunks
+
+  chunk_header = fread(fid,6,'int32');
+  first_i = chunk_header(1);
+  n = chunk_header(3);
+  num_runs = chunk_header(4);
+  streams = chunk_header(5);
+
+  % Occupancy runs alternate empty and occupied, starting with empty
+  runs = fread(fid,num_runs,'uint32');
+  cells = zeros(n,1);
+  pos = 0;
+  c = 0;
+  for r=2:2:num_runs
+    pos = pos + runs(r-1);
+    cells(c+1:c+runs(r)) = pos:pos+runs(r)-1;
+    c = c + runs(r);
+    pos = pos + runs(r);
+  end
+
+  rows = (i+1:i+n)';
+  if (i+n > size(data,1))
+    data = [data; zeros(i+n-size(data,1),NUM_COLUMNS)];
+  end
+
+  data(rows,1) = first_i + floor(cells/plane_size);
+  data(rows,2) = floor(mod(cells,plane_size)/res(3));
+  data(rows,3) = mod(cells,res(3));
+
+  for s=0:4
+
+    if (bitand(streams,2^s) == 0)
+      continue;
+    end
+
+    flags = double(read_block(fid,header.compression,1,n));
+
+    num_components = [2 3 4 4*NUM_MODIFIERS 0];
+    num_components = num_components(s+1);
+    values = read_values(fid,header,n*num_components);
+    values = reshape(values,n,num_components);
+
+    if (s == 0)
+      data(rows,4) = flags;
+      data(rows,5:6) = values;
+    elseif (s == 1)
+      data(rows,7) = flags;
+      data(rows,8:10) = values;
+    elseif (s == 2)
+      data(rows,11) = flags;
+      data(rows,12) = values(:,1);
+      data(rows,13:15) = values(:,2:4);
+    elseif (s == 3)
+      data(rows,16) = flags;
+      for m=1:NUM_MODIFIERS
+        data(rows,16+m) = values(:,4*(m-1)+1);
+        data(rows,16+NUM_MODIFIERS+3*(m-1)+(1:3)) = values(:,4*(m-1)+(2:4));
+      end
+    else
+      data(rows,16+4*NUM_MODIFIERS+1) = flags;
+    end
+
+  end
+
+  i = i + n;
+
+  if (mod(chunk,max(1,floor(header.num_chunks/10)))==0)
+    fprintf(1, '%.1f%% done...\n', 100.0*chunk/header.num_chunks);
+  end
+
+end
+
+data = data(1:i,:);
+
+
+% Reads one block of a version 2 chunk, num_bytes bytes once decoded
+function bytes = read_block(fid, compression, value_size, num_bytes)
+
+block_size = fread(fid,1,'int32');
+bytes = fread(fid,block_size,'*uint8');
+
+if (num_bytes == 0)
+  bytes = zeros(0,1,'uint8');
+  return;
+end
+
+if (compression == 1)
+  bytes = packbits_decode(bytes,num_bytes);
+  % Undo the byte shuffle
+  bytes = reshape(reshape(bytes,num_bytes/value_size,value_size)',[],1);
+end
+
+
+% Reads a block of float values (stored as 32- or 16-bit floats)
+function values = read_values(fid, header, num_values)
+
+if (header.encoding == 1)
+  bytes = read_block(fid,header.compression,2,num_values*2);
+  if (num_values == 0)
+    values = zeros(0,1);
+    return;
+  end
+  values = half_to_double(double(typecast(bytes,'uint16')));
+else
+  bytes = read_block(fid,header.compression,4,num_values*4);
+  if (num_values == 0)
+    values = zeros(0,1);
+    return;
+  end
+  values = double(typecast(bytes,'single'));
+end
+
+values = values(:);
+
+
+% PackBits: control byte c < 128 is followed by c+1 literal bytes, c > 128
+% by one byte to repeat 257-c times
+function out = packbits_decode(in, num_bytes)
+
+out = zeros(num_bytes,1,'uint8');
+ip = 1;
+op = 1;
+len = length(in);
+
+while (ip <= len)
+  c = double(in(ip));
+  ip = ip + 1;
+  if (c < 128)
+    out(op:op+c) = in(ip:ip+c);
+    ip = ip + c + 1;
+    op = op + c + 1;
+  elseif (c > 128)
+    count = 257 - c;
+    out(op:op+count-1) = in(ip);
+    ip = ip + 1;
+    op = op + count;
+  end
+end
+
+
+function x = half_to_double(h)
+
+negative = bitshift(h,-15);
+e = bitand(bitshift(h,-10),31);
+m = bitand(h,1023);
+
+x = (e == 0) .* (m/1024) * 2^-14 + ...
+    (e > 0 & e < 31) .* (1 + m/1024) .* 2.^(e-15);
+x(e == 31 & m == 0) = Inf;
+x(e == 31 & m > 0) = NaN;
+x = x .* (1 - 2*negative);
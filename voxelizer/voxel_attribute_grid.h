@@ -0,0 +1,178 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Storage for the per-voxel records (voxelfile_voxel's) built during a
+  voxelization.
+
+  Records live in one compact array, in the order they were added, and a
+  dense array with one entry per grid cell maps each voxel's grid index
+  to its record (or to VOXEL_ATTRIBUTE_NONE).  Lookups are O(1) and records
+  can be modified in place, so re-tagging a voxel doesn't cost a
+  find/erase/insert the way a std::set does.
+
+  The dense array costs four bytes per grid cell; everything else scales
+  with the number of records.
+
+  Records can be visited in the order they were added, or - after calling
+  sort_by_index() - in grid index order (i, then j, then k), which is the
+  order the old std::set-based code visited them in.
+
+  Distances to modifier meshes can be stored alongside the records, four
+  floats (distance, then gradient) per modifier per record, for as many
+  modifiers as set_num_modifiers() asks for; voxelfile_voxel only has room
+  for MAX_NUM_MODIFIERS of them.
+
+***********/
+
+#ifndef _VOXEL_ATTRIBUTE_GRID_H_
+#define _VOXEL_ATTRIBUTE_GRID_H_
+
+#include "voxel_file_format.h"
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+#define VOXEL_ATTRIBUTE_NONE 0xffffffff
+
+class voxel_attribute_grid {
+
+public:
+
+	voxel_attribute_grid() {
+		m_resolution[0] = m_resolution[1] = m_resolution[2] = 0;
+		m_num_cells = 0;
+		m_slots = 0;
+		m_num_modifiers = 0;
+	}
+
+	~voxel_attribute_grid() {
+		if (m_slots) delete[] m_slots;
+	}
+
+	// Sets up an empty grid with the given number of voxels along each axis
+	void initialize(const int* voxel_resolution) {
+
+		if (m_slots) delete[] m_slots;
+
+		for (int k = 0; k < 3; k++) m_resolution[k] = voxel_resolution[k];
+		m_num_cells = (unsigned int)(m_resolution[0]) * m_resolution[1] * m_resolution[2];
+		m_slots = new unsigned int[m_num_cells];
+
+		clear();
+	}
+
+	// Throws away all records, keeping the grid dimensions
+	void clear() {
+		if (m_slots) memset(m_slots, 0xff, m_num_cells * sizeof(unsigned int));
+		m_records.clear();
+		m_modifiers.clear();
+	}
+
+	inline bool contains(int i, int j, int k) const {
+		return (i >= 0 && i < m_resolution[0] &&
+			j >= 0 && j < m_resolution[1] &&
+			k >= 0 && k < m_resolution[2]);
+	}
+
+	inline unsigned int cell_index(int i, int j, int k) const {
+		return (unsigned int)(i) * (m_resolution[1] * m_resolution[2]) + j * m_resolution[2] + k;
+	}
+
+	// Returns the record for voxel (i,j,k), or 0 if there isn't one (which
+	// includes voxels that are off the grid)
+	//
+	// The pointer is only good until the next insert().
+	inline voxelfile_voxel* find(int i, int j, int k) {
+		if (contains(i, j, k) == false) return 0;
+		unsigned int slot = m_slots[cell_index(i, j, k)];
+		if (slot == VOXEL_ATTRIBUTE_NONE) return 0;
+		return &(m_records[slot]);
+	}
+
+	// Adds a record for voxel (v.i,v.j,v.k) and returns the stored copy.
+	//
+	// Like std::set::insert, if there's already a record for this voxel, the
+	// existing record wins and is returned unchanged.
+	inline voxelfile_voxel* insert(const voxelfile_voxel& v) {
+		unsigned int index = cell_index(v.i, v.j, v.k);
+		unsigned int slot = m_slots[index];
+		if (slot != VOXEL_ATTRIBUTE_NONE) return &(m_records[slot]);
+		m_slots[index] = (unsigned int)(m_records.size());
+		m_records.push_back(v);
+		if (m_num_modifiers) m_modifiers.resize(m_modifiers.size() + m_num_modifiers * 4, 0.0f);
+		return &(m_records.back());
+	}
+
+	// Number of records
+	inline unsigned int size() const { return (unsigned int)(m_records.size()); }
+
+	// The n'th record
+	inline voxelfile_voxel& operator[](unsigned int n) { return m_records[n]; }
+
+	// Makes room for distances to [num_modifiers] modifier meshes in every
+	// record (zeroing any that are already there)
+	void set_num_modifiers(int num_modifiers) {
+		m_num_modifiers = num_modifiers;
+		m_modifiers.assign(m_records.size() * m_num_modifiers * 4, 0.0f);
+	}
+
+	inline int num_modifiers() const { return m_num_modifiers; }
+
+	// The modifier distances for one record: for each modifier, the distance
+	// and then the gradient.  Returns 0 if there aren't any.
+	inline float* modifiers(const voxelfile_voxel* v) {
+		if (m_num_modifiers == 0) return 0;
+		unsigned int n = (unsigned int)(v - &(m_records[0]));
+		return &(m_modifiers[n * m_num_modifiers * 4]);
+	}
+
+	// Reorders the records by grid index
+	void sort_by_index() {
+
+		std::vector<voxelfile_voxel> sorted;
+		sorted.reserve(m_records.size());
+
+		unsigned int stride = m_num_modifiers * 4;
+		std::vector<float> sorted_modifiers;
+		sorted_modifiers.reserve(m_modifiers.size());
+
+		for (unsigned int index = 0; index < m_num_cells; index++) {
+			unsigned int slot = m_slots[index];
+			if (slot == VOXEL_ATTRIBUTE_NONE) continue;
+			m_slots[index] = (unsigned int)(sorted.size());
+			sorted.push_back(m_records[slot]);
+			if (stride) sorted_modifiers.insert(sorted_modifiers.end(),
+				m_modifiers.begin() + slot * stride, m_modifiers.begin() + (slot + 1) * stride);
+		}
+
+		m_records.swap(sorted);
+		m_modifiers.swap(sorted_modifiers);
+	}
+
+protected:
+
+	int m_resolution[3];
+	unsigned int m_num_cells;
+
+	// One entry per grid cell, indexing m_records
+	unsigned int* m_slots;
+
+	std::vector<voxelfile_voxel> m_records;
+
+	// Modifier distances, m_num_modifiers * 4 floats per record
+	int m_num_modifiers;
+	std::vector<float> m_modifiers;
+
+};
+
+#endif
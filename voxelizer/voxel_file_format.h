@@ -29,6 +29,44 @@
 //
 // When loading a model file that should line up with this voxel file,
 // apply the offset _before_ the scale factor
+//
+// That's version 1 of the format, which is still what the voxelizer writes
+// unless asked for version 2 (VOXEL_FILE_VERSION 2 or -file_version 2).
+// Version 2 files are sparse:
+//
+// The file begins with a voxelfile_file_header_v2, whose first int is
+// VOXELFILE_MAGIC_V2 (a version 1 file starts with sizeof(voxelfile_file_header),
+// so a reader can tell them apart from the first four bytes).
+//
+// Each object is one voxelfile_object_header (the same struct as version 1),
+// then one voxelfile_object_header_v2, then num_chunks chunks.  A chunk covers
+// planes_per_chunk consecutive i-planes (the last one may be thinner), and
+// every chunk is written, even empty ones.  Each chunk is:
+//
+// One voxelfile_chunk_header, followed by payload_size bytes of:
+//
+// num_runs unsigned ints: run lengths over the chunk's cells in grid index
+// order (i, then j, then k), alternating empty and occupied, starting with
+// an empty run (which may be zero-length).  Each occupied cell is a voxel
+// that version 1 would have written as ASCIIVOXEL_TEXTURED_VOXEL.
+//
+// Then one stream for each VOXELFILE_STREAM_* bit set in the chunk header,
+// in bit order.  A stream is present only if some voxel in the chunk has
+// that attribute.  Each stream is two blocks:
+//
+//   flags: one byte per occupied voxel (has_texture, has_normal,
+//          has_distance, num_modifiers, or is_on_border)
+//   values: the stream's float components, one array per component (e.g.
+//           all the u's, then all the v's), stored as VOXELFILE_ENCODING_*;
+//           empty for VOXELFILE_STREAM_BORDER
+//
+// Each block is an int (its size in bytes on disk) followed by its bytes.
+// With VOXELFILE_COMPRESSION_PACKBITS, a block's bytes are shuffled into
+// byte planes (byte 0 of every value, then byte 1, etc.) and then
+// PackBits-encoded; with VOXELFILE_COMPRESSION_NONE they're stored as-is.
+//
+// voxel_file_io.h has a writer for this format and a reader for both;
+// voxel_file_reader.h has random access to either.
 
 #ifndef _VOXEL_FILE_FORMAT_H_
 #define _VOXEL_FILE_FORMAT_H_
@@ -42,8 +80,30 @@
 // Voxel to be followed by more information
 #define ASCIIVOXEL_TEXTURED_VOXEL '2'
 
+// The number of modifiers a voxelfile_voxel (and so a version 1 file) has
+// room for.  The voxelizer handles any number of modifiers (up to 255), and
+// version 2 files store them all.
 #define MAX_NUM_MODIFIERS 5
 
+// The first int of a version 2 file ("VOX2")
+#define VOXELFILE_MAGIC_V2 0x32584f56
+
+// How a version 2 file stores float attributes
+#define VOXELFILE_ENCODING_FLOAT32 0
+#define VOXELFILE_ENCODING_FLOAT16 1
+
+// How a version 2 file compresses its attribute blocks
+#define VOXELFILE_COMPRESSION_NONE     0
+#define VOXELFILE_COMPRESSION_PACKBITS 1
+
+// Attribute streams in a version 2 chunk, and the float components of each
+#define VOXELFILE_STREAM_TEXTURE   (1<<0)   // u, v
+#define VOXELFILE_STREAM_NORMAL    (1<<1)   // normal[3]
+#define VOXELFILE_STREAM_DISTANCE  (1<<2)   // distance, gradient[3]
+#define VOXELFILE_STREAM_MODIFIERS (1<<3)   // distance, gradient[3] per modifier
+#define VOXELFILE_STREAM_BORDER    (1<<4)   // (flags only)
+#define VOXELFILE_NUM_STREAMS 5
+
 #pragma pack(push)
 #pragma pack(1)
 
@@ -108,6 +168,71 @@ struct voxelfile_object_header {
 };
 
 
+struct voxelfile_file_header_v2 {
+
+	// VOXELFILE_MAGIC_V2
+	int magic;
+
+	// 2
+	int version;
+
+	// Size of this structure
+	int header_size;
+
+	// Number of objects in this file
+	int num_objects;
+
+	// Sizes of the object headers and the chunk header
+	int object_header_size;
+	int object_header_v2_size;
+	int chunk_header_size;
+
+};
+
+// Follows the voxelfile_object_header in a version 2 file
+struct voxelfile_object_header_v2 {
+
+	// Number of modifier meshes each voxel has distances to
+	int num_modifiers;
+
+	// VOXELFILE_ENCODING_* and VOXELFILE_COMPRESSION_*
+	int encoding;
+	int compression;
+
+	// Number of i-planes in each chunk, and the number of chunks
+	int planes_per_chunk;
+	int num_chunks;
+
+	voxelfile_object_header_v2() {
+		num_modifiers = 0;
+		encoding = VOXELFILE_ENCODING_FLOAT32;
+		compression = VOXELFILE_COMPRESSION_NONE;
+		planes_per_chunk = 0;
+		num_chunks = 0;
+	}
+
+};
+
+struct voxelfile_chunk_header {
+
+	// The first i-plane in this chunk, and the number of planes
+	int first_i;
+	int num_planes;
+
+	// Number of occupied voxels in this chunk
+	int num_voxels;
+
+	// Number of occupancy runs
+	int num_runs;
+
+	// VOXELFILE_STREAM_* bits for the streams that follow the runs
+	int streams;
+
+	// Size of everything after this header, up to the next chunk
+	int payload_size;
+
+};
+
 struct voxelfile_voxel {
 
 	// Location of this voxel
@@ -137,7 +262,9 @@ struct voxelfile_voxel {
 	// closest point on the surface
 	float distance_gradient[3];
 
-	// Set to 0 if the 'modifier distance' fields are not meaningful
+	// Set to 0 if the 'modifier distance' fields are not meaningful;
+	// otherwise the number of modifiers this voxel has distances to, which
+	// can be more than MAX_NUM_MODIFIERS when read from a version 2 file
 	unsigned char num_modifiers;
 
 	// The distance and vector to the mesh that was selected as a
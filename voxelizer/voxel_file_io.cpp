@@ -0,0 +1,667 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "stdafx.h"
+#include "voxel_file_io.h"
+#include <conio.h>
+#include <stddef.h>
+
+// How much of a chunk's payload read_v2 reads at a time
+#define VOXELFILE_READ_PIECE_SIZE (16*1024*1024)
+
+// Number of float components in a stream's value block
+static int stream_components(int stream, int num_modifiers) {
+	if (stream == VOXELFILE_STREAM_TEXTURE) return 2;
+	if (stream == VOXELFILE_STREAM_NORMAL) return 3;
+	if (stream == VOXELFILE_STREAM_DISTANCE) return 4;
+	if (stream == VOXELFILE_STREAM_MODIFIERS) return 4 * num_modifiers;
+	return 0;
+}
+
+// The voxel field a stream's flag byte comes from
+static unsigned char* stream_flag(voxelfile_voxel& v, int stream) {
+	if (stream == VOXELFILE_STREAM_TEXTURE) return &v.has_texture;
+	if (stream == VOXELFILE_STREAM_NORMAL) return &v.has_normal;
+	if (stream == VOXELFILE_STREAM_DISTANCE) return &v.has_distance;
+	if (stream == VOXELFILE_STREAM_MODIFIERS) return &v.num_modifiers;
+	return &v.is_on_border;
+}
+
+// The voxel field one of a stream's components comes from, or 0 if the
+// voxel struct has no room for it (modifiers past MAX_NUM_MODIFIERS).
+//
+// voxelfile_voxel is packed, so the field may not be aligned for a float;
+// copy in and out of it with memcpy.
+static unsigned char* stream_value(voxelfile_voxel& v, int stream, int component) {
+	size_t offset;
+	if (stream == VOXELFILE_STREAM_TEXTURE)
+		offset = (component == 0) ? offsetof(voxelfile_voxel, u) : offsetof(voxelfile_voxel, v);
+	else if (stream == VOXELFILE_STREAM_NORMAL)
+		offset = offsetof(voxelfile_voxel, normal) + component * sizeof(float);
+	else if (stream == VOXELFILE_STREAM_DISTANCE) {
+		if (component == 0) offset = offsetof(voxelfile_voxel, distance_to_surface);
+		else offset = offsetof(voxelfile_voxel, distance_gradient) + (component - 1) * sizeof(float);
+	}
+	else if (stream == VOXELFILE_STREAM_MODIFIERS) {
+		int modifier = component / 4;
+		if (modifier >= MAX_NUM_MODIFIERS) return 0;
+		if (component % 4 == 0)
+			offset = offsetof(voxelfile_voxel, distance_to_modifier) + modifier * sizeof(float);
+		else
+			offset = offsetof(voxelfile_voxel, modifier_gradient) +
+				(modifier * 3 + component % 4 - 1) * sizeof(float);
+	}
+	else return 0;
+	return (unsigned char*)(&v) + offset;
+}
+
+void voxelfile_packbits_encode(const unsigned char* data, unsigned int size,
+	std::vector<unsigned char>& out) {
+
+	out.clear();
+
+	unsigned int pos = 0;
+	while (pos < size) {
+
+		// How long is the run starting here?
+		unsigned int run = 1;
+		while (pos + run < size && run < 128 && data[pos + run] == data[pos]) run++;
+
+		if (run >= 3) {
+			out.push_back((unsigned char)(1 - (int)(run)));
+			out.push_back(data[pos]);
+			pos += run;
+			continue;
+		}
+
+		// Otherwise take literals up to the next run of three
+		unsigned int literal_start = pos;
+		while (pos < size && pos - literal_start < 128) {
+			if (pos + 2 < size && data[pos] == data[pos + 1] && data[pos] == data[pos + 2]) break;
+			pos++;
+		}
+
+		unsigned int num_literals = pos - literal_start;
+		out.push_back((unsigned char)(num_literals - 1));
+		out.insert(out.end(), data + literal_start, data + pos);
+	}
+
+}
+
+bool voxelfile_packbits_decode(const unsigned char* data, unsigned int encoded_size,
+	unsigned char* out, unsigned int size) {
+
+	unsigned int in_pos = 0;
+	unsigned int out_pos = 0;
+
+	while (in_pos < encoded_size) {
+
+		int c = (signed char)(data[in_pos++]);
+
+		if (c >= 0) {
+			unsigned int count = c + 1;
+			if (in_pos + count > encoded_size || out_pos + count > size) return false;
+			memcpy(out + out_pos, data + in_pos, count);
+			in_pos += count;
+			out_pos += count;
+		}
+
+		else if (c != -128) {
+			unsigned int count = 1 - c;
+			if (in_pos >= encoded_size || out_pos + count > size) return false;
+			memset(out + out_pos, data[in_pos++], count);
+			out_pos += count;
+		}
+
+	}
+
+	return (out_pos == size);
+}
+
+// Reads one block from a chunk payload into [out] ([size] bytes once
+// decoded), advancing [pos]
+static bool read_block(const unsigned char* payload, unsigned int payload_size, unsigned int& pos,
+	int compression, int value_size, unsigned int size, std::vector<unsigned char>& out,
+	std::vector<unsigned char>& scratch) {
+
+	int block_size;
+	if (sizeof(block_size) > payload_size - pos) return false;
+	memcpy(&block_size, payload + pos, sizeof(block_size));
+	pos += sizeof(block_size);
+	if (block_size < 0 || (unsigned int)(block_size) > payload_size - pos) return false;
+
+	// Check the decoded size against the block before allocating for it;
+	// PackBits turns two bytes into at most 128
+	if (compression == VOXELFILE_COMPRESSION_NONE) {
+		if ((unsigned int)(block_size) != size) return false;
+	}
+	else if ((unsigned long long)(block_size) * 64 < size) return false;
+
+	out.resize(size);
+
+	if (compression == VOXELFILE_COMPRESSION_NONE) {
+		if (size) memcpy(&(out[0]), payload + pos, size);
+	}
+
+	else {
+
+		scratch.resize(size);
+		if (size && !voxelfile_packbits_decode(payload + pos, block_size, &(scratch[0]), size))
+			return false;
+
+		// Undo the byte shuffle
+		unsigned int num_values = size / value_size;
+		for (int b = 0; b < value_size; b++)
+			for (unsigned int n = 0; n < num_values; n++)
+				out[n * value_size + b] = scratch[b * num_values + n];
+	}
+
+	pos += block_size;
+	return true;
+}
+
+bool voxelfile_decode_chunk(const voxelfile_chunk_header& chunk_hdr,
+	const unsigned char* payload, const voxelfile_object_header& object_hdr,
+	const voxelfile_object_header_v2& object_hdr_v2, std::vector<voxelfile_voxel>& voxels,
+	std::vector<float>* modifiers) {
+
+	const int* res = object_hdr.voxel_resolution;
+
+	// Everything below is sized from these headers, so make sure a corrupt
+	// file can't overflow any of that arithmetic: voxel indices are shorts,
+	// so no grid is more than 32768 on a side, and num_modifiers is stored
+	// in an unsigned char
+	for (int k = 0; k < 3; k++) if (res[k] <= 0 || res[k] > 32768) return false;
+	if (object_hdr_v2.num_modifiers < 0 || object_hdr_v2.num_modifiers > 255) return false;
+	if (chunk_hdr.payload_size < 0) return false;
+	if (chunk_hdr.first_i < 0 || chunk_hdr.num_planes < 0 || chunk_hdr.num_planes > res[0] - chunk_hdr.first_i)
+		return false;
+
+	unsigned int payload_size = chunk_hdr.payload_size;
+	unsigned int pos = 0;
+
+	int plane_size = res[1] * res[2];
+	int row_size = res[2];
+
+	unsigned long long chunk_cells = (unsigned long long)(chunk_hdr.num_planes) * plane_size;
+	if (chunk_cells > 0xffffffffULL) return false;
+	unsigned int num_cells = (unsigned int)(chunk_cells);
+
+	if (chunk_hdr.num_voxels < 0 || (unsigned int)(chunk_hdr.num_voxels) > num_cells) return false;
+
+	if (chunk_hdr.num_runs < 0 || (unsigned int)(chunk_hdr.num_runs) > payload_size / sizeof(unsigned int))
+		return false;
+
+	size_t first_voxel = voxels.size();
+	size_t total_voxels = first_voxel + chunk_hdr.num_voxels;
+	if (total_voxels > 0xffffffffULL) return false;
+	voxels.resize(total_voxels);
+
+	// Every modifier for every voxel, four floats each
+	unsigned int modifier_stride = object_hdr_v2.num_modifiers * 4;
+	float* all_modifiers = 0;
+	if (modifiers) {
+		if ((unsigned long long)(total_voxels) * modifier_stride > modifiers->max_size()) return false;
+		modifiers->resize(total_voxels * modifier_stride, 0.0f);
+		if (modifier_stride && chunk_hdr.num_voxels) all_modifiers = &((*modifiers)[first_voxel * modifier_stride]);
+	}
+
+	// Walk the runs to place the voxels
+	unsigned int cell = 0;
+	unsigned int n = (unsigned int)(first_voxel);
+	for (int r = 0; r < chunk_hdr.num_runs; r++) {
+
+		unsigned int run;
+		memcpy(&run, payload + pos, sizeof(run));
+		pos += sizeof(run);
+
+		if (run > num_cells - cell) return false;
+
+		if (r % 2 == 1) {
+			if (run > voxels.size() - n) return false;
+			for (unsigned int c = cell; c < cell + run; c++) {
+				voxels[n++].initialize(chunk_hdr.first_i + c / plane_size,
+					(c % plane_size) / row_size, c % row_size);
+			}
+		}
+
+		cell += run;
+	}
+	if (n != voxels.size()) return false;
+
+	unsigned int num_voxels = chunk_hdr.num_voxels;
+	int value_size = (object_hdr_v2.encoding == VOXELFILE_ENCODING_FLOAT16) ? 2 : 4;
+
+	std::vector<unsigned char> block, scratch;
+
+	for (int s = 0; s < VOXELFILE_NUM_STREAMS; s++) {
+
+		int stream = 1 << s;
+		if ((chunk_hdr.streams & stream) == 0) continue;
+
+		if (!read_block(payload, payload_size, pos, object_hdr_v2.compression, 1, num_voxels, block, scratch))
+			return false;
+
+		for (n = 0; n < num_voxels; n++)
+			*stream_flag(voxels[first_voxel + n], stream) = block[n];
+
+		int num_components = stream_components(stream, object_hdr_v2.num_modifiers);
+		unsigned long long values_size = (unsigned long long)(num_voxels) * num_components * value_size;
+		if (values_size > 0xffffffffULL) return false;
+		if (!read_block(payload, payload_size, pos, object_hdr_v2.compression, value_size,
+			(unsigned int)(values_size), block, scratch))
+			return false;
+
+		for (int c = 0; c < num_components; c++) {
+			for (n = 0; n < num_voxels; n++) {
+
+				const unsigned char* src = &(block[0]) + (c * num_voxels + n) * value_size;
+				float f;
+				if (value_size == 2) {
+					unsigned short h;
+					memcpy(&h, src, sizeof(h));
+					f = voxelfile_half_to_float(h);
+				}
+				else memcpy(&f, src, sizeof(float));
+
+				unsigned char* value = stream_value(voxels[first_voxel + n], stream, c);
+				if (value) memcpy(value, &f, sizeof(f));
+				if (all_modifiers && stream == VOXELFILE_STREAM_MODIFIERS)
+					all_modifiers[n * modifier_stride + c] = f;
+			}
+		}
+
+	}
+
+	return true;
+}
+
+// Reads a version 1 file, after the first int of its header
+static int read_v1(FILE* f, voxelfile_object_header& object_hdr,
+	voxelfile_object_header_v2& object_hdr_v2, std::vector<voxelfile_voxel>& voxels,
+	std::vector<float>* modifiers) {
+
+	voxelfile_file_header file_hdr;
+	file_hdr.header_size = sizeof(file_hdr);
+	if (fread(&file_hdr.num_objects, sizeof(file_hdr) - sizeof(int), 1, f) != 1) return 0;
+
+	if (file_hdr.object_header_size != sizeof(voxelfile_object_header) ||
+		file_hdr.voxel_struct_size != sizeof(voxelfile_voxel)) {
+		_cprintf("Unexpected structure sizes in voxel file\n");
+		return 0;
+	}
+
+	if (fread(&object_hdr, sizeof(object_hdr), 1, f) != 1) return 0;
+
+	object_hdr_v2 = voxelfile_object_header_v2();
+	object_hdr_v2.num_modifiers = MAX_NUM_MODIFIERS;
+
+	unsigned int num_cells = (unsigned int)(object_hdr.voxel_resolution[0]) *
+		object_hdr.voxel_resolution[1] * object_hdr.voxel_resolution[2];
+
+	for (unsigned int c = 0; c < num_cells; c++) {
+
+		int mark = fgetc(f);
+		if (mark == EOF) return 0;
+
+		if (mark == ASCIIVOXEL_TEXTURED_VOXEL) {
+			voxelfile_voxel v;
+			if (fread(&v, sizeof(v), 1, f) != 1) return 0;
+			voxels.push_back(v);
+			if (modifiers) {
+				for (int m = 0; m < MAX_NUM_MODIFIERS; m++) {
+					modifiers->push_back(v.distance_to_modifier[m]);
+					modifiers->insert(modifiers->end(), v.modifier_gradient[m], v.modifier_gradient[m] + 3);
+				}
+			}
+		}
+	}
+
+	return 1;
+}
+
+// Reads a version 2 file, after the first int of its header
+static int read_v2(FILE* f, voxelfile_object_header& object_hdr,
+	voxelfile_object_header_v2& object_hdr_v2, std::vector<voxelfile_voxel>& voxels,
+	std::vector<float>* modifiers) {
+
+	voxelfile_file_header_v2 file_hdr;
+	file_hdr.magic = VOXELFILE_MAGIC_V2;
+	if (fread(&file_hdr.version, sizeof(file_hdr) - sizeof(int), 1, f) != 1) return 0;
+
+	if (file_hdr.version != 2 ||
+		file_hdr.object_header_size != sizeof(voxelfile_object_header) ||
+		file_hdr.object_header_v2_size != sizeof(voxelfile_object_header_v2) ||
+		file_hdr.chunk_header_size != sizeof(voxelfile_chunk_header)) {
+		_cprintf("Unexpected version or structure sizes in voxel file\n");
+		return 0;
+	}
+
+	if (fread(&object_hdr, sizeof(object_hdr), 1, f) != 1) return 0;
+	if (fread(&object_hdr_v2, sizeof(object_hdr_v2), 1, f) != 1) return 0;
+
+	std::vector<unsigned char> payload;
+
+	for (int chunk = 0; chunk < object_hdr_v2.num_chunks; chunk++) {
+
+		voxelfile_chunk_header chunk_hdr;
+		if (fread(&chunk_hdr, sizeof(chunk_hdr), 1, f) != 1) return 0;
+		if (chunk_hdr.payload_size < 0) return 0;
+
+		// Read the payload a piece at a time, so a corrupt size runs into the
+		// end of the file before we've allocated much more than the file holds
+		unsigned int payload_size = chunk_hdr.payload_size;
+		unsigned int payload_read = 0;
+		payload.resize(1);
+		while (payload_read < payload_size) {
+			unsigned int piece = payload_size - payload_read;
+			if (piece > VOXELFILE_READ_PIECE_SIZE) piece = VOXELFILE_READ_PIECE_SIZE;
+			payload.resize((size_t)(payload_read) + piece + 1);
+			if (fread(&(payload[payload_read]), piece, 1, f) != 1) return 0;
+			payload_read += piece;
+		}
+
+		if (!voxelfile_decode_chunk(chunk_hdr, &(payload[0]), object_hdr, object_hdr_v2, voxels, modifiers)) {
+			_cprintf("Chunk %d of the voxel file is malformed\n", chunk);
+			return 0;
+		}
+	}
+
+	return 2;
+}
+
+int voxelfile_read(const char* filename, voxelfile_object_header& object_hdr,
+	voxelfile_object_header_v2& object_hdr_v2, std::vector<voxelfile_voxel>& voxels,
+	std::vector<float>* modifiers) {
+
+	voxels.clear();
+	if (modifiers) modifiers->clear();
+
+	FILE* f = fopen(filename, "rb");
+	if (f == 0) {
+		_cprintf("Could not open voxel file %s\n", filename);
+		return 0;
+	}
+
+	int first;
+	int version = 0;
+
+	if (fread(&first, sizeof(first), 1, f) == 1) {
+		if (first == VOXELFILE_MAGIC_V2) version = read_v2(f, object_hdr, object_hdr_v2, voxels, modifiers);
+		else if (first == sizeof(voxelfile_file_header)) version = read_v1(f, object_hdr, object_hdr_v2, voxels, modifiers);
+		else _cprintf("%s is not a voxel file\n", filename);
+	}
+
+	if (version == 0) {
+		_cprintf("Error reading voxel file %s\n", filename);
+		voxels.clear();
+		if (modifiers) modifiers->clear();
+	}
+
+	fclose(f);
+	return version;
+}
+
+voxelfile_writer::voxelfile_writer() {
+	m_file = 0;
+	m_current_chunk = 0;
+	m_last_index = 0;
+	m_have_last_index = false;
+	m_num_voxels_written = 0;
+	m_bytes_written = 0;
+}
+
+voxelfile_writer::~voxelfile_writer() {
+	if (m_file) close();
+}
+
+bool voxelfile_writer::open(const char* filename, const voxelfile_object_header& object_hdr,
+	int num_modifiers, int encoding, int compression, int planes_per_chunk) {
+
+	if (m_file) close();
+
+	if (planes_per_chunk < 1) planes_per_chunk = VOXELFILE_DEFAULT_PLANES_PER_CHUNK;
+
+	m_file = fopen(filename, "wb");
+	if (m_file == 0) {
+		_cprintf("Could not open binary output file %s\n", filename);
+		return false;
+	}
+
+	m_object_hdr = object_hdr;
+	m_object_hdr_v2.num_modifiers = num_modifiers;
+	m_object_hdr_v2.encoding = encoding;
+	m_object_hdr_v2.compression = compression;
+	m_object_hdr_v2.planes_per_chunk = planes_per_chunk;
+	m_object_hdr_v2.num_chunks =
+		(object_hdr.voxel_resolution[0] + planes_per_chunk - 1) / planes_per_chunk;
+
+	voxelfile_file_header_v2 file_hdr;
+	file_hdr.magic = VOXELFILE_MAGIC_V2;
+	file_hdr.version = 2;
+	file_hdr.header_size = sizeof(file_hdr);
+	file_hdr.num_objects = 1;
+	file_hdr.object_header_size = sizeof(voxelfile_object_header);
+	file_hdr.object_header_v2_size = sizeof(voxelfile_object_header_v2);
+	file_hdr.chunk_header_size = sizeof(voxelfile_chunk_header);
+
+	fwrite(&file_hdr, sizeof(file_hdr), 1, m_file);
+	fwrite(&m_object_hdr, sizeof(m_object_hdr), 1, m_file);
+	fwrite(&m_object_hdr_v2, sizeof(m_object_hdr_v2), 1, m_file);
+	m_bytes_written = sizeof(file_hdr) + sizeof(m_object_hdr) + sizeof(m_object_hdr_v2);
+
+	m_current_chunk = 0;
+	m_have_last_index = false;
+	m_num_voxels_written = 0;
+	m_chunk_voxels.clear();
+
+	return true;
+}
+
+bool voxelfile_writer::add_voxel(const voxelfile_voxel& v, const float* modifiers) {
+
+	if (m_file == 0) return false;
+
+	const int* res = m_object_hdr.voxel_resolution;
+	if (v.i < 0 || v.i >= res[0] || v.j < 0 || v.j >= res[1] || v.k < 0 || v.k >= res[2]) {
+		_cprintf("Voxel %d,%d,%d is outside the grid\n", v.i, v.j, v.k);
+		return false;
+	}
+
+	unsigned int index = (unsigned int)(v.i) * (res[1] * res[2]) + v.j * res[2] + v.k;
+	if (m_have_last_index && index <= m_last_index) {
+		_cprintf("Voxel %d,%d,%d is out of order\n", v.i, v.j, v.k);
+		return false;
+	}
+	m_last_index = index;
+	m_have_last_index = true;
+
+	int chunk = v.i / m_object_hdr_v2.planes_per_chunk;
+	while (m_current_chunk < chunk) {
+		if (!write_chunk()) return false;
+	}
+
+	m_chunk_voxels.push_back(v);
+
+	// Keep every modifier's distance, from [modifiers] if we have it, or
+	// from the voxel itself if not
+	int num_modifiers = m_object_hdr_v2.num_modifiers;
+	for (int m = 0; m < num_modifiers; m++) {
+		if (modifiers) m_chunk_modifiers.insert(m_chunk_modifiers.end(), modifiers + m * 4, modifiers + m * 4 + 4);
+		else if (m < MAX_NUM_MODIFIERS) {
+			// Copy out of the packed voxel rather than pointing into it
+			float values[4];
+			memcpy(values, (const unsigned char*)(&v) + offsetof(voxelfile_voxel, distance_to_modifier) +
+				m * sizeof(float), sizeof(float));
+			memcpy(values + 1, (const unsigned char*)(&v) + offsetof(voxelfile_voxel, modifier_gradient) +
+				m * 3 * sizeof(float), 3 * sizeof(float));
+			m_chunk_modifiers.insert(m_chunk_modifiers.end(), values, values + 4);
+		}
+		else m_chunk_modifiers.insert(m_chunk_modifiers.end(), 4, 0.0f);
+	}
+
+	return true;
+}
+
+bool voxelfile_writer::close() {
+
+	if (m_file == 0) return false;
+
+	bool ok = true;
+	while (m_current_chunk < m_object_hdr_v2.num_chunks) {
+		if (!write_chunk()) {
+			ok = false;
+			break;
+		}
+	}
+
+	if (fclose(m_file) != 0) ok = false;
+	m_file = 0;
+
+	m_chunk_voxels.clear();
+	m_chunk_modifiers.clear();
+	m_payload.clear();
+
+	return ok;
+}
+
+void voxelfile_writer::append_block(const unsigned char* data, unsigned int size, int value_size) {
+
+	const unsigned char* out = data;
+	int out_size = size;
+
+	if (m_object_hdr_v2.compression == VOXELFILE_COMPRESSION_PACKBITS) {
+
+		// Byte planes compress much better than interleaved floats
+		m_shuffled.resize(size);
+		unsigned int num_values = size / value_size;
+		for (int b = 0; b < value_size; b++)
+			for (unsigned int n = 0; n < num_values; n++)
+				m_shuffled[b * num_values + n] = data[n * value_size + b];
+
+		if (size) voxelfile_packbits_encode(&(m_shuffled[0]), size, m_packed);
+		else m_packed.clear();
+
+		out_size = (int)(m_packed.size());
+		out = out_size ? &(m_packed[0]) : 0;
+	}
+
+	const unsigned char* size_bytes = (const unsigned char*)(&out_size);
+	m_payload.insert(m_payload.end(), size_bytes, size_bytes + sizeof(out_size));
+	if (out_size) m_payload.insert(m_payload.end(), out, out + out_size);
+}
+
+void voxelfile_writer::append_flags(int stream) {
+
+	unsigned int num_voxels = (unsigned int)(m_chunk_voxels.size());
+	m_block.resize(num_voxels);
+	for (unsigned int n = 0; n < num_voxels; n++)
+		m_block[n] = *stream_flag(m_chunk_voxels[n], stream);
+
+	append_block(num_voxels ? &(m_block[0]) : 0, num_voxels, 1);
+}
+
+void voxelfile_writer::append_values(int stream) {
+
+	unsigned int num_voxels = (unsigned int)(m_chunk_voxels.size());
+	int num_components = stream_components(stream, m_object_hdr_v2.num_modifiers);
+	int value_size = (m_object_hdr_v2.encoding == VOXELFILE_ENCODING_FLOAT16) ? 2 : 4;
+
+	m_block.resize(num_voxels * num_components * value_size);
+
+	for (int c = 0; c < num_components; c++) {
+		for (unsigned int n = 0; n < num_voxels; n++) {
+
+			float f;
+			if (stream == VOXELFILE_STREAM_MODIFIERS) f = m_chunk_modifiers[n * num_components + c];
+			else memcpy(&f, stream_value(m_chunk_voxels[n], stream, c), sizeof(f));
+
+			unsigned char* dest = &(m_block[0]) + (c * num_voxels + n) * value_size;
+			if (value_size == 2) {
+				unsigned short h = voxelfile_float_to_half(f);
+				memcpy(dest, &h, sizeof(h));
+			}
+			else memcpy(dest, &f, sizeof(f));
+		}
+	}
+
+	append_block(m_block.size() ? &(m_block[0]) : 0, (unsigned int)(m_block.size()), value_size);
+}
+
+bool voxelfile_writer::write_chunk() {
+
+	const int* res = m_object_hdr.voxel_resolution;
+	int planes_per_chunk = m_object_hdr_v2.planes_per_chunk;
+
+	voxelfile_chunk_header chunk_hdr;
+	chunk_hdr.first_i = m_current_chunk * planes_per_chunk;
+	chunk_hdr.num_planes = res[0] - chunk_hdr.first_i;
+	if (chunk_hdr.num_planes > planes_per_chunk) chunk_hdr.num_planes = planes_per_chunk;
+	chunk_hdr.num_voxels = (int)(m_chunk_voxels.size());
+
+	m_payload.clear();
+
+	// Occupancy runs
+	std::vector<unsigned int> runs;
+	unsigned int next_cell = 0;
+	unsigned int n;
+	for (n = 0; n < m_chunk_voxels.size(); n++) {
+		const voxelfile_voxel& v = m_chunk_voxels[n];
+		unsigned int cell = (unsigned int)(v.i - chunk_hdr.first_i) * (res[1] * res[2]) + v.j * res[2] + v.k;
+		if (runs.size() > 0 && cell == next_cell) runs.back()++;
+		else {
+			runs.push_back(cell - next_cell);
+			runs.push_back(1);
+		}
+		next_cell = cell + 1;
+	}
+	chunk_hdr.num_runs = (int)(runs.size());
+	if (runs.size()) {
+		const unsigned char* run_bytes = (const unsigned char*)(&(runs[0]));
+		m_payload.insert(m_payload.end(), run_bytes, run_bytes + runs.size() * sizeof(unsigned int));
+	}
+
+	// Which streams does this chunk need?
+	chunk_hdr.streams = 0;
+	for (n = 0; n < m_chunk_voxels.size(); n++) {
+		voxelfile_voxel& v = m_chunk_voxels[n];
+		if (v.has_texture) chunk_hdr.streams |= VOXELFILE_STREAM_TEXTURE;
+		if (v.has_normal) chunk_hdr.streams |= VOXELFILE_STREAM_NORMAL;
+		if (v.has_distance) chunk_hdr.streams |= VOXELFILE_STREAM_DISTANCE;
+		if (v.num_modifiers && m_object_hdr_v2.num_modifiers) chunk_hdr.streams |= VOXELFILE_STREAM_MODIFIERS;
+		if (v.is_on_border) chunk_hdr.streams |= VOXELFILE_STREAM_BORDER;
+	}
+
+	for (int s = 0; s < VOXELFILE_NUM_STREAMS; s++) {
+		int stream = 1 << s;
+		if ((chunk_hdr.streams & stream) == 0) continue;
+		append_flags(stream);
+		append_values(stream);
+	}
+
+	chunk_hdr.payload_size = (int)(m_payload.size());
+
+	size_t written = fwrite(&chunk_hdr, sizeof(chunk_hdr), 1, m_file);
+	if (m_payload.size()) written += fwrite(&(m_payload[0]), m_payload.size(), 1, m_file);
+	if (written != (m_payload.size() ? 2u : 1u)) {
+		_cprintf("Error writing chunk %d of the voxel file\n", m_current_chunk);
+		return false;
+	}
+
+	m_bytes_written += sizeof(chunk_hdr) + m_payload.size();
+	m_num_voxels_written += chunk_hdr.num_voxels;
+
+	m_chunk_voxels.clear();
+	m_chunk_modifiers.clear();
+	m_current_chunk++;
+
+	return true;
+}
@@ -0,0 +1,201 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Reading and writing .voxels files (see voxel_file_format.h for the
+  layout).
+
+  voxelfile_writer writes version 2 files as a stream: voxels go in one at a
+  time in grid index order, and each chunk is encoded and written as soon as
+  the voxels move past it, so only one chunk's worth of voxels is ever held
+  in memory.
+
+  voxelfile_read() reads a whole file of either version into memory;
+  voxelfile_reader (voxel_file_reader.h) reads individual voxels from files
+  too big for that.
+
+***********/
+
+#ifndef _VOXEL_FILE_IO_H_
+#define _VOXEL_FILE_IO_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "voxel_file_format.h"
+
+// The default chunk thickness, in i-planes
+#define VOXELFILE_DEFAULT_PLANES_PER_CHUNK 4
+
+// IEEE half-precision conversions (round-to-nearest-even)
+inline unsigned short voxelfile_float_to_half(float f) {
+
+	unsigned int x;
+	memcpy(&x, &f, sizeof(x));
+
+	unsigned int sign = (x >> 16) & 0x8000;
+	int exponent = (int)((x >> 23) & 0xff);
+	unsigned int mantissa = x & 0x7fffff;
+
+	// Inf and NaN
+	if (exponent == 255) return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+	int half_exponent = exponent - 127 + 15;
+
+	// Too big; goes to inf
+	if (half_exponent >= 31) return (unsigned short)(sign | 0x7c00);
+
+	// Denormal (or too small, goes to zero)
+	if (half_exponent <= 0) {
+		if (half_exponent < -10) return (unsigned short)(sign);
+		mantissa |= 0x800000;
+		int shift = 14 - half_exponent;
+		unsigned int h = mantissa >> shift;
+		unsigned int remainder = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (h & 1))) h++;
+		return (unsigned short)(sign | h);
+	}
+
+	// Rounding may carry into the exponent, which is what we want
+	unsigned int h = sign | (half_exponent << 10) | (mantissa >> 13);
+	unsigned int remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (h & 1))) h++;
+	return (unsigned short)(h);
+}
+
+inline float voxelfile_half_to_float(unsigned short h) {
+
+	unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+	int exponent = (h >> 10) & 0x1f;
+	unsigned int mantissa = h & 0x3ff;
+	unsigned int x;
+
+	if (exponent == 0) {
+		if (mantissa == 0) x = sign;
+		else {
+			// Denormal; normalize it
+			exponent = 1;
+			while ((mantissa & 0x400) == 0) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			mantissa &= 0x3ff;
+			x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+	}
+	else if (exponent == 31) x = sign | 0x7f800000 | (mantissa << 13);
+	else x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+	float f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+// PackBits: a control byte c in [0,127] is followed by c+1 literal bytes,
+// c in [-127,-1] by one byte to repeat 1-c times (-128 is skipped)
+void voxelfile_packbits_encode(const unsigned char* data, unsigned int size,
+	std::vector<unsigned char>& out);
+
+// Decodes exactly [size] bytes into [out], returns false if [data] is
+// malformed
+bool voxelfile_packbits_decode(const unsigned char* data, unsigned int encoded_size,
+	unsigned char* out, unsigned int size);
+
+// Decodes the payload of one version 2 chunk (everything after its
+// voxelfile_chunk_header), appending its voxels to [voxels].
+//
+// voxelfile_voxel only holds the first MAX_NUM_MODIFIERS modifiers; if
+// [modifiers] is supplied, all of them are appended to it, four floats
+// (distance, then gradient) per modifier per voxel.
+//
+// Returns false if the payload is malformed.
+bool voxelfile_decode_chunk(const voxelfile_chunk_header& chunk_hdr,
+	const unsigned char* payload, const voxelfile_object_header& object_hdr,
+	const voxelfile_object_header_v2& object_hdr_v2, std::vector<voxelfile_voxel>& voxels,
+	std::vector<float>* modifiers = 0);
+
+// Reads a version 1 or version 2 file; returns the version, or 0 on error.
+// [modifiers] is as for voxelfile_decode_chunk.
+//
+// Version 1 files have no voxelfile_object_header_v2; [object_hdr_v2] comes
+// back with num_modifiers = MAX_NUM_MODIFIERS and no chunks.
+int voxelfile_read(const char* filename, voxelfile_object_header& object_hdr,
+	voxelfile_object_header_v2& object_hdr_v2, std::vector<voxelfile_voxel>& voxels,
+	std::vector<float>* modifiers = 0);
+
+class voxelfile_writer {
+
+public:
+
+	voxelfile_writer();
+	~voxelfile_writer();
+
+	// Opens [filename] and writes the file and object headers.  Only one
+	// object per file, as always.
+	//
+	// [num_modifiers] can be more than MAX_NUM_MODIFIERS (up to 255).
+	bool open(const char* filename, const voxelfile_object_header& object_hdr,
+		int num_modifiers, int encoding = VOXELFILE_ENCODING_FLOAT32,
+		int compression = VOXELFILE_COMPRESSION_PACKBITS,
+		int planes_per_chunk = VOXELFILE_DEFAULT_PLANES_PER_CHUNK);
+
+	// Adds an occupied voxel; voxels must come in grid index order.  Writes
+	// out any chunks the voxel has moved past.
+	//
+	// [modifiers], if supplied, has four floats (distance, then gradient) for
+	// each of the file's modifiers; otherwise they come from [v], which only
+	// has room for MAX_NUM_MODIFIERS.
+	bool add_voxel(const voxelfile_voxel& v, const float* modifiers = 0);
+
+	// Writes the remaining chunks and closes the file
+	bool close();
+
+	inline int num_voxels_written() const { return m_num_voxels_written; }
+	inline double bytes_written() const { return m_bytes_written; }
+
+protected:
+
+	// Encodes and writes the current chunk, then moves to the next one
+	bool write_chunk();
+
+	// Appends one block to m_payload, compressing it if we're supposed to
+	void append_block(const unsigned char* data, unsigned int size, int value_size);
+
+	// Appends a stream's flags and values
+	void append_flags(int stream);
+	void append_values(int stream);
+
+	FILE* m_file;
+	voxelfile_object_header m_object_hdr;
+	voxelfile_object_header_v2 m_object_hdr_v2;
+
+	int m_current_chunk;
+	unsigned int m_last_index;
+	bool m_have_last_index;
+
+	// Voxels in the current chunk, and their modifier distances
+	std::vector<voxelfile_voxel> m_chunk_voxels;
+	std::vector<float> m_chunk_modifiers;
+
+	// Encoding scratch space
+	std::vector<unsigned char> m_payload;
+	std::vector<unsigned char> m_block;
+	std::vector<unsigned char> m_shuffled;
+	std::vector<unsigned char> m_packed;
+
+	int m_num_voxels_written;
+	double m_bytes_written;
+
+};
+
+#endif
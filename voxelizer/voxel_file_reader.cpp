@@ -0,0 +1,684 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "stdafx.h"
+#include "voxel_file_reader.h"
+#include <conio.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static inline unsigned int popcount32(unsigned int x) {
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	x = (x + (x >> 4)) & 0x0f0f0f0f;
+	return (x * 0x01010101) >> 24;
+}
+
+voxelfile_brick_iterator::voxelfile_brick_iterator() {
+	m_reader = 0;
+	m_i = m_j = m_k = 0;
+	for (int a = 0; a < 3; a++) m_min[a] = m_max[a] = 0;
+}
+
+voxelfile_brick_iterator::voxelfile_brick_iterator(voxelfile_reader* reader,
+	const int* box_min, const int* box_max) {
+
+	m_reader = reader;
+	for (int a = 0; a < 3; a++) {
+		m_min[a] = box_min[a];
+		m_max[a] = box_max[a];
+	}
+	m_i = m_min[0];
+	m_j = m_min[1];
+	m_k = m_min[2];
+
+	// Nothing to iterate over
+	if (m_min[1] >= m_max[1] || m_min[2] >= m_max[2]) m_i = m_max[0];
+}
+
+bool voxelfile_brick_iterator::next(voxelfile_voxel& v, float* modifiers) {
+
+	if (m_reader == 0) return false;
+
+	while (m_i < m_max[0]) {
+
+		int k = m_reader->next_occupied(m_i, m_j, m_k, m_max[2]);
+		if (k >= 0) {
+			m_k = k + 1;
+			return m_reader->get(m_i, m_j, k, v, modifiers);
+		}
+
+		// On to the next row
+		m_k = m_min[2];
+		m_j++;
+		if (m_j >= m_max[1]) {
+			m_j = m_min[1];
+			m_i++;
+		}
+	}
+
+	return false;
+}
+
+voxelfile_reader::voxelfile_reader() {
+
+	m_file_handle = 0;
+	m_mapping_handle = 0;
+	m_file_descriptor = -1;
+	m_file_size = 0;
+	m_granularity = 65536;
+	m_use_counter = 0;
+
+	memset(&m_index_hdr, 0, sizeof(m_index_hdr));
+
+	int v;
+	for (v = 0; v < VOXELFILE_READER_NUM_VIEWS; v++) {
+		m_views[v].data = 0;
+		m_views[v].offset = m_views[v].size = 0;
+		m_views[v].last_used = 0;
+	}
+
+	for (v = 0; v < VOXELFILE_READER_NUM_CACHED_CHUNKS; v++) {
+		m_chunks[v].chunk = -1;
+		m_chunks[v].last_used = 0;
+	}
+
+}
+
+voxelfile_reader::~voxelfile_reader() {
+	close();
+}
+
+void voxelfile_reader::unmap_views() {
+
+	for (int v = 0; v < VOXELFILE_READER_NUM_VIEWS; v++) {
+		if (m_views[v].data == 0) continue;
+#ifdef _WIN32
+		UnmapViewOfFile(m_views[v].data);
+#else
+		munmap(m_views[v].data, (size_t)(m_views[v].size));
+#endif
+		m_views[v].data = 0;
+		m_views[v].offset = m_views[v].size = 0;
+	}
+
+}
+
+void voxelfile_reader::close() {
+
+	unmap_views();
+
+#ifdef _WIN32
+	if (m_mapping_handle) CloseHandle((HANDLE)(m_mapping_handle));
+	if (m_file_handle) CloseHandle((HANDLE)(m_file_handle));
+#else
+	if (m_file_descriptor >= 0) ::close(m_file_descriptor);
+#endif
+
+	m_mapping_handle = 0;
+	m_file_handle = 0;
+	m_file_descriptor = -1;
+	m_file_size = 0;
+
+	m_row_rank.clear();
+	m_occupancy.clear();
+	m_offsets.clear();
+	memset(&m_index_hdr, 0, sizeof(m_index_hdr));
+
+	for (int c = 0; c < VOXELFILE_READER_NUM_CACHED_CHUNKS; c++) {
+		m_chunks[c].chunk = -1;
+		m_chunks[c].voxels.clear();
+		m_chunks[c].modifiers.clear();
+	}
+}
+
+const unsigned char* voxelfile_reader::map_bytes(unsigned long long offset, unsigned int size) {
+
+	if (offset + size > m_file_size) return 0;
+
+	m_use_counter++;
+
+	// Already mapped?
+	int v;
+	for (v = 0; v < VOXELFILE_READER_NUM_VIEWS; v++) {
+		mapped_view& view = m_views[v];
+		if (view.data && offset >= view.offset && offset + size <= view.offset + view.size) {
+			view.last_used = m_use_counter;
+			return view.data + (offset - view.offset);
+		}
+	}
+
+	// Recycle an empty view, or the least recently used one
+	int victim = 0;
+	for (v = 0; v < VOXELFILE_READER_NUM_VIEWS; v++) {
+		if (m_views[v].data == 0) {
+			victim = v;
+			break;
+		}
+		if (m_views[v].last_used < m_views[victim].last_used) victim = v;
+	}
+
+	mapped_view& view = m_views[victim];
+	if (view.data) {
+#ifdef _WIN32
+		UnmapViewOfFile(view.data);
+#else
+		munmap(view.data, (size_t)(view.size));
+#endif
+		view.data = 0;
+	}
+
+	// Views have to start on a multiple of the allocation granularity
+	unsigned long long start = offset - (offset % m_granularity);
+	unsigned long long view_size = VOXELFILE_READER_VIEW_SIZE;
+	if (offset - start + size > view_size) view_size = offset - start + size;
+	if (start + view_size > m_file_size) view_size = m_file_size - start;
+
+#ifdef _WIN32
+	view.data = (unsigned char*)(MapViewOfFile((HANDLE)(m_mapping_handle), FILE_MAP_READ,
+		(DWORD)(start >> 32), (DWORD)(start & 0xffffffff), (SIZE_T)(view_size)));
+#else
+	void* data = mmap(0, (size_t)(view_size), PROT_READ, MAP_SHARED, m_file_descriptor, (off_t)(start));
+	view.data = (data == MAP_FAILED) ? 0 : (unsigned char*)(data);
+#endif
+
+	if (view.data == 0) {
+		_cprintf("Could not map %d bytes of the voxel file at offset %.0lf\n",
+			(int)(view_size), (double)(start));
+		return 0;
+	}
+
+	view.offset = start;
+	view.size = view_size;
+	view.last_used = m_use_counter;
+
+	return view.data + (offset - start);
+}
+
+bool voxelfile_reader::open(const char* filename, bool use_sidecar) {
+
+	close();
+
+	long long file_time = 0;
+
+#ifdef _WIN32
+
+	HANDLE file = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE) {
+		_cprintf("Could not open voxel file %s\n", filename);
+		return false;
+	}
+	m_file_handle = file;
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	m_file_size = size.QuadPart;
+
+	FILETIME write_time;
+	GetFileTime(file, 0, 0, &write_time);
+	file_time = ((long long)(write_time.dwHighDateTime) << 32) | write_time.dwLowDateTime;
+
+	if (m_file_size > 0) m_mapping_handle = CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (m_mapping_handle == 0) {
+		_cprintf("Could not map voxel file %s\n", filename);
+		close();
+		return false;
+	}
+
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	m_granularity = info.dwAllocationGranularity;
+
+#else
+
+	m_file_descriptor = ::open(filename, O_RDONLY);
+	if (m_file_descriptor < 0) {
+		_cprintf("Could not open voxel file %s\n", filename);
+		return false;
+	}
+
+	struct stat st;
+	fstat(m_file_descriptor, &st);
+	m_file_size = st.st_size;
+	file_time = st.st_mtime;
+	m_granularity = (unsigned int)(sysconf(_SC_PAGESIZE));
+
+#endif
+
+	// Read the headers
+	const unsigned char* p = map_bytes(0, sizeof(int));
+	if (p == 0) {
+		_cprintf("%s is not a voxel file\n", filename);
+		close();
+		return false;
+	}
+
+	int first;
+	memcpy(&first, p, sizeof(first));
+
+	unsigned long long data_offset;
+
+	if (first == VOXELFILE_MAGIC_V2) {
+
+		voxelfile_file_header_v2 file_hdr;
+		p = map_bytes(0, sizeof(file_hdr));
+		if (p) memcpy(&file_hdr, p, sizeof(file_hdr));
+
+		if (p == 0 || file_hdr.version != 2 ||
+			file_hdr.object_header_size != sizeof(voxelfile_object_header) ||
+			file_hdr.object_header_v2_size != sizeof(voxelfile_object_header_v2) ||
+			file_hdr.chunk_header_size != sizeof(voxelfile_chunk_header)) {
+			_cprintf("Unexpected version or structure sizes in voxel file %s\n", filename);
+			close();
+			return false;
+		}
+
+		p = map_bytes(sizeof(file_hdr), sizeof(m_object_hdr) + sizeof(m_object_hdr_v2));
+		if (p == 0) {
+			close();
+			return false;
+		}
+		memcpy(&m_object_hdr, p, sizeof(m_object_hdr));
+		memcpy(&m_object_hdr_v2, p + sizeof(m_object_hdr), sizeof(m_object_hdr_v2));
+
+		m_index_hdr.file_version = 2;
+		data_offset = sizeof(file_hdr) + sizeof(m_object_hdr) + sizeof(m_object_hdr_v2);
+	}
+
+	else if (first == sizeof(voxelfile_file_header)) {
+
+		voxelfile_file_header file_hdr;
+		p = map_bytes(0, sizeof(file_hdr) + sizeof(m_object_hdr));
+		if (p) memcpy(&file_hdr, p, sizeof(file_hdr));
+
+		if (p == 0 || file_hdr.object_header_size != sizeof(voxelfile_object_header) ||
+			file_hdr.voxel_struct_size != sizeof(voxelfile_voxel)) {
+			_cprintf("Unexpected structure sizes in voxel file %s\n", filename);
+			close();
+			return false;
+		}
+
+		memcpy(&m_object_hdr, p + sizeof(file_hdr), sizeof(m_object_hdr));
+		m_object_hdr_v2 = voxelfile_object_header_v2();
+		m_object_hdr_v2.num_modifiers = MAX_NUM_MODIFIERS;
+
+		m_index_hdr.file_version = 1;
+		data_offset = sizeof(file_hdr) + sizeof(m_object_hdr);
+	}
+
+	else {
+		_cprintf("%s is not a voxel file\n", filename);
+		close();
+		return false;
+	}
+
+	const int* res = m_object_hdr.voxel_resolution;
+	if (res[0] < 0 || res[1] < 0 || res[2] < 0) {
+		close();
+		return false;
+	}
+
+	m_index_hdr.magic = VOXELFILE_INDEX_MAGIC;
+	m_index_hdr.header_size = sizeof(m_index_hdr);
+	m_index_hdr.file_size = m_file_size;
+	m_index_hdr.file_time = file_time;
+	for (int a = 0; a < 3; a++) m_index_hdr.voxel_resolution[a] = res[a];
+	m_index_hdr.num_rows = res[0] * res[1];
+	m_index_hdr.words_per_row = (res[2] + 31) / 32;
+	m_index_hdr.num_offsets = (m_index_hdr.file_version == 1) ?
+		m_index_hdr.num_rows : m_object_hdr_v2.num_chunks;
+	m_index_hdr.num_voxels = 0;
+
+	char sidecar_filename[_MAX_PATH];
+	sprintf(sidecar_filename, "%s%s", filename, VOXELFILE_INDEX_EXTENSION);
+
+	if (use_sidecar && read_sidecar(sidecar_filename)) return true;
+
+	m_row_rank.assign(m_index_hdr.num_rows + 1, 0);
+	m_occupancy.assign((size_t)(m_index_hdr.num_rows) * m_index_hdr.words_per_row, 0);
+	m_offsets.assign(m_index_hdr.num_offsets, 0);
+
+	bool ok = (m_index_hdr.file_version == 1) ?
+		build_index_v1(data_offset) : build_index_v2(data_offset);
+
+	if (ok == false) {
+		_cprintf("Could not index voxel file %s\n", filename);
+		close();
+		return false;
+	}
+
+	m_index_hdr.num_voxels = m_row_rank[m_index_hdr.num_rows];
+
+	if (use_sidecar) write_sidecar(sidecar_filename);
+
+	return true;
+}
+
+bool voxelfile_reader::build_index_v1(unsigned long long data_offset) {
+
+	const int* res = m_object_hdr.voxel_resolution;
+	unsigned int max_row_bytes = res[2] * (1 + sizeof(voxelfile_voxel));
+
+	unsigned long long pos = data_offset;
+
+	for (int row = 0; row < m_index_hdr.num_rows; row++) {
+
+		m_offsets[row] = pos;
+
+		unsigned int available = max_row_bytes;
+		if (pos + available > m_file_size) available = (unsigned int)(m_file_size - pos);
+
+		const unsigned char* p = available ? map_bytes(pos, available) : 0;
+		unsigned int* words = &(m_occupancy[0]) + (size_t)(row) * m_index_hdr.words_per_row;
+		unsigned int used = 0;
+		unsigned int count = 0;
+
+		for (int k = 0; k < res[2]; k++) {
+
+			if (used >= available) return false;
+			unsigned char mark = p[used++];
+
+			if (mark == ASCIIVOXEL_TEXTURED_VOXEL) {
+				used += sizeof(voxelfile_voxel);
+				if (used > available) return false;
+				words[k >> 5] |= (1u << (k & 31));
+				count++;
+			}
+		}
+
+		m_row_rank[row + 1] = m_row_rank[row] + count;
+		pos += used;
+	}
+
+	return true;
+}
+
+bool voxelfile_reader::build_index_v2(unsigned long long data_offset) {
+
+	const int* res = m_object_hdr.voxel_resolution;
+	unsigned int plane_size = res[1] * res[2];
+
+	std::vector<unsigned int> row_count(m_index_hdr.num_rows, 0);
+
+	unsigned long long pos = data_offset;
+
+	for (int chunk = 0; chunk < m_object_hdr_v2.num_chunks; chunk++) {
+
+		voxelfile_chunk_header chunk_hdr;
+		const unsigned char* p = map_bytes(pos, sizeof(chunk_hdr));
+		if (p == 0) return false;
+		memcpy(&chunk_hdr, p, sizeof(chunk_hdr));
+
+		if (chunk_hdr.first_i != chunk * m_object_hdr_v2.planes_per_chunk ||
+			chunk_hdr.num_planes < 0 || chunk_hdr.first_i + chunk_hdr.num_planes > res[0] ||
+			chunk_hdr.num_runs < 0 || chunk_hdr.payload_size < 0 ||
+			(unsigned int)(chunk_hdr.num_runs) * sizeof(unsigned int) > (unsigned int)(chunk_hdr.payload_size))
+			return false;
+
+		m_offsets[chunk] = pos;
+
+		const unsigned char* runs = 0;
+		if (chunk_hdr.num_runs) {
+			runs = map_bytes(pos + sizeof(chunk_hdr), chunk_hdr.num_runs * sizeof(unsigned int));
+			if (runs == 0) return false;
+		}
+
+		unsigned int num_cells = chunk_hdr.num_planes * plane_size;
+		unsigned int first_row = chunk_hdr.first_i * res[1];
+		unsigned int cell = 0;
+		unsigned int found = 0;
+
+		for (int r = 0; r < chunk_hdr.num_runs; r++) {
+
+			unsigned int run;
+			memcpy(&run, runs + r * sizeof(run), sizeof(run));
+			if (cell + run > num_cells) return false;
+
+			if (r % 2 == 1) {
+				for (unsigned int c = cell; c < cell + run; c++) {
+					unsigned int row = first_row + c / res[2];
+					int k = c % res[2];
+					m_occupancy[(size_t)(row) * m_index_hdr.words_per_row + (k >> 5)] |= (1u << (k & 31));
+					row_count[row]++;
+				}
+				found += run;
+			}
+
+			cell += run;
+		}
+
+		if (found != (unsigned int)(chunk_hdr.num_voxels)) return false;
+
+		pos += sizeof(chunk_hdr) + chunk_hdr.payload_size;
+	}
+
+	for (int row = 0; row < m_index_hdr.num_rows; row++)
+		m_row_rank[row + 1] = m_row_rank[row] + row_count[row];
+
+	return true;
+}
+
+bool voxelfile_reader::read_sidecar(const char* filename) {
+
+	FILE* f = fopen(filename, "rb");
+	if (f == 0) return false;
+
+	voxelfile_index_header hdr;
+	bool ok = (fread(&hdr, sizeof(hdr), 1, f) == 1);
+
+	// Does it still describe this file?
+	ok = ok && hdr.magic == VOXELFILE_INDEX_MAGIC && hdr.header_size == sizeof(hdr) &&
+		hdr.file_version == m_index_hdr.file_version && hdr.file_size == m_index_hdr.file_size &&
+		hdr.file_time == m_index_hdr.file_time &&
+		hdr.num_rows == m_index_hdr.num_rows && hdr.words_per_row == m_index_hdr.words_per_row &&
+		hdr.num_offsets == m_index_hdr.num_offsets;
+	for (int a = 0; a < 3; a++) ok = ok && hdr.voxel_resolution[a] == m_index_hdr.voxel_resolution[a];
+
+	if (ok) {
+		m_row_rank.resize(hdr.num_rows + 1);
+		m_occupancy.resize((size_t)(hdr.num_rows) * hdr.words_per_row);
+		m_offsets.resize(hdr.num_offsets);
+		ok = (fread(&(m_row_rank[0]), sizeof(unsigned int), m_row_rank.size(), f) == m_row_rank.size());
+		if (ok && m_occupancy.size())
+			ok = (fread(&(m_occupancy[0]), sizeof(unsigned int), m_occupancy.size(), f) == m_occupancy.size());
+		if (ok && m_offsets.size())
+			ok = (fread(&(m_offsets[0]), sizeof(unsigned long long), m_offsets.size(), f) == m_offsets.size());
+	}
+
+	fclose(f);
+
+	if (ok) m_index_hdr.num_voxels = hdr.num_voxels;
+	else {
+		m_row_rank.clear();
+		m_occupancy.clear();
+		m_offsets.clear();
+	}
+
+	return ok;
+}
+
+void voxelfile_reader::write_sidecar(const char* filename) {
+
+	FILE* f = fopen(filename, "wb");
+	if (f == 0) {
+		_cprintf("Could not write voxel index %s\n", filename);
+		return;
+	}
+
+	fwrite(&m_index_hdr, sizeof(m_index_hdr), 1, f);
+	fwrite(&(m_row_rank[0]), sizeof(unsigned int), m_row_rank.size(), f);
+	if (m_occupancy.size()) fwrite(&(m_occupancy[0]), sizeof(unsigned int), m_occupancy.size(), f);
+	if (m_offsets.size()) fwrite(&(m_offsets[0]), sizeof(unsigned long long), m_offsets.size(), f);
+
+	fclose(f);
+}
+
+unsigned int voxelfile_reader::rank_in_row(unsigned int row, int k) const {
+
+	const unsigned int* words = &(m_occupancy[0]) + (size_t)(row) * m_index_hdr.words_per_row;
+	unsigned int rank = 0;
+	for (int w = 0; w < (k >> 5); w++) rank += popcount32(words[w]);
+	if (k & 31) rank += popcount32(words[k >> 5] & ((1u << (k & 31)) - 1));
+	return rank;
+}
+
+bool voxelfile_reader::occupied(int i, int j, int k) const {
+
+	const int* res = m_index_hdr.voxel_resolution;
+	if (m_row_rank.size() == 0 ||
+		i < 0 || i >= res[0] || j < 0 || j >= res[1] || k < 0 || k >= res[2]) return false;
+
+	unsigned int row = i * res[1] + j;
+	return (m_occupancy[(size_t)(row) * m_index_hdr.words_per_row + (k >> 5)] & (1u << (k & 31))) != 0;
+}
+
+int voxelfile_reader::next_occupied(int i, int j, int k, int k_end) const {
+
+	const int* res = m_index_hdr.voxel_resolution;
+	if (m_row_rank.size() == 0 || i < 0 || i >= res[0] || j < 0 || j >= res[1]) return -1;
+	if (k < 0) k = 0;
+	if (k_end > res[2]) k_end = res[2];
+	if (k >= k_end) return -1;
+
+	unsigned int row = i * res[1] + j;
+	const unsigned int* words = &(m_occupancy[0]) + (size_t)(row) * m_index_hdr.words_per_row;
+
+	int w = k >> 5;
+	unsigned int bits = words[w] & (0xffffffffu << (k & 31));
+
+	while (true) {
+		if (bits) {
+			// Index of the lowest set bit
+			int found = (w << 5) + popcount32((bits & (0u - bits)) - 1);
+			return (found < k_end) ? found : -1;
+		}
+		w++;
+		if ((w << 5) >= k_end) return -1;
+		bits = words[w];
+	}
+}
+
+const voxelfile_reader::cached_chunk* voxelfile_reader::decoded_chunk(int chunk) {
+
+	m_use_counter++;
+
+	int c;
+	for (c = 0; c < VOXELFILE_READER_NUM_CACHED_CHUNKS; c++) {
+		if (m_chunks[c].chunk == chunk) {
+			m_chunks[c].last_used = m_use_counter;
+			return &(m_chunks[c]);
+		}
+	}
+
+	int victim = 0;
+	for (c = 1; c < VOXELFILE_READER_NUM_CACHED_CHUNKS; c++) {
+		if (m_chunks[c].last_used < m_chunks[victim].last_used) victim = c;
+	}
+
+	cached_chunk& cached = m_chunks[victim];
+	cached.chunk = -1;
+	cached.voxels.clear();
+	cached.modifiers.clear();
+
+	voxelfile_chunk_header chunk_hdr;
+	const unsigned char* p = map_bytes(m_offsets[chunk], sizeof(chunk_hdr));
+	if (p == 0) return 0;
+	memcpy(&chunk_hdr, p, sizeof(chunk_hdr));
+
+	static const unsigned char empty_payload = 0;
+	const unsigned char* payload = &empty_payload;
+	if (chunk_hdr.payload_size) {
+		payload = map_bytes(m_offsets[chunk] + sizeof(chunk_hdr), chunk_hdr.payload_size);
+		if (payload == 0) return 0;
+	}
+
+	if (!voxelfile_decode_chunk(chunk_hdr, payload, m_object_hdr, m_object_hdr_v2,
+		cached.voxels, &(cached.modifiers))) {
+		_cprintf("Chunk %d of the voxel file is malformed\n", chunk);
+		cached.voxels.clear();
+		cached.modifiers.clear();
+		return 0;
+	}
+
+	cached.chunk = chunk;
+	cached.last_used = m_use_counter;
+	return &cached;
+}
+
+bool voxelfile_reader::get(int i, int j, int k, voxelfile_voxel& v, float* modifiers) {
+
+	if (occupied(i, j, k) == false) return false;
+
+	const int* res = m_index_hdr.voxel_resolution;
+	unsigned int row = i * res[1] + j;
+	unsigned int rank = rank_in_row(row, k);
+
+	if (m_index_hdr.file_version == 1) {
+
+		// Each cell before this one has a mark, and each voxel before this one
+		// in the row has a record
+		unsigned long long offset = m_offsets[row] + k + 1 + (unsigned long long)(rank) * sizeof(voxelfile_voxel);
+		const unsigned char* p = map_bytes(offset, sizeof(voxelfile_voxel));
+		if (p == 0) return false;
+		memcpy(&v, p, sizeof(v));
+
+		if (modifiers) {
+			for (int m = 0; m < MAX_NUM_MODIFIERS; m++) {
+				modifiers[m * 4] = v.distance_to_modifier[m];
+				memcpy(modifiers + m * 4 + 1, v.modifier_gradient[m], 3 * sizeof(float));
+			}
+		}
+		return true;
+	}
+
+	int chunk = i / m_object_hdr_v2.planes_per_chunk;
+	const cached_chunk* cached = decoded_chunk(chunk);
+	if (cached == 0) return false;
+
+	unsigned int first_row = chunk * m_object_hdr_v2.planes_per_chunk * res[1];
+	unsigned int index = m_row_rank[row] - m_row_rank[first_row] + rank;
+	if (index >= cached->voxels.size()) return false;
+
+	v = cached->voxels[index];
+
+	unsigned int stride = m_object_hdr_v2.num_modifiers * 4;
+	if (modifiers && stride) memcpy(modifiers, &(cached->modifiers[index * stride]), stride * sizeof(float));
+
+	return true;
+}
+
+voxelfile_brick_iterator voxelfile_reader::brick(int bi, int bj, int bk, int brick_size) {
+
+	const int* res = m_index_hdr.voxel_resolution;
+	int b[3] = { bi, bj, bk };
+	int box_min[3], box_max[3];
+
+	for (int a = 0; a < 3; a++) {
+		box_min[a] = b[a] * brick_size;
+		box_max[a] = box_min[a] + brick_size;
+		if (box_min[a] < 0) box_min[a] = 0;
+		if (box_max[a] > res[a]) box_max[a] = res[a];
+		if (box_min[a] > box_max[a]) box_min[a] = box_max[a];
+	}
+
+	return voxelfile_brick_iterator(this, box_min, box_max);
+}
+
+voxelfile_brick_iterator voxelfile_reader::all() {
+	int box_min[3] = { 0, 0, 0 };
+	return voxelfile_brick_iterator(this, box_min, m_index_hdr.voxel_resolution);
+}
@@ -0,0 +1,214 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Random access to .voxels files (either version) without reading them
+  into memory.
+
+  voxelfile_reader memory-maps the file a window at a time (a few views of
+  VOXELFILE_READER_VIEW_SIZE bytes, recycled least-recently-used), so files
+  bigger than physical memory (or than a 32-bit address space) are fine.
+
+  Records in a .voxels file aren't fixed-size, so on open the reader needs
+  an index:
+
+  - one occupancy bit for every cell in the grid
+  - the number of occupied voxels before each (i,j) row
+  - where each row starts (version 1) or each chunk starts (version 2)
+
+  Building it takes one pass over the file (for version 2, just the chunk
+  headers and occupancy runs); it's then saved next to the file as
+  [filename].index and read back from there next time, as long as the
+  .voxels file's size and modification time haven't changed.
+
+  With the index, get(i,j,k) is O(1): a bit test and a popcount over one
+  row's bits, then either one read (version 1) or a lookup in a decoded
+  chunk (version 2, a few of which are cached).
+
+  A reader isn't thread-safe; use one per thread.
+
+***********/
+
+#ifndef _VOXEL_FILE_READER_H_
+#define _VOXEL_FILE_READER_H_
+
+#include "voxel_file_io.h"
+
+// Size of each mapped window into the file, and how many we keep mapped
+#define VOXELFILE_READER_VIEW_SIZE (32*1024*1024)
+#define VOXELFILE_READER_NUM_VIEWS 4
+
+// How many decoded version 2 chunks we keep around
+#define VOXELFILE_READER_NUM_CACHED_CHUNKS 8
+
+// The first int of an index sidecar ("VXI1")
+#define VOXELFILE_INDEX_MAGIC 0x31495856
+
+#define VOXELFILE_INDEX_EXTENSION ".index"
+
+// The header of an index sidecar; the index arrays follow, in the order
+// they're declared in voxelfile_reader
+struct voxelfile_index_header {
+
+	// VOXELFILE_INDEX_MAGIC
+	int magic;
+
+	// Size of this structure
+	int header_size;
+
+	// The .voxels file this indexes: its size and modification time, its
+	// version, and its grid
+	unsigned long long file_size;
+	long long file_time;
+	int file_version;
+	int voxel_resolution[3];
+
+	// Array sizes
+	int num_rows;
+	int words_per_row;
+	int num_offsets;
+
+	// Total occupied voxels
+	unsigned int num_voxels;
+
+};
+
+class voxelfile_reader;
+
+// Walks the occupied voxels in a box of the grid, in grid index order:
+//
+// voxelfile_brick_iterator iter = reader.brick(bi, bj, bk, 8);
+// voxelfile_voxel v;
+// while (iter.next(v)) { ... }
+class voxelfile_brick_iterator {
+
+public:
+
+	voxelfile_brick_iterator();
+
+	// Iterates over voxels with box_min[a] <= index < box_max[a]
+	voxelfile_brick_iterator(voxelfile_reader* reader, const int* box_min, const int* box_max);
+
+	// Fetches the next voxel (and its modifiers, as for
+	// voxelfile_reader::get), returns false when we run out
+	bool next(voxelfile_voxel& v, float* modifiers = 0);
+
+protected:
+
+	voxelfile_reader* m_reader;
+	int m_min[3], m_max[3];
+
+	// The next cell to look at
+	int m_i, m_j, m_k;
+};
+
+class voxelfile_reader {
+
+public:
+
+	voxelfile_reader();
+	~voxelfile_reader();
+
+	// Maps [filename] and reads or builds its index; returns false on error.
+	//
+	// If [use_sidecar] is set, the index is read from (or saved to)
+	// [filename].index.
+	bool open(const char* filename, bool use_sidecar = true);
+
+	void close();
+
+	inline int version() const { return m_index_hdr.file_version; }
+	inline const voxelfile_object_header& object_header() const { return m_object_hdr; }
+	inline const voxelfile_object_header_v2& object_header_v2() const { return m_object_hdr_v2; }
+	inline const int* resolution() const { return m_object_hdr.voxel_resolution; }
+	inline unsigned int num_voxels() const { return m_index_hdr.num_voxels; }
+
+	// Is there a voxel at (i,j,k)?
+	bool occupied(int i, int j, int k) const;
+
+	// Fetches the voxel at (i,j,k); returns false if there isn't one.
+	//
+	// If [modifiers] is supplied, it gets four floats (distance, then
+	// gradient) for each of object_header_v2().num_modifiers modifiers, which
+	// can be more than [v] has room for.
+	bool get(int i, int j, int k, voxelfile_voxel& v, float* modifiers = 0);
+
+	// Iterators over one brick of the grid (clipped to the grid), or the
+	// whole thing
+	voxelfile_brick_iterator brick(int bi, int bj, int bk, int brick_size);
+	voxelfile_brick_iterator all();
+
+	// The first cell at or after k in row (i,j) that has a voxel, or -1
+	int next_occupied(int i, int j, int k, int k_end) const;
+
+protected:
+
+	// Returns a pointer to [size] bytes at [offset] in the file, mapping a new
+	// view if necessary; the pointer is good until the next call
+	const unsigned char* map_bytes(unsigned long long offset, unsigned int size);
+
+	void unmap_views();
+
+	bool build_index_v1(unsigned long long data_offset);
+	bool build_index_v2(unsigned long long data_offset);
+
+	bool read_sidecar(const char* filename);
+	void write_sidecar(const char* filename);
+
+	// Number of occupied cells in row [row] before column k
+	unsigned int rank_in_row(unsigned int row, int k) const;
+
+	struct cached_chunk {
+		int chunk;
+		unsigned int last_used;
+		std::vector<voxelfile_voxel> voxels;
+		std::vector<float> modifiers;
+	};
+
+	// The decoded voxels for one version 2 chunk
+	const cached_chunk* decoded_chunk(int chunk);
+
+	voxelfile_object_header m_object_hdr;
+	voxelfile_object_header_v2 m_object_hdr_v2;
+	voxelfile_index_header m_index_hdr;
+
+	// Occupied voxels before each row (num_rows + 1 entries)
+	std::vector<unsigned int> m_row_rank;
+
+	// One bit per cell, words_per_row words per row
+	std::vector<unsigned int> m_occupancy;
+
+	// File offsets of each row (version 1) or chunk header (version 2)
+	std::vector<unsigned long long> m_offsets;
+
+	// The mapped file
+	void* m_file_handle;
+	void* m_mapping_handle;
+	int m_file_descriptor;
+	unsigned long long m_file_size;
+	unsigned int m_granularity;
+
+	struct mapped_view {
+		unsigned long long offset;
+		unsigned long long size;
+		unsigned char* data;
+		unsigned int last_used;
+	};
+	mapped_view m_views[VOXELFILE_READER_NUM_VIEWS];
+
+	cached_chunk m_chunks[VOXELFILE_READER_NUM_CACHED_CHUNKS];
+
+	unsigned int m_use_counter;
+
+};
+
+#endif
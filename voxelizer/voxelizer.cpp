@@ -11,11 +11,14 @@
 
 #include "stdafx.h"
 #include "voxelizer.h"
+#ifndef HEADLESS_BUILD
 #include "voxelizerDlg.h"
+#endif
 #include <conio.h>
 #include <process.h>
 #include <vector>
 #include "voxel_file_format.h"
+#include "voxel_file_io.h"
 #include <float.h>
 #include "CFileLoaderOBJ.h"
 #include "CFileLoader3DS.h"
@@ -24,6 +27,9 @@
 #include "meshImporter.h"
 #include "mesh_data_structures.h"
 #include "cImageLoader.h"
+#include "parallel_for.h"
+#include "voxel_attribute_grid.h"
+#include "aabb_distance_tree.h"
 
  // Turn off annoying compiler warnings
 #pragma warning(disable: 4305) // stl
@@ -31,14 +37,6 @@
 #pragma warning(disable: 4244) // numeric cast
 #pragma warning(disable: 4996) // deprecation
 
-#ifdef COMPILE_CPT
-#pragma comment(lib,"libmingwex.a")
-#pragma comment(lib,"libmingw32.a")
-#pragma comment(lib,"libstdc++.a")
-#pragma comment(lib,"libgcc.a")
-#pragma comment(lib,"cpt.a")
-#endif
-
 // Should we default to the "hard shape" or just the cube?
 // #define HARD_SHAPE
 
@@ -188,34 +186,17 @@ public:
 };
 
 
-struct ltvoxel
-{
-	bool operator()(const voxelfile_voxel& v1, const voxelfile_voxel& v2)
-		const
-	{
-		if (v1.i < v2.i) return true;
-		if (v2.i < v1.i) return false;
-
-		if (v1.j < v2.j) return true;
-		if (v2.j < v1.j) return false;
-
-		if (v1.k < v2.k) return true;
-		return false;
-	}
-};
-
-
-
 #include <vector>
 #include <set>
 
 typedef std::vector<voxel_id> voxel_list;
-typedef std::set<voxelfile_voxel, ltvoxel> voxel_set;
 
 #define ALLOCATE_SCOPED_GLOBALS
 #include "voxelizer_globals.h"
 #undef ALLOCATE_SCOPED_GLOBALS
 
+#ifndef HEADLESS_BUILD
+
 #ifdef _DEBUG
 #define new DEBUG_NEW
 #undef THIS_FILE
@@ -232,8 +213,11 @@ END_MESSAGE_MAP()
 // properly exported by the MS include files.
 extern "C" WINBASEAPI HWND WINAPI GetConsoleWindow();
 
+// (voxelizer_cli.cpp has the headless build's instance)
 CvoxelizerApp theApp;
 
+#endif
+
 void CvoxelizerApp::process_ini_file() {
 
 	FILE* f = fopen(INI_FILENAME, "r");
@@ -361,6 +345,81 @@ void CvoxelizerApp::process_ini_file() {
 			continue;
 		}
 
+		if (strncmp(token, "FILL_ALGORITHM", strlen("FILL_ALGORITHM")) == 0) {
+			token = strtok(0, " ");
+			if (token == 0) {
+				_cprintf("Could not read value for option FILL_ALGORITHM\n");
+			}
+			int result = sscanf(token, "%d", &m_fill_algorithm);
+			if (result == 0) {
+				_cprintf("Could not read value for option FILL_ALGORITHM\n");
+			}
+			else {
+				_cprintf("Read value %d for option FILL_ALGORITHM\n", m_fill_algorithm);
+			}
+			continue;
+		}
+
+		if (strncmp(token, "VOXEL_FILE_VERSION", strlen("VOXEL_FILE_VERSION")) == 0) {
+			token = strtok(0, " ");
+			if (token == 0) {
+				_cprintf("Could not read value for option VOXEL_FILE_VERSION\n");
+			}
+			int result = sscanf(token, "%d", &m_voxel_file_version);
+			if (result == 0) {
+				_cprintf("Could not read value for option VOXEL_FILE_VERSION\n");
+			}
+			else {
+				_cprintf("Read value %d for option VOXEL_FILE_VERSION\n", m_voxel_file_version);
+			}
+			continue;
+		}
+
+		if (strncmp(token, "VOXEL_FILE_ENCODING", strlen("VOXEL_FILE_ENCODING")) == 0) {
+			token = strtok(0, " ");
+			if (token == 0) {
+				_cprintf("Could not read value for option VOXEL_FILE_ENCODING\n");
+			}
+			int result = sscanf(token, "%d", &m_voxel_file_encoding);
+			if (result == 0) {
+				_cprintf("Could not read value for option VOXEL_FILE_ENCODING\n");
+			}
+			else {
+				_cprintf("Read value %d for option VOXEL_FILE_ENCODING\n", m_voxel_file_encoding);
+			}
+			continue;
+		}
+
+		if (strncmp(token, "VOXEL_FILE_COMPRESSION", strlen("VOXEL_FILE_COMPRESSION")) == 0) {
+			token = strtok(0, " ");
+			if (token == 0) {
+				_cprintf("Could not read value for option VOXEL_FILE_COMPRESSION\n");
+			}
+			int result = sscanf(token, "%d", &m_voxel_file_compression);
+			if (result == 0) {
+				_cprintf("Could not read value for option VOXEL_FILE_COMPRESSION\n");
+			}
+			else {
+				_cprintf("Read value %d for option VOXEL_FILE_COMPRESSION\n", m_voxel_file_compression);
+			}
+			continue;
+		}
+
+		if (strncmp(token, "NUM_THREADS", strlen("NUM_THREADS")) == 0) {
+			token = strtok(0, " ");
+			if (token == 0) {
+				_cprintf("Could not read value for option NUM_THREADS\n");
+			}
+			int result = sscanf(token, "%d", &m_num_threads);
+			if (result == 0) {
+				_cprintf("Could not read value for option NUM_THREADS\n");
+			}
+			else {
+				_cprintf("Read value %d for option NUM_THREADS\n", m_num_threads);
+			}
+			continue;
+		}
+
 		if (strncmp(token, "SEED_TRIANGLE", strlen("SEED_TRIANGLE")) == 0) {
 			token = strtok(0, " ");
 			if (token == 0) {
@@ -421,6 +480,11 @@ CvoxelizerApp::CvoxelizerApp() {
 	g_filename_to_voxelize[0] = '\0';
 	multithreaded_voxelizer = 0;
 	render_point_cloud = 0;
+	m_num_threads = 1;
+	m_fill_algorithm = FILL_ALGORITHM_FLOOD;
+	m_voxel_file_version = 1;
+	m_voxel_file_encoding = VOXELFILE_ENCODING_FLOAT32;
+	m_voxel_file_compression = VOXELFILE_COMPRESSION_PACKBITS;
 
 	total_time = 0.0;
 	distance_time = 0.0;
@@ -428,16 +492,16 @@ CvoxelizerApp::CvoxelizerApp() {
 	m_long_axis_resolution = DEFAULT_VOXEL_RESOLUTION;
 	m_normal_multiplier = DEFAULT_NORMAL_MULTIPLIER;
 
-#ifdef COMPILE_CPT
-	m_distance_array = 0;
-	m_closest_point_array = 0;
-	m_gradient_array = 0;
-	m_closest_face_array = 0;
-#endif
-
 	current_texture[0] = '\0';
 
+	quit_voxelizing = 0;
+
+	// Nobody would ever see the points in a headless build
+#ifdef HEADLESS_BUILD
+	cloud = 0;
+#else
 	cloud = new CPointCloud();
+#endif
 
 	object_to_voxelize = 0;
 
@@ -453,6 +517,11 @@ CvoxelizerApp::CvoxelizerApp() {
 
 	haptics_enabled = 0;
 
+	world = 0;
+	camera = 0;
+	viewport = 0;
+
+#ifndef HEADLESS_BUILD
 	AllocConsole();
 
 	HWND con_wnd = GetConsoleWindow();
@@ -462,6 +531,7 @@ CvoxelizerApp::CvoxelizerApp() {
 	::SetForegroundWindow(con_wnd);
 
 	SetWindowPos(con_wnd, HWND_TOP, 0, 0, 0, 0, SWP_NOSIZE);
+#endif
 
 	g_main_app = this;
 
@@ -473,7 +543,9 @@ CvoxelizerApp::CvoxelizerApp() {
 
 void CvoxelizerApp::uninitialize() {
 
+#ifndef HEADLESS_BUILD
 	toggle_haptics(TOGGLE_HAPTICS_DISABLE);
+#endif
 	world->removeChild(this);
 	delete world;
 	delete viewport;
@@ -485,6 +557,33 @@ void createCube(cMesh *mesh, float edge);
 void createChallengingShape(cMesh *mesh, float edge);
 
 
+#ifdef HEADLESS_BUILD
+
+void CvoxelizerApp::initialize_headless() {
+
+	// Meshes still need a world to live in, but nobody's looking at it
+	world = new cWorld();
+	world->addChild(this);
+
+}
+
+// There's no GUI to keep in sync...
+void CvoxelizerApp::update_gui_from_options() {
+}
+
+void CvoxelizerApp::update_options_from_gui() {
+}
+
+// ...or to pick files with
+int FileBrowse(char* buffer, int length, int save, char* forceExtension,
+	char* extension_string, char* title) {
+
+	_cprintf("Can't browse for files in a headless build\n");
+	return -1;
+}
+
+#else
+
 BOOL CvoxelizerApp::InitInstance() {
 
 	AfxEnableControlContainer();
@@ -776,6 +875,8 @@ int FileBrowse(char* buffer, int length, int save, char* forceExtension,
 	return 0;
 }
 
+#endif // HEADLESS_BUILD
+
 
 int CvoxelizerApp::LoadObjectToVoxelize(char* filename) {
 
@@ -912,6 +1013,8 @@ int CvoxelizerApp::LoadTexture(char* filename) {
 	return 0;
 }
 
+#ifndef HEADLESS_BUILD
+
 void CvoxelizerApp::zoom(int zoom_level) {
 
 	//camera->setPos(p.x,((float)(zoom_level))/100.0*10.0,p.z);
@@ -1061,6 +1164,8 @@ void CvoxelizerApp::select(CPoint p) {
 
 }
 
+#endif
+
 // Our haptic loop... just computes forces on the 
 // phantom every iteration, until haptics are disabled
 // in the supplied CvoxelizerApp
@@ -1440,40 +1545,6 @@ void createChallengingShape(cMesh *mesh, float edge) {
 }
 
 
-#define VECTOR_EQUAL_EPSILON 0.0001
-
-/****
- Note: this is not a stable operator.  It works because
- I know my points won't be all that close relative to
- VECTOR_EQUAL_EPSILON.
-****/
-struct lt_cVector3d {
-	inline bool operator()(const cVector3d& v1, const cVector3d& v2) const
-	{
-
-		// First check for approximate equality
-		if (v1.equals(v2, VECTOR_EQUAL_EPSILON)) return false;
-
-		// Now sort
-		if (v1[0] < v2[0]) return true;
-		else if (v1[0] > v2[0]) return false;
-		else if (v1[1] < v2[1]) return true;
-		else if (v1[1] > v2[1]) return false;
-		else if (v1[2] < v2[2]) return true;
-		else return false;
-	}
-};
-
-
-struct lt_outgoing_vertex_info {
-	inline bool operator()(const outgoing_vertex_info& v1, const outgoing_vertex_info& v2) const
-	{
-		lt_cVector3d compare;
-		return compare(v1.pos, v2.pos);
-	}
-};
-
-
 inline int voxel_index(const int* voxel_resolution, const voxel_id& id) {
 
 	return
@@ -1526,166 +1597,1442 @@ inline voxel_id compute_voxel_id(const cVector3d& coord,
 	return id;
 }
 
-double g_smallest_distance = DBL_MAX;
-double g_largest_distance = -DBL_MAX;
+// The 6-connected neighbor offsets, in the same order that the flood fill's
+// (di,dj,dk) loops visit them
+static const int six_connected_neighbors[6][3] =
+{
+  {-1, 0, 0},
+  { 0,-1, 0},
+  { 0, 0,-1},
+  { 0, 0, 1},
+  { 0, 1, 0},
+  { 1, 0, 0}
+};
 
-void CvoxelizerApp::voxelize_current_object(int operation) {
+// Per-voxel flags written by the parallel ray pass.
+//
+// Bit d is set if the ray from this voxel to neighbor d (in the order of
+// six_connected_neighbors) hits the object we're voxelizing, bit (d+6) is
+// set if it hits any subtractor, and RAYMARK_COMPUTED tells us the pass
+// actually looked at this voxel.
+#define RAYMARK_OBJECT_HIT(d) (1 << (d))
+#define RAYMARK_SUBTRACTOR_HIT(d) (1 << ((d) + 6))
+#define RAYMARK_COMPUTED (1 << 12)
+
+// Number of i-planes handed to a worker at a time
+#define RAYMARK_SLAB_THICKNESS 2
+
+// The same "is this point in the object's bounding box" test the flood
+// fill uses, with the object's transform cached so worker threads don't
+// have to touch the object itself
+struct object_box_test {
+
+	cMatrix3d object_inverse_rot;
+	cVector3d object_global_pos;
+	cVector3d object_min;
+	cVector3d object_max;
+
+	void initialize(cMesh* object) {
+		object->getGlobalRot().transr(object_inverse_rot);
+		object_global_pos = object->getGlobalPos();
+		object_min = object->getBoundaryMin();
+		object_max = object->getBoundaryMax();
+	}
 
-	m_nTets = 0;
+	inline bool in_box(const cVector3d& coordinates) const {
+		cVector3d local_coordinates = coordinates;
+		local_coordinates.sub(object_global_pos);
+		object_inverse_rot.mul(local_coordinates);
+		return cBoxContains(local_coordinates, object_min, object_max);
+	}
 
-	g_smallest_distance = DBL_MAX;
-	g_largest_distance = -DBL_MAX;
+};
 
-	if (object_to_voxelize->containsChild(current_voxelization_point, true) == 0)
-		object_to_voxelize->addChild(current_voxelization_point);
-	if (object_to_voxelize->containsChild(cloud, true) == 0)
-		object_to_voxelize->addChild(cloud);
+// Everything the ray-classification workers need to know about the current
+// voxelization; none of this changes while the workers run
+struct neighbor_ray_job {
 
-	WaitForSingleObject(cloud->point_mutex, INFINITE);
-	cloud->points.clear();
-	ReleaseMutex(cloud->point_mutex);
+	cMesh* object_to_voxelize;
+	std::vector<cMesh*>* objects_to_subtract;
 
-	// Align the object with the world-space axes, to avoid rotation issues
-	cMatrix3d new_rot;
-	new_rot.identity();
+	const int* voxel_resolution;
+	cVector3d voxel_size;
+	cVector3d voxel_start_offset;
 
-	// Make sure the object doesn't have any rotation applied to
-	// it...
-	object_to_voxelize->setRot(new_rot);
+	object_box_test box;
 
-	// Re-center the object, in case the user moved it...
-	object_to_voxelize->setPos(0, 0, 0);
+	unsigned short* ray_marks;
 
-	// Find the boundary box of the object
-	cVector3d object_min = object_to_voxelize->getBoundaryMin();
-	cVector3d object_max = object_to_voxelize->getBoundaryMax();
-	cVector3d span = cSub(object_max, object_min);
+};
 
-	// Increase the effective span by just a little, to make sure we leave room
-	// for all voxels...
-  // TODO: this is undefined just for debugging
-  // #define INCREASE_EFFECTIVE_SPAN
+// Classifies every ray the flood fill could possibly cast from the voxels in
+// one slab of i-planes.
+//
+// The rays are cast exactly as the flood fill casts them; we just record
+// whether they hit anything.  The collision detector is called with a
+// proxy call of -1, so it doesn't write its "last collision" cache and
+// several threads can share one AABB tree.
+void classify_neighbor_rays(void* param, int slab, int thread_index) {
 
-#ifdef INCREASE_EFFECTIVE_SPAN
-	cVector3d spacer = cMul(0.005, span);
-	object_min.sub(spacer);
-	object_max.add(spacer);
-	span = cSub(object_max, object_min);
-#endif
+	neighbor_ray_job* job = (neighbor_ray_job*)(param);
+	const int* voxel_resolution = job->voxel_resolution;
 
-	_cprintf("max min span (%lf,%lf,%lf) (%lf,%lf,%lf) (%lf,%lf,%lf)\n",
-		object_max.x, object_max.y, object_max.z,
-		object_min.x, object_min.y, object_min.z,
-		span.x, span.y, span.z);
+	int first_i = slab * RAYMARK_SLAB_THICKNESS;
+	int last_i = first_i + RAYMARK_SLAB_THICKNESS;
+	if (last_i > voxel_resolution[0]) last_i = voxel_resolution[0];
 
-	// Move the object to put its bounding box's minimum coordinate at (0,0,0)
-	// 
-	// That is, move it by (the opposite of its position + the opposite of its minimum)
-	old_object_pos = object_to_voxelize->getPos();
-	object_to_voxelize->translate(cMul(-1.0, old_object_pos));
-	object_to_voxelize->translate(cMul(-1.0, object_min));
+	for (int i = first_i; i < last_i; i++) {
+		for (int j = 0; j < voxel_resolution[1]; j++) {
+			for (int k = 0; k < voxel_resolution[2]; k++) {
 
-	_cprintf("Moving object from (%lf,%lf,%lf) to (%lf,%lf,%lf)\n",
-		old_object_pos.x, old_object_pos.y, old_object_pos.z,
-		object_to_voxelize->getPos().x, object_to_voxelize->getPos().y, object_to_voxelize->getPos().z);
+				voxel_id cur_voxel = { i,j,k };
 
-	_cprintf("Initializing subtractors...\n");
+				cVector3d voxel_coordinates;
+				compute_voxel_coordinate(cur_voxel, voxel_coordinates, job->voxel_size, job->voxel_start_offset);
 
-	if (objects_to_subtract.size() > 0) {
-		for (unsigned int i = 0; i < objects_to_subtract.size(); i++) {
-			cMesh* object_to_subtract = objects_to_subtract[i];
+				// The flood fill never casts rays from voxels outside the box
+				if (job->box.in_box(voxel_coordinates) == false) continue;
 
-			// This works because the same transformations were applied to
-			// all objects at load-time
-			object_to_subtract->setRot(new_rot);
-			object_to_subtract->setPos(0, 0, 0);
-			object_to_subtract->translate(cMul(-1.0, old_object_pos));
-			object_to_subtract->translate(cMul(-1.0, object_min));
-			object_to_subtract->computeGlobalPositions(false);
+				unsigned short marks = RAYMARK_COMPUTED;
 
-		}
-	}
+				for (int d = 0; d < 6; d++) {
 
-	_cprintf("Initializing modifiers...\n");
+					int di = six_connected_neighbors[d][0];
+					int dj = six_connected_neighbors[d][1];
+					int dk = six_connected_neighbors[d][2];
 
-	if (modifier_objects.size() > 0) {
-		for (unsigned int i = 0; i < modifier_objects.size(); i++) {
-			cMesh* modifier_object = modifier_objects[i];
+					voxel_id neighbor = cur_voxel;
+					neighbor.i += di;
+					neighbor.j += dj;
+					neighbor.k += dk;
 
-			// This works because the same transformations were applied to
-			// all objects at load-time
-			modifier_object->setRot(new_rot);
-			modifier_object->setPos(0, 0, 0);
-			modifier_object->translate(cMul(-1.0, old_object_pos));
-			modifier_object->translate(cMul(-1.0, object_min));
-			modifier_object->computeGlobalPositions(false);
-		}
-	}
+					// Neighbors outside the grid are handled by the flood fill
+					// without casting rays
+					if (
+						neighbor.i < 0 || neighbor.i >= voxel_resolution[0] ||
+						neighbor.j < 0 || neighbor.j >= voxel_resolution[1] ||
+						neighbor.k < 0 || neighbor.k >= voxel_resolution[2]
+						) continue;
 
-	// Man did this get me for a while...
-	//
-	// Note that I'm doing a computeGlobal for every vertex
-	_cprintf("Computing global vertex positions...\n");
-	object_to_voxelize->computeGlobalPositions(false);
-	_cprintf("Done computing vertex positions...\n");
+					cVector3d neighbor_coordinates;
+					compute_voxel_coordinate(neighbor, neighbor_coordinates, job->voxel_size, job->voxel_start_offset);
 
-	object_to_voxelize->computeBoundaryBox(true);
+					if (job->box.in_box(neighbor_coordinates) == false) continue;
 
-	// #define PRINT_ALL_VOXELS
+					cVector3d offset(
+						COLLISION_OFFSET_FACTOR*job->voxel_size.x*(float)di,
+						COLLISION_OFFSET_FACTOR*job->voxel_size.y*(float)dj,
+						COLLISION_OFFSET_FACTOR*job->voxel_size.z*(float)dk
+					);
 
-#ifdef ISOTROPIC_VOXELS
+					cGenericObject* colObject;
+					cTriangle*      colTriangle;
+					cVector3d       colPoint;
+					double          colSquareDistance = DBL_MAX;
 
-  // The resolution along the largest axis
-#define MAX_VOXEL_RESOLUTION VOXEL_RESOLUTION
+					for (unsigned int subtractor_index = 0; subtractor_index < job->objects_to_subtract->size(); subtractor_index++) {
 
-// The largest axis of this object
-	float max_span = (float)(max(span.x, max(span.y, span.z)));
+						cMesh* object_to_subtract = (*(job->objects_to_subtract))[subtractor_index];
 
-	// This is the isotropic voxel size
-	float voxel_edge = max_span / ((float)m_long_axis_resolution);
+						cVector3d start_point = voxel_coordinates;
+						int result = object_to_subtract->computeCollisionDetection(
+							start_point, cAdd(neighbor_coordinates, offset),
+							colObject, colTriangle, colPoint, colSquareDistance,
+							0, -1);
 
-	// Compute the resolution of each axis
-	voxel_resolution[0] = (int)ceil(span.x / voxel_edge);
-	voxel_resolution[1] = (int)ceil(span.y / voxel_edge);
-	voxel_resolution[2] = (int)ceil(span.z / voxel_edge);
+						if (result) {
+							marks |= RAYMARK_SUBTRACTOR_HIT(d);
+							break;
+						}
+					}
 
-	// Compute the size of each voxel
-	voxel_size.x = voxel_size.y = voxel_size.z = voxel_edge;
+					// The flood fill doesn't look at the object if a subtractor
+					// got in the way
+					if (marks & RAYMARK_SUBTRACTOR_HIT(d)) continue;
 
-	// Compute the total number of voxels
-	unsigned int total_num_voxels =
-		voxel_resolution[0] * voxel_resolution[1] * voxel_resolution[2];
+					colSquareDistance = DBL_MAX;
 
-	// Anisotropic voxels
-#else
+					cVector3d start_point = voxel_coordinates;
+					cVector3d end_point;
+					neighbor_coordinates.addr(offset, end_point);
 
-  // Compute the resolution of each axis
-	voxel_resolution[0] = voxel_resolution[1] = voxel_resolution[2] = VOXEL_RESOLUTION;
+					int result = job->object_to_voxelize->computeCollisionDetection(
+						start_point, end_point,
+						colObject, colTriangle, colPoint, colSquareDistance,
+						0, -1);
 
-	// Compute the size of each voxel
-	voxel_size.x = span.x / ((double)(voxel_resolution[0]));
-	voxel_size.y = span.y / ((double)(voxel_resolution[1]));
-	voxel_size.z = span.z / ((double)(voxel_resolution[2]));
+					if (result) marks |= RAYMARK_OBJECT_HIT(d);
 
-	// Compute the total number of voxels
-	unsigned int total_num_voxels =
-		voxel_resolution[0] * voxel_resolution[1] * voxel_resolution[2];
+				} // for each neighbor
 
-#endif
+				job->ray_marks[voxel_index(voxel_resolution, cur_voxel)] = marks;
 
-	_cprintf("Voxel size is %lf,%lf,%lf\n", voxel_size.x, voxel_size.y, voxel_size.z);
-	_cprintf("Voxel resolution is %d x %d x %d\n", voxel_resolution[0], voxel_resolution[1], voxel_resolution[2]);
+			} // for each k
+		} // for each j
+	} // for each i in this slab
 
-	// Compute the closest-point-transform...
-	// cpt_current_object();
+}
 
-	// Create an array to hold information about whether we've already
-	// processed a voxel
-	unsigned char* voxel_marks = new unsigned char[total_num_voxels];
-	memset(voxel_marks, 0, total_num_voxels);
+double g_smallest_distance = DBL_MAX;
+double g_largest_distance = -DBL_MAX;
 
-	// Create a stack of voxels that we still want to process
-	voxel_list voxel_stack;
+// Fills in the texture coordinate and normal for a voxel that lies just
+// outside the surface, given the triangle that the ray from its inside
+// neighbor hit and the hit point (in object local space)
+void fill_surface_voxel_record(voxelfile_voxel& file_voxel, cTriangle* colTriangle,
+	const cVector3d& colPoint) {
+
+	// In order to interpolate between vertices, we'll have
+	// to find barycentric coordinates for the intersection point
+
+	// From :
+	//
+	// http://kurtm.flipcode.com/devlog-VoxelMeshCreationandRendering.shtml
+
+	/*
+	a = area(Source Triangle)
+
+	bu = area([T1, T2, PT]) / a
+	bv = area([T2, T0, PT]) / a
+	bw = area([T0, T1, PT]) / a
+	*/
+
+	// These points are all in object local space...
+	cVector3d p0 = colTriangle->getVertex(0)->getPos();
+	cVector3d p1 = colTriangle->getVertex(1)->getPos();
+	cVector3d p2 = colTriangle->getVertex(2)->getPos();
+
+	raw_triangle source_triangle(p0, p1, p2);
+
+	float a = source_triangle.compute_area();
+
+	raw_triangle t1t2pt(p1, p2, colPoint);
+	raw_triangle t2t0pt(p2, p0, colPoint);
+	raw_triangle t0t1pt(p0, p1, colPoint);
+
+	float a0 = t1t2pt.compute_area();
+	float a1 = t2t0pt.compute_area();
+	float a2 = t0t1pt.compute_area();
+
+	float bu = a0 / a;
+	float bv = a1 / a;
+	float bw = a2 / a;
+
+	/*
+	TU = (bu * T0.TU) + (bv * T1.TU) + (bw * T2.TU);
+	TV = (bv * T0.TV) + (bv * T1.TV) + (bw * T2.TV);
+	*/
+
+	// Interpolate in barycentric coordinates
+	float u = bu * colTriangle->getVertex(0)->getTexCoord().x +
+		bv * colTriangle->getVertex(1)->getTexCoord().x +
+		bw * colTriangle->getVertex(2)->getTexCoord().x;
+
+	float v = bu * colTriangle->getVertex(0)->getTexCoord().y +
+		bv * colTriangle->getVertex(1)->getTexCoord().y +
+		bw * colTriangle->getVertex(2)->getTexCoord().y;
+
+	// A simpler scheme, for debugging...
+	/*
+	u = colTriangle->getVertex(0)->getTexCoord().x +
+		colTriangle->getVertex(1)->getTexCoord().x +
+		colTriangle->getVertex(2)->getTexCoord().x;
+	u/=3.0;
+
+	v = colTriangle->getVertex(0)->getTexCoord().y +
+		colTriangle->getVertex(1)->getTexCoord().y +
+		colTriangle->getVertex(2)->getTexCoord().y;
+	v/=3.0;
+	*/
+
+	file_voxel.u = u;
+	file_voxel.v = v;
+	file_voxel.has_texture = 1;
+	file_voxel.has_normal = 1;
+
+	cVector3d n;
+
+	static int printed_normal_status = 0;
+
+#if (NORMAL_SOURCE == NORMAL_SOURCE_TRIANGLE_FACE)
+
+	// Insert a normal for this voxel also, based on this triangle's face normal...
+	cVector3d nv1 = cSub(p1, p0);
+	cVector3d nv2 = cSub(p2, p0);
+	n = cCross(nv1, nv2);
+	n.normalize();
+
+	if (printed_normal_status == 0) {
+		_cprintf("Using face normals...\n");
+		printed_normal_status = 1;
+	}
+
+#elif (NORMAL_SOURCE == NORMAL_SOURCE_VERTEX_NORMALS)
+
+	if (printed_normal_status == 0) {
+		_cprintf("Using vertex normals...\n");
+		printed_normal_status = 1;
+	}
+
+	// Insert a normal for this voxel also, based on vertex normals...
+	cVector3d v0n = colTriangle->getVertex(0)->getNormal();
+	cVector3d v1n = colTriangle->getVertex(1)->getNormal();
+	cVector3d v2n = colTriangle->getVertex(2)->getNormal();
+
+	double d0 = cDistance(colPoint, colTriangle->getVertex(0)->getPos());
+	double d1 = cDistance(colPoint, colTriangle->getVertex(1)->getPos());
+	double d2 = cDistance(colPoint, colTriangle->getVertex(2)->getPos());
+
+	double totald = d0 + d1 + d2;
+	n = (v0n * (totald - d0)) + (v1n * (totald - d1)) + (v2n * (totald - d2));
+	n.normalize();
+
+#elif (NORMAL_SOURCE == NORMAL_SOURCE_NONE)
+
+	file_voxel.has_normal = 0;
+
+#else 
+	_cprintf("Unrecognized normal computation scheme...\n");
+#endif            
+
+	file_voxel.normal[0] = n.x;
+	file_voxel.normal[1] = n.y;
+	file_voxel.normal[2] = n.z;
+
+}
+
+// Edge length, in voxels, of the bricks we hand to the distance tree as a
+// single packet; a brick's worth of voxels has to fit in one packet
+#define DISTANCE_BRICK_SIZE 8
+
+// Everything the distance-field workers need; each thread has its own
+// packet and its own running min/max
+struct distance_field_job {
+
+	voxel_attribute_grid* voxels;
+	const aabb_distance_tree* tree;
+
+	const int* voxel_resolution;
+	int num_bricks[3];
+	cVector3d voxel_size;
+	cVector3d voxel_start_offset;
+
+	std::vector<distance_packet> packets;
+	std::vector< std::vector<voxelfile_voxel*> > packet_voxels;
+	std::vector<double> min_distance;
+	std::vector<double> max_distance;
+
+};
+
+// Computes surface distances for the voxel records in one brick of the
+// grid.
+//
+// Only records with has_distance set are filled in (the fill sets it on
+// every voxel it wants a distance for).  The gradient points from the voxel
+// toward the surface, and is flipped for surface voxels, whose centers are
+// outside the object.  (Modifiers are done separately, all at once; see
+// compute_brick_modifier_distances.)
+void compute_brick_distances(void* param, int brick, int thread_index) {
+
+	distance_field_job* job = (distance_field_job*)(param);
+
+	int bk = brick % job->num_bricks[2];
+	int bj = (brick / job->num_bricks[2]) % job->num_bricks[1];
+	int bi = brick / (job->num_bricks[2] * job->num_bricks[1]);
+
+	int first[3] = { bi*DISTANCE_BRICK_SIZE, bj*DISTANCE_BRICK_SIZE, bk*DISTANCE_BRICK_SIZE };
+	int last[3];
+	for (int k = 0; k < 3; k++) {
+		last[k] = first[k] + DISTANCE_BRICK_SIZE;
+		if (last[k] > job->voxel_resolution[k]) last[k] = job->voxel_resolution[k];
+	}
+
+	distance_packet& packet = job->packets[thread_index];
+	std::vector<voxelfile_voxel*>& records = job->packet_voxels[thread_index];
+	packet.clear();
+	records.clear();
+
+	for (int i = first[0]; i < last[0]; i++) {
+		for (int j = first[1]; j < last[1]; j++) {
+			for (int k = first[2]; k < last[2]; k++) {
+
+				voxelfile_voxel* v = job->voxels->find(i, j, k);
+				if (v == 0) continue;
+				if (v->has_distance == 0) continue;
+
+				voxel_id vid = { (short)i, (short)j, (short)k };
+				cVector3d coordinates;
+				compute_voxel_coordinate(vid, coordinates, job->voxel_size, job->voxel_start_offset);
+
+				packet.add_point(coordinates);
+				records.push_back(v);
+			}
+		}
+	}
+
+	if (packet.num_points == 0) return;
+
+	job->tree->query(packet);
+
+	for (int q = 0; q < packet.num_points; q++) {
+
+		voxelfile_voxel* v = records[q];
+		double d = sqrt(packet.sq_distance[q]);
+
+		if (d < job->min_distance[thread_index]) job->min_distance[thread_index] = d;
+		if (d > job->max_distance[thread_index]) job->max_distance[thread_index] = d;
+
+		cVector3d gradient(
+			packet.closest_x[q] - packet.x[q],
+			packet.closest_y[q] - packet.y[q],
+			packet.closest_z[q] - packet.z[q]);
+		gradient.normalize();
+
+		// This center is _outside_ the object
+		if (v->is_on_border == BORDER_TAG_NEIGHBOR_COLLISION) gradient.mul(-1.0);
+
+		v->distance_to_surface = d;
+		v->distance_gradient[0] = gradient.x;
+		v->distance_gradient[1] = gradient.y;
+		v->distance_gradient[2] = gradient.z;
+	}
+
+}
+
+// Computes distances from the voxel records in [voxels] to [mesh], one
+// brick of the grid at a time (see compute_brick_distances), and returns
+// the smallest and largest distances it found.
+//
+// Returns the number of threads that did the work.
+int compute_distance_field(voxel_attribute_grid& voxels, cMesh* mesh,
+	const int* voxel_resolution, const cVector3d& voxel_size, const cVector3d& voxel_start_offset,
+	int num_threads, double& min_distance, double& max_distance) {
+
+	aabb_distance_tree tree;
+	tree.build(mesh);
+
+	distance_field_job job;
+	job.voxels = &voxels;
+	job.tree = &tree;
+	job.voxel_resolution = voxel_resolution;
+	job.voxel_size = voxel_size;
+	job.voxel_start_offset = voxel_start_offset;
+
+	int total_bricks = 1;
+	for (int k = 0; k < 3; k++) {
+		job.num_bricks[k] = (voxel_resolution[k] + DISTANCE_BRICK_SIZE - 1) / DISTANCE_BRICK_SIZE;
+		total_bricks *= job.num_bricks[k];
+	}
+
+	num_threads = parallel_resolve_num_threads(num_threads);
+	job.packets.resize(num_threads);
+	job.packet_voxels.resize(num_threads);
+	job.min_distance.resize(num_threads, DBL_MAX);
+	job.max_distance.resize(num_threads, -DBL_MAX);
+
+	int threads_used = parallel_for_chunks(total_bricks, compute_brick_distances, &job, num_threads);
+
+	min_distance = DBL_MAX;
+	max_distance = -DBL_MAX;
+	for (int t = 0; t < num_threads; t++) {
+		if (job.min_distance[t] < min_distance) min_distance = job.min_distance[t];
+		if (job.max_distance[t] > max_distance) max_distance = job.max_distance[t];
+	}
+
+	return threads_used;
+}
+
+// Everything the modifier-distance workers need.  All the modifiers are
+// done in one pass over the grid: each brick's packet is gathered once and
+// then run through every modifier's tree.
+struct modifier_distance_job {
+
+	voxel_attribute_grid* voxels;
+	const std::vector<cMesh*>* meshes;
+	std::vector<aabb_distance_tree> trees;
+
+	const int* voxel_resolution;
+	int num_bricks[3];
+	cVector3d voxel_size;
+	cVector3d voxel_start_offset;
+
+	std::vector<distance_packet> packets;
+	std::vector< std::vector<voxelfile_voxel*> > packet_voxels;
+
+	// Running min/max for each thread and modifier, indexed by
+	// thread * num_modifiers + modifier
+	std::vector<double> min_distance;
+	std::vector<double> max_distance;
+
+};
+
+// Builds the distance tree for one modifier
+void build_modifier_tree(void* param, int modifier, int thread_index) {
+	modifier_distance_job* job = (modifier_distance_job*)(param);
+	job->trees[modifier].build((*(job->meshes))[modifier]);
+}
+
+// Computes distances from the voxel records in one brick of the grid to
+// every modifier.  Each record gets a distance and a gradient that points
+// toward the modifier; the first MAX_NUM_MODIFIERS also go in the record
+// itself.
+void compute_brick_modifier_distances(void* param, int brick, int thread_index) {
+
+	modifier_distance_job* job = (modifier_distance_job*)(param);
+
+	int num_modifiers = (int)(job->trees.size());
+
+	int bk = brick % job->num_bricks[2];
+	int bj = (brick / job->num_bricks[2]) % job->num_bricks[1];
+	int bi = brick / (job->num_bricks[2] * job->num_bricks[1]);
+
+	int first[3] = { bi*DISTANCE_BRICK_SIZE, bj*DISTANCE_BRICK_SIZE, bk*DISTANCE_BRICK_SIZE };
+	int last[3];
+	for (int k = 0; k < 3; k++) {
+		last[k] = first[k] + DISTANCE_BRICK_SIZE;
+		if (last[k] > job->voxel_resolution[k]) last[k] = job->voxel_resolution[k];
+	}
+
+	distance_packet& packet = job->packets[thread_index];
+	std::vector<voxelfile_voxel*>& records = job->packet_voxels[thread_index];
+	packet.clear();
+	records.clear();
+
+	for (int i = first[0]; i < last[0]; i++) {
+		for (int j = first[1]; j < last[1]; j++) {
+			for (int k = first[2]; k < last[2]; k++) {
+
+				voxelfile_voxel* v = job->voxels->find(i, j, k);
+				if (v == 0) continue;
+
+				voxel_id vid = { (short)i, (short)j, (short)k };
+				cVector3d coordinates;
+				compute_voxel_coordinate(vid, coordinates, job->voxel_size, job->voxel_start_offset);
+
+				packet.add_point(coordinates);
+				records.push_back(v);
+			}
+		}
+	}
+
+	if (packet.num_points == 0) return;
+
+	double* min_distance = &(job->min_distance[thread_index * num_modifiers]);
+	double* max_distance = &(job->max_distance[thread_index * num_modifiers]);
+
+	for (int m = 0; m < num_modifiers; m++) {
+
+		job->trees[m].query(packet);
+
+		for (int q = 0; q < packet.num_points; q++) {
+
+			voxelfile_voxel* v = records[q];
+			double d = sqrt(packet.sq_distance[q]);
+
+			if (d < min_distance[m]) min_distance[m] = d;
+			if (d > max_distance[m]) max_distance[m] = d;
+
+			cVector3d gradient(
+				packet.closest_x[q] - packet.x[q],
+				packet.closest_y[q] - packet.y[q],
+				packet.closest_z[q] - packet.z[q]);
+			gradient.normalize();
+
+			float* modifiers = job->voxels->modifiers(v) + m * 4;
+			modifiers[0] = (float)(d);
+			modifiers[1] = (float)(gradient.x);
+			modifiers[2] = (float)(gradient.y);
+			modifiers[3] = (float)(gradient.z);
+
+			if (m < MAX_NUM_MODIFIERS) {
+				v->distance_to_modifier[m] = d;
+				v->modifier_gradient[m][0] = gradient.x;
+				v->modifier_gradient[m][1] = gradient.y;
+				v->modifier_gradient[m][2] = gradient.z;
+			}
+		}
+	}
+
+	for (int q = 0; q < packet.num_points; q++)
+		records[q]->num_modifiers = (unsigned char)(num_modifiers);
+
+}
+
+// Computes distances from every record in [voxels] to every mesh in
+// [modifiers] (at most 255 of them), storing them in [voxels]' modifier
+// array.  [min_distance] and [max_distance] get one entry per modifier.
+//
+// Returns the number of threads that did the work.
+int compute_modifier_distances(voxel_attribute_grid& voxels, const std::vector<cMesh*>& modifiers,
+	const int* voxel_resolution, const cVector3d& voxel_size, const cVector3d& voxel_start_offset,
+	int num_threads, std::vector<double>& min_distance, std::vector<double>& max_distance) {
+
+	int num_modifiers = (int)(modifiers.size());
+
+	voxels.set_num_modifiers(num_modifiers);
+
+	modifier_distance_job job;
+	job.voxels = &voxels;
+	job.meshes = &modifiers;
+	job.trees.resize(num_modifiers);
+	job.voxel_resolution = voxel_resolution;
+	job.voxel_size = voxel_size;
+	job.voxel_start_offset = voxel_start_offset;
+
+	num_threads = parallel_resolve_num_threads(num_threads);
+
+	parallel_for_chunks(num_modifiers, build_modifier_tree, &job, num_threads);
+
+	int total_bricks = 1;
+	for (int k = 0; k < 3; k++) {
+		job.num_bricks[k] = (voxel_resolution[k] + DISTANCE_BRICK_SIZE - 1) / DISTANCE_BRICK_SIZE;
+		total_bricks *= job.num_bricks[k];
+	}
+
+	job.packets.resize(num_threads);
+	job.packet_voxels.resize(num_threads);
+	job.min_distance.resize(num_threads * num_modifiers, DBL_MAX);
+	job.max_distance.resize(num_threads * num_modifiers, -DBL_MAX);
+
+	int threads_used = parallel_for_chunks(total_bricks, compute_brick_modifier_distances, &job, num_threads);
+
+	min_distance.assign(num_modifiers, DBL_MAX);
+	max_distance.assign(num_modifiers, -DBL_MAX);
+	for (int t = 0; t < num_threads; t++) {
+		for (int m = 0; m < num_modifiers; m++) {
+			if (job.min_distance[t * num_modifiers + m] < min_distance[m])
+				min_distance[m] = job.min_distance[t * num_modifiers + m];
+			if (job.max_distance[t * num_modifiers + m] > max_distance[m])
+				max_distance[m] = job.max_distance[t * num_modifiers + m];
+		}
+	}
+
+	return threads_used;
+}
+
+
+// Gathers the AABB collision detectors for a mesh and all of its cMesh
+// descendants.
+//
+// All of these trees are treated as living in [mesh]'s local space, i.e.
+// children are assumed not to be offset from their parents, which is the
+// case for everything our importers produce.
+void collect_mesh_colliders(cMesh* mesh, std::list<cCollisionAABB*>& colliders) {
+
+	// This will hold all the parents we're still searching...
+	std::list<cMesh*> meshes_to_descend;
+
+	meshes_to_descend.push_front(mesh);
+
+	// While there are still parent meshes to process
+	while (meshes_to_descend.empty() == 0) {
+
+		// Grab the next parent
+		cMesh* cur_mesh = meshes_to_descend.front();
+		meshes_to_descend.pop_front();
+
+		cCollisionAABB* collider = (cCollisionAABB*)(cur_mesh->getCollisionDetector());
+		if (collider) colliders.push_front(collider);
+
+		// Put all his children on the list of parents to process
+		for (unsigned int i = 0; i < cur_mesh->getNumChildren(); i++) {
+
+			cGenericObject* cur_object = cur_mesh->getChild(i);
+
+			// Only process cMesh children
+			cMesh* child_mesh = dynamic_cast<cMesh*>(cur_object);
+			if (child_mesh) meshes_to_descend.push_back(child_mesh);
+		}
+	}
+
+}
+
+inline bool aabb_boxes_overlap(const cCollisionAABBBox& b1, const cCollisionAABBBox& b2) {
+	if (b1.m_max.x < b2.m_min.x || b2.m_max.x < b1.m_min.x) return false;
+	if (b1.m_max.y < b2.m_min.y || b2.m_max.y < b1.m_min.y) return false;
+	if (b1.m_max.z < b2.m_min.z || b2.m_max.z < b1.m_min.z) return false;
+	return true;
+}
+
+// One place where a segment crosses a triangle
+struct segment_crossing {
+
+	// Distance from the start of the segment
+	double distance;
+
+	// 1 if the triangle faces along the segment (we're leaving the surface),
+	// -1 if it faces back toward the start (we're entering it)
+	int side;
+
+	bool operator<(const segment_crossing& c) const { return distance < c.distance; }
+};
+
+// Finds _every_ place where the segment from a to b crosses a triangle in
+// any of the supplied trees (CHAI's own segment test only reports the
+// closest one), and appends each crossing to [crossings].
+//
+// a and b are in the trees' local space.  Only reads the trees, so this is
+// safe to call from several threads at once.
+void collect_segment_crossings(const std::list<cCollisionAABB*>& colliders,
+	const cVector3d& a, const cVector3d& b, std::vector<segment_crossing>& crossings) {
+
+	cVector3d dir = cSub(b, a);
+	double segment_sq_length = dir.lengthsq();
+
+	cCollisionAABBBox segment_box;
+	segment_box.setEmpty();
+	segment_box.enclose(a);
+	segment_box.enclose(b);
+
+	std::vector<cCollisionAABBNode*> node_stack;
+
+	std::list<cCollisionAABB*>::const_iterator collider_iter;
+	for (collider_iter = colliders.begin(); collider_iter != colliders.end(); collider_iter++) {
+
+		cCollisionAABBNode* root = (*collider_iter)->getRoot();
+		if (root == 0) continue;
+
+		node_stack.push_back(root);
+
+		while (node_stack.empty() == 0) {
+
+			cCollisionAABBNode* cur_node = node_stack.back();
+			node_stack.pop_back();
+
+			if (aabb_boxes_overlap(cur_node->m_bbox, segment_box) == false) continue;
+
+			cCollisionAABBLeaf* leaf = dynamic_cast<cCollisionAABBLeaf*>(cur_node);
+
+			if (leaf) {
+
+				cGenericObject* colObject;
+				cTriangle* colTriangle;
+				cVector3d colPoint;
+
+				// Anything closer than the end of the segment counts
+				double colSquareDistance = segment_sq_length;
+
+				cTriangle* tri = leaf->m_triangle;
+				if (tri->computeCollision(a, dir, colObject, colTriangle, colPoint, colSquareDistance)) {
+					cVector3d p0 = tri->getVertex(0)->getPos();
+					cVector3d normal = cCross(cSub(tri->getVertex(1)->getPos(), p0), cSub(tri->getVertex(2)->getPos(), p0));
+					segment_crossing crossing;
+					crossing.distance = sqrt(colSquareDistance);
+					crossing.side = (cDot(normal, dir) > 0) ? 1 : -1;
+					crossings.push_back(crossing);
+				}
+
+				continue;
+			}
+
+			cCollisionAABBInternal* internal = dynamic_cast<cCollisionAABBInternal*>(cur_node);
+			if (internal->m_leftSubTree) node_stack.push_back(internal->m_leftSubTree);
+			if (internal->m_rightSubTree) node_stack.push_back(internal->m_rightSubTree);
+		}
+	}
+
+}
+
+// A mesh that the scanline fill casts column rays through
+struct scanline_mesh {
+
+	std::list<cCollisionAABB*> colliders;
+
+	// Global position of the mesh; the trees live in space relative to this
+	cVector3d pos;
+
+	// Global extent of the mesh along the scan (x) axis
+	double min_x, max_x;
+
+	void initialize(cMesh* mesh) {
+		collect_mesh_colliders(mesh, colliders);
+		pos = mesh->getPos();
+		min_x = mesh->getBoundaryMin().x + pos.x;
+		max_x = mesh->getBoundaryMax().x + pos.x;
+	}
+
+};
+
+// Crossings closer together than this (as a fraction of the voxel size)
+// happened at the same point, i.e. on an edge or vertex shared by several
+// triangles.  Those that face the same way are one crossing; a ray that
+// grazes a silhouette edge or vertex hits one triangle facing each way, and
+// enters and leaves the surface at that point.
+#define SCANLINE_DUPLICATE_CROSSING_TOLERANCE 1.0e-6
+
+// Classifies each of [n] voxel centers along an x-axis column as inside or
+// outside [mesh] by counting surface crossings (parity).  first_x is the
+// global x coordinate of the first center, and y,z are the column's global
+// coordinates.  Sets inside[i] to 1 for centers inside the surface.
+void classify_column_by_parity(const scanline_mesh& mesh, double first_x, double spacing,
+	double y, double z, int n, std::vector<segment_crossing>& crossings, unsigned char* inside) {
+
+	memset(inside, 0, n);
+
+	double last_x = first_x + spacing * (double)(n - 1);
+
+	// Start and end the ray outside the mesh, so we know the parity at the start
+	double start_x = ((first_x < mesh.min_x) ? first_x : mesh.min_x) - spacing;
+	double end_x = ((last_x > mesh.max_x) ? last_x : mesh.max_x) + spacing;
+
+	cVector3d a(start_x, y, z);
+	cVector3d b(end_x, y, z);
+	a.sub(mesh.pos);
+	b.sub(mesh.pos);
+
+	crossings.clear();
+	collect_segment_crossings(mesh.colliders, a, b, crossings);
+	if (crossings.size() == 0) return;
+
+	std::sort(crossings.begin(), crossings.end());
+
+	double tolerance = spacing * SCANLINE_DUPLICATE_CROSSING_TOLERANCE;
+
+	unsigned int next_crossing = 0;
+	double last_crossing = -DBL_MAX;
+	int num_crossings = 0;
+
+	// Which sides (bit 0 for entering, bit 1 for leaving) we've already
+	// counted at the point we're crossing at
+	int sides_counted = 0;
+
+	for (int i = 0; i < n; i++) {
+
+		double t = (first_x + spacing * (double)i) - start_x;
+
+		// Count every (distinct) crossing before this center
+		while (next_crossing < crossings.size() && crossings[next_crossing].distance < t) {
+			const segment_crossing& crossing = crossings[next_crossing];
+			int side_bit = (crossing.side > 0) ? 2 : 1;
+			if (crossing.distance - last_crossing > tolerance) sides_counted = 0;
+			if ((sides_counted & side_bit) == 0) {
+				num_crossings++;
+				sides_counted |= side_bit;
+			}
+			last_crossing = crossing.distance;
+			next_crossing++;
+		}
+
+		if (num_crossings & 1) inside[i] = 1;
+	}
+
+}
+
+// Everything the scanline workers need; none of this changes while they run
+struct scanline_job {
+
+	scanline_mesh object;
+	std::vector<scanline_mesh> subtractors;
+
+	const int* voxel_resolution;
+	cVector3d voxel_size;
+	cVector3d voxel_start_offset;
+
+	// Filled in by the workers
+	unsigned char* voxel_marks;
+
+};
+
+// Classifies every voxel in one j-plane of the grid, casting one ray along
+// x for each k.  Voxels inside the object (and not inside any subtractor)
+// are marked VOXELMARK_INVOLUME_UNTEXTURED, voxels inside a subtractor are
+// marked VOXELMARK_NOTINVOLUME, and everything else is left alone.
+void scanline_classify_plane(void* param, int j, int thread_index) {
+
+	scanline_job* job = (scanline_job*)(param);
+	const int* voxel_resolution = job->voxel_resolution;
+	int n = voxel_resolution[0];
+
+	std::vector<segment_crossing> crossings;
+	std::vector<unsigned char> inside(n);
+	std::vector<unsigned char> subtracted(n);
+
+	for (int k = 0; k < voxel_resolution[2]; k++) {
+
+		voxel_id first_voxel = { 0,j,k };
+		cVector3d first_center;
+		compute_voxel_coordinate(first_voxel, first_center, job->voxel_size, job->voxel_start_offset);
+
+		classify_column_by_parity(job->object, first_center.x, job->voxel_size.x,
+			first_center.y, first_center.z, n, crossings, &(inside[0]));
+
+		memset(&(subtracted[0]), 0, n);
+		for (unsigned int s = 0; s < job->subtractors.size(); s++) {
+			std::vector<unsigned char> inside_subtractor(n);
+			classify_column_by_parity(job->subtractors[s], first_center.x, job->voxel_size.x,
+				first_center.y, first_center.z, n, crossings, &(inside_subtractor[0]));
+			for (int i = 0; i < n; i++) subtracted[i] |= inside_subtractor[i];
+		}
+
+		for (int i = 0; i < n; i++) {
+			voxel_id id = { i,j,k };
+			int index = voxel_index(voxel_resolution, id);
+			if (subtracted[i]) job->voxel_marks[index] = VOXELMARK_NOTINVOLUME;
+			else if (inside[i]) job->voxel_marks[index] = VOXELMARK_INVOLUME_UNTEXTURED;
+		}
+	}
+
+}
+
+// Writes a version 1 .voxels file: a mark for every voxel in the grid, and a
+// voxelfile_voxel after each textured one.  Only the first
+// MAX_NUM_MODIFIERS modifiers fit.
+//
+// Returns false if the file couldn't be written.
+bool write_voxel_file_v1(const char* filename, const voxelfile_object_header& object_hdr,
+	const unsigned char* voxel_marks, voxel_attribute_grid& textured_voxels) {
+
+	FILE* binary_f = fopen(filename, "wb");
+
+	if (binary_f == 0) {
+		_cprintf("Could not open binary output file %s\n", filename);
+		return false;
+	}
+
+	// Write out binary file header and object header
+	voxelfile_file_header file_hdr;
+	file_hdr.header_size = sizeof(file_hdr);
+	file_hdr.object_header_size = sizeof(voxelfile_object_header);
+	file_hdr.voxel_struct_size = sizeof(voxelfile_voxel);
+	file_hdr.num_objects = 1;
+
+	fwrite(&file_hdr, sizeof(file_hdr), 1, binary_f);
+
+	_cprintf("File header is %d bytes\n", file_hdr.header_size);
+	_cprintf("Object header is %d bytes\n", file_hdr.object_header_size);
+	_cprintf("Voxel struct is %d bytes\n", file_hdr.voxel_struct_size);
+
+	fwrite(&object_hdr, sizeof(object_hdr), 1, binary_f);
+
+	if (textured_voxels.num_modifiers() > MAX_NUM_MODIFIERS)
+		_cprintf("Warning: version 1 files only hold %d of the %d modifiers\n",
+			MAX_NUM_MODIFIERS, textured_voxels.num_modifiers());
+
+	const int* voxel_resolution = object_hdr.voxel_resolution;
+
+	for (int i = 0; i < voxel_resolution[0]; i++) {
+
+		for (int j = 0; j < voxel_resolution[1]; j++) {
+			for (int k = 0; k < voxel_resolution[2]; k++) {
+
+				voxel_id vi = { i,j,k };
+
+				int index = voxel_index(voxel_resolution, vi);
+
+				int mark = voxel_marks[index];
+
+				if (mark == VOXELMARK_NOTINVOLUME) fputc(ASCIIVOXEL_NOVOXEL, binary_f);
+
+				/*
+				else if (mark == VOXELMARK_INVOLUME_UNTEXTURED) fputc(ASCIIVOXEL_INTERNAL_VOXEL,binary_f);
+
+				else if (mark == VOXELMARK_INVOLUME_TEXTURED) {
+				*/
+
+				else if (mark == VOXELMARK_INVOLUME_TEXTURED || mark == VOXELMARK_INVOLUME_UNTEXTURED) {
+
+					voxelfile_voxel* rec = textured_voxels.find(i, j, k);
+
+					if (rec == 0) {
+						_cprintf("Could not find voxel %d,%d,%d on the textured voxel list\n",
+							i, j, k);
+						fputc(ASCIIVOXEL_INTERNAL_VOXEL, binary_f);
+					}
+
+					else {
+
+						voxelfile_voxel file_voxel = *rec;
+						if (file_voxel.num_modifiers > MAX_NUM_MODIFIERS)
+							file_voxel.num_modifiers = MAX_NUM_MODIFIERS;
+
+						fputc(ASCIIVOXEL_TEXTURED_VOXEL, binary_f);
+						fwrite(&file_voxel, sizeof(voxelfile_voxel), 1, binary_f);
+
+					}
+
+				}
+
+				else {
+
+					// unmarked
+					fputc(ASCIIVOXEL_NOVOXEL, binary_f);
+
+				}
+			}
+		}
+	}
+
+	bool write_error = (ferror(binary_f) != 0);
+	if (fclose(binary_f) != 0) write_error = true;
+
+	if (write_error) {
+		_cprintf("Error writing voxel file %s\n", filename);
+		return false;
+	}
+
+	return true;
+}
+
+// Writes a version 2 .voxels file, streaming each chunk out as the walk over
+// the grid passes it; this includes every modifier in [textured_voxels]
+//
+// Returns false if the file couldn't be written.
+bool write_voxel_file_v2(const char* filename, const voxelfile_object_header& object_hdr,
+	const unsigned char* voxel_marks, voxel_attribute_grid& textured_voxels,
+	int encoding, int compression) {
+
+	int num_modifiers = textured_voxels.num_modifiers();
+
+	voxelfile_writer writer;
+	if (writer.open(filename, object_hdr, num_modifiers, encoding, compression) == false) return false;
+
+	const int* voxel_resolution = object_hdr.voxel_resolution;
+
+	for (int i = 0; i < voxel_resolution[0]; i++) {
+		for (int j = 0; j < voxel_resolution[1]; j++) {
+			for (int k = 0; k < voxel_resolution[2]; k++) {
+
+				voxel_id vi = { (short)(i), (short)(j), (short)(k) };
+				int mark = voxel_marks[voxel_index(voxel_resolution, vi)];
+
+				if (mark != VOXELMARK_INVOLUME_TEXTURED && mark != VOXELMARK_INVOLUME_UNTEXTURED) continue;
+
+				voxelfile_voxel* rec = textured_voxels.find(i, j, k);
+
+				// Version 1 would have written this as an ASCIIVOXEL_INTERNAL_VOXEL,
+				// which nothing reads
+				if (rec == 0) {
+					_cprintf("Could not find voxel %d,%d,%d on the textured voxel list\n", i, j, k);
+					continue;
+				}
+
+				if (writer.add_voxel(*rec, textured_voxels.modifiers(rec)) == false) {
+					_cprintf("Error writing voxel file %s\n", filename);
+					writer.close();
+					return false;
+				}
+
+			}
+		}
+	}
+
+	if (writer.close() == false) {
+		_cprintf("Error writing voxel file %s\n", filename);
+		return false;
+	}
+
+	_cprintf("Wrote %d voxels in %.0lf bytes (%s, %s)\n", writer.num_voxels_written(), writer.bytes_written(),
+		(encoding == VOXELFILE_ENCODING_FLOAT16) ? "half precision" : "full precision",
+		(compression == VOXELFILE_COMPRESSION_PACKBITS) ? "compressed" : "uncompressed");
+
+	return true;
+}
+
+// How many voxel records each tetrahedralization work item covers
+#define TETRAHEDRALIZE_CHUNK_SIZE 4096
+
+// Everything the tetrahedralization workers need.  Cube corners lie on the
+// (res+1)^3 lattice of voxel corners, so a corner is identified by its
+// lattice index rather than by searching on its position.
+//
+// Every voxel record n owns slots [n*8, n*8+8) of the corner arrays and
+// [n*TETS_PER_CUBE, ...) of the tet array, and border voxels own four faces
+// per tet starting at first_face[n], so the workers never write to the same
+// place.
+struct tetrahedralize_job {
+
+	voxel_attribute_grid* voxels;
+	int corner_resolution[3];
+
+	// Each record's corners: lattice index and border flag
+	std::vector<unsigned int> corner_lattice_index;
+	std::vector<unsigned char> corner_border;
+
+	// Vertex id for each lattice point, once they've been assigned
+	const std::vector<unsigned int>* lattice_vertex_ids;
+
+	std::vector<indexed_tet> tets;
+
+	// Faces of tets from border voxels
+	std::vector<unsigned int> first_face;
+	std::vector<indexed_face> faces;
+};
+
+// Finds the lattice index and border flag of every corner of each voxel
+// record in one chunk.  Corners are numbered as in the cube tables above:
+// bit 2 is +i, bit 1 is +j, bit 0 is +k.
+void tetrahedralize_find_corners(void* param, int chunk, int thread_index) {
+
+	tetrahedralize_job* job = (tetrahedralize_job*)(param);
+	voxel_attribute_grid& voxels = *(job->voxels);
+
+	unsigned int first = chunk * TETRAHEDRALIZE_CHUNK_SIZE;
+	unsigned int last = first + TETRAHEDRALIZE_CHUNK_SIZE;
+	if (last > voxels.size()) last = voxels.size();
+
+	const int* cres = job->corner_resolution;
+
+	for (unsigned int n = first; n < last; n++) {
+
+		const voxelfile_voxel& v = voxels[n];
+		int border_voxel = (v.is_on_border != 0) ? 1 : 0;
+
+		int curcorner = 0;
+		for (int i = -1; i <= 1; i += 2) {
+			for (int j = -1; j <= 1; j += 2) {
+				for (int k = -1; k <= 1; k += 2) {
+
+					int ci = v.i + (i + 1) / 2;
+					int cj = v.j + (j + 1) / 2;
+					int ck = v.k + (k + 1) / 2;
+					job->corner_lattice_index[n * 8 + curcorner] =
+						((unsigned int)(ci)* cres[1] + cj) * cres[2] + ck;
+
+					// If this is a border voxel, this is a border vertex if any of
+					// my 6-connected neighbors on its side don't exist
+					bool border = false;
+					if (border_voxel) {
+						if (voxels.find(v.i + i, v.j, v.k) == 0 ||
+							voxels.find(v.i, v.j + j, v.k) == 0 ||
+							voxels.find(v.i, v.j, v.k + k) == 0)
+							border = true;
+					}
+					job->corner_border[n * 8 + curcorner] = border ? 1 : 0;
+
+					curcorner++;
+				}
+			}
+		}
+	}
+}
+
+// Builds the tets (and, for border voxels, their faces) for each voxel
+// record in one chunk, once vertex ids have been assigned
+void tetrahedralize_build_tets(void* param, int chunk, int thread_index) {
+
+	tetrahedralize_job* job = (tetrahedralize_job*)(param);
+	voxel_attribute_grid& voxels = *(job->voxels);
+	const std::vector<unsigned int>& lattice_vertex_ids = *(job->lattice_vertex_ids);
+
+	unsigned int first = chunk * TETRAHEDRALIZE_CHUNK_SIZE;
+	unsigned int last = first + TETRAHEDRALIZE_CHUNK_SIZE;
+	if (last > voxels.size()) last = voxels.size();
+
+	for (unsigned int n = first; n < last; n++) {
+
+		const voxelfile_voxel& v = voxels[n];
+
+		unsigned int cube_vertex_ids[8];
+		for (int c = 0; c < 8; c++)
+			cube_vertex_ids[c] = lattice_vertex_ids[job->corner_lattice_index[n * 8 + c]];
+
+		for (int curtet = 0; curtet < TETS_PER_CUBE; curtet++) {
+
+			unsigned int tet_slot = n * TETS_PER_CUBE + curtet;
+			indexed_tet& t = job->tets[tet_slot];
+
+			for (int i = 0; i < 4; i++) {
+				int index;
+				if (TETS_PER_CUBE == 5)
+					index = five_tet_cube_corners[curtet][i];
+				else
+					index = six_tet_cube_corners[curtet][i];
+				t.vertices[i] = cube_vertex_ids[index];
+			}
+
+			sort_indexed_tet(t);
+
+			// Record boundary information for this tet
+			t.attribute = v.is_on_border;
+
+			// Build faces if this is a border voxel
+			//
+			// TODO: this approach creates many subsurface faces; it only
+			// tests whether the center voxel is on the border
+			if (v.is_on_border == 0) continue;
+
+			for (int curface = 0; curface < 4; curface++) {
+				indexed_face& f = job->faces[job->first_face[n] + curtet * 4 + curface];
+				f.vertices[0] = t.vertices[(tet_triangle_faces[curface][0])];
+				f.vertices[1] = t.vertices[(tet_triangle_faces[curface][1])];
+				f.vertices[2] = t.vertices[(tet_triangle_faces[curface][2])];
+				sort_indexed_face(f);
+			}
+		}
+	}
+}
+
+inline bool equal_indexed_tets(const indexed_tet& t1, const indexed_tet& t2) {
+	return memcmp(t1.vertices, t2.vertices, sizeof(t1.vertices)) == 0;
+}
+
+inline bool equal_indexed_faces(const indexed_face& f1, const indexed_face& f2) {
+	return memcmp(f1.vertices, f2.vertices, sizeof(f1.vertices)) == 0;
+}
+
+// Splits every record in [voxels] into TETS_PER_CUBE tets, welding cube
+// corners that coincide.
+//
+// [vertices] gets the welded vertices in the order they're first used,
+// [tets] and [faces] come back sorted (as ltindexed_tet and ltindexed_face
+// order them) with duplicates removed; [faces] only has faces of tets from
+// border voxels.
+//
+// Returns the number of threads that did the work.
+int tetrahedralize_voxels(voxel_attribute_grid& voxels, const int* voxel_resolution,
+	const cVector3d& voxel_size, const cVector3d& voxel_start_offset, int num_threads,
+	std::vector<outgoing_vertex_info>& vertices, std::vector<indexed_tet>& tets,
+	std::vector<indexed_face>& faces) {
+
+	unsigned int num_records = voxels.size();
+	int num_chunks = (num_records + TETRAHEDRALIZE_CHUNK_SIZE - 1) / TETRAHEDRALIZE_CHUNK_SIZE;
+
+	tetrahedralize_job job;
+	job.voxels = &voxels;
+	for (int k = 0; k < 3; k++) job.corner_resolution[k] = voxel_resolution[k] + 1;
+	job.corner_lattice_index.resize(num_records * 8);
+	job.corner_border.resize(num_records * 8);
+
+	num_threads = parallel_resolve_num_threads(num_threads);
+
+	int threads_used = parallel_for_chunks(num_chunks, tetrahedralize_find_corners, &job, num_threads);
+
+	// Assign vertex ids in the order corners are first seen, which is what
+	// the position-keyed map used to do; a vertex is on the border if any
+	// voxel says it is
+	std::vector<unsigned int> lattice_vertex_ids(
+		(unsigned int)(job.corner_resolution[0]) * job.corner_resolution[1] * job.corner_resolution[2],
+		0xffffffff);
+
+	vertices.clear();
+
+	// ...and hand out face slots to the border voxels while we're at it
+	job.first_face.resize(num_records);
+	unsigned int num_faces = 0;
+
+	for (unsigned int n = 0; n < num_records; n++) {
+
+		const voxelfile_voxel& v = voxels[n];
+
+		job.first_face[n] = num_faces;
+		if (v.is_on_border) num_faces += TETS_PER_CUBE * 4;
+
+		voxel_id vid = { v.i, v.j, v.k };
+		cVector3d voxelpos;
+		bool have_voxelpos = false;
+
+		for (int c = 0; c < 8; c++) {
+
+			unsigned int& vertex_id = lattice_vertex_ids[job.corner_lattice_index[n * 8 + c]];
+			bool border = job.corner_border[n * 8 + c] != 0;
+
+			if (vertex_id != 0xffffffff) {
+				if (border) vertices[vertex_id].border = true;
+				continue;
+			}
+
+			if (have_voxelpos == false) {
+				compute_voxel_coordinate(vid, voxelpos, voxel_size, voxel_start_offset);
+				have_voxelpos = true;
+			}
+
+			int i = (c & 4) ? 1 : -1;
+			int j = (c & 2) ? 1 : -1;
+			int k = (c & 1) ? 1 : -1;
+
+			outgoing_vertex_info ovi;
+			ovi.pos.set(
+				voxelpos.x + (double)(i)*voxel_size.x / 2.0,
+				voxelpos.y + (double)(j)*voxel_size.y / 2.0,
+				voxelpos.z + (double)(k)*voxel_size.z / 2.0);
+			ovi.border = border;
+
+			vertex_id = (unsigned int)(vertices.size());
+			vertices.push_back(ovi);
+		}
+	}
+
+	// Build the tets and faces into their preallocated slots
+	job.lattice_vertex_ids = &lattice_vertex_ids;
+	job.tets.resize(num_records * TETS_PER_CUBE);
+	job.faces.resize(num_faces);
+
+	parallel_for_chunks(num_chunks, tetrahedralize_build_tets, &job, num_threads);
+
+	// Corners of a cube are distinct lattice points, so tets can't be
+	// degenerate and different cubes can't make the same tet; sorting and
+	// de-duplicating just puts them in the order we've always written them
+	tets.swap(job.tets);
+	std::sort(tets.begin(), tets.end(), ltindexed_tet());
+	tets.erase(std::unique(tets.begin(), tets.end(), equal_indexed_tets), tets.end());
+
+	faces.swap(job.faces);
+	std::sort(faces.begin(), faces.end(), ltindexed_face());
+	faces.erase(std::unique(faces.begin(), faces.end(), equal_indexed_faces), faces.end());
+
+	return threads_used;
+}
+
+int CvoxelizerApp::voxelize_current_object(int operation) {
+
+	// Set to -1 by anything that keeps us from producing the output
+	int result = 0;
+
+	m_nTets = 0;
+
+	g_smallest_distance = DBL_MAX;
+	g_largest_distance = -DBL_MAX;
+
+	if (object_to_voxelize->containsChild(current_voxelization_point, true) == 0)
+		object_to_voxelize->addChild(current_voxelization_point);
+
+	if (cloud) {
+		if (object_to_voxelize->containsChild(cloud, true) == 0)
+			object_to_voxelize->addChild(cloud);
+
+		WaitForSingleObject(cloud->point_mutex, INFINITE);
+		cloud->points.clear();
+		ReleaseMutex(cloud->point_mutex);
+	}
+
+	// Align the object with the world-space axes, to avoid rotation issues
+	cMatrix3d new_rot;
+	new_rot.identity();
+
+	// Make sure the object doesn't have any rotation applied to
+	// it...
+	object_to_voxelize->setRot(new_rot);
+
+	// Re-center the object, in case the user moved it...
+	object_to_voxelize->setPos(0, 0, 0);
+
+	// Find the boundary box of the object
+	cVector3d object_min = object_to_voxelize->getBoundaryMin();
+	cVector3d object_max = object_to_voxelize->getBoundaryMax();
+	cVector3d span = cSub(object_max, object_min);
+
+	// Increase the effective span by just a little, to make sure we leave room
+	// for all voxels...
+  // TODO: this is undefined just for debugging
+  // #define INCREASE_EFFECTIVE_SPAN
+
+#ifdef INCREASE_EFFECTIVE_SPAN
+	cVector3d spacer = cMul(0.005, span);
+	object_min.sub(spacer);
+	object_max.add(spacer);
+	span = cSub(object_max, object_min);
+#endif
+
+	_cprintf("max min span (%lf,%lf,%lf) (%lf,%lf,%lf) (%lf,%lf,%lf)\n",
+		object_max.x, object_max.y, object_max.z,
+		object_min.x, object_min.y, object_min.z,
+		span.x, span.y, span.z);
+
+	// Move the object to put its bounding box's minimum coordinate at (0,0,0)
+	// 
+	// That is, move it by (the opposite of its position + the opposite of its minimum)
+	old_object_pos = object_to_voxelize->getPos();
+	object_to_voxelize->translate(cMul(-1.0, old_object_pos));
+	object_to_voxelize->translate(cMul(-1.0, object_min));
+
+	_cprintf("Moving object from (%lf,%lf,%lf) to (%lf,%lf,%lf)\n",
+		old_object_pos.x, old_object_pos.y, old_object_pos.z,
+		object_to_voxelize->getPos().x, object_to_voxelize->getPos().y, object_to_voxelize->getPos().z);
+
+	_cprintf("Initializing subtractors...\n");
+
+	if (objects_to_subtract.size() > 0) {
+		for (unsigned int i = 0; i < objects_to_subtract.size(); i++) {
+			cMesh* object_to_subtract = objects_to_subtract[i];
+
+			// This works because the same transformations were applied to
+			// all objects at load-time
+			object_to_subtract->setRot(new_rot);
+			object_to_subtract->setPos(0, 0, 0);
+			object_to_subtract->translate(cMul(-1.0, old_object_pos));
+			object_to_subtract->translate(cMul(-1.0, object_min));
+			object_to_subtract->computeGlobalPositions(false);
+
+		}
+	}
+
+	_cprintf("Initializing modifiers...\n");
+
+	if (modifier_objects.size() > 0) {
+		for (unsigned int i = 0; i < modifier_objects.size(); i++) {
+			cMesh* modifier_object = modifier_objects[i];
+
+			// This works because the same transformations were applied to
+			// all objects at load-time
+			modifier_object->setRot(new_rot);
+			modifier_object->setPos(0, 0, 0);
+			modifier_object->translate(cMul(-1.0, old_object_pos));
+			modifier_object->translate(cMul(-1.0, object_min));
+			modifier_object->computeGlobalPositions(false);
+		}
+	}
+
+	// Man did this get me for a while...
+	//
+	// Note that I'm doing a computeGlobal for every vertex
+	_cprintf("Computing global vertex positions...\n");
+	object_to_voxelize->computeGlobalPositions(false);
+	_cprintf("Done computing vertex positions...\n");
+
+	object_to_voxelize->computeBoundaryBox(true);
+
+	// #define PRINT_ALL_VOXELS
+
+#ifdef ISOTROPIC_VOXELS
+
+  // The resolution along the largest axis
+#define MAX_VOXEL_RESOLUTION VOXEL_RESOLUTION
+
+// The largest axis of this object
+	float max_span = (float)(max(span.x, max(span.y, span.z)));
+
+	// This is the isotropic voxel size
+	float voxel_edge = max_span / ((float)m_long_axis_resolution);
+
+	// Compute the resolution of each axis
+	voxel_resolution[0] = (int)ceil(span.x / voxel_edge);
+	voxel_resolution[1] = (int)ceil(span.y / voxel_edge);
+	voxel_resolution[2] = (int)ceil(span.z / voxel_edge);
+
+	// Compute the size of each voxel
+	voxel_size.x = voxel_size.y = voxel_size.z = voxel_edge;
+
+	// Compute the total number of voxels
+	unsigned int total_num_voxels =
+		voxel_resolution[0] * voxel_resolution[1] * voxel_resolution[2];
+
+	// Anisotropic voxels
+#else
+
+  // Compute the resolution of each axis
+	voxel_resolution[0] = voxel_resolution[1] = voxel_resolution[2] = VOXEL_RESOLUTION;
+
+	// Compute the size of each voxel
+	voxel_size.x = span.x / ((double)(voxel_resolution[0]));
+	voxel_size.y = span.y / ((double)(voxel_resolution[1]));
+	voxel_size.z = span.z / ((double)(voxel_resolution[2]));
+
+	// Compute the total number of voxels
+	unsigned int total_num_voxels =
+		voxel_resolution[0] * voxel_resolution[1] * voxel_resolution[2];
+
+#endif
+
+	_cprintf("Voxel size is %lf,%lf,%lf\n", voxel_size.x, voxel_size.y, voxel_size.z);
+	_cprintf("Voxel resolution is %d x %d x %d\n", voxel_resolution[0], voxel_resolution[1], voxel_resolution[2]);
+
+	// Create an array to hold information about whether we've already
+	// processed a voxel
+	unsigned char* voxel_marks = new unsigned char[total_num_voxels];
+	memset(voxel_marks, 0, total_num_voxels);
+
+	// Create a stack of voxels that we still want to process
+	voxel_list voxel_stack;
 
 	cVector3d start_point;
 
@@ -1710,7 +3057,7 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 	if (tri == 0) {
 		_cprintf("Could not find a seed triangle...\n");
 		delete[] voxel_marks;
-		return;
+		return -1;
 	}
 
 	// Find his vertices    
@@ -1784,34 +3131,246 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 	int dot_interval = (float)total_num_voxels / 10000.0;
 	if (dot_interval == 0) dot_interval = 10;
 
-	_cprintf("Each dot will be %d voxels (of %d total)\n", dot_interval, total_num_voxels);
+	_cprintf("Each dot will be %d voxels (of %d total)\n", dot_interval, total_num_voxels);
+
+	// Number of dots per time interval
+	int time_report_interval = 15;
+	int dots_since_report = 0;
+
+	total_time = distance_time = 0.0;
+
+	cPrecisionClock dot_timer;
+	double start_time = dot_timer.getCPUtime();
+
+	// The records for every voxel we keep, indexed by grid position
+	voxel_attribute_grid textured_voxels;
+	textured_voxels.initialize(voxel_resolution);
+
+	// Put this voxel on the output list with his texture coordinates
+	voxelfile_voxel file_voxel(start_voxel.i, start_voxel.j, start_voxel.k);
+
+	// TODO: interpolate here (I do it for all the other triangles)
+	file_voxel.has_texture = 1;
+	file_voxel.is_on_border = BORDERTAG_INITIAL_ELEMENT;
+	file_voxel.u = tri->getVertex(0)->getTexCoord().x;
+	file_voxel.v = tri->getVertex(0)->getTexCoord().y;
+
+	file_voxel.num_modifiers = 0;
+
+	// voxels_to_write.insert(file_voxel);
+	textured_voxels.insert(file_voxel);
+
+	double floodfill_start_time = dot_timer.getCPUtime();
+
+	// If we're allowed more than one thread, classify every ray the flood fill
+	// might cast up front, in parallel.
+	//
+	// The fill itself still runs in the original stack order below, just
+	// looking up ray results instead of casting rays, so the output is
+	// identical to the serial fill.  Rays that hit the object get re-cast
+	// when they come up, since we need the hit point and triangle, but
+	// those only happen on the surface.
+	unsigned short* ray_marks = 0;
+
+	if (m_num_threads != 1 && m_fill_algorithm == FILL_ALGORITHM_FLOOD) {
+
+		ray_marks = new unsigned short[total_num_voxels];
+		memset(ray_marks, 0, total_num_voxels * sizeof(unsigned short));
+
+		neighbor_ray_job job;
+		job.object_to_voxelize = object_to_voxelize;
+		job.objects_to_subtract = &objects_to_subtract;
+		job.voxel_resolution = voxel_resolution;
+		job.voxel_size = voxel_size;
+		job.voxel_start_offset = voxel_start_offset;
+		job.box.initialize(object_to_voxelize);
+		job.ray_marks = ray_marks;
+
+		int num_slabs = (voxel_resolution[0] + RAYMARK_SLAB_THICKNESS - 1) / RAYMARK_SLAB_THICKNESS;
+
+		double t1 = dot_timer.getCPUtime();
+		int threads_used = parallel_for_chunks(num_slabs, classify_neighbor_rays, &job, m_num_threads);
+		_cprintf("Classified neighbor rays in %d slabs on %d threads (%lfs)\n",
+			num_slabs, threads_used, dot_timer.getCPUtime() - t1);
+	}
+
+	// The scanline engine classifies the whole grid by casting one ray along x
+	// through each (j,k) column and counting surface crossings, then builds
+	// the same voxel records the flood fill would, only casting the short
+	// neighbor-to-neighbor rays at the surface.
+	//
+	// Unlike the flood fill, this doesn't need a seed and fills every closed
+	// component of the mesh, but it does need the mesh to be watertight along
+	// each column.
+	//
+	// Records are tagged by the flood fill's rules, so the two engines write
+	// the same tags for the same voxels: the seed voxel keeps its
+	// BORDERTAG_INITIAL_ELEMENT record, and BORDER_TAG_BAD_NEIGHBOR only
+	// ever means a neighbor was off the grid or out of the bounding box.
+	// Where a short neighbor ray disagrees with parity (it misses a surface
+	// parity says is there), we do what the flood fill does - call the
+	// neighbor inside - and hand him to the flood fill loop below, which
+	// otherwise has nothing to do.
+	if (m_fill_algorithm == FILL_ALGORITHM_SCANLINE) {
+
+		_cprintf("Classifying voxels by scanline parity...\n");
+
+		// Start from scratch; we'll put the seed voxel back if parity agrees
+		// that he's inside
+		voxelfile_voxel seed_voxel = file_voxel;
+		memset(voxel_marks, 0, total_num_voxels);
+		textured_voxels.clear();
+		voxel_stack.clear();
+
+		scanline_job job;
+		job.object.initialize(object_to_voxelize);
+		job.subtractors.resize(objects_to_subtract.size());
+		for (unsigned int i = 0; i < objects_to_subtract.size(); i++) {
+			job.subtractors[i].initialize(objects_to_subtract[i]);
+		}
+		job.voxel_resolution = voxel_resolution;
+		job.voxel_size = voxel_size;
+		job.voxel_start_offset = voxel_start_offset;
+		job.voxel_marks = voxel_marks;
+
+		double t1 = dot_timer.getCPUtime();
+		int threads_used = parallel_for_chunks(voxel_resolution[1], scanline_classify_plane, &job, m_num_threads);
+		_cprintf("Cast %d column rays on %d threads (%lfs)\n",
+			voxel_resolution[1] * voxel_resolution[2], threads_used, dot_timer.getCPUtime() - t1);
+
+		// The seed gets the record the flood fill gives him, and the flood fill
+		// loop below checks his neighbors, just as it would have
+		if (voxel_marks[start_index] == VOXELMARK_INVOLUME_UNTEXTURED) {
+			voxel_marks[start_index] = VOXELMARK_INVOLUME_TEXTURED;
+			textured_voxels.insert(seed_voxel);
+			voxel_stack.push_back(start_voxel);
+		}
+		else {
+			_cprintf("The seed voxel isn't inside the surface by parity; not writing a seed record\n");
+		}
+
+		object_box_test box;
+		box.initialize(object_to_voxelize);
+
+		// Now build records for every inside voxel, and for the outside voxels
+		// next to them, visiting voxels in index order and neighbors in the
+		// same order the flood fill does
+		for (unsigned int index = 0; index < total_num_voxels && quit_voxelizing == 0; index++) {
+
+			if (voxel_marks[index] != VOXELMARK_INVOLUME_UNTEXTURED) continue;
+
+			voxel_id cur_voxel = voxel_coords(voxel_resolution, index);
+
+			// Already handed to the flood fill loop
+			if (textured_voxels.find(cur_voxel.i, cur_voxel.j, cur_voxel.k)) continue;
+
+			cVector3d voxel_coordinates;
+			compute_voxel_coordinate(cur_voxel, voxel_coordinates, voxel_size, voxel_start_offset);
+
+			voxelfile_voxel file_voxel(cur_voxel.i, cur_voxel.j, cur_voxel.k);
+			file_voxel.is_on_border = BORDER_TAG_NOT_ON_BORDER;
+
+			voxels_processed++;
+
+			for (int d = 0; d < 6; d++) {
+
+				int di = six_connected_neighbors[d][0];
+				int dj = six_connected_neighbors[d][1];
+				int dk = six_connected_neighbors[d][2];
+
+				voxel_id neighbor = cur_voxel;
+				neighbor.i += di;
+				neighbor.j += dj;
+				neighbor.k += dk;
+
+				cVector3d neighbor_coordinates;
+				compute_voxel_coordinate(neighbor, neighbor_coordinates, voxel_size, voxel_start_offset);
+
+				// Same rule as the flood fill: a neighbor off the grid or out of
+				// the bounding box puts this voxel on the border, and we stop
+				// looking at his neighbors
+				if (
+					neighbor.i < 0 || neighbor.i >= voxel_resolution[0] ||
+					neighbor.j < 0 || neighbor.j >= voxel_resolution[1] ||
+					neighbor.k < 0 || neighbor.k >= voxel_resolution[2]
+					|| (box.in_box(neighbor_coordinates) == false)
+					) {
+					file_voxel.is_on_border = BORDER_TAG_BAD_NEIGHBOR;
+					break;
+				}
+
+				int neighbor_index = voxel_index(voxel_resolution, neighbor);
+
+				// Inside, subtracted, or already given a surface record
+				if (voxel_marks[neighbor_index] != VOXELMARK_UNMARKED) continue;
+
+				cVector3d offset(
+					COLLISION_OFFSET_FACTOR*voxel_size.x*(float)di,
+					COLLISION_OFFSET_FACTOR*voxel_size.y*(float)dj,
+					COLLISION_OFFSET_FACTOR*voxel_size.z*(float)dk
+				);
+
+				cGenericObject* colObject;
+				cTriangle*      colTriangle;
+				cVector3d       colPoint;
+				double          colSquareDistance = DBL_MAX;
+
+				cVector3d start_point = voxel_coordinates;
+				cVector3d end_point;
+				neighbor_coordinates.addr(offset, end_point);
+
+				int result = object_to_voxelize->computeCollisionDetection(
+					start_point, end_point,
+					colObject, colTriangle, colPoint, colSquareDistance,
+					0, 1);
+
+				// Parity says there's a surface between us, but the short ray
+				// didn't find it (e.g. it grazed an edge).  The flood fill would
+				// call the neighbor inside and go on from him, so we do too.
+				if (result == 0) {
+
+					voxel_marks[neighbor_index] = VOXELMARK_INVOLUME_UNTEXTURED;
+
+					voxelfile_voxel inside_voxel(neighbor.i, neighbor.j, neighbor.k);
+					inside_voxel.is_on_border = BORDER_TAG_NOT_ON_BORDER;
+					if (m_compute_distance_field) inside_voxel.has_distance = 1;
+					textured_voxels.insert(inside_voxel);
+
+					voxel_stack.push_back(neighbor);
+
+					if (render_point_cloud) add_cloud_point(neighbor_coordinates, neighbor_index, 1.0, 0.0, 0.0);
+					continue;
+				}
+
+				voxel_marks[neighbor_index] = VOXELMARK_INVOLUME_TEXTURED;
 
-	// Number of dots per time interval
-	int time_report_interval = 15;
-	int dots_since_report = 0;
+				colPoint.sub(object_to_voxelize->getPos());
 
-	total_time = distance_time = 0.0;
+				voxelfile_voxel surface_voxel(neighbor.i, neighbor.j, neighbor.k);
+				fill_surface_voxel_record(surface_voxel, colTriangle, colPoint);
+				surface_voxel.is_on_border = BORDER_TAG_NEIGHBOR_COLLISION;
 
-	cPrecisionClock dot_timer;
-	double start_time = dot_timer.getCPUtime();
+				// Distances are filled in once the fill is done
+				if (m_compute_distance_field) surface_voxel.has_distance = 1;
 
-	voxel_set textured_voxels;
+				textured_voxels.insert(surface_voxel);
 
-	// Put this voxel on the output list with his texture coordinates
-	voxelfile_voxel file_voxel(start_voxel.i, start_voxel.j, start_voxel.k);
+				if (render_point_cloud) add_cloud_point(neighbor_coordinates, neighbor_index, 0.0, 1.0, 0.0);
 
-	// TODO: interpolate here (I do it for all the other triangles)
-	file_voxel.has_texture = 1;
-	file_voxel.is_on_border = BORDERTAG_INITIAL_ELEMENT;
-	file_voxel.u = tri->getVertex(0)->getTexCoord().x;
-	file_voxel.v = tri->getVertex(0)->getTexCoord().y;
+			} // for each neighbor
 
-	file_voxel.num_modifiers = 0;
+			if (m_compute_distance_field) file_voxel.has_distance = 1;
 
-	// voxels_to_write.insert(file_voxel);
-	textured_voxels.insert(file_voxel);
+			textured_voxels.insert(file_voxel);
 
-	double floodfill_start_time = dot_timer.getCPUtime();
+			if (render_point_cloud) {
+				if (file_voxel.is_on_border) add_cloud_point(voxel_coordinates, index, 0.0, 0.0, 1.0);
+				else add_cloud_point(voxel_coordinates, index, 1.0, 0.0, 0.0);
+			}
+
+		} // for each voxel
+
+	} // if we're using the scanline engine
 
 	// As long as the stack is not empty
 	while (voxel_stack.empty() == 0 && quit_voxelizing == 0) {
@@ -1886,6 +3445,14 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 
 		bool voxel_out_of_bounds = false;
 
+		// Which of the six neighbors we're looking at (indexes
+		// six_connected_neighbors)
+		int neighbor_direction = -1;
+
+		// Ray results for this voxel, if the parallel pass got to him
+		unsigned short cur_ray_marks = 0;
+		if (ray_marks) cur_ray_marks = ray_marks[voxel_index(voxel_resolution, cur_voxel)];
+
 		// For each of his voxel neighbors
 		for (int di = -1; di <= 1 && (voxel_out_of_bounds == false); di++) {
 			for (int dj = -1; dj <= 1 && (voxel_out_of_bounds == false); dj++) {
@@ -1897,6 +3464,8 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 					// Ignore the voxel himself
 					if (di == 0 && dj == 0 && dk == 0) continue;
 
+					neighbor_direction++;
+
 					// Compute the indices of this neighbor
 					voxel_id neighbor = cur_voxel;
 					neighbor.i += di;
@@ -1943,20 +3512,17 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 						) {
 
 						// Find the record for the current voxel
-						voxelfile_voxel key(cur_voxel.i, cur_voxel.j, cur_voxel.k);
-						voxel_set::iterator iter = textured_voxels.find(key);
-						if (iter == textured_voxels.end()) {
+						voxelfile_voxel* v = textured_voxels.find(cur_voxel.i, cur_voxel.j, cur_voxel.k);
+						if (v == 0) {
 							_cprintf("That's strange... I couldn't find the current voxel.\n");
 							continue;
 						}
 
 						//_cprintf("Re-assigned a voxel to the border...\n");
-						voxelfile_voxel v = (*iter);
 
 						// A note-to-self that this voxel was _re-assigned_ to the border
-						v.is_on_border = BORDER_TAG_BAD_NEIGHBOR;
-						textured_voxels.erase(iter);
-						textured_voxels.insert(v);
+						// (the record is modified in place)
+						v->is_on_border = BORDER_TAG_BAD_NEIGHBOR;
 
 						if (render_point_cloud) {
 
@@ -2010,8 +3576,16 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 					cVector3d       colPoint;
 					double          colSquareDistance = DBL_MAX;
 
+					// Use the results of the parallel ray pass if we have them
+					if (cur_ray_marks & RAYMARK_COMPUTED) {
+						if (cur_ray_marks & RAYMARK_SUBTRACTOR_HIT(neighbor_direction)) {
+							voxel_marks[neighbor_index] = VOXELMARK_NOTINVOLUME;
+							continue;
+						}
+					}
+
 					// See if this ray enters the "cut zone"
-					if (objects_to_subtract.size() > 0) {
+					else if (objects_to_subtract.size() > 0) {
 
 						int found_cut_zone = 0;
 
@@ -2056,7 +3630,15 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 					neighbor_coordinates.addr(offset, end_point);
 
 					// See if this ray leaves the object
-					int result = object_to_voxelize->computeCollisionDetection(
+					int result = 0;
+
+					// If the parallel pass already told us this ray is clear, we're
+					// done; rays that hit get re-cast, since we need to know what
+					// they hit
+					bool known_miss = (cur_ray_marks & RAYMARK_COMPUTED) &&
+						((cur_ray_marks & RAYMARK_OBJECT_HIT(neighbor_direction)) == 0);
+
+					if (known_miss == false) result = object_to_voxelize->computeCollisionDetection(
 
 						// Create a ray from the voxel to this neighbor
 						start_point, end_point,
@@ -2085,154 +3667,18 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 						// File-writing stuff
 						// {
 
-						// In order to interpolate between vertices, we'll have
-						// to find barycentric coordinates for the intersection point
-
-						// From :
-						//
-						// http://kurtm.flipcode.com/devlog-VoxelMeshCreationandRendering.shtml
-
-						/*
-						a = area(Source Triangle)
-
-						bu = area([T1, T2, PT]) / a
-						bv = area([T2, T0, PT]) / a
-						bw = area([T0, T1, PT]) / a
-						*/
-
-						// These points are all in object local space...
-						cVector3d p0 = colTriangle->getVertex(0)->getPos();
-						cVector3d p1 = colTriangle->getVertex(1)->getPos();
-						cVector3d p2 = colTriangle->getVertex(2)->getPos();
-
-						// So we need to convert this point to object local space also...
+						// The collision point is in global space, the triangle's
+						// vertices are in object local space
 						colPoint.sub(object_to_voxelize->getPos());
 
-						raw_triangle source_triangle(p0, p1, p2);
-
-						float a = source_triangle.compute_area();
-
-						raw_triangle t1t2pt(p1, p2, colPoint);
-						raw_triangle t2t0pt(p2, p0, colPoint);
-						raw_triangle t0t1pt(p0, p1, colPoint);
-
-						float a0 = t1t2pt.compute_area();
-						float a1 = t2t0pt.compute_area();
-						float a2 = t0t1pt.compute_area();
-
-						float bu = a0 / a;
-						float bv = a1 / a;
-						float bw = a2 / a;
-
-						/*
-						TU = (bu * T0.TU) + (bv * T1.TU) + (bw * T2.TU);
-						TV = (bv * T0.TV) + (bv * T1.TV) + (bw * T2.TV);
-						*/
-
-						// Interpolate in barycentric coordinates
-						float u = bu * colTriangle->getVertex(0)->getTexCoord().x +
-							bv * colTriangle->getVertex(1)->getTexCoord().x +
-							bw * colTriangle->getVertex(2)->getTexCoord().x;
-
-						float v = bu * colTriangle->getVertex(0)->getTexCoord().y +
-							bv * colTriangle->getVertex(1)->getTexCoord().y +
-							bw * colTriangle->getVertex(2)->getTexCoord().y;
-
-						// A simpler scheme, for debugging...
-						/*
-						u = colTriangle->getVertex(0)->getTexCoord().x +
-							colTriangle->getVertex(1)->getTexCoord().x +
-							colTriangle->getVertex(2)->getTexCoord().x;
-						u/=3.0;
-
-						v = colTriangle->getVertex(0)->getTexCoord().y +
-							colTriangle->getVertex(1)->getTexCoord().y +
-							colTriangle->getVertex(2)->getTexCoord().y;
-						v/=3.0;
-						*/
-
-
 						// Insert this voxel in the output set of "interesting" voxels
 						voxelfile_voxel file_voxel(neighbor.i, neighbor.j, neighbor.k);
-						file_voxel.u = u;
-						file_voxel.v = v;
-						file_voxel.has_texture = 1;
+						fill_surface_voxel_record(file_voxel, colTriangle, colPoint);
 						file_voxel.is_on_border = BORDER_TAG_NEIGHBOR_COLLISION;
-						file_voxel.has_normal = 1;
-
-						cVector3d n;
-
-						static int printed_normal_status = 0;
-
-#if (NORMAL_SOURCE == NORMAL_SOURCE_TRIANGLE_FACE)
-
-						// Insert a normal for this voxel also, based on this triangle's face normal...
-						cVector3d nv1 = cSub(p1, p0);
-						cVector3d nv2 = cSub(p2, p0);
-						n = cCross(nv1, nv2);
-						n.normalize();
-
-						if (printed_normal_status == 0) {
-							_cprintf("Using face normals...\n");
-							printed_normal_status = 1;
-						}
-
-#elif (NORMAL_SOURCE == NORMAL_SOURCE_VERTEX_NORMALS)
-
-						if (printed_normal_status == 0) {
-							_cprintf("Using vertex normals...\n");
-							printed_normal_status = 1;
-						}
-
-						// Insert a normal for this voxel also, based on vertex normals...
-						cVector3d v0n = colTriangle->getVertex(0)->getNormal();
-						cVector3d v1n = colTriangle->getVertex(1)->getNormal();
-						cVector3d v2n = colTriangle->getVertex(2)->getNormal();
-
-						double d0 = cDistance(colPoint, colTriangle->getVertex(0)->getPos());
-						double d1 = cDistance(colPoint, colTriangle->getVertex(1)->getPos());
-						double d2 = cDistance(colPoint, colTriangle->getVertex(2)->getPos());
-
-						double totald = d0 + d1 + d2;
-						n = (v0n * (totald - d0)) + (v1n * (totald - d1)) + (v2n * (totald - d2));
-						n.normalize();
 
-#elif (NORMAL_SOURCE == NORMAL_SOURCE_NONE)
-
-						file_voxel.has_normal = 0;
-
-#else 
-						_cprintf("Unrecognized normal computation scheme...\n");
-#endif            
-
-						file_voxel.normal[0] = n.x;
-						file_voxel.normal[1] = n.y;
-						file_voxel.normal[2] = n.z;
-
-						if (m_compute_distance_field) {
-
-							double t1 = dot_timer.getCPUtime();
-
-							file_voxel.has_distance = 1;
-
-							cVector3d closest_point;
-							file_voxel.distance_to_surface =
-								AABB_distance_computer::closest_vertex(
-									object_to_voxelize, neighbor_coordinates, 0, &closest_point);
-							cVector3d gradient = cSub(closest_point, neighbor_coordinates);
-							gradient.normalize();
-
-							// This corrects for the fact that this center is
-							// _outside_ the object
-							gradient.mul(-1.0);
-							file_voxel.distance_gradient[0] = gradient.x;
-							file_voxel.distance_gradient[1] = gradient.y;
-							file_voxel.distance_gradient[2] = gradient.z;
-
-							double elapsed = dot_timer.getCPUtime() - t1;
-							distance_time += elapsed;
-
-						}
+						// Distances are filled in in batches once the fill is
+						// done (see compute_distance_field)
+						if (m_compute_distance_field) file_voxel.has_distance = 1;
 
 						// TODO: average over the relevant triangles (right now
 						// only the _first_ triangle to get hit for this voxel
@@ -2287,27 +3733,7 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 					// Put him on the list of voxels to write out
 					voxelfile_voxel file_voxel(neighbor.i, neighbor.j, neighbor.k);
 
-					if (m_compute_distance_field) {
-
-						double t1 = dot_timer.getCPUtime();
-
-						file_voxel.has_distance = 1;
-
-						cVector3d closest_point;
-						file_voxel.distance_to_surface =
-							AABB_distance_computer::closest_vertex(
-								object_to_voxelize, neighbor_coordinates, 0, &closest_point);
-
-						cVector3d gradient = cSub(closest_point, neighbor_coordinates);
-						gradient.normalize();
-						file_voxel.distance_gradient[0] = gradient.x;
-						file_voxel.distance_gradient[1] = gradient.y;
-						file_voxel.distance_gradient[2] = gradient.z;
-
-						double elapsed = dot_timer.getCPUtime() - t1;
-						distance_time += elapsed;
-
-					}
+					if (m_compute_distance_field) file_voxel.has_distance = 1;
 
 					if (render_point_cloud) {
 
@@ -2346,6 +3772,30 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 
 	} // while the stack isn't empty
 
+	if (ray_marks) delete[] ray_marks;
+
+	// Whatever we'd write now would only be part of the object
+	if (quit_voxelizing) {
+		_cprintf("Voxelization stopped before it finished\n");
+		result = -1;
+	}
+
+	// Everything downstream (in particular vertex numbering in the
+	// tetrahedralizer) visits voxels in grid order
+	textured_voxels.sort_by_index();
+
+	if (m_compute_distance_field) {
+
+		double t1 = dot_timer.getCPUtime();
+
+		int threads_used = compute_distance_field(textured_voxels, object_to_voxelize,
+			voxel_resolution, voxel_size, voxel_start_offset,
+			m_num_threads, g_smallest_distance, g_largest_distance);
+
+		distance_time += dot_timer.getCPUtime() - t1;
+		_cprintf("Computed surface distances on %d threads\n", threads_used);
+	}
+
 	found_voxels = 0;
 	for (unsigned int i = 0; i < total_num_voxels; i++) {
 		if (voxel_marks[i] > VOXELMARK_NOTINVOLUME) found_voxels++;
@@ -2361,228 +3811,21 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 	// Do the tetrahedralization based on these voxels
 	if (operation == OPERATION_TETRAHEDRALIZE) {
 
-		// A searchable list of tets
-		std::set<indexed_tet, ltindexed_tet> tets;
-
-		// A searchable list of exterior faces
-		std::set<indexed_face, ltindexed_face> faces;
-
-		// a map from coordinates to vertex id's
-		std::map<outgoing_vertex_info, unsigned int, lt_outgoing_vertex_info> coordinate_to_vertexid_map;
-
-		// a list of coordinates, in vertex id order
+		// The welded vertices, in vertex id order, and the tets and border
+		// faces built on them
 		std::vector<outgoing_vertex_info> coordinates_in_vertex_order;
+		std::vector<indexed_tet> tets;
+		std::vector<indexed_face> faces;
 
-		// The unique vertex id we'll assign to the next new vertex we find
-		unsigned int current_vertex_id = 0;
-
-		voxel_set::iterator iter = textured_voxels.begin();
-
-		_cprintf("\nTetrahedralizing...\n");
-
-		int voxels_processed = 0;
-		int dot_interval = (float)textured_voxels.size() / 10000.0;
-		if (dot_interval == 0) dot_interval = 10;
-
-		_cprintf("Each dot will be %d textured voxels (of %d total)\n", dot_interval, textured_voxels.size());
-
-		// For each voxel on the list
-		while (iter != textured_voxels.end()) {
-
-			voxelfile_voxel v = *iter;
-			voxel_id vid = { v.i,v.j,v.k };
-			cVector3d voxelpos;
-			compute_voxel_coordinate(vid, voxelpos, voxel_size, voxel_start_offset);
-
-			int border_voxel = (v.is_on_border != 0) ? 1 : 0;
-
-			// Now build eight vertices from this voxel to make a cube
-			cVector3d cube_vertices[8];
-
-			// Are these "border vertices?"
-			bool cube_vertices_on_border[8];
-			memset(cube_vertices_on_border, 0, 8 * sizeof(bool));
-
-			int curcorner = 0;
-			for (int i = -1; i <= 1; i += 2) {
-				for (int j = -1; j <= 1; j += 2) {
-					for (int k = -1; k <= 1; k += 2) {
-						cube_vertices[curcorner].set(
-							voxelpos.x + (double)(i)*voxel_size.x / 2.0,
-							voxelpos.y + (double)(j)*voxel_size.y / 2.0,
-							voxelpos.z + (double)(k)*voxel_size.z / 2.0
-						);
-
-						// If this is a border voxel, check whether these are border
-						// vertices
-						if (border_voxel) {
-
-							// Do any of my 6-connected neighbors not exist?
-							voxelfile_voxel key_vf(v.i, v.j, v.k);
-
-							voxel_set::iterator search_iter;
-
-							key_vf.i = v.i + i; key_vf.j = v.j; key_vf.k = v.k;
-							search_iter = textured_voxels.find(key_vf);
-							if (search_iter == textured_voxels.end()) {
-								//_cprintf("I'm %d,%d,%d and %d,%d,%d isn't there; I'm on the border...\n",
-								//  v.i,v.j,v.k,key_vf.i,key_vf.j,key_vf.k);
-								cube_vertices_on_border[curcorner] = true;
-							}
-
-							key_vf.i = v.i; key_vf.j = v.j + j; key_vf.k = v.k;
-							search_iter = textured_voxels.find(key_vf);
-							if (search_iter == textured_voxels.end()) {
-								//_cprintf("I'm %d,%d,%d and %d,%d,%d isn't there; I'm on the border...\n",
-								//  v.i,v.j,v.k,key_vf.i,key_vf.j,key_vf.k);
-								cube_vertices_on_border[curcorner] = true;
-							}
-
-							key_vf.i = v.i; key_vf.j = v.j; key_vf.k = v.k + k;
-							search_iter = textured_voxels.find(key_vf);
-							if (search_iter == textured_voxels.end()) {
-								//_cprintf("I'm %d,%d,%d and %d,%d,%d isn't there; I'm on the border...\n",
-								//  v.i,v.j,v.k,key_vf.i,key_vf.j,key_vf.k);
-								cube_vertices_on_border[curcorner] = true;
-							}
-
-						}
-						curcorner++;
-					}
-				}
-			}
-
-			unsigned int cube_vertex_ids[8];
-			// Assign or retrieve vertex id's for each vertex
-			for (int i = 0; i < 8; i++) {
-
-				cVector3d cur_vertex_pos = cube_vertices[i];
-				outgoing_vertex_info ovi;
-				ovi.pos = cur_vertex_pos;
-				ovi.border = cube_vertices_on_border[i];
-
-				// Does this guy already have a vertex id?
-				std::map<outgoing_vertex_info, unsigned int, lt_outgoing_vertex_info>::iterator iter =
-					coordinate_to_vertexid_map.find(ovi);
-
-				// This is a new vertex
-				if (iter == coordinate_to_vertexid_map.end()) {
-
-					cube_vertex_ids[i] = current_vertex_id;
-					coordinate_to_vertexid_map[ovi] = current_vertex_id;
-
-					// _cprintf("Adding vertex %d (%s)\n",current_vertex_id,cur_vertex_pos.str(2).c_str());
-
-					current_vertex_id++;
+		_cprintf("\nTetrahedralizing %d voxels...\n", (int)(textured_voxels.size()));
 
-					// If we assign a new vertex id, put this coordinate
-					// on the output list
-					coordinates_in_vertex_order.push_back(ovi);
-				}
-
-				// We've seen this vertex before
-				else {
-					cube_vertex_ids[i] = (*iter).second;
-					outgoing_vertex_info old_ovi = (*iter).first;
-
-					// Is this a change in border status?
-					if (old_ovi.border != ovi.border) {
-
-						// If I'm changing him to say that he _is_ on the border,
-						// update the list.
-						if (ovi.border) {
-							coordinates_in_vertex_order[(*iter).second] = ovi;
-						}
-						//_cprintf("Warning: vertex %d (%s) has old border %d, new border %d\n",
-						  //(*iter).second,cur_vertex_pos.str(2).c_str(),(int)(old_ovi.border),(int)(ovi.border));
-					}
-				}
-			} // for each cube vertex
-
-			// Build tets from these vertices
-
-			for (int curtet = 0; curtet < TETS_PER_CUBE; curtet++) {
-
-				indexed_tet t;
-				for (int i = 0; i < 4; i++) {
-					int index;
-					if (TETS_PER_CUBE == 5)
-						index = five_tet_cube_corners[curtet][i];
-					else
-						index = six_tet_cube_corners[curtet][i];
-					t.vertices[i] = cube_vertex_ids[index];
-				}
-
-				indexed_tet sorted_tet = t;
-
-				// Sort this tet
-				sort_indexed_tet(sorted_tet);
-
-				// Confirm that this tet is not degenerate
-				if (isDegenerateTet(sorted_tet)) {
-					_cprintf("Oops... voxel %d, tet %d is degenerate...\n",
-						voxels_processed, curtet);
-					continue;
-				}
-
-				// Confirm that we haven't build this tet already
-				std::set<indexed_tet, ltindexed_tet>::iterator tetsearch_iter =
-					tets.find(sorted_tet);
-
-				bool tet_exists = (tetsearch_iter != tets.end());
-
-				if (tet_exists) {
-					_cprintf("Oops... voxel %d, tet %d already exists (%d,%d,%d,%d)...\n",
-						voxels_processed, curtet,
-						sorted_tet.vertices[0], sorted_tet.vertices[1],
-						sorted_tet.vertices[2], sorted_tet.vertices[3]);
-					continue;
-				}
-
-				// Record boundary information for this tet
-				sorted_tet.attribute = v.is_on_border;
-
-				// Okay, we appear to have a new tet
-				tets.insert(sorted_tet);
-
-				// Build faces if this is a border voxel
-				if (v.is_on_border) {
-
-					// TODO: this approach creates many subsurface faces; it only
-					// tests whether the center voxel is on the border 
-					for (int curface = 0; curface < 4; curface++) {
-						indexed_face f;
-						f.vertices[0] = sorted_tet.vertices[(tet_triangle_faces[curface][0])];
-						f.vertices[1] = sorted_tet.vertices[(tet_triangle_faces[curface][1])];
-						f.vertices[2] = sorted_tet.vertices[(tet_triangle_faces[curface][2])];
-
-						sort_indexed_face(f);
-
-						// Strictly speaking I could just add the face and let the STL
-						// avoid duplication, but I leave the code this way in case I
-						// want to do some processing on each new face later, and as a
-						// sanity check...
-
-						// Is this face already on the list?
-						std::set<indexed_face, ltindexed_face>::iterator face_search =
-							faces.find(f);
-
-						// Ignore this face if we've already created it
-						if (face_search != faces.end()) continue;
-
-						// Put this face on our face list
-						faces.insert(f);
-					} // for each face we can make from this tet
-
-				} // if this voxel is on the border
+		int threads_used = tetrahedralize_voxels(textured_voxels, voxel_resolution, voxel_size,
+			voxel_start_offset, m_num_threads, coordinates_in_vertex_order, tets, faces);
 
-			} // for each tet we made from this voxel
+		_cprintf("Built %d vertices, %d tets, and %d faces on %d threads\n",
+			(int)(coordinates_in_vertex_order.size()), (int)(tets.size()), (int)(faces.size()), threads_used);
 
-			iter++;
-			voxels_processed++;
-			if ((g_voxelize_immediately == 0) && ((voxels_processed % dot_interval) == 0)) _cprintf(".");
-
-		} // for each voxel
+		unsigned int current_vertex_id = coordinates_in_vertex_order.size();
 
 		m_nTets = tets.size();
 
@@ -2696,7 +3939,7 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 					coordinates_in_vertex_order.size(), n_border_vertices);
 
 				// go through the list of tets
-				std::set<indexed_tet, ltindexed_tet>::iterator tetiter = tets.begin();
+				std::vector<indexed_tet>::iterator tetiter = tets.begin();
 				unsigned int tet_id = 0;
 				while (tetiter != tets.end()) {
 
@@ -2717,7 +3960,7 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 				}
 
 				// go through the list of faces
-				std::set<indexed_face, ltindexed_face>::iterator faceiter = faces.begin();
+				std::vector<indexed_face>::iterator faceiter = faces.begin();
 				unsigned int face_id = 0;
 				while (faceiter != faces.end()) {
 					indexed_face f = (*faceiter);
@@ -2726,13 +3969,17 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 					faceiter++;
 				}
 
-				// close the file
-				if (nodef) fclose(nodef);
-				if (elef) fclose(elef);
-				if (facef) fclose(facef);
-
 			} // if we were able to open the files
 
+			else result = -1;
+
+			// close the files, checking that everything made it out
+			if (nodef && (ferror(nodef) || fclose(nodef) != 0)) result = -1;
+			if (elef && (ferror(elef) || fclose(elef) != 0)) result = -1;
+			if (facef && (ferror(facef) || fclose(facef) != 0)) result = -1;
+
+			if (result != 0) _cprintf("Error writing tet files\n");
+
 			_cprintf("Finished writing tets to file...\n");
 
 		} // if we're writing output
@@ -2755,7 +4002,14 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 			strcat(file_details_str, buf);
 		}
 
-		for (unsigned int i = 0; i < modifier_objects.size(); i++) {
+		// With lots of modifiers, their names won't fit in a filename
+		if ((int)(modifier_objects.size()) > MAX_NUM_MODIFIERS) {
+			char buf[_MAX_PATH];
+			sprintf(buf, ".m_%d_modifiers", (int)(modifier_objects.size()));
+			strcat(file_details_str, buf);
+		}
+
+		else for (unsigned int i = 0; i < modifier_objects.size(); i++) {
 			char* filename = (char*)(modifier_objects[i]->m_userData);
 			char buf[_MAX_PATH];
 			sprintf(buf, ".m_%s", filename);
@@ -2768,218 +4022,88 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 		_cprintf("Output filename is %s\n", binary_filename);
 
 		// If necessary, compute the distance from each voxel that we're
-		// going to output to the modifier mesh...
+		// going to output to each modifier mesh...
 		if (modifier_objects.size() > 0) {
 
-			unsigned int num_modifiers = modifier_objects.size();
-
-			for (unsigned int modifier_index = 0; modifier_index < num_modifiers; modifier_index++) {
-
-				_cprintf("\nComputing distances to modifier object... %d\n", modifier_index);
-
-				if (modifier_index >= MAX_NUM_MODIFIERS) {
-					_cprintf("Warning: only %d modifiers are supported\n", MAX_NUM_MODIFIERS);
-					break;
-				}
-
-				cMesh* modifier_object = modifier_objects[modifier_index];
-				_cprintf("Object has %d triangles\n", modifier_object->getNumTriangles(true));
-
-				// Force a reset for the distance computation on the first pass
-				int first_pass = 1;
-
-				// The modifier mesh has already been transformed to match
-				// the transform we applied to the main mesh
-
-				int total_voxels = textured_voxels.size();
-				int dot_interval = ((float)total_voxels) / 1000.0;
-				_cprintf("Computing %d voxel distances (%d per dot)\n",
-					total_voxels, dot_interval);
-
-				int voxels_processed = 0;
-
-				double min_distance = DBL_MAX;
-				double max_distance = 0.0;
-
-				voxel_set::iterator iter = textured_voxels.begin();
-
-				// For each voxel
-				while (iter != textured_voxels.end()) {
-
-					voxels_processed++;
-
-					if ((voxels_processed % dot_interval) == 0) _cprintf(".");
-
-					// I think this should let us modify the data in-place
-					voxelfile_voxel* v = (voxelfile_voxel*)(&(*iter));
-
-					voxel_id vi = { v->i,v->j,v->k };
-
-					cVector3d voxel_coordinates;
-					compute_voxel_coordinate(vi, voxel_coordinates, voxel_size, voxel_start_offset);
-
-					cVector3d p;
-					double d = AABB_distance_computer::closest_vertex(
-						modifier_object, voxel_coordinates, 0, &p, first_pass);
-
-					if (d < min_distance) min_distance = d;
-					if (d > max_distance) max_distance = d;
-
-					v->distance_to_modifier[modifier_index] = d;
-
-					if (first_pass) _cprintf("Initializing distance variables\n");
-					first_pass = 0;
-
-					cVector3d gradient = cSub(p, voxel_coordinates);
-
-					// Sanity check the returned value
-					double err = fabs(gradient.length() - v->distance_to_modifier[modifier_index]);
-
-					if (err > 0.001) _cprintf("Distance error %lf\n", err);
-
-					gradient.normalize();
-
-					v->num_modifiers++;
-					v->modifier_gradient[modifier_index][0] = gradient.x;
-					v->modifier_gradient[modifier_index][1] = gradient.y;
-					v->modifier_gradient[modifier_index][2] = gradient.z;
-
-					// Replace the old voxel
-					// 
-					// Now I'm modifying in-place...
-					// textured_voxels.insert(v);
+			// The modifier meshes have already been transformed to match
+			// the transform we applied to the main mesh
+			std::vector<cMesh*> modifiers(modifier_objects.begin(), modifier_objects.end());
+			if (modifiers.size() > 255) {
+				_cprintf("Warning: only 255 modifiers are supported\n");
+				modifiers.resize(255);
+			}
 
-					iter++;
+			_cprintf("\nComputing %d voxel distances to %d modifier objects...\n",
+				(int)(textured_voxels.size()), (int)(modifiers.size()));
 
-				} // for each voxel
+			std::vector<double> min_distance, max_distance;
+			int threads_used = compute_modifier_distances(textured_voxels, modifiers,
+				voxel_resolution, voxel_size, voxel_start_offset,
+				m_num_threads, min_distance, max_distance);
 
-				_cprintf("Finished computing distances to modifier object %d...\n", modifier_index);
-				_cprintf("Min and max distances to modifier were %3.3lf, %3.3lf\n", min_distance, max_distance);
+			_cprintf("Used %d threads\n", threads_used);
 
-			} // for each modifier object
+			for (unsigned int modifier_index = 0; modifier_index < modifiers.size(); modifier_index++) {
+				_cprintf("Modifier %d has %d triangles; min and max distances were %3.3lf, %3.3lf\n",
+					modifier_index, modifiers[modifier_index]->getNumTriangles(true),
+					min_distance[modifier_index], max_distance[modifier_index]);
+			}
 
 		} // if there's a modifier object
 
 		if (m_write_output_file) {
 
-			FILE* binary_f = fopen(binary_filename, "wb");
-
-			if (binary_f == 0) {
-
-				_cprintf("Could not open binary output file %s\n", binary_filename);
-
-			}
-
-			else {
-
-				// Write out binary file header and object header
-				voxelfile_file_header file_hdr;
-				file_hdr.header_size = sizeof(file_hdr);
-				file_hdr.object_header_size = sizeof(voxelfile_object_header);
-				file_hdr.voxel_struct_size = sizeof(voxelfile_voxel);
-				file_hdr.num_objects = 1;
-
-				fwrite(&file_hdr, sizeof(file_hdr), 1, binary_f);
-
-				_cprintf("File header is %d bytes\n", file_hdr.header_size);
-				_cprintf("Object header is %d bytes\n", file_hdr.object_header_size);
-				_cprintf("Voxel struct is %d bytes\n", file_hdr.voxel_struct_size);
-
-				voxelfile_object_header object_hdr;
-
-				int k;
-
-				for (k = 0; k < 3; k++) object_hdr.voxel_resolution[k] = voxel_resolution[k];
-				for (k = 0; k < 3; k++) object_hdr.voxel_size[k] = voxel_size.get(k);
-
-				// The zero_coordinate vector now represents the center of the
-				// (0,0,0) voxel, after moving and offsetting to put the ll corner
-				// of the bounding box at 0.  So now I want to add back in that
-				// translation...
-				zero_coordinate.add(old_object_pos);
-				zero_coordinate.add(object_min);
-				zero_coordinate.sub(voxel_size.x / 2.0, voxel_size.y / 2.0, voxel_size.z / 2.0);
-
-				// This gives us the zero coordinate in the post-scaling,
-				// post-offset world
-
-				_cprintf("Zero coordinate going out to file: (%lf,%lf,%lf)\n",
-					zero_coordinate.x, zero_coordinate.y, zero_coordinate.z);
-
-				for (k = 0; k < 3; k++) object_hdr.zero_coordinate[k] = zero_coordinate.get(k);
-
-				// These represent the transformation we performed when we first
-				// loaded the object: a translation, then a scale
-				for (k = 0; k < 3; k++) object_hdr.model_offset[k] = model_offset.get(k);
-				object_hdr.model_scale_factor = model_scale_factor;
-
-				object_hdr.num_voxels = found_voxels;
-
-				_cprintf("\nWriting %d voxels (%d textured voxels) to the binary output file\n",
-					object_hdr.num_voxels, textured_voxels.size());
-
-				_cprintf("\nResolution %d,%d,%d, size %f,%f,%f\n",
-					object_hdr.voxel_resolution[0], object_hdr.voxel_resolution[1], object_hdr.voxel_resolution[2],
-					object_hdr.voxel_size[0], object_hdr.voxel_size[1], object_hdr.voxel_size[2]);
-
-				object_hdr.has_texture = 1;
-
-				strcpy(object_hdr.texture_filename, current_texture);
-				_cprintf("Storing texture %s\n", current_texture);
+			voxelfile_object_header object_hdr;
 
-				fwrite(&object_hdr, sizeof(object_hdr), 1, binary_f);
+			int k;
 
-				for (int i = 0; i < voxel_resolution[0]; i++) {
-					for (int j = 0; j < voxel_resolution[1]; j++) {
-						for (int k = 0; k < voxel_resolution[2]; k++) {
+			for (k = 0; k < 3; k++) object_hdr.voxel_resolution[k] = voxel_resolution[k];
+			for (k = 0; k < 3; k++) object_hdr.voxel_size[k] = voxel_size.get(k);
 
-							voxel_id vi = { i,j,k };
+			// The zero_coordinate vector now represents the center of the
+			// (0,0,0) voxel, after moving and offsetting to put the ll corner
+			// of the bounding box at 0.  So now I want to add back in that
+			// translation...
+			zero_coordinate.add(old_object_pos);
+			zero_coordinate.add(object_min);
+			zero_coordinate.sub(voxel_size.x / 2.0, voxel_size.y / 2.0, voxel_size.z / 2.0);
 
-							int index = voxel_index(voxel_resolution, vi);
+			// This gives us the zero coordinate in the post-scaling,
+			// post-offset world
 
-							int mark = voxel_marks[index];
+			_cprintf("Zero coordinate going out to file: (%lf,%lf,%lf)\n",
+				zero_coordinate.x, zero_coordinate.y, zero_coordinate.z);
 
-							if (mark == VOXELMARK_NOTINVOLUME) fputc(ASCIIVOXEL_NOVOXEL, binary_f);
+			for (k = 0; k < 3; k++) object_hdr.zero_coordinate[k] = zero_coordinate.get(k);
 
-							/*
-							else if (mark == VOXELMARK_INVOLUME_UNTEXTURED) fputc(ASCIIVOXEL_INTERNAL_VOXEL,binary_f);
+			// These represent the transformation we performed when we first
+			// loaded the object: a translation, then a scale
+			for (k = 0; k < 3; k++) object_hdr.model_offset[k] = model_offset.get(k);
+			object_hdr.model_scale_factor = model_scale_factor;
 
-							else if (mark == VOXELMARK_INVOLUME_TEXTURED) {
-							*/
+			object_hdr.num_voxels = found_voxels;
 
-							else if (mark == VOXELMARK_INVOLUME_TEXTURED || mark == VOXELMARK_INVOLUME_UNTEXTURED) {
+			_cprintf("\nWriting %d voxels (%d textured voxels) to the binary output file\n",
+				object_hdr.num_voxels, (int)(textured_voxels.size()));
 
-								voxelfile_voxel cur(i, j, k);
-								voxel_set::iterator iter = textured_voxels.find(cur);
+			_cprintf("\nResolution %d,%d,%d, size %f,%f,%f\n",
+				object_hdr.voxel_resolution[0], object_hdr.voxel_resolution[1], object_hdr.voxel_resolution[2],
+				object_hdr.voxel_size[0], object_hdr.voxel_size[1], object_hdr.voxel_size[2]);
 
-								if (iter == textured_voxels.end()) {
-									_cprintf("Could not find voxel %d,%d,%d on the textured voxel list\n",
-										i, j, k);
-									fputc(ASCIIVOXEL_INTERNAL_VOXEL, binary_f);
-								}
+			object_hdr.has_texture = 1;
 
-								else {
+			strcpy(object_hdr.texture_filename, current_texture);
+			_cprintf("Storing texture %s\n", current_texture);
 
-									fputc(ASCIIVOXEL_TEXTURED_VOXEL, binary_f);
-									voxelfile_voxel out = *iter;
-									fwrite(&out, sizeof(voxelfile_voxel), 1, binary_f);
-
-								}
-
-							}
-
-							else {
-
-								// unmarked
-								fputc(ASCIIVOXEL_NOVOXEL, binary_f);
-
-							}
-						}
-					}
-				}
-
-				fclose(binary_f);
+			bool written;
+			if (m_voxel_file_version == 1)
+				written = write_voxel_file_v1(binary_filename, object_hdr, voxel_marks, textured_voxels);
+			else {
+				written = write_voxel_file_v2(binary_filename, object_hdr, voxel_marks, textured_voxels,
+					m_voxel_file_encoding, m_voxel_file_compression);
 			}
+			if (written == false) result = -1;
+
 
 		} // if we're writing output
 
@@ -2991,6 +4115,7 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 
 	else {
 		_cprintf("Unrecognized voxelization operation\n");
+		result = -1;
 	}
 
 	if (current_voxelization_point)
@@ -3015,7 +4140,7 @@ void CvoxelizerApp::voxelize_current_object(int operation) {
 	// Delete our voxel mark array
 	delete[] voxel_marks;
 
-
+	return result;
 }
 
 
@@ -3061,6 +4186,23 @@ void CPointCloud::render(int a_renderMode) {
 
 }
 
+void CvoxelizerApp::add_cloud_point(const cVector3d& coordinates, int index, float r, float g, float b) {
+
+	cVector3d cloud_point = cSub(coordinates, object_to_voxelize->getPos());
+	simple_point p;
+	p.x = cloud_point.x;
+	p.y = cloud_point.y;
+	p.z = cloud_point.z;
+	p.r = r;
+	p.g = g;
+	p.b = b;
+
+	WaitForSingleObject(cloud->point_mutex, INFINITE);
+	cloud->points[index] = p;
+	ReleaseMutex(cloud->point_mutex);
+
+}
+
 void CvoxelizerApp::render(const int a_renderMode) {
 
 #ifdef STORE_POINT_CLOUD_DISTANCE_INFO
@@ -3200,9 +4342,6 @@ double AABB_distance_computer::closest_vertex(cMesh* mesh,
 	// Convert the point to object space  
 	p.sub(mesh->getPos());
 
-	// This will hold all the parents we're still searching...
-	std::list<cMesh*> meshes_to_descend;
-
 	static std::list<cCollisionAABB*> colliders;
 
 	if (g_mesh_list_initialized == 0 || reinit_mesh_list) {
@@ -3213,28 +4352,7 @@ double AABB_distance_computer::closest_vertex(cMesh* mesh,
 		last_hit = 0;
 		colliders.clear();
 
-		meshes_to_descend.push_front(mesh);
-
-		// While there are still parent meshes to process
-		while (meshes_to_descend.empty() == 0) {
-
-			// Grab the next parent
-			cMesh* cur_mesh = meshes_to_descend.front();
-			meshes_to_descend.pop_front();
-
-			cCollisionAABB* collider = (cCollisionAABB*)(cur_mesh->getCollisionDetector());
-			if (collider) colliders.push_front(collider);
-
-			// Put all his children on the list of parents to process
-			for (unsigned int i = 0; i < cur_mesh->getNumChildren(); i++) {
-
-				cGenericObject* cur_object = cur_mesh->getChild(i);
-
-				// Only process cMesh children
-				cMesh* child_mesh = dynamic_cast<cMesh*>(cur_object);
-				if (child_mesh) meshes_to_descend.push_back(child_mesh);
-			}
-		}
+		collect_mesh_colliders(mesh, colliders);
 	}
 
 	std::list<cCollisionAABB*>::iterator collider_iter;
@@ -16,7 +16,7 @@
 #pragma once
 #endif // _MSC_VER > 1000
 
-#ifndef __AFXWIN_H__
+#if !defined(__AFXWIN_H__) && !defined(HEADLESS_BUILD)
 #error include 'stdafx.h' before including this file for PCH
 #endif
 
@@ -28,6 +28,15 @@ typedef enum {
 	OPERATION_VOXELIZE = 0, OPERATION_TETRAHEDRALIZE, OPERATION_TESTONLY
 } voxelizer_operations;
 
+// How we decide which voxels are inside the object
+typedef enum {
+	// Flood-fill from a seed voxel, casting a ray to each neighbor
+	FILL_ALGORITHM_FLOOD = 0,
+
+	// Cast one ray per grid column and fill by crossing parity
+	FILL_ALGORITHM_SCANLINE
+} voxelizer_fill_algorithms;
+
 #include "resource.h"
 #include "CWorld.h"
 #include "CViewport.h"
@@ -35,21 +44,11 @@ typedef enum {
 #include "CPhantom3dofPointer.h"
 #include "CPrecisionTimer.h"
 #include <vector>
+#include <list>
 #include "CCollisionAABB.h"
 #include "CMeta3dofPointer.h"
 #include "CLight.h"
 
-// Controls whether I compile and link with the cpt library
-// (which has to be in ../cpt/cpt)
-//
-// This is off right now, since I just do the cpt explicitly using
-// CHAI primitives.
-// #define COMPILE_CPT
-
-#ifdef COMPILE_CPT
-#include "cpt_c.h"
-#endif
-
 // #define STORE_POINT_CLOUD_DISTANCE_INFO
 
 struct simple_point {
@@ -87,10 +86,22 @@ public:
 int FileBrowse(char* buffer, int length, int save = 0, char* forceExtension = 0,
 	char* extension_string = 0, char* title = 0);
 
+// With HEADLESS_BUILD defined (voxelizer_cli), this is a plain object with
+// no window, GL context, or haptics; call initialize_headless() in place of
+// InitInstance()
+#ifdef HEADLESS_BUILD
+class CvoxelizerApp : public cGenericObject {
+#else
 class CvoxelizerApp : public CWinApp, public cGenericObject {
+#endif
 public:
 	CvoxelizerApp();
 
+#ifdef HEADLESS_BUILD
+	// Sets up a world to load meshes into, and nothing else
+	void initialize_headless();
+#endif
+
 	// Call this in place of a destructor to clean up
 	void uninitialize();
 
@@ -101,8 +112,8 @@ public:
 
 	virtual int render_loop();
 
-	void voxelize_current_object(int operation = OPERATION_VOXELIZE);
-	void cpt_current_object();
+	// Returns 0 on success, -1 if the output couldn't be produced
+	int voxelize_current_object(int operation = OPERATION_VOXELIZE);
 
 	void launch_voxelization();
 
@@ -121,6 +132,20 @@ public:
 	int m_compute_distance_field;
 	int m_write_output_file;
 
+	// Number of threads used to classify neighbor rays during the flood fill
+	// (1 runs the original serial fill, less than 1 means "one per processor")
+	int m_num_threads;
+
+	// One of the voxelizer_fill_algorithms
+	int m_fill_algorithm;
+
+	// Which .voxels format to write (1 or 2; see voxel_file_format.h), and
+	// for version 2, the VOXELFILE_ENCODING_* and VOXELFILE_COMPRESSION_*
+	// to write it with
+	int m_voxel_file_version;
+	int m_voxel_file_encoding;
+	int m_voxel_file_compression;
+
 	// Grab relevant options from checkboxes and sliders in the GUI
 	void update_options_from_gui();
 	void update_gui_from_options();
@@ -136,10 +161,12 @@ public:
 	int LoadTexture(char* filename);
 
 	void check_mesh();
+#ifndef HEADLESS_BUILD
 	void zoom(int zoom_level);
 	// Handles mouse-scroll events (moves or rotates the selected object)
 	void scroll(CPoint p, int button = MOUSE_BUTTON_LEFT);
 	void select(CPoint p);
+#endif
 	cGenericObject* selected_object;
 	cTriangle* selected_tri;
 
@@ -162,6 +189,9 @@ public:
 
 	CPointCloud* cloud;
 
+	// Puts a point (at a global-space voxel center) in the point cloud
+	void add_cloud_point(const cVector3d& coordinates, int index, float r, float g, float b);
+
 	int quit_voxelizing;
 	int multithreaded_voxelizer;
 	int render_point_cloud;
@@ -171,14 +201,6 @@ public:
 	unsigned int found_voxels;
 	unsigned int m_nTets;
 
-	// Closet-point transform data
-#ifdef COMPILE_CPT
-	cpt::number_type* m_distance_array;
-	cpt::number_type* m_closest_point_array;
-	cpt::number_type* m_gradient_array;
-	int* m_closest_face_array;
-#endif
-
 	/***
 
 	Voxelization info that is exported with the outgoing model...
@@ -221,6 +243,7 @@ public:
 	cCamera* camera;
 	cViewport* viewport;
 
+#ifndef HEADLESS_BUILD
 	// Overrides
 		// ClassWizard generated virtual function overrides
 		//{{AFX_VIRTUAL(CvoxelizerApp)
@@ -234,9 +257,17 @@ public:
 	  //{{AFX_MSG(CvoxelizerApp)
 	  //}}AFX_MSG
 	DECLARE_MESSAGE_MAP()
+#endif
 };
 
 
+// Gathers the AABB collision detectors for a mesh and all of its cMesh
+// descendants
+void collect_mesh_colliders(cMesh* mesh, std::list<cCollisionAABB*>& colliders);
+
+// Single-point closest-point queries.  These share state between calls, so
+// they're not safe to use from more than one thread; the voxelizer itself
+// computes its distance fields in batches with aabb_distance_tree.
 class AABB_distance_computer {
 
 public:
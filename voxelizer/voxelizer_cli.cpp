@@ -0,0 +1,165 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  voxelizer_cli: the voxelizer with no GUI, for batch pipelines.
+
+  This is built with HEADLESS_BUILD defined, so CvoxelizerApp never opens a
+  window, creates a GL context, starts the haptics thread, or builds a point
+  cloud; it just loads meshes, voxelizes (or tetrahedralizes), and writes
+  the output files.  Everything comes from the command line; voxelizer.ini
+  isn't read.
+
+  usage: voxelizer_cli [options] model_file
+
+  -resolution n           voxels along the longest axis
+  -seed_triangle n        triangle to start the flood fill from
+  -fill_algorithm n       see FILL_ALGORITHM in voxelizer.ini
+  -distance               compute a distance field
+  -modifier file          compute distances to this mesh (repeatable)
+  -subtract file          subtract this mesh (repeatable)
+  -threads n              0 means one per processor
+  -tetrahedralize         write .node/.ele/.face files instead of .voxels
+  -file_version n         .voxels format (1, the default, or 2)
+  -file_encoding n        see VOXEL_FILE_ENCODING in voxelizer.ini
+  -file_compression n     see VOXEL_FILE_COMPRESSION in voxelizer.ini
+  -output root            output filename root (default: the model's name)
+
+  Progress goes to stdout and errors to stderr.  Returns 0 on success,
+  nonzero if the model couldn't be loaded or voxelized or the output
+  couldn't be written.
+
+***********/
+
+#include "stdafx.h"
+#include "voxelizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The headless build's one and only instance (the GUI build has theApp)
+CvoxelizerApp g_cli_app;
+
+void print_usage() {
+	fprintf(stderr, "usage: voxelizer_cli [options] model_file\n\n");
+	fprintf(stderr, "  -resolution n           voxels along the longest axis\n");
+	fprintf(stderr, "  -seed_triangle n        triangle to start the flood fill from\n");
+	fprintf(stderr, "  -fill_algorithm n       0 (flood fill) or 1 (scanline)\n");
+	fprintf(stderr, "  -distance               compute a distance field\n");
+	fprintf(stderr, "  -modifier file          compute distances to this mesh (repeatable)\n");
+	fprintf(stderr, "  -subtract file          subtract this mesh (repeatable)\n");
+	fprintf(stderr, "  -threads n              0 means one per processor\n");
+	fprintf(stderr, "  -tetrahedralize         write .node/.ele/.face files instead of .voxels\n");
+	fprintf(stderr, "  -file_version n         .voxels format (1, the default, or 2)\n");
+	fprintf(stderr, "  -file_encoding n        0 (32-bit floats) or 1 (16-bit floats)\n");
+	fprintf(stderr, "  -file_compression n     0 (none) or 1 (compressed)\n");
+	fprintf(stderr, "  -output root            output filename root\n");
+}
+
+int main(int argc, char** argv) {
+
+	CvoxelizerApp& app = g_cli_app;
+
+	char* model_filename = 0;
+	char* output_root = 0;
+	std::vector<char*> subtract_filenames;
+	std::vector<char*> modifier_filenames;
+	int operation = OPERATION_VOXELIZE;
+
+	for (int i = 1; i < argc; i++) {
+
+		char* arg = argv[i];
+
+		// Options without a value
+		if (strcmp(arg, "-distance") == 0) {
+			app.m_compute_distance_field = 1;
+			continue;
+		}
+
+		if (strcmp(arg, "-tetrahedralize") == 0) {
+			operation = OPERATION_TETRAHEDRALIZE;
+			continue;
+		}
+
+		if (arg[0] != '-') {
+			if (model_filename) {
+				fprintf(stderr, "Only one model can be voxelized at a time (got %s and %s)\n", model_filename, arg);
+				return -1;
+			}
+			model_filename = arg;
+			continue;
+		}
+
+		// Options with a value
+		if (i + 1 >= argc) {
+			fprintf(stderr, "Option %s needs a value\n", arg);
+			print_usage();
+			return -1;
+		}
+
+		char* value = argv[++i];
+
+		if (strcmp(arg, "-resolution") == 0) app.m_long_axis_resolution = atoi(value);
+		else if (strcmp(arg, "-seed_triangle") == 0) app.seed_triangle_index = atoi(value);
+		else if (strcmp(arg, "-fill_algorithm") == 0) app.m_fill_algorithm = atoi(value);
+		else if (strcmp(arg, "-modifier") == 0) modifier_filenames.push_back(value);
+		else if (strcmp(arg, "-subtract") == 0) subtract_filenames.push_back(value);
+		else if (strcmp(arg, "-threads") == 0) app.m_num_threads = atoi(value);
+		else if (strcmp(arg, "-file_version") == 0) app.m_voxel_file_version = atoi(value);
+		else if (strcmp(arg, "-file_encoding") == 0) app.m_voxel_file_encoding = atoi(value);
+		else if (strcmp(arg, "-file_compression") == 0) app.m_voxel_file_compression = atoi(value);
+		else if (strcmp(arg, "-output") == 0) output_root = value;
+		else {
+			fprintf(stderr, "Unrecognized option: %s\n", arg);
+			print_usage();
+			return -1;
+		}
+	}
+
+	if (model_filename == 0) {
+		print_usage();
+		return -1;
+	}
+
+	app.initialize_headless();
+
+	// The object to voxelize has to come first; it decides the transform
+	// that gets applied to everything else
+	if (app.LoadObjectToVoxelize(model_filename) < 0) {
+		fprintf(stderr, "Could not load %s\n", model_filename);
+		return -1;
+	}
+
+	unsigned int i;
+	for (i = 0; i < subtract_filenames.size(); i++) {
+		if (app.LoadObjectToSubtract(subtract_filenames[i]) < 0) {
+			fprintf(stderr, "Could not load %s\n", subtract_filenames[i]);
+			return -1;
+		}
+	}
+
+	for (i = 0; i < modifier_filenames.size(); i++) {
+		if (app.LoadModifierObject(modifier_filenames[i]) < 0) {
+			fprintf(stderr, "Could not load %s\n", modifier_filenames[i]);
+			return -1;
+		}
+	}
+
+	if (output_root) strcpy(app.output_filename_root, output_root);
+
+	if (app.voxelize_current_object(operation) < 0) {
+		fprintf(stderr, "Could not voxelize %s\n", model_filename);
+		return -1;
+	}
+
+	return 0;
+}
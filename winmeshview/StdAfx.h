@@ -10,6 +10,19 @@
 #pragma once
 #endif // _MSC_VER > 1000
 
+// Console-only builds (HEADLESS_BUILD, e.g. voxelizer_cli) don't use MFC
+#ifdef HEADLESS_BUILD
+
+#include <windows.h>
+#include <conio.h>
+#include <stdio.h>
+
+// There's no console window to print to; send progress to stdout, where
+// batch jobs can capture it
+#define _cprintf printf
+
+#else
+
 #define VC_EXTRALEAN		// Exclude rarely-used stuff from Windows headers
 
 #include <afxwin.h>         // MFC core and standard components
@@ -20,6 +33,8 @@
 #include <afxcmn.h>			// MFC support for Windows Common Controls
 #endif // _AFX_NO_AFXCMN_SUPPORT
 
+#endif // HEADLESS_BUILD
+
 
 //{{AFX_INSERT_LOCATION}}
 // Microsoft Visual C++ will insert additional declarations immediately before the previous line.
@@ -12,8 +12,10 @@
 #include "cTetMesh.h"
 #include "CTriangle.h"
 #include "CVertex.h"
+#include "parallel_for.h"
 
 #include <conio.h>
+#include <algorithm>
 
 void cTetMesh::renderMesh(const int a_renderMode) {
 
@@ -72,6 +74,7 @@ cTetMesh::cTetMesh(cWorld* a_world) : PARENT_MESH_TYPE(a_world) {
 
 	m_nTets = 0;
 	m_tets = 0;
+	m_tetFaceTriangles = 0;
 
 	m_attributeValue = -1;
 	m_nAttributes = 0;
@@ -85,6 +88,7 @@ cTetMesh::cTetMesh(cWorld* a_world) : PARENT_MESH_TYPE(a_world) {
 
 cTetMesh::~cTetMesh() {
 	if (m_tets) delete[] m_tets;
+	if (m_tetFaceTriangles) delete[] m_tetFaceTriangles;
 	if (face_centers) delete[] face_centers;
 	if (face_normals) delete[] face_normals;
 }
@@ -216,3 +220,265 @@ void cTetMesh::fixTriangleOrientations(bool a_affectChildren) {
 	}
 
 }
+
+
+/***
+Boundary extraction
+
+Every face of every tet becomes a record holding its sorted vertex indices.
+The records are scattered into buckets by a hash of those indices, so the
+two copies of an interior face always land in the same bucket, and then
+each bucket is sorted on its own; a face that shows up exactly once after
+sorting is on the boundary.  The boundary faces then get triangles in tet
+order, so the result doesn't depend on the number of threads.
+***/
+
+#define BOUNDARY_FACE_BUCKET_BITS 10
+#define BOUNDARY_FACE_BUCKETS (1<<BOUNDARY_FACE_BUCKET_BITS)
+
+// Tets per parallel_for chunk
+#define BOUNDARY_TET_CHUNK_SIZE 65536
+
+struct tet_face_record {
+
+	// Sorted
+	unsigned int v[3];
+
+	// 4 * tet + face
+	unsigned int tet_face;
+};
+
+inline bool operator<(const tet_face_record& a, const tet_face_record& b) {
+	if (a.v[0] != b.v[0]) return a.v[0] < b.v[0];
+	if (a.v[1] != b.v[1]) return a.v[1] < b.v[1];
+	return a.v[2] < b.v[2];
+}
+
+inline bool same_face(const tet_face_record& a, const tet_face_record& b) {
+	return (a.v[0] == b.v[0] && a.v[1] == b.v[1] && a.v[2] == b.v[2]);
+}
+
+inline void make_tet_face_record(const unsigned int* tets, unsigned int tet_face,
+	tet_face_record& r) {
+
+	const unsigned int* t = tets + 4 * (tet_face / 4);
+	const int* f = tet_triangle_faces[tet_face % 4];
+	unsigned int a = t[f[0]], b = t[f[1]], c = t[f[2]], tmp;
+	if (a > b) { tmp = a; a = b; b = tmp; }
+	if (b > c) { tmp = b; b = c; c = tmp; }
+	if (a > b) { tmp = a; a = b; b = tmp; }
+	r.v[0] = a;
+	r.v[1] = b;
+	r.v[2] = c;
+	r.tet_face = tet_face;
+}
+
+inline unsigned int tet_face_bucket(const tet_face_record& r) {
+	unsigned int h = (r.v[0] * 73856093u) ^ (r.v[1] * 19349663u) ^ (r.v[2] * 83492791u);
+	return (h * 2654435761u) >> (32 - BOUNDARY_FACE_BUCKET_BITS);
+}
+
+struct boundary_job {
+
+	cTetMesh* mesh;
+	const unsigned int* tets;
+	unsigned int ntets;
+
+	// [chunk * BOUNDARY_FACE_BUCKETS + bucket]: the number of records a
+	// chunk puts in a bucket, then where the chunk's first one goes
+	std::vector<unsigned int> bucket_counts;
+	std::vector<unsigned int> bucket_starts;
+
+	std::vector<tet_face_record> records;
+
+	// One per tet face: is it on the boundary?
+	std::vector<unsigned char> boundary;
+
+	// Boundary faces in each chunk, then the first triangle index for each chunk
+	std::vector<unsigned int> chunk_faces;
+
+	cTriangle* triangles;
+};
+
+inline void boundary_chunk_range(int chunk, unsigned int ntets, unsigned int& first, unsigned int& last) {
+	first = chunk * BOUNDARY_TET_CHUNK_SIZE;
+	last = first + BOUNDARY_TET_CHUNK_SIZE;
+	if (last > ntets) last = ntets;
+}
+
+static void count_bucket_chunk(void* param, int chunk, int thread_index) {
+
+	boundary_job* job = (boundary_job*)(param);
+	unsigned int* counts = &(job->bucket_counts[chunk * BOUNDARY_FACE_BUCKETS]);
+
+	unsigned int first, last;
+	boundary_chunk_range(chunk, job->ntets, first, last);
+
+	tet_face_record r;
+	for (unsigned int i = 4 * first; i < 4 * last; i++) {
+		make_tet_face_record(job->tets, i, r);
+		counts[tet_face_bucket(r)]++;
+	}
+}
+
+static void scatter_bucket_chunk(void* param, int chunk, int thread_index) {
+
+	boundary_job* job = (boundary_job*)(param);
+	unsigned int* next = &(job->bucket_starts[chunk * BOUNDARY_FACE_BUCKETS]);
+
+	unsigned int first, last;
+	boundary_chunk_range(chunk, job->ntets, first, last);
+
+	tet_face_record r;
+	for (unsigned int i = 4 * first; i < 4 * last; i++) {
+		make_tet_face_record(job->tets, i, r);
+		job->records[next[tet_face_bucket(r)]++] = r;
+	}
+}
+
+// Sorts one bucket and marks the faces that only appear once
+static void sort_bucket(void* param, int bucket, int thread_index) {
+
+	boundary_job* job = (boundary_job*)(param);
+
+	unsigned int first = job->bucket_starts[bucket];
+	unsigned int last = (bucket + 1 < BOUNDARY_FACE_BUCKETS) ?
+		job->bucket_starts[bucket + 1] : (unsigned int)(job->records.size());
+	if (first == last) return;
+
+	tet_face_record* records = &(job->records[0]);
+	std::sort(records + first, records + last);
+
+	unsigned int run_start = first;
+	for (unsigned int i = first + 1; i <= last; i++) {
+		if (i < last && same_face(records[i], records[run_start])) continue;
+
+		// Degenerate faces don't get triangles, just like
+		// cMesh::removeRedundantTriangles() would have thrown them out
+		const tet_face_record& r = records[run_start];
+		if ((i - run_start) == 1 && r.v[0] != r.v[1] && r.v[1] != r.v[2])
+			job->boundary[r.tet_face] = 1;
+
+		run_start = i;
+	}
+}
+
+static void count_boundary_chunk(void* param, int chunk, int thread_index) {
+
+	boundary_job* job = (boundary_job*)(param);
+
+	unsigned int first, last;
+	boundary_chunk_range(chunk, job->ntets, first, last);
+
+	unsigned int n = 0;
+	for (unsigned int i = 4 * first; i < 4 * last; i++) n += job->boundary[i];
+	job->chunk_faces[chunk] = n;
+}
+
+static void build_boundary_chunk(void* param, int chunk, int thread_index) {
+
+	boundary_job* job = (boundary_job*)(param);
+	cTetMesh* mesh = job->mesh;
+
+	unsigned int first, last;
+	boundary_chunk_range(chunk, job->ntets, first, last);
+
+	unsigned int index = job->chunk_faces[chunk];
+	for (unsigned int i = 4 * first; i < 4 * last; i++) {
+
+		if (job->boundary[i] == 0) {
+			mesh->m_tetFaceTriangles[i] = -1;
+			continue;
+		}
+
+		const unsigned int* t = job->tets + 4 * (i / 4);
+		const int* f = tet_triangle_faces[i % 4];
+
+		cTriangle tri(mesh, t[f[0]], t[f[1]], t[f[2]]);
+		tri.m_allocated = 1;
+		tri.m_index = index;
+		job->triangles[index] = tri;
+
+		mesh->m_tetFaceTriangles[i] = index;
+		index++;
+	}
+}
+
+unsigned int cTetMesh::extractBoundaryTriangles(int a_numThreads) {
+
+	std::vector<cTriangle>* tri_vector = pTriangles();
+	tri_vector->clear();
+	m_freeTriangles.clear();
+
+	if (m_tetFaceTriangles) delete[] m_tetFaceTriangles;
+	m_tetFaceTriangles = 0;
+
+	if (m_nTets == 0) return 0;
+
+	boundary_job job;
+	job.mesh = this;
+	job.tets = m_tets;
+	job.ntets = m_nTets;
+
+	int nchunks = (int)((m_nTets + BOUNDARY_TET_CHUNK_SIZE - 1) / BOUNDARY_TET_CHUNK_SIZE);
+	unsigned int nfaces = 4 * m_nTets;
+
+	// Bucket the faces
+	job.bucket_counts.resize(nchunks * BOUNDARY_FACE_BUCKETS, 0);
+	parallel_for_chunks(nchunks, count_bucket_chunk, &job, a_numThreads);
+
+	job.bucket_starts.resize(nchunks * BOUNDARY_FACE_BUCKETS);
+	unsigned int total = 0;
+	int bucket, chunk;
+	for (bucket = 0; bucket < BOUNDARY_FACE_BUCKETS; bucket++) {
+		for (chunk = 0; chunk < nchunks; chunk++) {
+			job.bucket_starts[chunk * BOUNDARY_FACE_BUCKETS + bucket] = total;
+			total += job.bucket_counts[chunk * BOUNDARY_FACE_BUCKETS + bucket];
+		}
+	}
+
+	job.records.resize(nfaces);
+	parallel_for_chunks(nchunks, scatter_bucket_chunk, &job, a_numThreads);
+
+	// Scattering used up the per-chunk starts; all we need from here on is
+	// where each bucket starts
+	job.bucket_starts.resize(BOUNDARY_FACE_BUCKETS);
+	total = 0;
+	for (bucket = 0; bucket < BOUNDARY_FACE_BUCKETS; bucket++) {
+		job.bucket_starts[bucket] = total;
+		for (chunk = 0; chunk < nchunks; chunk++) {
+			total += job.bucket_counts[chunk * BOUNDARY_FACE_BUCKETS + bucket];
+		}
+	}
+
+	// Find the faces that only appear once
+	job.boundary.resize(nfaces, 0);
+	parallel_for_chunks(BOUNDARY_FACE_BUCKETS, sort_bucket, &job, a_numThreads);
+
+	job.records.clear();
+	std::vector<tet_face_record>().swap(job.records);
+
+	// Give them triangles, in tet order
+	job.chunk_faces.resize(nchunks);
+	parallel_for_chunks(nchunks, count_boundary_chunk, &job, a_numThreads);
+
+	unsigned int ntriangles = 0;
+	for (chunk = 0; chunk < nchunks; chunk++) {
+		unsigned int n = job.chunk_faces[chunk];
+		job.chunk_faces[chunk] = ntriangles;
+		ntriangles += n;
+	}
+
+	m_tetFaceTriangles = new int[nfaces];
+
+	cTriangle t(0, 0, 0, 0);
+	tri_vector->reserve(ntriangles);
+	tri_vector->resize(ntriangles, t);
+	job.triangles = (ntriangles > 0) ? &((*tri_vector)[0]) : 0;
+
+	parallel_for_chunks(nchunks, build_boundary_chunk, &job, a_numThreads);
+
+	_cprintf("Extracted %u boundary triangles from %u tet faces\n", ntriangles, nfaces);
+
+	return ntriangles;
+}
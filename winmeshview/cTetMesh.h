@@ -23,6 +23,10 @@
 // problematic...
 #define DEFAULT_SMALL_IMPORT_TET_VOLUME 0.0001
 
+// When a tet mesh is loaded without a face file, should it get triangles
+// only for its boundary faces, rather than for all four faces of every tet?
+#define DEFAULT_BOUNDARY_FACES_ONLY_AT_IMPORT false
+
 #include "CVBOMesh.h"
 
 // Triangle orientation consistent with tetgen files, deduced from:
@@ -57,6 +61,16 @@ public:
 	// 4 indices for each tet
 	unsigned int* m_tets;
 
+	// If this mesh's triangles came from extractBoundaryTriangles(), then for
+	// each face of each tet (in tet_triangle_faces order), the index of that
+	// face's triangle, or -1 for faces inside the mesh
+	int* m_tetFaceTriangles;
+
+	// Replaces this mesh's triangles with one triangle for each tet face that
+	// isn't shared with another tet, using up to [a_numThreads] threads (less
+	// than one means one per processor); returns the number of triangles
+	unsigned int extractBoundaryTriangles(int a_numThreads = 0);
+
 	// This will be -1 if this mesh is empty and has no attribute-valued vertices
 	int m_attributeValue;
 	int m_nAttributes;
@@ -13,6 +13,7 @@
 #include "meshExporter.h"
 #include "CVertex.h"
 #include "CTriangle.h"
+#include "parallel_text_writer.h"
 
 const char* mesh_export_extensions[] = {
   "node","anode","smesh","obj","ply","ply","inp"
@@ -62,6 +63,169 @@ bool IsTetValid(cVector3d vertices[4], int tetNumber, bool& verySmall) {
 }
 
 
+// What one mesh's vertices (or faces) need to be formatted as text on
+// several threads; see write_text_parallel()
+struct export_vertex_text {
+	cMesh* mesh;
+	const mesh_xform_information* xform;
+	int filetype;
+
+	// The output index of the mesh's first vertex
+	unsigned int first_point;
+
+	// Written after each node if nNodeBoundaryMarkers is non-zero
+	int nNodeBoundaryMarkers;
+	int nodeBoundaryMarker;
+};
+
+struct export_face_text {
+	cMesh* mesh;
+	int filetype;
+
+	// The output index of the mesh's first vertex and first face
+	unsigned int pointOffset;
+	unsigned int first_face;
+
+	// Written after each face if nFaceBoundaryMarkers is non-zero
+	int nFaceBoundaryMarkers;
+	int curMeshIndex;
+};
+
+// Each line here is exactly what the fprintf it replaced wrote
+static void format_export_vertices(void* param, unsigned int first, unsigned int last,
+	text_buffer& text) {
+
+	export_vertex_text* job = (export_vertex_text*)param;
+
+	for (unsigned int i = first; i < last; i++) {
+
+		const cVertex* v = job->mesh->getVertex(i, false);
+		cVector3d pos = v->getPos();
+
+		// Scale and offset this vertex
+		if (job->xform) {
+			pos /= job->xform->model_scale_factor;
+			pos -= job->xform->model_offset;
+		}
+
+		unsigned int curPoint = job->first_point + i;
+
+		if (job->filetype == FILETYPE_NODE || job->filetype == FILETYPE_ANODE) {
+			// "%u %f %f %f"
+			text.put_unsigned(curPoint);
+			text.put_char(' ');
+			text.put_fixed6((float)(pos.x));
+			text.put_char(' ');
+			text.put_fixed6((float)(pos.y));
+			text.put_char(' ');
+			text.put_fixed6((float)(pos.z));
+			if (job->nNodeBoundaryMarkers) {
+				text.put_char(' ');
+				text.put_signed(job->nodeBoundaryMarker);
+			}
+			text.put_char('\n');
+		}
+
+		else if (job->filetype == FILETYPE_OBJ) {
+			// "v %f %f %f\n"
+			text.put_string("v ");
+			text.put_fixed6((float)(pos.x));
+			text.put_char(' ');
+			text.put_fixed6((float)(pos.y));
+			text.put_char(' ');
+			text.put_fixed6((float)(pos.z));
+
+			// "vt %f %f\n"
+			cVector3d tc = v->getTexCoord();
+			text.put_string("\nvt ");
+			text.put_fixed6((float)(tc.x));
+			text.put_char(' ');
+			text.put_fixed6((float)(tc.y));
+
+			// "vn %f %f %f\n"
+			cVector3d n = v->getNormal();
+			text.put_string("\nvn ");
+			text.put_fixed6((float)(n.x));
+			text.put_char(' ');
+			text.put_fixed6((float)(n.y));
+			text.put_char(' ');
+			text.put_fixed6((float)(n.z));
+			text.put_char('\n');
+		}
+
+		else if (job->filetype == FILETYPE_ABAQUS_INP) {
+			// "%u, %lf, %lf, %lf\n"
+			text.put_unsigned(curPoint + 1);
+			text.put_string(", ");
+			text.put_fixed6(pos.x);
+			text.put_string(", ");
+			text.put_fixed6(pos.y);
+			text.put_string(", ");
+			text.put_fixed6(pos.z);
+			text.put_char('\n');
+		}
+	}
+}
+
+static void format_export_faces(void* param, unsigned int first, unsigned int last,
+	text_buffer& text) {
+
+	export_face_text* job = (export_face_text*)param;
+
+	for (unsigned int i = first; i < last; i++) {
+
+		const cTriangle* t = job->mesh->getTriangle(i, false);
+		unsigned int v0 = t->getVertexIndex(0) + job->pointOffset;
+		unsigned int v1 = t->getVertexIndex(1) + job->pointOffset;
+		unsigned int v2 = t->getVertexIndex(2) + job->pointOffset;
+		unsigned int curFace = job->first_face + i;
+
+		if (job->filetype == FILETYPE_NODE) {
+			// "%u %u %u %u"
+			text.put_unsigned(curFace);
+			text.put_char(' ');
+			text.put_unsigned(v0);
+			text.put_char(' ');
+			text.put_unsigned(v1);
+			text.put_char(' ');
+			text.put_unsigned(v2);
+			if (job->nFaceBoundaryMarkers) {
+				text.put_char(' ');
+				text.put_signed(job->curMeshIndex);
+			}
+			text.put_char('\n');
+		}
+
+		else if (job->filetype == FILETYPE_OBJ) {
+			// "f %d/%d/%d %d/%d/%d %d/%d/%d\n"
+			unsigned int indices[3] = { v0 + 1, v1 + 1, v2 + 1 };
+			text.put_char('f');
+			for (int j = 0; j < 3; j++) {
+				text.put_char(' ');
+				text.put_signed((int)(indices[j]));
+				text.put_char('/');
+				text.put_signed((int)(indices[j]));
+				text.put_char('/');
+				text.put_signed((int)(indices[j]));
+			}
+			text.put_char('\n');
+		}
+
+		else if (job->filetype == FILETYPE_ABAQUS_INP) {
+			// "%u,%u,%u,%u\n"
+			text.put_unsigned(curFace + 1);
+			text.put_char(',');
+			text.put_unsigned(v0 + 1);
+			text.put_char(',');
+			text.put_unsigned(v1 + 1);
+			text.put_char(',');
+			text.put_unsigned(v2 + 1);
+			text.put_char('\n');
+		}
+	}
+}
+
+
 int ExportModel(cMesh* object, const char* in_filename,
 	const mesh_xform_information* xform,
 	const char* original_filename, ExportHelper* helper) {
@@ -423,8 +587,25 @@ int ExportModel(cMesh* object, const char* in_filename,
 			// Vertices only go anywhere on the first pass...
 			if (curPass == PASS_WRITE_VERTICES) {
 
-				// Write each of his vertices to the node file
-				for (int i = 0; i < local_nVertices; i++) {
+				// Text files are formatted on every core
+				if (nodef || objf || inpf) {
+
+					export_vertex_text job;
+					job.mesh = curMesh;
+					job.xform = xform;
+					job.filetype = filetype;
+					job.first_point = curPoint;
+					job.nNodeBoundaryMarkers = nNodeBoundaryMarkers;
+					job.nodeBoundaryMarker = nodeBoundaryMarker;
+
+					if (write_text_parallel(f, local_nVertices, format_export_vertices, &job) == false)
+						_cprintf("Error writing vertices\n");
+
+					curPoint += local_nVertices;
+				}
+
+				// Write each of his vertices to the smesh or ply file
+				else for (int i = 0; i < local_nVertices; i++) {
 					cVertex* raw_v = curMesh->getVertex(i, false);
 					cVertex* v;
 					cVertex outv(0, 0, 0);
@@ -440,33 +621,6 @@ int ExportModel(cMesh* object, const char* in_filename,
 						v->m_localPos -= xform->model_offset;
 					}
 
-					if (nodef) {
-						fprintf(nodef, "%u %f %f %f",
-							curPoint,
-							(float)(v->getPos().x),
-							(float)(v->getPos().y),
-							(float)(v->getPos().z));
-
-						if (nNodeBoundaryMarkers) fprintf(nodef, " %d", nodeBoundaryMarker);
-						fprintf(nodef, "\n");
-					}
-
-					if (objf) {
-						fprintf(objf, "v %f %f %f\n",
-							(float)(v->getPos().x),
-							(float)(v->getPos().y),
-							(float)(v->getPos().z));
-
-						fprintf(objf, "vt %f %f\n",
-							(float)(v->getTexCoord().x),
-							(float)(v->getTexCoord().y));
-
-						fprintf(objf, "vn %f %f %f\n",
-							(float)(v->getNormal().x),
-							(float)(v->getNormal().y),
-							(float)(v->getNormal().z));
-					}
-
 					if (smeshf) {
 						fprintf(smeshf, "%u %f %f %f",
 							curPoint,
@@ -494,12 +648,6 @@ int ExportModel(cMesh* object, const char* in_filename,
 						}
 					}
 
-					if (inpf) {
-						fprintf(inpf, "%u, %lf, %lf, %lf\n", curPoint + 1,
-							(double)(v->getPos().x),
-							(double)(v->getPos().y),
-							(double)(v->getPos().z));
-					}
 					curPoint++;
 				} // For each vertex
 
@@ -549,32 +697,27 @@ int ExportModel(cMesh* object, const char* in_filename,
 					}
 				}
 
-				for (int i = 0; i < local_nFaces; i++) {
-					cTriangle* t = curMesh->getTriangle(i, false);
+				// Text files are formatted on every core
+				if (facef || objf || inpf) {
 
-					if (facef) {
-						fprintf(facef, "%u %u %u %u",
-							curFace,
-							t->getVertexIndex(0) + pointOffset,
-							t->getVertexIndex(1) + pointOffset,
-							t->getVertexIndex(2) + pointOffset);
+					export_face_text job;
+					job.mesh = curMesh;
+					job.filetype = filetype;
+					job.pointOffset = pointOffset;
+					job.first_face = curFace;
+					job.nFaceBoundaryMarkers = nFaceBoundaryMarkers;
+					job.curMeshIndex = curMeshIndex;
 
-						if (nFaceBoundaryMarkers) fprintf(facef, " %d", curMeshIndex);
-						fprintf(facef, "\n");
-					}
+					FILE* face_output = facef ? facef : f;
+					if (write_text_parallel(face_output, local_nFaces, format_export_faces, &job) == false)
+						_cprintf("Error writing faces\n");
 
-					if (objf) {
-						fprintf(objf, "f %d/%d/%d %d/%d/%d %d/%d/%d\n",
-							t->getVertexIndex(0) + pointOffset + 1,
-							t->getVertexIndex(0) + pointOffset + 1,
-							t->getVertexIndex(0) + pointOffset + 1,
-							t->getVertexIndex(1) + pointOffset + 1,
-							t->getVertexIndex(1) + pointOffset + 1,
-							t->getVertexIndex(1) + pointOffset + 1,
-							t->getVertexIndex(2) + pointOffset + 1,
-							t->getVertexIndex(2) + pointOffset + 1,
-							t->getVertexIndex(2) + pointOffset + 1);
-					}
+					curFace += local_nFaces;
+				}
+
+				// Write each of his faces to the smesh or ply file
+				else for (int i = 0; i < local_nFaces; i++) {
+					cTriangle* t = curMesh->getTriangle(i, false);
 
 					if (smeshf) {
 						fprintf(smeshf, "%d %u %u %u",
@@ -609,13 +752,6 @@ int ExportModel(cMesh* object, const char* in_filename,
 						}
 					}
 
-					if (inpf) {
-						fprintf(inpf, "%u,%u,%u,%u\n", curFace + 1,
-							t->getVertexIndex(0) + pointOffset + 1,
-							t->getVertexIndex(1) + pointOffset + 1,
-							t->getVertexIndex(2) + pointOffset + 1);
-					}
-
 					curFace++;
 				} // For each triangle
 
@@ -0,0 +1,720 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "mesh_stream_converter.h"
+#include "meshExporter.h"
+#include "ply_stream.h"
+#include <conio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Longest line we'll format (three %lf's of huge doubles fit)
+#define MESH_STREAM_MAX_LINE 1200
+
+typedef enum {
+	MESH_STREAM_VERTICES = 0,
+	MESH_STREAM_TRIANGLES,
+	MESH_STREAM_END
+} mesh_stream_block_types;
+
+struct mesh_stream_block {
+	int type;
+
+	// The number of vertices or triangles
+	unsigned int count;
+
+	// x,y,z per vertex
+	std::vector<double> positions;
+
+	// Only if the file has them
+	std::vector<float> normals;
+	std::vector<float> texcoords;
+
+	// Three vertex indices per triangle
+	std::vector<unsigned int> triangles;
+};
+
+// Blocks in [head, head+count) are waiting to be written; the reader owns
+// the slot after them
+struct mesh_stream_queue {
+
+	FILE* f;
+	ply_file_layout layout;
+	ply_mesh_layout mesh_layout;
+
+	mesh_stream_block blocks[MESH_STREAM_QUEUE_LENGTH];
+	unsigned int head;
+	unsigned int count;
+
+	// Set by the reader if the file is bad, by the writer if it gives up
+	bool failed;
+	bool cancelled;
+
+#ifdef _WIN32
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE not_empty;
+	CONDITION_VARIABLE not_full;
+	HANDLE thread;
+	void enter() { EnterCriticalSection(&lock); }
+	void leave() { LeaveCriticalSection(&lock); }
+	void wait_not_empty() { SleepConditionVariableCS(&not_empty, &lock, INFINITE); }
+	void wait_not_full() { SleepConditionVariableCS(&not_full, &lock, INFINITE); }
+	void signal_not_empty() { WakeConditionVariable(&not_empty); }
+	void signal_not_full() { WakeConditionVariable(&not_full); }
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	pthread_t thread;
+	void enter() { pthread_mutex_lock(&lock); }
+	void leave() { pthread_mutex_unlock(&lock); }
+	void wait_not_empty() { pthread_cond_wait(&not_empty, &lock); }
+	void wait_not_full() { pthread_cond_wait(&not_full, &lock); }
+	void signal_not_empty() { pthread_cond_signal(&not_empty); }
+	void signal_not_full() { pthread_cond_signal(&not_full); }
+#endif
+
+	mesh_stream_queue() {
+		f = 0;
+		head = count = 0;
+		failed = cancelled = false;
+#ifdef _WIN32
+		InitializeCriticalSection(&lock);
+		InitializeConditionVariable(&not_empty);
+		InitializeConditionVariable(&not_full);
+		thread = 0;
+#else
+		pthread_mutex_init(&lock, 0);
+		pthread_cond_init(&not_empty, 0);
+		pthread_cond_init(&not_full, 0);
+#endif
+	}
+
+	~mesh_stream_queue() {
+#ifdef _WIN32
+		DeleteCriticalSection(&lock);
+#else
+		pthread_mutex_destroy(&lock);
+		pthread_cond_destroy(&not_empty);
+		pthread_cond_destroy(&not_full);
+#endif
+	}
+
+	// Reader side: waits for a free slot; returns zero if the writer gave up
+	mesh_stream_block* begin_block() {
+		enter();
+		while (count == MESH_STREAM_QUEUE_LENGTH && cancelled == false) wait_not_full();
+		mesh_stream_block* b = cancelled ? 0 : &(blocks[(head + count) % MESH_STREAM_QUEUE_LENGTH]);
+		leave();
+		return b;
+	}
+
+	void publish_block() {
+		enter();
+		count++;
+		signal_not_empty();
+		leave();
+	}
+
+	// Writer side
+	mesh_stream_block* next_block() {
+		enter();
+		while (count == 0) wait_not_empty();
+		mesh_stream_block* b = &(blocks[head]);
+		leave();
+		return b;
+	}
+
+	void release_block() {
+		enter();
+		head = (head + 1) % MESH_STREAM_QUEUE_LENGTH;
+		count--;
+		signal_not_full();
+		leave();
+	}
+
+	void cancel() {
+		enter();
+		cancelled = true;
+		signal_not_full();
+		leave();
+	}
+};
+
+
+/***
+Reading
+***/
+
+// Reads the whole file, a block at a time, ending with a MESH_STREAM_END block
+static void mesh_stream_read_loop(mesh_stream_queue* q) {
+
+	const std::vector<ply_element_layout>& elements = q->layout.elements;
+	const ply_mesh_layout& m = q->mesh_layout;
+	unsigned int nvertices = elements[m.vertex_element].count;
+
+	ply_block_reader reader(q->f, q->layout);
+	std::vector<unsigned int> face_indices;
+	double values[PLY_NUM_TARGETS];
+	bool ok = true;
+
+	for (unsigned int i = 0; i < elements.size() && ok; i++) {
+
+		const ply_element_layout& e = elements[i];
+		unsigned int k = 0;
+
+		if ((int)i == m.vertex_element) {
+
+			while (k < e.count && ok) {
+
+				mesh_stream_block* b = q->begin_block();
+				if (b == 0) return;
+
+				unsigned int n = e.count - k;
+				if (n > MESH_STREAM_BLOCK_ITEMS) n = MESH_STREAM_BLOCK_ITEMS;
+
+				b->type = MESH_STREAM_VERTICES;
+				b->count = 0;
+				b->positions.resize(3 * n);
+				if (m.has_normals) b->normals.resize(3 * n);
+				if (m.has_texcoords) b->texcoords.resize(2 * n);
+
+				for (unsigned int j = 0; j < n; j++) {
+					if (reader.read_vertex(e, m, values) == false) {
+						ok = false;
+						break;
+					}
+					memcpy(&(b->positions[3 * j]), values + PLY_TARGET_X, 3 * sizeof(double));
+					if (m.has_normals) {
+						b->normals[3 * j] = (float)(values[PLY_TARGET_NX]);
+						b->normals[3 * j + 1] = (float)(values[PLY_TARGET_NY]);
+						b->normals[3 * j + 2] = (float)(values[PLY_TARGET_NZ]);
+					}
+					if (m.has_texcoords) {
+						b->texcoords[2 * j] = (float)(values[PLY_TARGET_U]);
+						b->texcoords[2 * j + 1] = (float)(values[PLY_TARGET_V]);
+					}
+					b->count++;
+				}
+				k += n;
+
+				if (ok) q->publish_block();
+			}
+		}
+
+		else if ((int)i == m.face_element && m.index_property >= 0) {
+
+			while (k < e.count && ok) {
+
+				mesh_stream_block* b = q->begin_block();
+				if (b == 0) return;
+
+				b->type = MESH_STREAM_TRIANGLES;
+				b->count = 0;
+				b->triangles.clear();
+
+				// Fan-triangulate faces until the block is full
+				while (k < e.count && b->count < MESH_STREAM_BLOCK_ITEMS) {
+					if (reader.read_face(e, m, nvertices, face_indices) == false) {
+						ok = false;
+						break;
+					}
+					for (unsigned int j = 1; j + 1 < face_indices.size(); j++) {
+						b->triangles.push_back(face_indices[0]);
+						b->triangles.push_back(face_indices[j]);
+						b->triangles.push_back(face_indices[j + 1]);
+						b->count++;
+					}
+					k++;
+				}
+
+				if (ok) q->publish_block();
+			}
+		}
+
+		else {
+			for (k = 0; k < e.count && ok; k++) ok = reader.skip_element(e);
+		}
+	}
+
+	mesh_stream_block* b = q->begin_block();
+	if (b == 0) return;
+	b->type = MESH_STREAM_END;
+	b->count = 0;
+	q->failed = (ok == false);
+	q->publish_block();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI mesh_stream_thread_proc(void* param) {
+	mesh_stream_read_loop((mesh_stream_queue*)param);
+	return 0;
+}
+#else
+static void* mesh_stream_thread_proc(void* param) {
+	mesh_stream_read_loop((mesh_stream_queue*)param);
+	return 0;
+}
+#endif
+
+// Reads the faces once just to count the triangles they'll turn into
+static bool count_ply_triangles(const char* filename, unsigned int& ntriangles) {
+
+	ntriangles = 0;
+
+	FILE* f = fopen(filename, "rb");
+	if (f == 0) return false;
+
+	ply_file_layout layout;
+	ply_mesh_layout m;
+	if (read_ply_header(f, layout) == false || find_ply_mesh_layout(layout, m) == false) {
+		fclose(f);
+		return false;
+	}
+
+	bool ok = true;
+	if (m.face_element >= 0 && m.index_property >= 0) {
+
+		ply_block_reader reader(f, layout);
+		unsigned int nvertices = layout.elements[m.vertex_element].count;
+		std::vector<unsigned int> face_indices;
+
+		for (int i = 0; i <= m.face_element && ok; i++) {
+			const ply_element_layout& e = layout.elements[i];
+			for (unsigned int k = 0; k < e.count && ok; k++) {
+				if (i < m.face_element) {
+					ok = reader.skip_element(e);
+					continue;
+				}
+				ok = reader.read_face(e, m, nvertices, face_indices);
+				if (face_indices.size() > 2) ntriangles += face_indices.size() - 2;
+			}
+		}
+	}
+
+	fclose(f);
+	return ok;
+}
+
+
+/***
+Writing
+***/
+
+#define WINMESHVIEW_GENERATED_COMMENT "Generated by WinMeshView ( http://cs.stanford.edu/~dmorris/projects/winmeshview )"
+
+struct mesh_stream_writer {
+
+	int filetype;
+	bool has_normals;
+	bool has_texcoords;
+
+	// .node, .anode, .obj or .inp
+	FILE* f;
+
+	// .face
+	FILE* facef;
+
+	unsigned int nvertices;
+	unsigned int ntriangles;
+	unsigned int vertices_written;
+	unsigned int triangles_written;
+
+	// One block's worth of text
+	std::vector<char> text;
+	size_t text_length;
+
+	void append(const char* line, int length) {
+		if (text_length + length > text.size()) text.resize((text_length + length) * 2);
+		memcpy(&(text[text_length]), line, length);
+		text_length += length;
+	}
+
+	bool flush(FILE* out) {
+		bool ok = (text_length == 0 || fwrite(&(text[0]), 1, text_length, out) == text_length);
+		text_length = 0;
+		return ok;
+	}
+};
+
+static bool write_stream_vertices(mesh_stream_writer& w, const mesh_stream_block* b) {
+
+	char line[MESH_STREAM_MAX_LINE];
+	int n;
+
+	for (unsigned int i = 0; i < b->count; i++) {
+
+		const double* p = &(b->positions[3 * i]);
+		unsigned int index = w.vertices_written + i;
+
+		if (w.filetype == FILETYPE_NODE || w.filetype == FILETYPE_ANODE) {
+			n = sprintf(line, "%u %f %f %f\n", index, (float)(p[0]), (float)(p[1]), (float)(p[2]));
+			w.append(line, n);
+		}
+
+		else if (w.filetype == FILETYPE_OBJ) {
+			n = sprintf(line, "v %f %f %f\n", (float)(p[0]), (float)(p[1]), (float)(p[2]));
+			w.append(line, n);
+			if (w.has_texcoords) {
+				const float* t = &(b->texcoords[2 * i]);
+				n = sprintf(line, "vt %f %f\n", t[0], t[1]);
+				w.append(line, n);
+			}
+			if (w.has_normals) {
+				const float* v = &(b->normals[3 * i]);
+				n = sprintf(line, "vn %f %f %f\n", v[0], v[1], v[2]);
+				w.append(line, n);
+			}
+		}
+
+		else if (w.filetype == FILETYPE_ABAQUS_INP) {
+			n = sprintf(line, "%u, %lf, %lf, %lf\n", index + 1, p[0], p[1], p[2]);
+			w.append(line, n);
+		}
+	}
+
+	w.vertices_written += b->count;
+	return w.flush(w.f);
+}
+
+static bool write_stream_triangles(mesh_stream_writer& w, const mesh_stream_block* b) {
+
+	char line[MESH_STREAM_MAX_LINE];
+	int n = 0;
+
+	for (unsigned int i = 0; i < b->count; i++) {
+
+		const unsigned int* t = &(b->triangles[3 * i]);
+		unsigned int index = w.triangles_written + i;
+
+		if (w.filetype == FILETYPE_NODE) {
+			n = sprintf(line, "%u %u %u %u\n", index, t[0], t[1], t[2]);
+		}
+
+		else if (w.filetype == FILETYPE_OBJ) {
+			unsigned int a = t[0] + 1, c = t[1] + 1, d = t[2] + 1;
+			if (w.has_texcoords && w.has_normals)
+				n = sprintf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, d, d, d);
+			else if (w.has_texcoords)
+				n = sprintf(line, "f %d/%d %d/%d %d/%d\n", a, a, c, c, d, d);
+			else if (w.has_normals)
+				n = sprintf(line, "f %d//%d %d//%d %d//%d\n", a, a, c, c, d, d);
+			else
+				n = sprintf(line, "f %d %d %d\n", a, c, d);
+		}
+
+		else if (w.filetype == FILETYPE_ABAQUS_INP) {
+			n = sprintf(line, "%u,%u,%u,%u\n", index + 1, t[0] + 1, t[1] + 1, t[2] + 1);
+		}
+
+		w.append(line, n);
+	}
+
+	w.triangles_written += b->count;
+	return w.flush(w.facef ? w.facef : w.f);
+}
+
+int convert_mesh_streaming(const char* in_filename, const char* out_filename,
+	const mesh_xform_information* xform) {
+
+	if (in_filename == 0 || out_filename == 0) return -1;
+
+	char filename[_MAX_PATH];
+	strcpy(filename, out_filename);
+	char* extension = find_extension(filename);
+
+	int filetype = FILETYPE_INVALID;
+	if (extension == 0) filetype = FILETYPE_INVALID;
+	else if (strcmp(extension, "node") == 0) filetype = FILETYPE_NODE;
+	else if (strcmp(extension, "anode") == 0) filetype = FILETYPE_ANODE;
+	else if (strcmp(extension, "obj") == 0) filetype = FILETYPE_OBJ;
+	else if (strcmp(extension, "inp") == 0) filetype = FILETYPE_ABAQUS_INP;
+
+	if (filetype == FILETYPE_INVALID) {
+		_cprintf("Can only stream to .node, .anode, .obj or .inp files, not %s\n", out_filename);
+		return -1;
+	}
+
+	mesh_stream_queue* q = new mesh_stream_queue;
+
+	q->f = fopen(in_filename, "rb");
+	if (q->f == 0) {
+		_cprintf("Could not open %s\n", in_filename);
+		delete q;
+		return -1;
+	}
+
+	if (read_ply_header(q->f, q->layout) == false || find_ply_mesh_layout(q->layout, q->mesh_layout) == false) {
+		_cprintf("%s isn't a ply file with vertices that I can read\n", in_filename);
+		fclose(q->f);
+		delete q;
+		return -1;
+	}
+
+	const ply_mesh_layout& m = q->mesh_layout;
+	if (m.face_element >= 0 && m.face_element < m.vertex_element) {
+		_cprintf("Can't stream %s; its faces come before its vertices\n", in_filename);
+		fclose(q->f);
+		delete q;
+		return -1;
+	}
+
+	mesh_stream_writer w;
+	w.filetype = filetype;
+	w.has_normals = m.has_normals;
+	w.has_texcoords = m.has_texcoords;
+	w.f = 0;
+	w.facef = 0;
+	w.nvertices = q->layout.elements[m.vertex_element].count;
+	w.ntriangles = 0;
+	w.vertices_written = 0;
+	w.triangles_written = 0;
+	w.text.resize(MESH_STREAM_BLOCK_ITEMS * 64);
+	w.text_length = 0;
+
+	bool write_faces = (filetype != FILETYPE_ANODE && m.face_element >= 0 && m.index_property >= 0);
+
+	// .face and .inp files need the triangle count up front
+	if (filetype == FILETYPE_NODE || filetype == FILETYPE_ABAQUS_INP) {
+		if (write_faces && count_ply_triangles(in_filename, w.ntriangles) == false) {
+			_cprintf("Error reading faces from %s\n", in_filename);
+			fclose(q->f);
+			delete q;
+			return -1;
+		}
+	}
+
+	char face_filename[_MAX_PATH];
+	strcpy(extension, "face");
+	strcpy(face_filename, filename);
+	strcpy(filename, out_filename);
+
+	w.f = fopen(filename, "wb");
+	if (w.f == 0) {
+		_cprintf("Could not open output file %s\n", filename);
+		fclose(q->f);
+		delete q;
+		return -1;
+	}
+
+	if (filetype == FILETYPE_NODE) {
+		w.facef = fopen(face_filename, "wb");
+		if (w.facef == 0) {
+			_cprintf("Could not open output face file %s\n", face_filename);
+			fclose(w.f);
+			fclose(q->f);
+			delete q;
+			return -1;
+		}
+	}
+
+	_cprintf("Streaming %u vertices from %s to %s\n", w.nvertices, in_filename, filename);
+
+	float scale_factor = 1.0f;
+	cVector3d offset(0, 0, 0);
+	if (xform) {
+		offset = xform->model_offset;
+		scale_factor = (float)(xform->model_scale_factor);
+		_cprintf("Offsetting by (%lf,%lf,%lf), scaling by %f\n",
+			offset.x, offset.y, offset.z, scale_factor);
+	}
+
+	// Headers
+	if (filetype == FILETYPE_NODE || filetype == FILETYPE_ANODE) {
+		fprintf(w.f, "# %s\n", WINMESHVIEW_GENERATED_COMMENT);
+		fprintf(w.f, "%d %d %d %d\n", w.nvertices, 3, 0, 0);
+	}
+	if (w.facef) {
+		fprintf(w.facef, "# %s\n", WINMESHVIEW_GENERATED_COMMENT);
+		fprintf(w.facef, "%d %d\n", w.ntriangles, 0);
+	}
+	if (filetype == FILETYPE_OBJ) {
+		fprintf(w.f, "# %s\n", WINMESHVIEW_GENERATED_COMMENT);
+	}
+	if (filetype == FILETYPE_ABAQUS_INP) {
+		fprintf(w.f, "*Heading\n");
+		fprintf(w.f, "** %s\n", WINMESHVIEW_GENERATED_COMMENT);
+		fprintf(w.f, "*Preprint, echo=NO, model=NO, history=NO, contact=NO\n");
+		fprintf(w.f, "*Part, name=winmeshview_exported_part\n");
+		fprintf(w.f, "** Writing out %d vertices\n", w.nvertices);
+		fprintf(w.f, "*Node\n");
+	}
+
+	// Start reading
+#ifdef _WIN32
+	DWORD thread_id;
+	q->thread = ::CreateThread(0, 0, mesh_stream_thread_proc, q, 0, &thread_id);
+	bool started = (q->thread != 0);
+#else
+	bool started = (pthread_create(&(q->thread), 0, mesh_stream_thread_proc, q) == 0);
+#endif
+
+	bool ok = started;
+	if (started == false) _cprintf("Could not start the mesh reader thread\n");
+
+	bool started_faces = false;
+
+	while (ok) {
+
+		mesh_stream_block* b = q->next_block();
+
+		if (b->type == MESH_STREAM_END) {
+			ok = (q->failed == false);
+			if (ok == false) _cprintf("Error reading ply file %s\n", in_filename);
+			q->release_block();
+			break;
+		}
+
+		if (b->type == MESH_STREAM_VERTICES) {
+			if (xform) {
+				for (unsigned int i = 0; i < 3 * b->count; i++) {
+					b->positions[i] += offset[i % 3];
+					b->positions[i] *= scale_factor;
+				}
+			}
+			ok = write_stream_vertices(w, b);
+		}
+
+		else if (b->type == MESH_STREAM_TRIANGLES && write_faces) {
+			if (started_faces == false) {
+				if (filetype == FILETYPE_OBJ) {
+					char group_name[_MAX_PATH];
+					getShortFilename(group_name, in_filename);
+					fprintf(w.f, "g %s\n", group_name);
+				}
+				if (filetype == FILETYPE_ABAQUS_INP) {
+					fprintf(w.f, "** Writing out %d faces\n", w.ntriangles);
+					fprintf(w.f, "*Element, type=SFM3D3\n");
+				}
+				started_faces = true;
+			}
+			ok = write_stream_triangles(w, b);
+		}
+
+		q->release_block();
+
+		if (ok == false) _cprintf("Error writing %s\n", filename);
+	}
+
+	// If we stopped early, let the reader know no one's listening
+	if (ok == false) q->cancel();
+
+	if (started) {
+#ifdef _WIN32
+		WaitForSingleObject(q->thread, INFINITE);
+		CloseHandle(q->thread);
+#else
+		pthread_join(q->thread, 0);
+#endif
+	}
+
+	if (ok && filetype == FILETYPE_ABAQUS_INP) {
+		if (started_faces == false) {
+			fprintf(w.f, "** Writing out %d faces\n", w.ntriangles);
+			fprintf(w.f, "*Element, type=SFM3D3\n");
+		}
+		fprintf(w.f, "*Elset, elset=WMV-ELSET, generate\n");
+		fprintf(w.f, "1,%d,1\n", 0);
+		fprintf(w.f, "*Solid Section, elset=WMV-ELSET, material=WMV-MATERIAL\n");
+		fprintf(w.f, "1.0,\n");
+		fprintf(w.f, "*End part\n");
+	}
+
+	bool counted_triangles = (write_faces && (filetype == FILETYPE_NODE || filetype == FILETYPE_ABAQUS_INP));
+	if (ok && (w.vertices_written != w.nvertices ||
+		(counted_triangles && w.triangles_written != w.ntriangles))) {
+		_cprintf("Wrote %u vertices and %u triangles, expected %u and %u\n",
+			w.vertices_written, w.triangles_written, w.nvertices, w.ntriangles);
+		ok = false;
+	}
+
+	if (fclose(w.f) != 0) ok = false;
+	if (w.facef && fclose(w.facef) != 0) ok = false;
+	fclose(q->f);
+	delete q;
+
+	if (ok == false) return -1;
+
+	_cprintf("Wrote %u vertices and %u triangles\n", w.vertices_written, w.triangles_written);
+	return 0;
+}
+
+
+/***
+Command line
+***/
+
+static void print_conversion_usage() {
+	_cprintf("usage: winmeshview -convert input_file output_file [options]\n\n");
+	_cprintf("  input_file              a .ply file (ascii or binary)\n");
+	_cprintf("  output_file             a .node (and .face), .anode, .obj or .inp file\n");
+	_cprintf("  -scale s                scale each vertex by s (after offsetting it)\n");
+	_cprintf("  -offset x y z           offset each vertex by (x,y,z)\n");
+}
+
+int run_command_line_conversion(int argc, char** argv) {
+
+	char* in_filename = 0;
+	char* out_filename = 0;
+
+	mesh_xform_information xform;
+	xform.model_offset.set(0, 0, 0);
+	xform.model_scale_factor = 1.0;
+	bool use_xform = false;
+
+	for (int i = 0; i < argc; i++) {
+
+		char* arg = argv[i];
+
+		if (strcmp(arg, "-scale") == 0) {
+			if (i + 1 >= argc) {
+				print_conversion_usage();
+				return -1;
+			}
+			xform.model_scale_factor = atof(argv[++i]);
+			use_xform = true;
+		}
+
+		else if (strcmp(arg, "-offset") == 0) {
+			if (i + 3 >= argc) {
+				print_conversion_usage();
+				return -1;
+			}
+			xform.model_offset.set(atof(argv[i + 1]), atof(argv[i + 2]), atof(argv[i + 3]));
+			i += 3;
+			use_xform = true;
+		}
+
+		else if (in_filename == 0) in_filename = arg;
+		else if (out_filename == 0) out_filename = arg;
+
+		else {
+			_cprintf("Unrecognized argument: %s\n", arg);
+			print_conversion_usage();
+			return -1;
+		}
+	}
+
+	if (in_filename == 0 || out_filename == 0) {
+		print_conversion_usage();
+		return -1;
+	}
+
+	return convert_mesh_streaming(in_filename, out_filename, use_xform ? &xform : 0);
+}
@@ -0,0 +1,56 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Converts a .ply file to .node/.face, .anode, .obj or .inp without ever
+  building a cMesh, so models far bigger than memory can be converted.
+
+  Vertices and triangles pass through in blocks of MESH_STREAM_BLOCK_ITEMS:
+
+    reader thread:  decode a block from the .ply file
+    calling thread: transform it (optionally), format it, write it
+
+  The queue between them is MESH_STREAM_QUEUE_LENGTH blocks long, so the
+  next block is read while the last one is written, and memory use doesn't
+  depend on the size of the model.
+
+  The output matches what ExportModel writes for the same model, except
+  that .obj files only get texture coordinates and normals if the .ply file
+  has them (there's no mesh to compute normals from), and no material file.
+  .face and .inp files say how many triangles they hold before listing
+  them, so for those the faces are read twice: once to count triangles, and
+  once to write them.
+
+***********/
+
+#ifndef _MESH_STREAM_CONVERTER_H_
+#define _MESH_STREAM_CONVERTER_H_
+
+#include "meshImporter.h"
+
+#define MESH_STREAM_BLOCK_ITEMS 65536
+#define MESH_STREAM_QUEUE_LENGTH 2
+
+// If [xform] is supplied, each vertex is moved the way importModel() moves
+// it for XFORMOP_USESUPPLIED: the offset is added, then the result is
+// scaled.  Returns 0 for success, -1 for failure.
+int convert_mesh_streaming(const char* in_filename, const char* out_filename,
+	const mesh_xform_information* xform = 0);
+
+// Handles the arguments that follow "-convert" on the command line:
+//
+//   input_file output_file [-scale s] [-offset x y z]
+//
+// Returns 0 for success.
+int run_command_line_conversion(int argc, char** argv);
+
+#endif
@@ -0,0 +1,367 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  A tiny helper for spreading a range of independent work items ("chunks")
+  across several threads.
+
+  Each thread repeatedly claims the next unclaimed chunk from a shared
+  counter, so threads that finish early just keep pulling work until
+  everything is done; there's no static partitioning to get wrong when
+  chunks have very different costs.
+
+  The work function is called as f(param, chunk_index, thread_index), where
+  thread_index is in [0,num_threads) and is meant for indexing per-thread
+  scratch space.  The calling thread does work too (as thread 0), and
+  parallel_for_chunks() doesn't return until every chunk is finished.
+
+  parallel_for_chunks() starts (and joins) its threads on every call, which
+  is fine for one-off jobs but too slow for work that runs many times a
+  second; a parallel_worker_pool keeps its threads waiting between calls
+  to run().
+
+***********/
+
+#ifndef _PARALLEL_FOR_H_
+#define _PARALLEL_FOR_H_
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include <vector>
+
+typedef void(*parallel_chunk_function)(void* param, int chunk, int thread_index);
+
+// The number of processors we can run on, used when the caller asks for
+// "as many threads as possible"
+inline int parallel_num_processors() {
+
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	int n = (int)(info.dwNumberOfProcessors);
+#else
+	int n = (int)(sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+
+	return (n < 1) ? 1 : n;
+}
+
+// Turn a user-supplied thread count into a real one; anything less than
+// one means "use every processor"
+inline int parallel_resolve_num_threads(int num_threads) {
+	if (num_threads < 1) return parallel_num_processors();
+	return num_threads;
+}
+
+struct parallel_for_context {
+	parallel_chunk_function f;
+	void* param;
+	int num_chunks;
+	volatile long next_chunk;
+};
+
+struct parallel_for_thread {
+	parallel_for_context* context;
+	int thread_index;
+};
+
+// Atomically claims the next chunk, returning its index
+inline long parallel_claim_chunk(parallel_for_context* context) {
+#ifdef _WIN32
+	return InterlockedIncrement(&(context->next_chunk)) - 1;
+#else
+	return __sync_fetch_and_add(&(context->next_chunk), 1);
+#endif
+}
+
+inline void parallel_for_worker(parallel_for_thread* t) {
+
+	parallel_for_context* context = t->context;
+
+	while (1) {
+		long chunk = parallel_claim_chunk(context);
+		if (chunk >= context->num_chunks) break;
+		context->f(context->param, (int)chunk, t->thread_index);
+	}
+
+}
+
+#ifdef _WIN32
+inline DWORD WINAPI parallel_for_thread_proc(void* param) {
+	parallel_for_worker((parallel_for_thread*)(param));
+	return 0;
+}
+#else
+inline void* parallel_for_thread_proc(void* param) {
+	parallel_for_worker((parallel_for_thread*)(param));
+	return 0;
+}
+#endif
+
+// Runs f(param,chunk,thread) for every chunk in [0,num_chunks), using up
+// to num_threads threads (less than one means "one per processor").
+//
+// Returns the number of threads that actually ran.
+inline int parallel_for_chunks(int num_chunks, parallel_chunk_function f, void* param,
+	int num_threads = 0) {
+
+	num_threads = parallel_resolve_num_threads(num_threads);
+	if (num_threads > num_chunks) num_threads = num_chunks;
+	if (num_threads < 1) num_threads = 1;
+
+	parallel_for_context context;
+	context.f = f;
+	context.param = param;
+	context.num_chunks = num_chunks;
+	context.next_chunk = 0;
+
+	std::vector<parallel_for_thread> threads(num_threads);
+	for (int i = 0; i < num_threads; i++) {
+		threads[i].context = &context;
+		threads[i].thread_index = i;
+	}
+
+#ifdef _WIN32
+	std::vector<HANDLE> handles;
+	for (int i = 1; i < num_threads; i++) {
+		DWORD thread_id;
+		HANDLE h = ::CreateThread(0, 0, parallel_for_thread_proc, &(threads[i]), 0, &thread_id);
+
+		// If we couldn't get a thread, the remaining threads (at least this
+		// one) will just pick up the extra chunks
+		if (h) handles.push_back(h);
+	}
+#else
+	std::vector<pthread_t> handles;
+	for (int i = 1; i < num_threads; i++) {
+		pthread_t h;
+		if (pthread_create(&h, 0, parallel_for_thread_proc, &(threads[i])) == 0)
+			handles.push_back(h);
+	}
+#endif
+
+	// The calling thread is thread 0
+	parallel_for_worker(&(threads[0]));
+
+#ifdef _WIN32
+	for (unsigned int i = 0; i < handles.size(); i++) {
+		WaitForSingleObject(handles[i], INFINITE);
+		CloseHandle(handles[i]);
+	}
+#else
+	for (unsigned int i = 0; i < handles.size(); i++) {
+		pthread_join(handles[i], 0);
+	}
+#endif
+
+	return (int)(handles.size()) + 1;
+}
+
+// Subtracts one from [value], returning the new value
+inline long parallel_atomic_decrement(volatile long* value) {
+#ifdef _WIN32
+	return InterlockedDecrement(value);
+#else
+	return __sync_sub_and_fetch(value, 1);
+#endif
+}
+
+// An auto-reset event: wait() blocks until someone calls set(), then clears
+// it again
+struct parallel_event {
+
+#ifdef _WIN32
+	HANDLE handle;
+
+	void create() { handle = ::CreateEvent(0, FALSE, FALSE, 0); }
+	void destroy() { CloseHandle(handle); }
+	void set() { SetEvent(handle); }
+	void wait() { WaitForSingleObject(handle, INFINITE); }
+#else
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool signaled;
+
+	void create() {
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&cond, 0);
+		signaled = false;
+	}
+	void destroy() {
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&mutex);
+	}
+	void set() {
+		pthread_mutex_lock(&mutex);
+		signaled = true;
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&mutex);
+	}
+	void wait() {
+		pthread_mutex_lock(&mutex);
+		while (signaled == false) pthread_cond_wait(&cond, &mutex);
+		signaled = false;
+		pthread_mutex_unlock(&mutex);
+	}
+#endif
+};
+
+class parallel_worker_pool;
+
+struct parallel_pool_worker {
+	parallel_worker_pool* pool;
+	parallel_for_thread thread;
+	parallel_event start;
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+};
+
+// A fixed set of threads that sleep until run() hands them chunks; the
+// thread that calls run() is thread 0, as with parallel_for_chunks().
+// run() isn't re-entrant, and only one thread should call it at a time.
+class parallel_worker_pool {
+
+public:
+
+	// Starts up to [num_threads]-1 workers (less than one means "one
+	// thread per processor")
+	parallel_worker_pool(int num_threads = 0) {
+
+		num_threads = parallel_resolve_num_threads(num_threads);
+
+		m_quit = false;
+		m_remaining = 0;
+		m_done.create();
+
+		for (int i = 1; i < num_threads; i++) {
+
+			parallel_pool_worker* w = new parallel_pool_worker;
+			w->pool = this;
+			w->thread.context = &m_context;
+			w->thread.thread_index = (int)(m_workers.size()) + 1;
+			w->start.create();
+
+#ifdef _WIN32
+			DWORD thread_id;
+			w->handle = ::CreateThread(0, 0, worker_proc, w, 0, &thread_id);
+			bool started = (w->handle != 0);
+#else
+			bool started = (pthread_create(&(w->handle), 0, worker_proc, w) == 0);
+#endif
+
+			// Whoever we did get will pick up the extra chunks
+			if (started == false) {
+				w->start.destroy();
+				delete w;
+				continue;
+			}
+
+			m_workers.push_back(w);
+		}
+	}
+
+	~parallel_worker_pool() {
+
+		m_quit = true;
+
+		for (unsigned int i = 0; i < m_workers.size(); i++) {
+			parallel_pool_worker* w = m_workers[i];
+			w->start.set();
+#ifdef _WIN32
+			WaitForSingleObject(w->handle, INFINITE);
+			CloseHandle(w->handle);
+#else
+			pthread_join(w->handle, 0);
+#endif
+			w->start.destroy();
+			delete w;
+		}
+
+		m_done.destroy();
+	}
+
+	// Including the calling thread
+	int num_threads() const { return (int)(m_workers.size()) + 1; }
+
+	// Runs f(param,chunk,thread) for every chunk in [0,num_chunks), and
+	// returns when they're all finished
+	void run(int num_chunks, parallel_chunk_function f, void* param) {
+
+		if (num_chunks <= 0) return;
+
+		m_context.f = f;
+		m_context.param = param;
+		m_context.num_chunks = num_chunks;
+		m_context.next_chunk = 0;
+
+		// Only wake as many workers as there are chunks to share
+		int num_woken = num_chunks - 1;
+		if (num_woken > (int)(m_workers.size())) num_woken = (int)(m_workers.size());
+
+		m_remaining = num_woken;
+		for (int i = 0; i < num_woken; i++) m_workers[i]->start.set();
+
+		parallel_for_thread caller;
+		caller.context = &m_context;
+		caller.thread_index = 0;
+		parallel_for_worker(&caller);
+
+		// A worker can still be finishing its last chunk
+		if (num_woken > 0) m_done.wait();
+	}
+
+private:
+
+	static void worker_loop(parallel_pool_worker* w) {
+
+		parallel_worker_pool* pool = w->pool;
+
+		while (1) {
+			w->start.wait();
+			if (pool->m_quit) break;
+			parallel_for_worker(&(w->thread));
+			if (parallel_atomic_decrement(&(pool->m_remaining)) == 0) pool->m_done.set();
+		}
+	}
+
+#ifdef _WIN32
+	static DWORD WINAPI worker_proc(void* param) {
+		worker_loop((parallel_pool_worker*)(param));
+		return 0;
+	}
+#else
+	static void* worker_proc(void* param) {
+		worker_loop((parallel_pool_worker*)(param));
+		return 0;
+	}
+#endif
+
+	std::vector<parallel_pool_worker*> m_workers;
+	parallel_for_context m_context;
+	volatile long m_remaining;
+	volatile bool m_quit;
+	parallel_event m_done;
+
+	// Not copyable; the workers point back at us
+	parallel_worker_pool(const parallel_worker_pool&);
+	parallel_worker_pool& operator=(const parallel_worker_pool&);
+};
+
+#endif
@@ -0,0 +1,144 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "parallel_text_writer.h"
+#include "parallel_for.h"
+#include <math.h>
+#include <string.h>
+
+// Values at least this big go to sprintf; below it, the six decimals we
+// print are well inside the 17 digits any printf gets right
+#define FIXED6_FAST_LIMIT 1e8
+
+// How close (in millionths) the part we drop can be to one half before we
+// let sprintf decide which way to round
+#define FIXED6_TIE_MARGIN 1e-3
+
+static inline int write_digits(char* dest, unsigned int value) {
+
+	char digits[10];
+	int n = 0;
+	do {
+		digits[n++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value);
+
+	for (int i = 0; i < n; i++) dest[i] = digits[n - 1 - i];
+	return n;
+}
+
+int format_unsigned(char* dest, unsigned int value) {
+	return write_digits(dest, value);
+}
+
+int format_signed(char* dest, int value) {
+	if (value >= 0) return write_digits(dest, (unsigned int)value);
+	dest[0] = '-';
+	return 1 + write_digits(dest + 1, 0u - (unsigned int)value);
+}
+
+int format_fixed6(char* dest, double value) {
+
+	// printf prints a minus sign for anything with the sign bit set, even -0
+	unsigned long long bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bool negative = (bits >> 63) != 0;
+	double a = negative ? -value : value;
+
+	// Also catches infinities and NaNs
+	if (!(a < FIXED6_FAST_LIMIT)) return sprintf(dest, "%f", value);
+
+	// Both of these are exact...
+	double whole = floor(a);
+	double fraction = a - whole;
+
+	// ...and this is off by far less than FIXED6_TIE_MARGIN
+	double millionths = fraction * 1e6;
+	double below = floor(millionths);
+	double dropped = millionths - below;
+	if (fabs(dropped - 0.5) < FIXED6_TIE_MARGIN) return sprintf(dest, "%f", value);
+
+	unsigned int integer_part = (unsigned int)whole;
+	unsigned int fraction_part = (unsigned int)below + ((dropped > 0.5) ? 1 : 0);
+	if (fraction_part == 1000000) {
+		fraction_part = 0;
+		integer_part++;
+	}
+
+	char* p = dest;
+	if (negative) *p++ = '-';
+	p += write_digits(p, integer_part);
+	*p++ = '.';
+	for (int i = 5; i >= 0; i--) {
+		p[i] = (char)('0' + fraction_part % 10);
+		fraction_part /= 10;
+	}
+	p += 6;
+
+	return (int)(p - dest);
+}
+
+
+struct text_writer_batch {
+	text_item_formatter formatter;
+	void* param;
+	unsigned int first;
+	unsigned int count;
+	std::vector<text_buffer>* buffers;
+};
+
+static void format_text_chunk(void* param, int chunk, int /*thread_index*/) {
+
+	text_writer_batch* batch = (text_writer_batch*)param;
+
+	unsigned int first = batch->first + chunk * TEXT_WRITER_CHUNK_ITEMS;
+	unsigned int last = first + TEXT_WRITER_CHUNK_ITEMS;
+	if (last > batch->count) last = batch->count;
+
+	text_buffer& text = (*(batch->buffers))[chunk];
+	text.length = 0;
+	batch->formatter(batch->param, first, last, text);
+}
+
+bool write_text_parallel(FILE* f, unsigned int count, text_item_formatter formatter,
+	void* param, int num_threads) {
+
+	num_threads = parallel_resolve_num_threads(num_threads);
+
+	std::vector<text_buffer> buffers(TEXT_WRITER_BATCH_CHUNKS);
+
+	text_writer_batch batch;
+	batch.formatter = formatter;
+	batch.param = param;
+	batch.count = count;
+	batch.buffers = &buffers;
+
+	bool ok = true;
+
+	for (unsigned int first = 0; first < count; first += TEXT_WRITER_BATCH_CHUNKS * TEXT_WRITER_CHUNK_ITEMS) {
+
+		unsigned int remaining = count - first;
+		int nchunks = (int)((remaining + TEXT_WRITER_CHUNK_ITEMS - 1) / TEXT_WRITER_CHUNK_ITEMS);
+		if (nchunks > TEXT_WRITER_BATCH_CHUNKS) nchunks = TEXT_WRITER_BATCH_CHUNKS;
+
+		batch.first = first;
+		parallel_for_chunks(nchunks, format_text_chunk, &batch, num_threads);
+
+		// Keep going after a failed write, so the caller still gets a whole
+		// (if broken) file to look at
+		for (int i = 0; i < nchunks; i++) {
+			text_buffer& text = buffers[i];
+			if (text.length && fwrite(&(text.data[0]), 1, text.length, f) != text.length) ok = false;
+		}
+	}
+
+	return ok;
+}
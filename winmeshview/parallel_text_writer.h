@@ -0,0 +1,94 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Writes long runs of formatted text (one line per vertex or face) using
+  every core.
+
+  The items are split into chunks of TEXT_WRITER_CHUNK_ITEMS; each chunk is
+  formatted into its own buffer on whichever thread claims it, and the
+  buffers are written to the file in order, one fwrite per chunk.  At most
+  TEXT_WRITER_BATCH_CHUNKS chunks are held at once, so memory doesn't grow
+  with the size of the model.
+
+  The number formatters produce exactly what sprintf does for "%f", "%u"
+  and "%d", so files come out byte-for-byte the same as with fprintf.
+
+***********/
+
+#ifndef _PARALLEL_TEXT_WRITER_H_
+#define _PARALLEL_TEXT_WRITER_H_
+
+#include <stdio.h>
+#include <vector>
+
+#define TEXT_WRITER_CHUNK_ITEMS 4096
+#define TEXT_WRITER_BATCH_CHUNKS 32
+
+// Room for any number we'll format ("%f" of the largest double is a bit
+// over 300 characters)
+#define TEXT_WRITER_MAX_NUMBER 400
+
+// Each writes the same characters as sprintf(dest,"%f",value) (or "%u",
+// "%d"), and returns the number of characters written; [dest] isn't
+// null-terminated
+int format_fixed6(char* dest, double value);
+int format_unsigned(char* dest, unsigned int value);
+int format_signed(char* dest, int value);
+
+// A growing block of text
+struct text_buffer {
+
+	std::vector<char> data;
+	size_t length;
+
+	text_buffer() { length = 0; }
+
+	// Returns a pointer to at least [n] free characters
+	inline char* reserve(size_t n) {
+		if (length + n > data.size()) data.resize((length + n) * 2);
+		return &(data[length]);
+	}
+
+	inline void put_char(char c) {
+		*reserve(1) = c;
+		length++;
+	}
+
+	inline void put_string(const char* s) {
+		while (*s) put_char(*s++);
+	}
+
+	inline void put_fixed6(double value) {
+		length += format_fixed6(reserve(TEXT_WRITER_MAX_NUMBER), value);
+	}
+
+	inline void put_unsigned(unsigned int value) {
+		length += format_unsigned(reserve(TEXT_WRITER_MAX_NUMBER), value);
+	}
+
+	inline void put_signed(int value) {
+		length += format_signed(reserve(TEXT_WRITER_MAX_NUMBER), value);
+	}
+};
+
+// Appends the text for items [first,last) to [text]
+typedef void(*text_item_formatter)(void* param, unsigned int first, unsigned int last,
+	text_buffer& text);
+
+// Formats items [0,count) with [formatter] on up to [num_threads] threads
+// (less than one means "one per processor") and writes them to [f] in
+// order.  Returns false if a write failed.
+bool write_text_parallel(FILE* f, unsigned int count, text_item_formatter formatter,
+	void* param, int num_threads = 0);
+
+#endif
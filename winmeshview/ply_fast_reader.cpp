@@ -0,0 +1,189 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Fast reader for binary (little- or big-endian) .ply files.
+
+  rply calls back once per scalar, and each callback ends up in
+  cMesh::newVertex() or cMesh::newTriangle(), which check the free lists
+  one element at a time.  Here, the header is parsed up front, the vertex
+  and triangle arrays are allocated once, and the data is read in large
+  blocks and decoded straight into them, byte-swapping if the file's byte
+  order isn't ours.  Faces are fan-triangulated exactly as face_cb() does
+  it.
+
+  Besides x,y,z, vertices can have normals (nx,ny,nz), colors
+  (red,green,blue[,alpha]) and texture coordinates (u,v or s,t); anything
+  else, and any element other than vertices and faces, is skipped.
+
+  ASCII files, meshes that already have something in them, and files whose
+  faces come before their vertices are left to rply.
+
+  The header parsing and decoding live in ply_stream.cpp.
+
+***********/
+
+#include "ply_loader.h"
+#include "ply_stream.h"
+#include "CVertex.h"
+#include "CTriangle.h"
+#include <conio.h>
+#include <stdio.h>
+#include <vector>
+
+int cPlyLoader::fast_read_binary_ply(cMesh* mesh, const char* filename) {
+
+	// The free lists only matter for a mesh that already has something in it
+	if (mesh->getNumVertices(false) > 0 || mesh->getNumTriangles(false) > 0)
+		return PLY_FAST_READ_UNSUPPORTED;
+
+	FILE* f = fopen(filename, "rb");
+	if (f == 0) return PLY_FAST_READ_UNSUPPORTED;
+
+	ply_file_layout layout;
+	ply_mesh_layout mesh_layout;
+	bool supported = read_ply_header(f, layout) && layout.format != PLY_FORMAT_ASCII &&
+		find_ply_mesh_layout(layout, mesh_layout);
+	if (supported && mesh_layout.face_element >= 0 && mesh_layout.face_element < mesh_layout.vertex_element)
+		supported = false;
+
+	if (supported == false) {
+		fclose(f);
+		return PLY_FAST_READ_UNSUPPORTED;
+	}
+
+	const std::vector<ply_element_layout>& elements = layout.elements;
+	int vertex_element = mesh_layout.vertex_element;
+	int face_element = mesh_layout.face_element;
+	const bool* has_target = mesh_layout.has_target;
+
+	// Allocate everything up front; a face is usually one triangle
+	std::vector<cVertex>* vertex_vector = mesh->pVertices();
+	std::vector<cTriangle>* tri_vector = mesh->pTriangles();
+
+	unsigned int nvertices = elements[vertex_element].count;
+	vertex_vector->reserve(nvertices);
+	if (face_element >= 0 && mesh_layout.index_property >= 0) tri_vector->reserve(elements[face_element].count);
+
+	ply_block_reader reader(f, layout);
+	bool ok = true;
+	std::vector<unsigned int> face_indices;
+	double values[PLY_NUM_TARGETS];
+
+	for (unsigned int i = 0; i < elements.size() && ok; i++) {
+
+		const ply_element_layout& e = elements[i];
+
+		// Vertices: decode as many whole vertices as are in the buffer at a
+		// time (if they're all the same size)
+		if ((int)i == vertex_element) {
+
+			unsigned int stride = e.fixed_size;
+			unsigned int remaining = e.count;
+
+			while (remaining > 0) {
+
+				unsigned int nblock = 1;
+				const unsigned char* p = 0;
+				if (stride) {
+					if (reader.ensure(stride) == false) {
+						ok = false;
+						break;
+					}
+					nblock = (unsigned int)((reader.end - reader.pos) / stride);
+					if (nblock > remaining) nblock = remaining;
+					p = reader.data();
+				}
+
+				for (unsigned int k = 0; k < nblock; k++) {
+
+					if (stride) {
+						decode_ply_vertex(p, e, mesh_layout, layout.swap, values);
+						p += stride;
+					}
+					else if (reader.read_vertex(e, mesh_layout, values) == false) {
+						ok = false;
+						break;
+					}
+
+					cVertex v(values[PLY_TARGET_X], values[PLY_TARGET_Y], values[PLY_TARGET_Z]);
+					v.m_index = vertex_vector->size();
+					if (mesh_layout.has_normals)
+						v.setNormal(values[PLY_TARGET_NX], values[PLY_TARGET_NY], values[PLY_TARGET_NZ]);
+					if (mesh_layout.has_colors)
+						v.setColor(cColorb((GLubyte)values[PLY_TARGET_RED], (GLubyte)values[PLY_TARGET_GREEN],
+							(GLubyte)values[PLY_TARGET_BLUE],
+							has_target[PLY_TARGET_ALPHA] ? (GLubyte)values[PLY_TARGET_ALPHA] : 0xff));
+					if (mesh_layout.has_texcoords)
+						v.setTexCoord(values[PLY_TARGET_U], values[PLY_TARGET_V]);
+					vertex_vector->push_back(v);
+				}
+				if (ok == false) break;
+
+				reader.pos += nblock * stride;
+				remaining -= nblock;
+			}
+		}
+
+		// Faces: fan-triangulate each one, just like face_cb()
+		else if ((int)i == face_element && mesh_layout.index_property >= 0) {
+
+			cVertex* vertices = (nvertices > 0) ? &((*vertex_vector)[0]) : 0;
+
+			for (unsigned int k = 0; k < e.count; k++) {
+
+				if (reader.read_face(e, mesh_layout, nvertices, face_indices) == false) {
+					ok = false;
+					break;
+				}
+
+				unsigned int count = face_indices.size();
+				for (unsigned int m = 1; m + 1 < count; m++) {
+					unsigned int v0 = face_indices[0];
+					unsigned int v1 = face_indices[m];
+					unsigned int v2 = face_indices[m + 1];
+					cTriangle tri(mesh, v0, v1, v2);
+					tri.m_index = tri_vector->size();
+					tri.m_allocated = true;
+					tri_vector->push_back(tri);
+					vertices[v0].m_allocated = true;
+					vertices[v0].m_nTriangles++;
+					vertices[v1].m_allocated = true;
+					vertices[v1].m_nTriangles++;
+					vertices[v2].m_allocated = true;
+					vertices[v2].m_nTriangles++;
+				}
+			}
+		}
+
+		// Anything else (or faces without indices) we just read past
+		else {
+			for (unsigned int k = 0; k < e.count && ok; k++) {
+				ok = reader.skip_element(e);
+			}
+		}
+	}
+
+	fclose(f);
+
+	if (ok == false) {
+		_cprintf("Error reading ply file %s\n", filename);
+		return PLY_FAST_READ_ERROR;
+	}
+
+	// Keep the normals that came with the file
+	if (mesh_layout.has_normals == false) mesh->computeAllNormals(0);
+	mesh->useCulling(0, 1);
+	mesh->useColors(0, 1);
+
+	return PLY_FAST_READ_OK;
+}
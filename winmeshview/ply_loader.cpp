@@ -101,6 +101,11 @@ bool cPlyLoader::load_ply_file(cMesh* mesh, cWorld* world, const char* filename)
 
 	long nvertices, nfaces;
 
+	// Binary files are much faster to read without rply
+	int fast_result = fast_read_binary_ply(mesh, filename);
+	if (fast_result == PLY_FAST_READ_OK) return true;
+	if (fast_result == PLY_FAST_READ_ERROR) return false;
+
 	// Open the ply file
 	p_ply ply = ply_open(filename, NULL);
 	if (!ply) {
@@ -14,6 +14,13 @@
 
 #include "CMesh.h"
 
+// What cPlyLoader::fast_read_binary_ply() did with a file
+typedef enum {
+	PLY_FAST_READ_UNSUPPORTED = 0,
+	PLY_FAST_READ_OK,
+	PLY_FAST_READ_ERROR
+} ply_fast_read_results;
+
 class cPlyLoader {
 
 public:
@@ -31,5 +38,11 @@ public:
 	int current_face_expected_vertices;
 	std::vector<int> current_face_elements;
 
+protected:
+	// Loads binary files without going through rply's callbacks (see
+	// ply_fast_reader.cpp); returns PLY_FAST_READ_UNSUPPORTED, having
+	// changed nothing, for anything it can't read
+	int fast_read_binary_ply(cMesh* mesh, const char* filename);
+
 };
 #endif
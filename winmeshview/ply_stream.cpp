@@ -0,0 +1,359 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+#include "ply_stream.h"
+#include <conio.h>
+#include <stdlib.h>
+
+const int ply_type_sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+static int ply_type_from_name(const char* name) {
+	static const char* names[] = {
+		"char", "uchar", "short", "ushort", "int", "uint", "float", "double",
+		"int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64"
+	};
+	for (int i = 0; i < 16; i++) {
+		if (strcmp(name, names[i]) == 0) return i % 8;
+	}
+	return PLY_TYPE_INVALID;
+}
+
+static int ply_vertex_target(const std::string& name) {
+	if (name == "x") return PLY_TARGET_X;
+	if (name == "y") return PLY_TARGET_Y;
+	if (name == "z") return PLY_TARGET_Z;
+	if (name == "nx") return PLY_TARGET_NX;
+	if (name == "ny") return PLY_TARGET_NY;
+	if (name == "nz") return PLY_TARGET_NZ;
+	if (name == "red" || name == "diffuse_red") return PLY_TARGET_RED;
+	if (name == "green" || name == "diffuse_green") return PLY_TARGET_GREEN;
+	if (name == "blue" || name == "diffuse_blue") return PLY_TARGET_BLUE;
+	if (name == "alpha" || name == "diffuse_alpha") return PLY_TARGET_ALPHA;
+	if (name == "u" || name == "s" || name == "texture_u" || name == "texture_s") return PLY_TARGET_U;
+	if (name == "v" || name == "t" || name == "texture_v" || name == "texture_t") return PLY_TARGET_V;
+	return PLY_TARGET_NONE;
+}
+
+static bool ply_host_is_little_endian() {
+	unsigned int one = 1;
+	return (*((unsigned char*)(&one)) == 1);
+}
+
+unsigned char ply_color_value(double value, int type) {
+	if (type == PLY_TYPE_FLOAT32 || type == PLY_TYPE_FLOAT64) value *= 255.0;
+	if (value <= 0.0) return 0;
+	if (value >= 255.0) return 255;
+	return (unsigned char)(value + 0.5);
+}
+
+
+/***
+Header
+***/
+
+bool read_ply_header(FILE* f, ply_file_layout& layout) {
+
+	char buf[PLY_HEADER_LINE_BUFFER];
+	char word[PLY_HEADER_LINE_BUFFER], type_name[PLY_HEADER_LINE_BUFFER],
+		count_type_name[PLY_HEADER_LINE_BUFFER], name[PLY_HEADER_LINE_BUFFER];
+
+	std::vector<ply_element_layout>& elements = layout.elements;
+	elements.clear();
+
+	if (fgets(buf, PLY_HEADER_LINE_BUFFER, f) == 0) return false;
+	if (strncmp(buf, "ply", 3) != 0 || (buf[3] != '\n' && buf[3] != '\r')) return false;
+
+	bool found_format = false;
+
+	while (1) {
+
+		if (fgets(buf, PLY_HEADER_LINE_BUFFER, f) == 0) return false;
+		if (strchr(buf, '\n') == 0) return false;
+
+		if (sscanf(buf, "%s", word) != 1) continue;
+		std::string keyword(word);
+
+		if (keyword == "end_header") break;
+
+		else if (keyword == "comment" || keyword == "obj_info") continue;
+
+		else if (keyword == "format") {
+			if (sscanf(buf, "%*s %s", word) != 1) return false;
+			if (strcmp(word, "ascii") == 0) layout.format = PLY_FORMAT_ASCII;
+			else if (strcmp(word, "binary_little_endian") == 0) layout.format = PLY_FORMAT_BINARY_LITTLE_ENDIAN;
+			else if (strcmp(word, "binary_big_endian") == 0) layout.format = PLY_FORMAT_BINARY_BIG_ENDIAN;
+			else return false;
+			found_format = true;
+		}
+
+		else if (keyword == "element") {
+			ply_element_layout element;
+			long count;
+			if (sscanf(buf, "%*s %s %ld", name, &count) != 2 || count < 0) return false;
+			element.name = name;
+			element.count = (unsigned int)count;
+			element.fixed_size = 0;
+			elements.push_back(element);
+		}
+
+		else if (keyword == "property") {
+			if (elements.size() == 0) return false;
+			ply_property_layout property;
+			if (sscanf(buf, "%*s %s", word) != 1) return false;
+			if (strcmp(word, "list") == 0) {
+				if (sscanf(buf, "%*s %*s %s %s %s", count_type_name, type_name, name) != 3) return false;
+				property.count_type = ply_type_from_name(count_type_name);
+				property.type = ply_type_from_name(type_name);
+				if (property.count_type == PLY_TYPE_INVALID ||
+					property.count_type == PLY_TYPE_FLOAT32 ||
+					property.count_type == PLY_TYPE_FLOAT64) return false;
+			}
+			else {
+				if (sscanf(buf, "%*s %s %s", type_name, name) != 2) return false;
+				property.count_type = PLY_TYPE_INVALID;
+				property.type = ply_type_from_name(type_name);
+			}
+			if (property.type == PLY_TYPE_INVALID) return false;
+			property.name = name;
+			elements.back().properties.push_back(property);
+		}
+
+		else return false;
+	}
+
+	if (found_format == false) return false;
+
+	layout.swap = false;
+	if (layout.format == PLY_FORMAT_BINARY_LITTLE_ENDIAN) layout.swap = !ply_host_is_little_endian();
+	if (layout.format == PLY_FORMAT_BINARY_BIG_ENDIAN) layout.swap = ply_host_is_little_endian();
+
+	for (unsigned int i = 0; i < elements.size(); i++) {
+		ply_element_layout& e = elements[i];
+		unsigned int size = 0;
+		for (unsigned int j = 0; j < e.properties.size(); j++) {
+			if (e.properties[j].count_type != PLY_TYPE_INVALID) {
+				size = 0;
+				break;
+			}
+			size += ply_type_sizes[e.properties[j].type];
+		}
+		e.fixed_size = size;
+	}
+
+	return true;
+}
+
+bool find_ply_mesh_layout(const ply_file_layout& file, ply_mesh_layout& mesh) {
+
+	const std::vector<ply_element_layout>& elements = file.elements;
+
+	mesh.vertex_element = -1;
+	mesh.face_element = -1;
+	mesh.index_property = -1;
+	mesh.targets.clear();
+
+	unsigned int i, j;
+	for (i = 0; i < elements.size(); i++) {
+		if (elements[i].name == "vertex" && mesh.vertex_element < 0) mesh.vertex_element = i;
+		else if (elements[i].name == "face" && mesh.face_element < 0) mesh.face_element = i;
+	}
+
+	for (i = 0; i < PLY_NUM_TARGETS; i++) mesh.has_target[i] = false;
+
+	if (mesh.vertex_element < 0) return false;
+
+	const ply_element_layout& v = elements[mesh.vertex_element];
+	for (j = 0; j < v.properties.size(); j++) {
+		int target = PLY_TARGET_NONE;
+		if (v.properties[j].count_type == PLY_TYPE_INVALID) target = ply_vertex_target(v.properties[j].name);
+		if (target != PLY_TARGET_NONE && mesh.has_target[target]) target = PLY_TARGET_NONE;
+		if (target != PLY_TARGET_NONE) mesh.has_target[target] = true;
+		mesh.targets.push_back(target);
+	}
+
+	const bool* has = mesh.has_target;
+	mesh.has_normals = (has[PLY_TARGET_NX] && has[PLY_TARGET_NY] && has[PLY_TARGET_NZ]);
+	mesh.has_colors = (has[PLY_TARGET_RED] && has[PLY_TARGET_GREEN] && has[PLY_TARGET_BLUE]);
+	mesh.has_texcoords = (has[PLY_TARGET_U] && has[PLY_TARGET_V]);
+
+	// rply looks for vertex_indices first
+	if (mesh.face_element >= 0) {
+		const ply_element_layout& f = elements[mesh.face_element];
+		for (j = 0; j < f.properties.size() && mesh.index_property < 0; j++) {
+			if (f.properties[j].name == "vertex_indices" && f.properties[j].count_type != PLY_TYPE_INVALID)
+				mesh.index_property = j;
+		}
+		for (j = 0; j < f.properties.size() && mesh.index_property < 0; j++) {
+			if (f.properties[j].name == "vertex_index" && f.properties[j].count_type != PLY_TYPE_INVALID)
+				mesh.index_property = j;
+		}
+	}
+
+	return (has[PLY_TARGET_X] && has[PLY_TARGET_Y] && has[PLY_TARGET_Z]);
+}
+
+
+/***
+Reading
+***/
+
+ply_block_reader::ply_block_reader(FILE* file, const ply_file_layout& layout) {
+	f = file;
+	format = layout.format;
+	swap = layout.swap;
+	buffer.resize(PLY_READ_BLOCK_BYTES);
+	pos = 0;
+	end = 0;
+}
+
+bool ply_block_reader::refill(size_t n) {
+	if (pos > 0) {
+		memmove(&(buffer[0]), &(buffer[pos]), end - pos);
+		end -= pos;
+		pos = 0;
+	}
+	if (n > buffer.size()) buffer.resize(n);
+	end += fread(&(buffer[end]), 1, buffer.size() - end, f);
+	return (end - pos >= n);
+}
+
+static inline bool is_ply_whitespace(unsigned char c) {
+	return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+bool ply_block_reader::read_ascii_value(double& value) {
+
+	while (1) {
+		if (ensure(1) == false) return false;
+		if (is_ply_whitespace(buffer[pos]) == false) break;
+		pos++;
+	}
+
+	char token[PLY_MAX_TOKEN_LENGTH + 1];
+	int n = 0;
+	while (ensure(1) && is_ply_whitespace(buffer[pos]) == false) {
+		if (n == PLY_MAX_TOKEN_LENGTH) return false;
+		token[n++] = (char)(buffer[pos++]);
+	}
+	token[n] = '\0';
+
+	char* stop;
+	value = strtod(token, &stop);
+	return (stop != token && *stop == '\0');
+}
+
+bool ply_block_reader::read_value(int type, double& value) {
+	if (format == PLY_FORMAT_ASCII) return read_ascii_value(value);
+	int size = ply_type_sizes[type];
+	if (ensure(size) == false) return false;
+	value = ply_scalar_value(data(), type, swap);
+	pos += size;
+	return true;
+}
+
+bool ply_block_reader::skip_property(const ply_property_layout& p) {
+
+	double count = 1.0;
+	if (p.count_type != PLY_TYPE_INVALID) {
+		if (read_value(p.count_type, count) == false || count < 0) return false;
+	}
+
+	if (format == PLY_FORMAT_ASCII) {
+		double value;
+		for (unsigned int i = 0; i < (unsigned int)count; i++) {
+			if (read_ascii_value(value) == false) return false;
+		}
+		return true;
+	}
+
+	size_t size = ply_type_sizes[p.type] * (size_t)count;
+	if (ensure(size) == false) return false;
+	pos += size;
+	return true;
+}
+
+bool ply_block_reader::skip_element(const ply_element_layout& e) {
+
+	if (e.fixed_size && format != PLY_FORMAT_ASCII) {
+		if (ensure(e.fixed_size) == false) return false;
+		pos += e.fixed_size;
+		return true;
+	}
+
+	for (unsigned int i = 0; i < e.properties.size(); i++) {
+		if (skip_property(e.properties[i]) == false) return false;
+	}
+	return true;
+}
+
+bool ply_block_reader::read_vertex(const ply_element_layout& e, const ply_mesh_layout& mesh, double* values) {
+
+	if (e.fixed_size && format != PLY_FORMAT_ASCII) {
+		if (ensure(e.fixed_size) == false) return false;
+		decode_ply_vertex(data(), e, mesh, swap, values);
+		pos += e.fixed_size;
+		return true;
+	}
+
+	for (unsigned int j = 0; j < e.properties.size(); j++) {
+		int target = mesh.targets[j];
+		if (target == PLY_TARGET_NONE) {
+			if (skip_property(e.properties[j]) == false) return false;
+			continue;
+		}
+		double value;
+		if (read_value(e.properties[j].type, value) == false) return false;
+		if (target >= PLY_TARGET_RED && target <= PLY_TARGET_ALPHA)
+			value = ply_color_value(value, e.properties[j].type);
+		values[target] = value;
+	}
+	return true;
+}
+
+bool ply_block_reader::read_face(const ply_element_layout& e, const ply_mesh_layout& mesh,
+	unsigned int nvertices, std::vector<unsigned int>& indices) {
+
+	for (unsigned int j = 0; j < e.properties.size(); j++) {
+
+		const ply_property_layout& p = e.properties[j];
+		if ((int)j != mesh.index_property) {
+			if (skip_property(p) == false) return false;
+			continue;
+		}
+
+		double count_value;
+		if (read_value(p.count_type, count_value) == false || count_value < 0) return false;
+		unsigned int count = (unsigned int)count_value;
+		indices.resize(count);
+
+		// Binary indices can all be decoded at once
+		unsigned int size = ply_type_sizes[p.type];
+		if (format != PLY_FORMAT_ASCII && ensure(count * size) == false) return false;
+
+		for (unsigned int m = 0; m < count; m++) {
+			double index;
+			if (format == PLY_FORMAT_ASCII) {
+				if (read_ascii_value(index) == false) return false;
+			}
+			else {
+				index = ply_scalar_value(data() + m * size, p.type, swap);
+			}
+			if (index < 0 || index >= nvertices) {
+				_cprintf("A face refers to vertex %.0lf, but there are only %u vertices\n",
+					index, nvertices);
+				return false;
+			}
+			indices[m] = (unsigned int)index;
+		}
+		if (format != PLY_FORMAT_ASCII) pos += count * size;
+	}
+	return true;
+}
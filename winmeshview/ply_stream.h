@@ -0,0 +1,213 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  The pieces of .ply parsing that don't depend on where the data is going:
+  the header, a reader that hands out the body a block at a time, and
+  per-vertex / per-face decoding.  Used by the fast binary reader in
+  cPlyLoader and by the streaming converter.
+
+***********/
+
+#ifndef _PLY_STREAM_H_
+#define _PLY_STREAM_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Longest header line we'll accept
+#define PLY_HEADER_LINE_BUFFER 1000
+
+// Bytes read from the file at a time
+#define PLY_READ_BLOCK_BYTES (4<<20)
+
+// Longest number we'll accept in an ascii file
+#define PLY_MAX_TOKEN_LENGTH 63
+
+typedef enum {
+	PLY_TYPE_INVALID = -1,
+	PLY_TYPE_INT8 = 0,
+	PLY_TYPE_UINT8,
+	PLY_TYPE_INT16,
+	PLY_TYPE_UINT16,
+	PLY_TYPE_INT32,
+	PLY_TYPE_UINT32,
+	PLY_TYPE_FLOAT32,
+	PLY_TYPE_FLOAT64
+} ply_scalar_types;
+
+extern const int ply_type_sizes[];
+
+typedef enum {
+	PLY_FORMAT_ASCII = 0,
+	PLY_FORMAT_BINARY_LITTLE_ENDIAN,
+	PLY_FORMAT_BINARY_BIG_ENDIAN
+} ply_formats;
+
+// What a vertex property turns into
+typedef enum {
+	PLY_TARGET_NONE = -1,
+	PLY_TARGET_X = 0, PLY_TARGET_Y, PLY_TARGET_Z,
+	PLY_TARGET_NX, PLY_TARGET_NY, PLY_TARGET_NZ,
+	PLY_TARGET_RED, PLY_TARGET_GREEN, PLY_TARGET_BLUE, PLY_TARGET_ALPHA,
+	PLY_TARGET_U, PLY_TARGET_V,
+	PLY_NUM_TARGETS
+} ply_vertex_targets;
+
+struct ply_property_layout {
+	std::string name;
+
+	// For lists, the type of each item
+	int type;
+
+	// PLY_TYPE_INVALID for scalars
+	int count_type;
+};
+
+struct ply_element_layout {
+	std::string name;
+	unsigned int count;
+	std::vector<ply_property_layout> properties;
+
+	// Bytes per element in a binary file, or zero if the element has a list
+	unsigned int fixed_size;
+};
+
+struct ply_file_layout {
+	int format;
+
+	// Binary data isn't in our byte order
+	bool swap;
+
+	std::vector<ply_element_layout> elements;
+};
+
+// Where the mesh is in a ply file
+struct ply_mesh_layout {
+
+	// -1 if there isn't one
+	int vertex_element;
+	int face_element;
+
+	// The face element's list of vertex indices, or -1
+	int index_property;
+
+	// For each vertex property, a PLY_TARGET_ value
+	std::vector<int> targets;
+	bool has_target[PLY_NUM_TARGETS];
+
+	bool has_normals;
+	bool has_colors;
+	bool has_texcoords;
+};
+
+// Reads the header, leaving [f] at the start of the data; returns false if
+// this isn't a ply file we can read
+bool read_ply_header(FILE* f, ply_file_layout& layout);
+
+// Finds the vertices (which need x,y,z) and faces; returns false if there
+// aren't any vertices
+bool find_ply_mesh_layout(const ply_file_layout& file, ply_mesh_layout& mesh);
+
+// Colors are stored as bytes; floating-point colors run from 0 to 1
+unsigned char ply_color_value(double value, int type);
+
+// Reads one binary scalar of [type] at [p], swapping its bytes if [swap] is set
+inline double ply_scalar_value(const unsigned char* p, int type, bool swap) {
+
+	unsigned char bytes[8];
+	int size = ply_type_sizes[type];
+	if (swap) {
+		for (int i = 0; i < size; i++) bytes[i] = p[size - 1 - i];
+	}
+	else {
+		memcpy(bytes, p, size);
+	}
+
+	switch (type) {
+	case PLY_TYPE_INT8: { signed char v; memcpy(&v, bytes, 1); return v; }
+	case PLY_TYPE_UINT8: { unsigned char v; memcpy(&v, bytes, 1); return v; }
+	case PLY_TYPE_INT16: { short v; memcpy(&v, bytes, 2); return v; }
+	case PLY_TYPE_UINT16: { unsigned short v; memcpy(&v, bytes, 2); return v; }
+	case PLY_TYPE_INT32: { int v; memcpy(&v, bytes, 4); return v; }
+	case PLY_TYPE_UINT32: { unsigned int v; memcpy(&v, bytes, 4); return v; }
+	case PLY_TYPE_FLOAT32: { float v; memcpy(&v, bytes, 4); return v; }
+	case PLY_TYPE_FLOAT64: { double v; memcpy(&v, bytes, 8); return v; }
+	}
+	return 0;
+}
+
+// Decodes the vertex at [p] in a binary file into [values] (indexed by
+// PLY_TARGET_); colors come out as 0-255
+inline void decode_ply_vertex(const unsigned char* p, const ply_element_layout& e,
+	const ply_mesh_layout& mesh, bool swap, double* values) {
+
+	unsigned int offset = 0;
+	for (unsigned int j = 0; j < e.properties.size(); j++) {
+		int type = e.properties[j].type;
+		int target = mesh.targets[j];
+		if (target != PLY_TARGET_NONE) {
+			double value = ply_scalar_value(p + offset, type, swap);
+			if (target >= PLY_TARGET_RED && target <= PLY_TARGET_ALPHA)
+				value = ply_color_value(value, type);
+			values[target] = value;
+		}
+		offset += ply_type_sizes[type];
+	}
+}
+
+// Hands out the body of the file a block at a time
+struct ply_block_reader {
+
+	FILE* f;
+	int format;
+	bool swap;
+
+	std::vector<unsigned char> buffer;
+	size_t pos;
+	size_t end;
+
+	ply_block_reader(FILE* file, const ply_file_layout& layout);
+
+	// Makes sure at least [n] bytes are available at [pos]; returns false if
+	// the file ends first
+	inline bool ensure(size_t n) {
+		if (end - pos >= n) return true;
+		return refill(n);
+	}
+
+	const unsigned char* data() const { return &(buffer[pos]); }
+
+	bool refill(size_t n);
+
+	// Reads one value (from text or binary, depending on the format)
+	bool read_value(int type, double& value);
+
+	// Reads past a property or an element we don't use
+	bool skip_property(const ply_property_layout& p);
+	bool skip_element(const ply_element_layout& e);
+
+	// Reads one vertex into [values] (indexed by PLY_TARGET_)
+	bool read_vertex(const ply_element_layout& e, const ply_mesh_layout& mesh, double* values);
+
+	// Reads one face, putting its vertex indices in [indices]; fails (and
+	// says so) if an index isn't less than [nvertices]
+	bool read_face(const ply_element_layout& e, const ply_mesh_layout& mesh,
+		unsigned int nvertices, std::vector<unsigned int>& indices);
+
+protected:
+	bool read_ascii_value(double& value);
+};
+
+#endif
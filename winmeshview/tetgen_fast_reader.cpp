@@ -0,0 +1,992 @@
+/******
+*
+* Written by Dan Morris
+* dmorris@cs.stanford.edu
+* http://cs.stanford.edu/~dmorris
+*
+* You can do anything you want with this file as long as this header
+* stays on it and I am credited when it's appropriate.
+*
+******/
+
+/***********
+
+  Fast readers for TetGen .node and .ele files.
+
+  The file is mapped into memory, the header is read just as the fgets()
+  readers in tetgen_loader.cpp read it, and the rest is split into chunks
+  of whole lines that are parsed on every processor, straight into the
+  vertex array and m_tets:
+
+  * a first pass counts the data (non-comment) lines in each chunk, so
+    each chunk knows which point/tet its first line is
+
+  * a second pass tokenizes each line (on spaces and tabs, like strtok)
+    and converts each field with the scanners below; numbers with up to 15
+    significant digits and small exponents are converted exactly (so
+    they're identical to what sscanf gives), and anything else is handed to
+    sscanf itself
+
+  The fgets() readers put up with all sorts of things that never appear in
+  TetGen's own output (points out of order, lines longer than their
+  buffers, fields they only partially parse...); rather than imitate all
+  of that, the fast readers give up on any file they don't fully
+  understand, having changed nothing, and let the fgets() readers load it.
+
+  Everything that depends on the order of the tets (small-tet removal, the
+  order in which each vertex's normal is summed, and the console output) is
+  done in file order, so the resulting mesh is identical to the one the
+  fgets() reader builds.
+
+***********/
+
+#include "tetgen_loader.h"
+#include <conio.h>
+#include "cTetMesh.h"
+#include "CVertex.h"
+#include "CTriangle.h"
+#include "parallel_for.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// The size of the buffer the fgets() readers read lines into; any line
+// (including its newline) longer than TETGEN_LINE_BUFFER-1 would be split
+#define TETGEN_LINE_BUFFER 1000
+#define TETGEN_MAX_LINE_LENGTH (TETGEN_LINE_BUFFER - 2)
+
+// Longest field we'll copy out to hand to sscanf
+#define TETGEN_MAX_FIELD_LENGTH 63
+
+// Bytes of text per parallel_for chunk (rounded up to a whole line)
+#define TETGEN_PARSE_CHUNK_BYTES (1<<20)
+
+// Tets (or vertices) per parallel_for chunk for per-tet work
+#define TETGEN_TET_CHUNK_SIZE 65536
+
+#define TET_FLAG_REMOVED           1
+#define TET_FLAG_DEGENERATE_NORMAL 2
+
+
+/***
+Mapping
+***/
+
+struct tetgen_mapped_file {
+
+	const char* data;
+	size_t size;
+
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int file_descriptor;
+#endif
+
+	tetgen_mapped_file() {
+		data = 0;
+		size = 0;
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = 0;
+#else
+		file_descriptor = -1;
+#endif
+	}
+
+	~tetgen_mapped_file() {
+		close();
+	}
+
+	// Returns false if the file can't be mapped (which includes empty files)
+	bool open(const char* filename) {
+
+#ifdef _WIN32
+		file = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN, 0);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER file_size;
+		if (GetFileSizeEx(file, &file_size) == 0 || file_size.QuadPart == 0 ||
+			(unsigned long long)(file_size.QuadPart) > (size_t)(-1)) {
+			close();
+			return false;
+		}
+		size = (size_t)(file_size.QuadPart);
+
+		mapping = CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0);
+		if (mapping == 0) {
+			close();
+			return false;
+		}
+		data = (const char*)(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		file_descriptor = ::open(filename, O_RDONLY);
+		if (file_descriptor < 0) return false;
+
+		struct stat st;
+		if (fstat(file_descriptor, &st) != 0 || st.st_size == 0) {
+			close();
+			return false;
+		}
+		size = (size_t)(st.st_size);
+
+		void* p = mmap(0, size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+		data = (p == MAP_FAILED) ? 0 : (const char*)(p);
+#endif
+
+		if (data == 0) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = 0;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data) munmap((void*)(data), size);
+		if (file_descriptor >= 0) ::close(file_descriptor);
+		file_descriptor = -1;
+#endif
+		data = 0;
+		size = 0;
+	}
+};
+
+// Copies the next line into [buf] exactly as fgets(buf,n,f) would, and
+// advances [p] past it; returns false at the end of the file
+static bool mapped_fgets(char* buf, int n, const char*& p, const char* end) {
+
+	if (p >= end) return false;
+
+	int i = 0;
+	while (i < n - 1 && p < end) {
+		char c = *(p++);
+		buf[i++] = c;
+		if (c == '\n') break;
+	}
+	buf[i] = '\0';
+	return true;
+}
+
+// The newline that ends the line starting at [p], or [end] if there isn't one
+static inline const char* find_line_end(const char* p, const char* end) {
+	const char* newline = (const char*)(memchr(p, '\n', end - p));
+	return newline ? newline : end;
+}
+
+static inline const char* next_line_start(const char* line_end, const char* end) {
+	return (line_end < end) ? (line_end + 1) : end;
+}
+
+
+/***
+Scanning
+***/
+
+static inline bool is_digit(char c) {
+	return (c >= '0' && c <= '9');
+}
+
+// Finds the next field in [p,line_end), as strtok(0,"\t ") would; returns
+// false if the line has run out.  A carriage return ends the line.
+static inline bool next_field(const char*& p, const char* line_end,
+	const char*& field, const char*& field_end) {
+
+	while (p < line_end && (*p == ' ' || *p == '\t')) p++;
+	if (p == line_end || *p == '\r') return false;
+
+	field = p;
+	while (p < line_end && *p != ' ' && *p != '\t' && *p != '\r') p++;
+	field_end = p;
+	return true;
+}
+
+// Runs sscanf on a copy of a field, for the numbers the scanners below
+// don't convert themselves
+template <class T>
+static bool sscanf_field(const char* field, const char* field_end, const char* format, T* value) {
+
+	size_t n = field_end - field;
+	if (n > TETGEN_MAX_FIELD_LENGTH) return false;
+
+	char buf[TETGEN_MAX_FIELD_LENGTH + 1];
+	memcpy(buf, field, n);
+	buf[n] = '\0';
+	return (sscanf(buf, format, value) == 1);
+}
+
+// Each scanner accepts only a field that is entirely a number of its type;
+// anything else (including things sscanf would partially accept, like
+// "12abc") makes the whole file fall back to the fgets() reader.
+
+static bool scan_unsigned(const char* field, const char* field_end, unsigned int& value) {
+
+	const char* p = field;
+	if (p < field_end && *p == '+') p++;
+
+	const char* digits = p;
+	if (p == field_end) return false;
+
+	unsigned int v = 0;
+	for (; p < field_end; p++) {
+		if (!is_digit(*p)) return false;
+		v = v * 10 + (*p - '0');
+	}
+
+	if (field_end - digits > 9) return sscanf_field(field, field_end, "%u", &value);
+
+	value = v;
+	return true;
+}
+
+static bool scan_int(const char* field, const char* field_end, int& value) {
+
+	const char* p = field;
+	bool negative = false;
+	if (p < field_end && (*p == '+' || *p == '-')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	const char* digits = p;
+	if (p == field_end) return false;
+
+	int v = 0;
+	for (; p < field_end; p++) {
+		if (!is_digit(*p)) return false;
+		v = v * 10 + (*p - '0');
+	}
+
+	if (field_end - digits > 9) return sscanf_field(field, field_end, "%d", &value);
+
+	value = negative ? -v : v;
+	return true;
+}
+
+// Every power of ten that's exactly representable as a double
+static const double exact_powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Accepts [+-]digits[.digits][(e|E)[+-]digits].  When the digits form an
+// integer below 2^53 and the exponent is within the table above, one
+// multiply or divide of two exact doubles gives the correctly-rounded
+// result, i.e. what sscanf("%lf") gives; everything else goes to sscanf.
+static bool scan_double(const char* field, const char* field_end, double& value) {
+
+	const char* p = field;
+	bool negative = false;
+	if (p < field_end && (*p == '+' || *p == '-')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int significant_digits = 0;
+	int digits = 0;
+	int exponent = 0;
+
+	for (; p < field_end && is_digit(*p); p++, digits++) {
+		if (mantissa == 0 && *p == '0') continue;
+		if (significant_digits < 19) mantissa = mantissa * 10 + (*p - '0');
+		else exponent++;
+		significant_digits++;
+	}
+
+	if (p < field_end && *p == '.') {
+		p++;
+		for (; p < field_end && is_digit(*p); p++, digits++) {
+			if (mantissa == 0 && *p == '0') {
+				exponent--;
+				continue;
+			}
+			if (significant_digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+			significant_digits++;
+		}
+	}
+
+	if (digits == 0) return false;
+
+	if (p < field_end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negative_exponent = false;
+		if (p < field_end && (*p == '+' || *p == '-')) {
+			negative_exponent = (*p == '-');
+			p++;
+		}
+		if (p == field_end) return false;
+		int e = 0;
+		for (; p < field_end && is_digit(*p); p++) {
+			if (e < 100000) e = e * 10 + (*p - '0');
+		}
+		exponent += negative_exponent ? -e : e;
+	}
+
+	if (p != field_end) return false;
+
+	if (mantissa == 0) {
+		value = negative ? -0.0 : 0.0;
+		return true;
+	}
+
+	if (significant_digits > 15 || exponent < -22 || exponent > 22)
+		return sscanf_field(field, field_end, "%lf", &value);
+
+	double v = (double)(mantissa);
+	if (exponent < 0) v /= exact_powers_of_ten[-exponent];
+	else v *= exact_powers_of_ten[exponent];
+
+	value = negative ? -v : v;
+	return true;
+}
+
+
+/***
+Parallel passes
+***/
+
+struct tetgen_text_chunk {
+	const char* begin;
+	const char* end;
+
+	// The data (non-comment) lines in this chunk, and the number of data
+	// lines before it
+	unsigned int n_data_lines;
+	unsigned int first_data_line;
+
+	bool failed;
+};
+
+struct tetgen_parse_job {
+
+	std::vector<tetgen_text_chunk> chunks;
+
+	// Data lines past this many are ignored
+	unsigned int n_lines;
+
+	// The number of the first point/tet (zero or one); each point or tet
+	// must be numbered one after the last
+	unsigned int first_index;
+
+	// For node files
+	unsigned int nattributes;
+	unsigned int nmarkers;
+	cVertex* vertices;
+	int* markers;
+
+	// For element files
+	unsigned int nodes_per_tet;
+	unsigned int nvertices;
+	unsigned int* tets;
+	unsigned char* flags;
+	unsigned char* flagged_chunks;
+	bool remove_small_tets;
+	float small_tet_volume;
+	unsigned int ntets_kept;
+	unsigned int vertices_per_normal_chunk;
+	cTetMesh* mesh;
+	cTriangle* triangles;
+};
+
+// Splits [begin,end) into chunks of whole lines
+static void split_into_chunks(const char* begin, const char* end,
+	std::vector<tetgen_text_chunk>& chunks) {
+
+	while (begin < end) {
+		tetgen_text_chunk c;
+		c.begin = begin;
+		if ((size_t)(end - begin) <= TETGEN_PARSE_CHUNK_BYTES) c.end = end;
+		else c.end = next_line_start(find_line_end(begin + TETGEN_PARSE_CHUNK_BYTES, end), end);
+		c.n_data_lines = c.first_data_line = 0;
+		c.failed = false;
+		chunks.push_back(c);
+		begin = c.end;
+	}
+}
+
+static void count_lines_chunk(void* param, int chunk, int thread_index) {
+
+	tetgen_parse_job* job = (tetgen_parse_job*)(param);
+	tetgen_text_chunk& c = job->chunks[chunk];
+
+	const char* p = c.begin;
+	while (p < c.end) {
+		const char* line_end = find_line_end(p, c.end);
+		if (line_end - p > TETGEN_MAX_LINE_LENGTH) {
+			c.failed = true;
+			return;
+		}
+		if (*p != '#') c.n_data_lines++;
+		p = next_line_start(line_end, c.end);
+	}
+}
+
+// Counts the data lines in every chunk; returns the total, or -1 if any
+// line is too long for the fgets() readers to have read it whole
+static long long count_data_lines(tetgen_parse_job& job) {
+
+	parallel_for_chunks((int)(job.chunks.size()), count_lines_chunk, &job);
+
+	unsigned long long total = 0;
+	for (unsigned int i = 0; i < job.chunks.size(); i++) {
+		if (job.chunks[i].failed) return -1;
+		job.chunks[i].first_data_line = (unsigned int)(total);
+		total += job.chunks[i].n_data_lines;
+	}
+
+	if (total > 0xffffffffULL) return -1;
+	return (long long)(total);
+}
+
+static bool any_chunk_failed(const tetgen_parse_job& job) {
+	for (unsigned int i = 0; i < job.chunks.size(); i++) {
+		if (job.chunks[i].failed) return true;
+	}
+	return false;
+}
+
+// Reads the number of the first point/tet in [p,end); returns false if
+// there isn't one
+static bool read_first_index(const char* p, const char* end, unsigned int& index) {
+
+	while (p < end) {
+		const char* line_end = find_line_end(p, end);
+		if (*p != '#') {
+			const char *field, *field_end;
+			if (next_field(p, line_end, field, field_end) == false) return false;
+			return scan_unsigned(field, field_end, index);
+		}
+		p = next_line_start(line_end, end);
+	}
+	return false;
+}
+
+static void parse_node_chunk(void* param, int chunk, int thread_index) {
+
+	tetgen_parse_job* job = (tetgen_parse_job*)(param);
+	tetgen_text_chunk& c = job->chunks[chunk];
+
+	unsigned int point = c.first_data_line;
+	const char *field, *field_end;
+
+	const char* p = c.begin;
+	while (p < c.end) {
+
+		const char* line_end = find_line_end(p, c.end);
+		const char* line_start = p;
+		p = next_line_start(line_end, c.end);
+
+		if (*line_start == '#') continue;
+		if (point >= job->n_lines) return;
+
+		const char* cur = line_start;
+
+		unsigned int point_index;
+		if (next_field(cur, line_end, field, field_end) == false ||
+			scan_unsigned(field, field_end, point_index) == false ||
+			point_index != point + job->first_index) {
+			c.failed = true;
+			return;
+		}
+
+		cVector3d pos;
+		for (unsigned int k = 0; k < 3; k++) {
+			double value;
+			if (next_field(cur, line_end, field, field_end) == false ||
+				scan_double(field, field_end, value) == false) {
+				c.failed = true;
+				return;
+			}
+			pos[k] = value;
+		}
+
+		// Attributes are read (and checked) but not used, like in read_node_file
+		for (unsigned int k = 0; k < job->nattributes; k++) {
+			double value;
+			if (next_field(cur, line_end, field, field_end) == false ||
+				scan_double(field, field_end, value) == false) {
+				c.failed = true;
+				return;
+			}
+		}
+
+		int* markerpos = job->markers + (job->nmarkers * point);
+		for (unsigned int k = 0; k < job->nmarkers; k++) {
+			if (next_field(cur, line_end, field, field_end) == false ||
+				scan_int(field, field_end, markerpos[k]) == false) {
+				c.failed = true;
+				return;
+			}
+		}
+
+		cVertex v(pos.x, pos.y, pos.z);
+		v.setNormal(0, 0, 0);
+		job->vertices[point] = v;
+
+		point++;
+	}
+}
+
+static void parse_element_chunk(void* param, int chunk, int thread_index) {
+
+	tetgen_parse_job* job = (tetgen_parse_job*)(param);
+	tetgen_text_chunk& c = job->chunks[chunk];
+
+	unsigned int tet = c.first_data_line;
+	const char *field, *field_end;
+
+	const char* p = c.begin;
+	while (p < c.end) {
+
+		const char* line_end = find_line_end(p, c.end);
+		const char* line_start = p;
+		p = next_line_start(line_end, c.end);
+
+		if (*line_start == '#') continue;
+
+		const char* cur = line_start;
+
+		unsigned int tet_index;
+		if (next_field(cur, line_end, field, field_end) == false ||
+			scan_unsigned(field, field_end, tet_index) == false ||
+			tet_index != tet + job->first_index) {
+			c.failed = true;
+			return;
+		}
+
+		unsigned int* t = job->tets + ((size_t)(tet) * job->nodes_per_tet);
+		for (unsigned int k = 0; k < job->nodes_per_tet; k++) {
+
+			unsigned int value;
+			if (next_field(cur, line_end, field, field_end) == false ||
+				scan_unsigned(field, field_end, value) == false) {
+				c.failed = true;
+				return;
+			}
+
+			// One-indexed tet files use one-indexed vertex indices
+			if (job->first_index) {
+				if (value == 0) {
+					c.failed = true;
+					return;
+				}
+				value--;
+			}
+
+			if (value >= job->nvertices) {
+				c.failed = true;
+				return;
+			}
+
+			t[k] = value;
+		}
+
+		tet++;
+	}
+}
+
+// The positions and center of mass of a tet, computed exactly as
+// read_element_file computes them
+static inline void tet_geometry(const cVertex* vertex_array, const unsigned int* tet_indices,
+	cVector3d* positions, cVector3d& center_of_mass) {
+
+	center_of_mass.set(0, 0, 0);
+	for (int k = 0; k < 4; k++) {
+		int vertex_index = tet_indices[k];
+		positions[k] = vertex_array[vertex_index].getPos();
+		center_of_mass += positions[k];
+	}
+
+	center_of_mass /= 4.0;
+}
+
+static inline double tet_signed_volume(const cVector3d* positions) {
+	return (1.0 / 6.0) *
+		(positions[1] - positions[0]).dot(
+		((positions[2] - positions[0]).crossAndReturn(positions[3] - positions[0]))
+		);
+}
+
+static inline void tet_chunk_range(int chunk, unsigned int n, unsigned int& first, unsigned int& last) {
+	first = chunk * TETGEN_TET_CHUNK_SIZE;
+	last = first + TETGEN_TET_CHUNK_SIZE;
+	if (last > n) last = n;
+}
+
+static inline int num_tet_chunks(unsigned int n) {
+	return (int)((n + TETGEN_TET_CHUNK_SIZE - 1) / TETGEN_TET_CHUNK_SIZE);
+}
+
+// Finds the tets that will be removed for being too small, and the ones
+// with a vertex too close to their center to give it a normal
+static void flag_tets_chunk(void* param, int chunk, int thread_index) {
+
+	tetgen_parse_job* job = (tetgen_parse_job*)(param);
+
+	unsigned int first, last;
+	tet_chunk_range(chunk, job->n_lines, first, last);
+
+	bool flagged = false;
+	for (unsigned int i = first; i < last; i++) {
+
+		cVector3d positions[4];
+		cVector3d center_of_mass;
+		tet_geometry(job->vertices, job->tets + ((size_t)(i) * job->nodes_per_tet), positions, center_of_mass);
+
+		unsigned char flags = 0;
+		if (job->remove_small_tets && (fabs(tet_signed_volume(positions)) < job->small_tet_volume)) {
+			flags = TET_FLAG_REMOVED;
+		}
+		else {
+			for (int k = 0; k < 4; k++) {
+				if (cSub(positions[k], center_of_mass).length() < 0.00001)
+					flags |= TET_FLAG_DEGENERATE_NORMAL;
+			}
+		}
+
+		job->flags[i] = flags;
+		if (flags) flagged = true;
+	}
+
+	job->flagged_chunks[chunk] = flagged ? 1 : 0;
+}
+
+// Adds each tet's contribution to the normals of the vertices in one
+// range of vertices.  Every range visits the tets in file order, so each
+// vertex's normal is summed in the same order read_element_file sums it.
+static void accumulate_normals_chunk(void* param, int chunk, int thread_index) {
+
+	tetgen_parse_job* job = (tetgen_parse_job*)(param);
+
+	unsigned int first = chunk * job->vertices_per_normal_chunk;
+	unsigned int last = first + job->vertices_per_normal_chunk;
+	if (last > job->nvertices) last = job->nvertices;
+
+	for (unsigned int i = 0; i < job->ntets_kept; i++) {
+
+		const unsigned int* tet_indices = job->tets + ((size_t)(i) * job->nodes_per_tet);
+
+		int k;
+		for (k = 0; k < 4; k++) {
+			if (tet_indices[k] >= first && tet_indices[k] < last) break;
+		}
+		if (k == 4) continue;
+
+		cVector3d positions[4];
+		cVector3d center_of_mass;
+		tet_geometry(job->vertices, tet_indices, positions, center_of_mass);
+
+		for (k = 0; k < 4; k++) {
+			cVector3d normal = cSub(positions[k], center_of_mass);
+			if (normal.length() < 0.00001) continue;
+
+			int vertex_index = tet_indices[k];
+			if (tet_indices[k] < first || tet_indices[k] >= last) continue;
+
+			normal.normalize();
+			cVertex* vp = job->vertices + vertex_index;
+			vp->setNormal(vp->getNormal() + normal);
+		}
+	}
+}
+
+static void build_triangles_chunk(void* param, int chunk, int thread_index) {
+
+	tetgen_parse_job* job = (tetgen_parse_job*)(param);
+
+	unsigned int first, last;
+	tet_chunk_range(chunk, job->ntets_kept, first, last);
+
+	for (unsigned int i = first; i < last; i++) {
+
+		const unsigned int* tet_indices = job->tets + ((size_t)(i) * job->nodes_per_tet);
+		unsigned int face_index = i * 4;
+
+		for (int t = 0; t < 4; t++) {
+			cTriangle triangle(job->mesh,
+				tet_indices[(tet_triangle_faces[t][0])],
+				tet_indices[(tet_triangle_faces[t][1])],
+				tet_indices[(tet_triangle_faces[t][2])]);
+			triangle.m_allocated = 1;
+			triangle.m_index = face_index;
+			job->triangles[face_index++] = triangle;
+		}
+	}
+}
+
+static void normalize_normals_chunk(void* param, int chunk, int thread_index) {
+
+	tetgen_parse_job* job = (tetgen_parse_job*)(param);
+
+	unsigned int first, last;
+	tet_chunk_range(chunk, job->nvertices, first, last);
+
+	for (unsigned int k = first; k < last; k++) {
+		job->vertices[k].m_normal.normalize();
+	}
+}
+
+
+/***
+The readers
+***/
+
+bool cTetGenLoader::fast_read_node_file(const char* filename) {
+
+	tetgen_mapped_file file;
+	if (file.open(filename) == false) return false;
+
+	const char* p = file.data;
+	const char* end = file.data + file.size;
+	char buf[TETGEN_LINE_BUFFER];
+
+	// Find the header line, holding on to the comments before it (which may
+	// have scale/offset information) until we know we can load the file
+	std::vector<std::string> header_comments;
+	while (1) {
+		if (mapped_fgets(buf, TETGEN_LINE_BUFFER, p, end) == false) return false;
+		if (buf[0] == '#') {
+			header_comments.push_back(buf);
+			continue;
+		}
+		if (buf[0] != '\0' && buf[0] != '\n') break;
+	}
+
+	unsigned int npoints, dimension, nattributes, nmarkers;
+	unsigned int* header_values[4] = { &npoints, &dimension, &nattributes, &nmarkers };
+	char* token = strtok(buf, "\t ");
+	for (int i = 0; i < 4; i++) {
+		if (token == 0 || sscanf(token, "%u", header_values[i]) != 1) return false;
+		token = strtok(0, "\t ");
+	}
+
+	if (dimension != 3 || npoints == 0) return false;
+
+	cTetMesh* mesh = this->current_mesh;
+	std::vector<cVertex>* vertex_vector = mesh->pVertices();
+	if (vertex_vector->size() != 0) return false;
+
+	tetgen_parse_job job;
+	if (read_first_index(p, end, job.first_index) == false) return false;
+
+	// The first point is range-checked before it's taken to mean "one-indexed"
+	if (job.first_index > 1 || (job.first_index == 1 && npoints < 2)) return false;
+
+	split_into_chunks(p, end, job.chunks);
+	long long nlines = count_data_lines(job);
+	if (nlines < (long long)(npoints)) return false;
+
+	job.n_lines = npoints;
+	job.nattributes = nattributes;
+	job.nmarkers = nmarkers;
+
+	cVertex v(0, 0, 0);
+	v.setNormal(0, 0, 0);
+	vertex_vector->reserve(npoints);
+	vertex_vector->resize(npoints, v);
+	job.vertices = &((*vertex_vector)[0]);
+	job.markers = (nmarkers > 0) ? new int[nmarkers*npoints] : 0;
+
+	parallel_for_chunks((int)(job.chunks.size()), parse_node_chunk, &job);
+
+	if (any_chunk_failed(job)) {
+		vertex_vector->clear();
+		if (job.markers) delete[] job.markers;
+		return false;
+	}
+
+	// Everything from here on is what read_node_file would have done
+	for (unsigned int i = 0; i < header_comments.size(); i++) {
+		read_node_header_comment(header_comments[i].c_str());
+	}
+
+	_cprintf("Loading %d points with %d attributes and %d boundary markers\n",
+		npoints, nattributes, nmarkers);
+
+	if (nmarkers > 0) {
+		mesh->m_nVertexBoundaryMarkers = nmarkers;
+		mesh->m_vertexBoundaryMarkers = job.markers;
+	}
+
+	one_indexed_points = job.first_index;
+	if (one_indexed_points) _cprintf("Assuming one-indexed points...\n");
+
+	_cprintf("Successfully loaded node file %s (%u nodes)\n", filename, npoints);
+
+	return true;
+}
+
+
+bool cTetGenLoader::fast_read_element_file(const char* filename) {
+
+	tetgen_mapped_file file;
+	if (file.open(filename) == false) return false;
+
+	const char* p = file.data;
+	const char* end = file.data + file.size;
+	char buf[TETGEN_LINE_BUFFER];
+
+	// Get the header line
+	while (1) {
+		if (mapped_fgets(buf, TETGEN_LINE_BUFFER, p, end) == false) return false;
+		if (buf[0] != '#' && buf[0] != '\0' && buf[0] != '\n') break;
+	}
+
+	unsigned int ntets, nodes_per_tet, nmarkers;
+	unsigned int* header_values[3] = { &ntets, &nodes_per_tet, &nmarkers };
+	char* token = strtok(buf, "\t ");
+	for (int i = 0; i < 3; i++) {
+		if (token == 0 || sscanf(token, "%u", header_values[i]) != 1) return false;
+		token = strtok(0, "\t ");
+	}
+
+	if (ntets == 0 || nodes_per_tet < 4) return false;
+
+	cTetMesh* top_level_mesh = this->current_mesh;
+	std::vector<cVertex>* vertex_vector = top_level_mesh->pVertices();
+	if (vertex_vector->size() == 0) return false;
+
+	tetgen_parse_job job;
+	if (read_first_index(p, end, job.first_index) == false) return false;
+	if (job.first_index > 1 || (job.first_index == 1 && ntets < 2)) return false;
+
+	split_into_chunks(p, end, job.chunks);
+	long long nlines = count_data_lines(job);
+	if (nlines < 0 || nlines > (long long)(ntets)) return false;
+
+	job.n_lines = (unsigned int)(nlines);
+	job.nodes_per_tet = nodes_per_tet;
+	job.vertices = &((*vertex_vector)[0]);
+	job.nvertices = vertex_vector->size();
+	job.tets = new unsigned int[(size_t)(nodes_per_tet) * ntets];
+
+	parallel_for_chunks((int)(job.chunks.size()), parse_element_chunk, &job);
+
+	if (any_chunk_failed(job)) {
+		delete[] job.tets;
+		return false;
+	}
+
+	// Everything from here on is what read_element_file would have done
+	_cprintf("remove tets: %d, %f\n", (int)m_remove_small_tets_at_import, m_small_import_tet_volume);
+	_cprintf("Loading %d %d-node tets with %d boundary markers\n",
+		ntets, nodes_per_tet, nmarkers);
+
+	// Tet markers are always ignored (see read_element_file), so all the tets
+	// go in the top-level mesh
+	top_level_mesh->m_nTets = ntets;
+	top_level_mesh->m_tets = job.tets;
+	if (loaded_face_file == false)
+		top_level_mesh->setMaterial(default_materials[0]);
+
+	bool build_tet_faces = (loaded_face_file == false && m_boundary_faces_only_at_import == false);
+	if (build_tet_faces) {
+		unsigned int nfaces = ntets * 4;
+		_cprintf("Reserving %d faces...\n", nfaces);
+		top_level_mesh->pTriangles()->reserve(nfaces);
+		cTriangle t(0, 0, 0, 0);
+		top_level_mesh->pTriangles()->resize(nfaces, t);
+		top_level_mesh->setMaterial(default_materials[0]);
+	}
+
+	if (job.first_index) _cprintf("Assuming one-indexed tets...\n");
+
+	job.remove_small_tets = m_remove_small_tets_at_import;
+	job.small_tet_volume = m_small_import_tet_volume;
+	std::vector<unsigned char> flags(job.n_lines);
+	job.flags = &(flags[0]);
+
+	int ntet_chunks = num_tet_chunks(job.n_lines);
+	std::vector<unsigned char> flagged_chunks(ntet_chunks);
+	job.flagged_chunks = &(flagged_chunks[0]);
+	parallel_for_chunks(ntet_chunks, flag_tets_chunk, &job);
+
+	// Drop the small tets and report the degenerate ones, in file order
+	unsigned int ntets_read = 0;
+	for (int chunk = 0; chunk < ntet_chunks; chunk++) {
+
+		unsigned int first, last;
+		tet_chunk_range(chunk, job.n_lines, first, last);
+
+		if (flagged_chunks[chunk] == 0 && ntets_read == first) {
+			ntets_read = last;
+			continue;
+		}
+
+		for (unsigned int i = first; i < last; i++) {
+
+			unsigned int* tet_indices = job.tets + ((size_t)(i) * nodes_per_tet);
+
+			if (flags[i]) {
+				cVector3d positions[4];
+				cVector3d center_of_mass;
+				tet_geometry(job.vertices, tet_indices, positions, center_of_mass);
+
+				if (flags[i] & TET_FLAG_REMOVED) {
+					_cprintf("Ignoring tet %d due to volume error (%lf)...\n", ntets_read, tet_signed_volume(positions));
+					continue;
+				}
+
+				for (int k = 0; k < 4; k++) {
+					double length = cSub(positions[k], center_of_mass).length();
+					if (length < 0.00001) {
+						_cprintf("Ignoring tet %d due to normal error (%lf)...\n", ntets_read, length);
+					}
+				}
+			}
+
+			if (ntets_read != i) {
+				memmove(job.tets + ((size_t)(ntets_read) * nodes_per_tet), tet_indices,
+					nodes_per_tet * sizeof(unsigned int));
+			}
+			ntets_read++;
+		}
+	}
+
+	job.ntets_kept = ntets_read;
+
+	int nthreads = parallel_resolve_num_threads(0);
+	job.vertices_per_normal_chunk = (job.nvertices + nthreads - 1) / nthreads;
+	parallel_for_chunks(nthreads, accumulate_normals_chunk, &job, nthreads);
+
+	if (build_tet_faces) {
+		job.mesh = top_level_mesh;
+		job.triangles = &((*(top_level_mesh->pTriangles()))[0]);
+		parallel_for_chunks(num_tet_chunks(ntets_read), build_triangles_chunk, &job);
+	}
+
+	if (ntets_read != ntets) {
+		_cprintf("Expected %d tets, found %d\n", ntets, ntets_read);
+		top_level_mesh->m_nTets = ntets_read;
+	}
+
+	loaded_element_file = true;
+
+	// Normalize all the vertices
+	parallel_for_chunks(num_tet_chunks(job.nvertices), normalize_normals_chunk, &job);
+
+	_cprintf("Successfully loaded element file %s (%u tets)\n", filename, ntets_read);
+
+	return true;
+}
@@ -37,6 +37,7 @@ typedef enum {
 
 bool cTetGenLoader::m_remove_small_tets_at_import = DEFAULT_REMOVE_SMALL_TETS_AT_IMPORT;
 float cTetGenLoader::m_small_import_tet_volume = DEFAULT_SMALL_IMPORT_TET_VOLUME;
+bool cTetGenLoader::m_boundary_faces_only_at_import = DEFAULT_BOUNDARY_FACES_ONLY_AT_IMPORT;
 
 cTetGenLoader::cTetGenLoader() {
 
@@ -271,6 +272,14 @@ cMesh* cTetGenLoader::load_tetgen_file(cWorld* world, const char* filename, cons
 
 	}
 
+	// Without a face file, we may only want the faces on the outside of the
+	// tets
+	bool extracted_boundary = false;
+	if (m_boundary_faces_only_at_import && loaded_element_file && loaded_face_file == false) {
+		current_mesh->extractBoundaryTriangles();
+		extracted_boundary = true;
+	}
+
 	// TODO: which order should this happen in?
 
 	_cprintf("Before removing redundancy, loaded mesh has %d vertices, %d faces, and %d tets\n",
@@ -278,7 +287,10 @@ cMesh* cTetGenLoader::load_tetgen_file(cWorld* world, const char* filename, cons
 		current_mesh->getNumTriangles(true),
 		current_mesh->getNumTets(true)
 	);
-	current_mesh->removeRedundantTriangles(true);
+
+	// Boundary triangles are already unique, and m_tetFaceTriangles depends
+	// on their order
+	if (extracted_boundary == false) current_mesh->removeRedundantTriangles(true);
 
 	current_mesh->fixTriangleOrientations(true);
 	_cprintf("Computing normals...\n");
@@ -394,8 +406,10 @@ bool cTetGenLoader::read_element_file(FILE* f, const char* filename, int element
 			top_level_mesh->setMaterial(default_materials[0]);
 	}
 
-	// Allocate faces if necessary
-	if (loaded_face_file == 0 && nmarkers == 0) {
+	// Allocate faces if necessary; if we're only keeping boundary faces,
+	// those get built once all the tets are loaded
+	bool build_tet_faces = (loaded_face_file == false && m_boundary_faces_only_at_import == false);
+	if (build_tet_faces && nmarkers == 0) {
 		unsigned int nfaces = ntets * 4;
 		_cprintf("Reserving %d faces...\n", nfaces);
 		top_level_mesh->pTriangles()->reserve(nfaces);
@@ -640,7 +654,7 @@ bool cTetGenLoader::read_element_file(FILE* f, const char* filename, int element
 			memcpy(top_level_mesh->m_tets + (nodes_per_tet*tet_index), tet_indices, nodes_per_tet * sizeof(unsigned int));
 
 			// Create triangles in our face array if necessary
-			if (loaded_face_file == false) {
+			if (build_tet_faces) {
 
 				// TODO: what is the actual location of the four "important"
 				// tets in the 10-node format?
@@ -758,6 +772,47 @@ bool cTetGenLoader::read_element_file(FILE* f, const char* filename, int element
 }
 
 
+// Handles a comment line from the top of a node file, picking up the
+// scale/offset information that some of our tools write there
+void cTetGenLoader::read_node_header_comment(const char* buf) {
+
+	const char* token = buf + 2;
+	cTetMesh* top_level_mesh = this->current_mesh;
+	if (strncmp(token, "SCALE", strlen("SCALE")) == 0) {
+		token += (strlen("SCALE") + 1);
+		float scale;
+		int result = sscanf(token, "%f", &scale);
+		if (result != 1) {
+			_cprintf("Could not read scale factor from %s\n", buf);
+			return;
+		}
+		top_level_mesh->mesh_prescale = scale;
+		_cprintf("Prescale: %f\n", scale);
+	}
+	else if (strncmp(token, "OFFSET", strlen("OFFSET")) == 0) {
+		token += (strlen("OFFSET") + 1);
+		float ox, oy, oz;
+		int result = sscanf(token, "%f %f %f", &ox, &oy, &oz);
+		if (result != 3) {
+			_cprintf("Could not read offset from %s\n", buf);
+			return;
+		}
+		top_level_mesh->mesh_preoffset.set(ox, oy, oz);
+		_cprintf("Pre-offset: %s\n", top_level_mesh->mesh_preoffset.str(3).c_str());
+	}
+	else if (strncmp(token, "ZERO", strlen("ZERO")) == 0) {
+		token += (strlen("ZERO") + 1);
+		float ox, oy, oz;
+		int result = sscanf(token, "%f %f %f", &ox, &oy, &oz);
+		if (result != 3) {
+			_cprintf("Could not read offset from %s\n", buf);
+			return;
+		}
+		top_level_mesh->mesh_prezero.set(ox, oy, oz);
+		_cprintf("Pre-zero: %s\n", top_level_mesh->mesh_prezero.str(3).c_str());
+	}
+}
+
 bool cTetGenLoader::read_node_file(FILE* f, const char* filename, int node_format) {
 
 	// Node format:
@@ -794,42 +849,8 @@ bool cTetGenLoader::read_node_file(FILE* f, const char* filename, int node_forma
 
 		// Skip leading comments, unless they give us scale/offset information
 		if (buf[0] == '#') {
-			char* token = buf + 2;
-			cTetMesh* top_level_mesh = this->current_mesh;
-			if (strncmp(token, "SCALE", strlen("SCALE")) == 0) {
-				token += (strlen("SCALE") + 1);
-				float scale;
-				int result = sscanf(token, "%f", &scale);
-				if (result != 1) {
-					_cprintf("Could not read scale factor from %s\n", buf);
-					continue;
-				}
-				top_level_mesh->mesh_prescale = scale;
-				_cprintf("Prescale: %f\n", scale);
-			}
-			else if (strncmp(token, "OFFSET", strlen("OFFSET")) == 0) {
-				token += (strlen("OFFSET") + 1);
-				float ox, oy, oz;
-				int result = sscanf(token, "%f %f %f", &ox, &oy, &oz);
-				if (result != 3) {
-					_cprintf("Could not read offset from %s\n", buf);
-					continue;
-				}
-				top_level_mesh->mesh_preoffset.set(ox, oy, oz);
-				_cprintf("Pre-offset: %s\n", top_level_mesh->mesh_preoffset.str(3).c_str());
-			}
-			else if (strncmp(token, "ZERO", strlen("ZERO")) == 0) {
-				token += (strlen("ZERO") + 1);
-				float ox, oy, oz;
-				int result = sscanf(token, "%f %f %f", &ox, &oy, &oz);
-				if (result != 3) {
-					_cprintf("Could not read offset from %s\n", buf);
-					continue;
-				}
-				top_level_mesh->mesh_prezero.set(ox, oy, oz);
-				_cprintf("Pre-zero: %s\n", top_level_mesh->mesh_prezero.str(3).c_str());
-			}
-			else continue;
+			read_node_header_comment(buf);
+			continue;
 		}
 		if (buf[0] != '#' && buf[0] != '\0' && buf[0] != '\n') break;
 	}
@@ -1288,6 +1309,10 @@ bool cTetGenLoader::load_element_file(const char* filename) {
 
 	loaded_element_file = false;
 
+	// Most files can be mapped and parsed in parallel; anything the fast
+	// reader isn't sure about comes through here instead
+	if (fast_read_element_file(filename)) return true;
+
 	FILE* f = fopen(filename, "rb");
 
 	if (f == 0) {
@@ -1307,6 +1332,8 @@ bool cTetGenLoader::load_node_file(const char* filename) {
 
 	_cprintf("Loading node file %s\n", filename);
 
+	if (fast_read_node_file(filename)) return true;
+
 	FILE* f = fopen(filename, "rb");
 
 	if (f == 0) {
@@ -46,6 +46,10 @@ public:
 	static bool m_remove_small_tets_at_import;
 	static float m_small_import_tet_volume;
 
+	// If set, tets loaded without a face file only get triangles for their
+	// boundary faces (see cTetMesh::extractBoundaryTriangles())
+	static bool m_boundary_faces_only_at_import;
+
 private:
 	cTetMesh* current_mesh;
 	bool loaded_face_file;
@@ -64,6 +68,15 @@ private:
 	bool read_element_file(FILE* f, const char* filename, int element_format = ELEMENT_FORMAT_ELE_FILE);
 	bool read_face_file(FILE* f, const char* filename, int face_format = FACE_FORMAT_FACE_FILE);
 	bool read_node_file(FILE* f, const char* filename, int node_format = NODE_FORMAT_NODE_FILE);
+	void read_node_header_comment(const char* buf);
+
+	// Memory-mapped, multithreaded readers for TetGen .node and .ele files
+	// (tetgen_fast_reader.cpp), which load exactly what the readers above
+	// would.  They return false without touching the mesh if they can't
+	// handle a file (including any file with errors in it), in which case
+	// the readers above should be used.
+	bool fast_read_node_file(const char* filename);
+	bool fast_read_element_file(const char* filename);
 
 	// Data for pre-counted element counts
 	unsigned int m_precounted_tets;
@@ -26,6 +26,7 @@
 #include "CImageLoader.h"
 #include "CPhantom3dofPointer.h"
 #include "meshExporter.h"
+#include "mesh_stream_converter.h"
 
 #ifndef M_PI
 #define M_PI 3.1415926535898
@@ -94,6 +95,7 @@ CwinmeshviewApp::CwinmeshviewApp() {
 	current_mesh_transform.model_scale_factor = 1.0;
 
 	m_current_param_index = 0;
+	m_exit_code = 0;
 	m_current_cut_plane = CUT_PLANE_NONE;
 	m_invert_clip_plane = false;
 	cutplane = 0;
@@ -151,7 +153,11 @@ int CwinmeshviewApp::ExitInstance() {
 	FreeConsole();
 	_cprintf("Exited winmeshview instance...\n");
 	// _getch();
-	return CWinApp::ExitInstance();
+	int result = CWinApp::ExitInstance();
+
+	// Let batch scripts know if a command-line conversion failed
+	if (m_exit_code) return m_exit_code;
+	return result;
 }
 
 
@@ -159,6 +165,15 @@ BOOL CwinmeshviewApp::InitInstance() {
 
 	_cprintf("Initializing winmeshview instance...\n");
 
+#ifdef COMPILING_WINMESHVIEW
+	// "winmeshview -convert input output" streams one model file to another
+	// without loading it (see mesh_stream_converter.h), then exits
+	if (__argc >= 2 && (strcmp(__argv[1], "-convert") == 0 || strcmp(__argv[1], "/convert") == 0)) {
+		m_exit_code = (run_command_line_conversion(__argc - 2, __argv + 2) == 0) ? 0 : 1;
+		return FALSE;
+	}
+#endif
+
 	memset(keys_to_handle, 0, sizeof(keys_to_handle));
 
 #ifdef COMPILING_WINMESHVIEW
@@ -67,6 +67,10 @@ public:
 	virtual void ParseParam(const TCHAR* pszParam, BOOL bFlag, BOOL bLast);
 	int m_current_param_index;
 
+	// Returned from ExitInstance() (non-zero if a command-line conversion
+	// failed)
+	int m_exit_code;
+
 	int m_current_cut_plane;
 	float m_current_cut_plane_position;
 	bool m_invert_clip_plane;